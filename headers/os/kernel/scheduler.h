@@ -52,6 +52,7 @@ enum be_task_flags {
 enum scheduler_mode {
 	SCHEDULER_MODE_LOW_LATENCY,
 	SCHEDULER_MODE_POWER_SAVING,
+	SCHEDULER_MODE_THROUGHPUT,
 };
 
 #if defined(__cplusplus)
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SPAWN_H_
+#define _SPAWN_H_
+
+
+#include <sched.h>
+#include <signal.h>
+#include <sys/types.h>
+
+
+typedef struct _posix_spawnattr				*posix_spawnattr_t;
+typedef struct _posix_spawn_file_actions	*posix_spawn_file_actions_t;
+
+
+/* posix_spawnattr_t flags */
+#define POSIX_SPAWN_RESETIDS		0x01
+#define POSIX_SPAWN_SETPGROUP		0x02
+#define POSIX_SPAWN_SETSIGDEF		0x10
+#define POSIX_SPAWN_SETSIGMASK		0x20
+#define POSIX_SPAWN_SETSID			0x40
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+extern int	posix_spawn(pid_t *pid, const char *path,
+				const posix_spawn_file_actions_t *fileActions,
+				const posix_spawnattr_t *attributes, char *const argv[],
+				char *const environment[]);
+extern int	posix_spawnp(pid_t *pid, const char *file,
+				const posix_spawn_file_actions_t *fileActions,
+				const posix_spawnattr_t *attributes, char *const argv[],
+				char *const environment[]);
+
+/* file actions functions */
+extern int	posix_spawn_file_actions_init(
+				posix_spawn_file_actions_t *fileActions);
+extern int	posix_spawn_file_actions_destroy(
+				posix_spawn_file_actions_t *fileActions);
+extern int	posix_spawn_file_actions_addopen(
+				posix_spawn_file_actions_t *fileActions, int fd,
+				const char *path, int openMode, mode_t mode);
+extern int	posix_spawn_file_actions_addclose(
+				posix_spawn_file_actions_t *fileActions, int fd);
+extern int	posix_spawn_file_actions_adddup2(
+				posix_spawn_file_actions_t *fileActions, int fd, int newFD);
+
+/* attributes functions */
+extern int	posix_spawnattr_init(posix_spawnattr_t *attributes);
+extern int	posix_spawnattr_destroy(posix_spawnattr_t *attributes);
+
+extern int	posix_spawnattr_getflags(const posix_spawnattr_t *attributes,
+				short *flags);
+extern int	posix_spawnattr_setflags(posix_spawnattr_t *attributes,
+				short flags);
+
+extern int	posix_spawnattr_getpgroup(const posix_spawnattr_t *attributes,
+				pid_t *processGroup);
+extern int	posix_spawnattr_setpgroup(posix_spawnattr_t *attributes,
+				pid_t processGroup);
+
+extern int	posix_spawnattr_getsigdefault(const posix_spawnattr_t *attributes,
+				sigset_t *signals);
+extern int	posix_spawnattr_setsigdefault(posix_spawnattr_t *attributes,
+				const sigset_t *signals);
+
+extern int	posix_spawnattr_getsigmask(const posix_spawnattr_t *attributes,
+				sigset_t *signals);
+extern int	posix_spawnattr_setsigmask(posix_spawnattr_t *attributes,
+				const sigset_t *signals);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif	/* _SPAWN_H_ */
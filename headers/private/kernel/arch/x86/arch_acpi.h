@@ -10,6 +10,7 @@
 #define ACPI_RSDT_SIGNATURE		"RSDT"
 #define ACPI_XSDT_SIGNATURE		"XSDT"
 #define ACPI_MADT_SIGNATURE		"APIC"
+#define ACPI_SRAT_SIGNATURE		"SRAT"
 
 #define ACPI_LOCAL_APIC_ENABLED	0x01
 
@@ -202,5 +203,56 @@ typedef struct acpi_local_x2_apic_nmi {
 	uint8	reserved3;				/* reserved (must be set to zero) */
 } _PACKED acpi_local_x2_apic_nmi;
 
+typedef struct acpi_srat {
+	acpi_descriptor_header	header;		/* "SRAT" signature */
+	uint32	table_revision;			/* must be 1 */
+	uint64	reserved;
+} _PACKED acpi_srat;
+
+enum {
+	ACPI_SRAT_PROCESSOR_AFFINITY = 0,
+	ACPI_SRAT_MEMORY_AFFINITY = 1,
+	ACPI_SRAT_X2_APIC_AFFINITY = 2
+};
+
+#define ACPI_SRAT_AFFINITY_ENABLED		0x01
+#define ACPI_SRAT_MEMORY_HOT_PLUGGABLE	0x02
+
+typedef struct acpi_srat_processor_affinity {
+	uint8	type;					/* 0 = processor local APIC affinity */
+	uint8	length;					/* 16 bytes */
+	uint8	proximity_domain_low;	/* bits 0-7 of the proximity domain */
+	uint8	apic_id;				/* processor local APIC ID */
+	uint32	flags;					/* 1 = enabled */
+	uint8	local_sapic_eid;
+	uint8	proximity_domain_high[3];
+									/* bits 8-31 of the proximity domain */
+	uint32	clock_domain;
+} _PACKED acpi_srat_processor_affinity;
+
+typedef struct acpi_srat_memory_affinity {
+	uint8	type;					/* 1 = memory affinity */
+	uint8	length;					/* 40 bytes */
+	uint32	proximity_domain;
+	uint16	reserved1;
+	uint64	base_address;			/* physical base address of the range */
+	uint64	range_length;			/* length of the range in bytes */
+	uint32	reserved2;
+	uint32	flags;					/* 1 = enabled, 2 = hot pluggable,
+									   4 = non volatile */
+	uint64	reserved3;
+} _PACKED acpi_srat_memory_affinity;
+
+typedef struct acpi_srat_x2_apic_affinity {
+	uint8	type;					/* 2 = processor local x2APIC affinity */
+	uint8	length;					/* 24 bytes */
+	uint16	reserved1;
+	uint32	proximity_domain;
+	uint32	x2apic_id;				/* processor local x2APIC ID */
+	uint32	flags;					/* 1 = enabled */
+	uint32	clock_domain;
+	uint32	reserved2;
+} _PACKED acpi_srat_x2_apic_affinity;
+
 
 #endif	/* _KERNEL_ARCH_x86_ARCH_ACPI_H */
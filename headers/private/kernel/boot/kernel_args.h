@@ -21,8 +21,10 @@
 #include <util/FixedWidthPointer.h>
 
 
-#define CURRENT_KERNEL_ARGS_VERSION	1
+#define CURRENT_KERNEL_ARGS_VERSION	2
 #define MAX_KERNEL_ARGS_RANGE		20
+#define MAX_MEMORY_NODES			8
+#define MAX_MEMORY_NODE_RANGES		32
 
 // names of common boot_volume fields
 #define BOOT_METHOD						"boot method"
@@ -42,6 +44,13 @@ enum {
 	BOOT_METHOD_DEFAULT		= BOOT_METHOD_HARD_DISK
 };
 
+// physical memory range local to a memory (NUMA) node
+typedef struct memory_node_addr_range {
+	uint64		start;
+	uint64		size;
+	uint32		node;
+} _PACKED memory_node_addr_range;
+
 typedef struct kernel_args {
 	uint32		kernel_args_size;
 	uint32		version;
@@ -62,6 +71,12 @@ typedef struct kernel_args {
 	uint32		num_cpus;
 	addr_range	cpu_kstack[SMP_MAX_CPUS];
 
+	// memory (NUMA) topology; num_memory_nodes is 0 when unknown
+	uint32		num_memory_nodes;
+	uint32		num_memory_node_ranges;
+	memory_node_addr_range memory_node_range[MAX_MEMORY_NODE_RANGES];
+	uint8		cpu_memory_node[SMP_MAX_CPUS];
+
 	// boot volume KMessage data
 	FixedWidthPointer<void> boot_volume;
 	int32		boot_volume_size;
@@ -58,6 +58,8 @@ typedef struct cpu_ent {
 	// keeping track of CPU activity
 	seqlock			active_time_lock;
 	bigtime_t		active_time;
+	bigtime_t		real_time_active_time;
+		// the part of active_time spent running real-time threads
 	bigtime_t		irq_time;
 	bigtime_t		interrupt_time;
 	bigtime_t		last_kernel_time;
@@ -83,6 +83,7 @@ status_t allocate_io_interrupt_vectors(long count, long *startVector,
 	enum interrupt_type type);
 void free_io_interrupt_vectors(long count, long startVector);
 
-void assign_io_interrupt_to_cpu(long vector, int32 cpu);
+bool assign_io_interrupt_to_cpu(long vector, int32 oldCPU, int32 newCPU);
+bool is_latency_critical_cpu(int32 cpu);
 
 #endif /* _KERNEL_INT_H */
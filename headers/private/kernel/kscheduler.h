@@ -14,6 +14,7 @@
 #include <thread_types.h>
 
 
+struct scheduler_group_info;
 struct scheduling_analysis;
 struct SchedulerListener;
 
@@ -72,6 +73,7 @@ void scheduler_start(void);
 /*! Sets scheduler operation mode.
  */
 status_t scheduler_set_operation_mode(scheduler_mode mode);
+scheduler_mode scheduler_get_operation_mode(void);
 
 /*! Dumps scheduler specific thread information.
 */
@@ -84,6 +86,15 @@ void scheduler_set_cpu_enabled(int32 cpu, bool enabled);
 void scheduler_add_listener(struct SchedulerListener* listener);
 void scheduler_remove_listener(struct SchedulerListener* listener);
 
+/*!	Called when a userland team has been created. Puts it into the
+	scheduling group of \a parent.
+*/
+void scheduler_on_team_create(Team* team, Team* parent);
+
+/*!	Called when a Team structure is freed.
+*/
+void scheduler_on_team_destroy(Team* team);
+
 void scheduler_init(void);
 void scheduler_enable_scheduling(void);
 
@@ -94,6 +105,15 @@ status_t _user_analyze_scheduling(bigtime_t from, bigtime_t until, void* buffer,
 status_t _user_set_scheduler_mode(int32 mode);
 int32 _user_get_scheduler_mode(void);
 
+int32 _user_create_scheduler_group(const char* name, int32 parent);
+status_t _user_delete_scheduler_group(int32 group);
+status_t _user_set_scheduler_group_limits(int32 group, int32 weight,
+	bigtime_t quota, bigtime_t period);
+status_t _user_get_next_scheduler_group_info(int32* cookie,
+	struct scheduler_group_info* info);
+status_t _user_set_team_scheduler_group(team_id team, int32 group);
+int32 _user_get_team_scheduler_group(team_id team);
+
 #ifdef __cplusplus
 }
 #endif
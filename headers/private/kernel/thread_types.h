@@ -63,6 +63,7 @@ struct VMAddressSpace;
 struct xsi_sem_context;			// defined in xsi_semaphore.cpp
 
 namespace Scheduler {
+	struct SchedulerGroup;
 	struct ThreadData;
 }
 
@@ -85,6 +86,12 @@ struct team_loading_info {
 	bool				done;		// set when loading is done/aborted
 };
 
+struct team_vfork_info {
+	ConditionVariable	condition;	// notified when done is set
+	bool				done;		// set when the child doesn't use the
+									// parent's memory anymore
+};
+
 struct team_watcher {
 	struct list_link	link;
 	void				(*hook)(team_id team, void *data);
@@ -250,6 +257,7 @@ struct Team : TeamThreadIteratorEntry<team_id>, KernelReferenceable,
 	Thread			*thread_list;	// protected by fLock, signal_lock and
 									// gThreadCreationLock
 	struct team_loading_info *loading_info;	// protected by fLock
+	struct team_vfork_info *vfork_info;	// protected by fLock
 	struct list		image_list;		// protected by sImageMutex
 	struct list		watcher_list;
 	struct list		sem_list;		// protected by sSemsSpinlock
@@ -272,6 +280,10 @@ struct Team : TeamThreadIteratorEntry<team_id>, KernelReferenceable,
 	bigtime_t		cpu_clock_offset;
 	spinlock		time_lock;
 
+	Scheduler::SchedulerGroup* scheduler_group;
+									// protected by the scheduler groups lock,
+									// NULL for the root group
+
 	// user group information; protected by fLock
 	uid_t			saved_set_uid;
 	uid_t			real_uid;
@@ -426,6 +438,7 @@ struct Thread : TeamThreadIteratorEntry<thread_id>, KernelReferenceable {
 	bool			going_to_suspend;	// protected by scheduler lock
 	int32			priority;		// protected by scheduler lock
 	int32			io_priority;	// protected by fLock
+	bigtime_t		timer_slack;	// only accessed by this thread
 	int32			state;			// protected by scheduler lock
 	struct cpu_ent	*cpu;			// protected by scheduler lock
 	struct cpu_ent	*previous_cpu;	// protected by scheduler lock
@@ -26,6 +26,10 @@ struct kernel_args;
 #define B_TIMER_FLAGS	\
 	(B_TIMER_USE_TIMER_STRUCT_TIMES | B_TIMER_REAL_TIME_BASE)
 
+#define DEFAULT_USER_TIMER_SLACK		50
+	// default slack (in microseconds) for timeouts of userland threads and
+	// for user timers
+
 /* Timer info structure */
 struct timer_info {
 	const char *name;
@@ -39,6 +43,9 @@ typedef struct timer_info timer_info;
 
 
 /* kernel functions */
+status_t add_timer_etc(timer *event, timer_hook hook, bigtime_t period,
+	int32 flags, bigtime_t slack);
+
 status_t timer_init(struct kernel_args *);
 void timer_init_post_rtc(void);
 void timer_real_time_clock_changed();
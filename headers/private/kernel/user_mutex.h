@@ -20,6 +20,7 @@ status_t	_user_mutex_lock(int32* mutex, const char* name, uint32 flags,
 status_t	_user_mutex_unlock(int32* mutex, uint32 flags);
 status_t	_user_mutex_switch_lock(int32* fromMutex, int32* toMutex,
 				const char* name, uint32 flags, bigtime_t timeout);
+status_t	_user_mutex_requeue(int32* fromMutex, int32* toMutex);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_UTIL_LZ4_H
+#define _KERNEL_UTIL_LZ4_H
+
+
+#include <SupportDefs.h>
+
+
+// Size of the work memory lz4_compress() needs.
+#define LZ4_WORK_MEMORY_SIZE	(4096 * sizeof(uint16))
+
+// The largest input lz4_compress() accepts.
+#define LZ4_MAX_INPUT_SIZE		65536
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t lz4_compress(const void* source, size_t sourceSize, void* dest,
+	size_t destCapacity, void* workMemory);
+ssize_t lz4_decompress(const void* source, size_t sourceSize, void* dest,
+	size_t destCapacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif	// _KERNEL_UTIL_LZ4_H
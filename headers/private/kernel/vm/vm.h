@@ -15,6 +15,7 @@
 #include <vm/vm_types.h>
 
 
+struct compressed_swap_info;
 struct generic_io_vec;
 struct kernel_args;
 struct ObjectCache;
@@ -114,6 +115,8 @@ area_id vm_create_null_area(team_id team, const char *name, void **address,
 			uint32 addressSpec, addr_t size, uint32 flags);
 area_id vm_copy_area(team_id team, const char *name, void **_address,
 			uint32 addressSpec, uint32 protection, area_id sourceID);
+area_id vm_share_area(team_id team, const char *name, void **_address,
+			uint32 addressSpec, uint32 protection, area_id sourceID);
 area_id vm_clone_area(team_id team, const char *name, void **address,
 			uint32 addressSpec, uint32 protection, uint32 mapping,
 			area_id sourceArea, bool kernel);
@@ -174,6 +177,7 @@ status_t _user_sync_memory(void *address, size_t size, uint32 flags);
 status_t _user_memory_advice(void* address, size_t size, uint32 advice);
 status_t _user_get_memory_properties(team_id teamID, const void *address,
 			uint32 *_protected, uint32 *_lock);
+status_t _user_get_compressed_swap_info(struct compressed_swap_info *info);
 
 area_id _user_area_for(void *address);
 area_id _user_find_area(const char *name);
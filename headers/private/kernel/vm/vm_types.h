@@ -154,6 +154,8 @@ public:
 	uint8					unused : 1;
 
 	uint8					usage_count;
+	uint8					memory_node;
+		// index of the memory (NUMA) node the page belongs to
 
 	inline void Init(page_num_t pageNumber);
 
@@ -209,6 +211,7 @@ vm_page::Init(page_num_t pageNumber)
 	new(&mappings) vm_page_mappings();
 	fWiredCount = 0;
 	usage_count = 0;
+	memory_node = 0;
 	busy_writing = false;
 	SetCacheRef(NULL);
 	#if DEBUG_PAGE_QUEUE
@@ -107,6 +107,7 @@ typedef struct image_t {
 
 	// pointer to symbol participation data structures
 	uint32				*symhash;
+	uint32				*gnuhash;		// DT_GNU_HASH table, if any
 	elf_sym				*syms;
 	char				*strtab;
 	elf_rel				*rel;
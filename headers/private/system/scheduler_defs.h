@@ -62,4 +62,27 @@ struct scheduling_analysis {
 };
 
 
+// scheduling groups
+
+#define SCHEDULER_ROOT_GROUP			0
+#define SCHEDULER_GROUP_DEFAULT_WEIGHT	1024
+#define SCHEDULER_GROUP_MIN_WEIGHT		1
+#define SCHEDULER_GROUP_MAX_WEIGHT		65536
+#define SCHEDULER_GROUP_MIN_PERIOD		1000
+#define SCHEDULER_GROUP_MAX_PERIOD		1000000
+
+struct scheduler_group_info {
+	int32		id;
+	int32		parent;
+	char		name[B_OS_NAME_LENGTH];
+	int32		weight;
+	bigtime_t	quota;			// CPU time per period, 0 if unlimited
+	bigtime_t	period;
+	int32		team_count;
+	int32		penalty;		// current priority penalty of the threads
+	bigtime_t	usage;			// total CPU time used by the group's threads
+	bigtime_t	throttled_time;	// total time the group has been throttled
+};
+
+
 #endif	/* _SYSTEM_SCHEDULER_DEFS_H */
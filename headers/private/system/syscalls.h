@@ -21,6 +21,7 @@ extern "C" {
 #endif
 
 struct attr_info;
+struct compressed_swap_info;
 struct dirent;
 struct fd_info;
 struct fd_set;
@@ -30,6 +31,7 @@ struct msqid_ds;
 struct net_stat;
 struct pollfd;
 struct rlimit;
+struct scheduler_group_info;
 struct scheduling_analysis;
 struct _sem_t;
 struct sembuf;
@@ -79,6 +81,7 @@ extern status_t		_kern_mutex_lock(int32* mutex, const char* name,
 extern status_t		_kern_mutex_unlock(int32* mutex, uint32 flags);
 extern status_t		_kern_mutex_switch_lock(int32* fromMutex, int32* toMutex,
 						const char* name, uint32 flags, bigtime_t timeout);
+extern status_t		_kern_mutex_requeue(int32* fromMutex, int32* toMutex);
 
 /* sem functions */
 extern sem_id		_kern_create_sem(int count, const char *name);
@@ -142,6 +145,7 @@ extern status_t		_kern_exec(const char *path, const char* const* flatArgs,
 						size_t flatArgsSize, int32 argCount, int32 envCount,
 						mode_t umask);
 extern thread_id	_kern_fork(void);
+extern thread_id	_kern_vfork(void);
 extern pid_t		_kern_process_info(pid_t process, int32 which);
 extern pid_t		_kern_setpgid(pid_t process, pid_t group);
 extern pid_t		_kern_setsid(void);
@@ -195,6 +199,17 @@ extern bigtime_t	_kern_estimate_max_scheduling_latency(thread_id thread);
 extern status_t		_kern_set_scheduler_mode(int32 mode);
 extern int32		_kern_get_scheduler_mode(void);
 
+extern int32		_kern_create_scheduler_group(const char* name,
+						int32 parent);
+extern status_t		_kern_delete_scheduler_group(int32 group);
+extern status_t		_kern_set_scheduler_group_limits(int32 group,
+						int32 weight, bigtime_t quota, bigtime_t period);
+extern status_t		_kern_get_next_scheduler_group_info(int32* cookie,
+						struct scheduler_group_info* info);
+extern status_t		_kern_set_team_scheduler_group(team_id team,
+						int32 group);
+extern int32		_kern_get_team_scheduler_group(team_id team);
+
 // user/group functions
 extern gid_t		_kern_getgid(bool effective);
 extern uid_t		_kern_getuid(bool effective);
@@ -441,6 +456,8 @@ extern status_t		_kern_memory_advice(void *address, size_t size,
 
 extern status_t		_kern_get_memory_properties(team_id teamID,
 						const void *address, uint32* _protected, uint32* _lock);
+extern status_t		_kern_get_compressed_swap_info(
+						struct compressed_swap_info *info);
 
 /* kernel port functions */
 extern port_id		_kern_create_port(int32 queue_length, const char *name);
@@ -12,6 +12,12 @@
 	// state will be locked.
 
 
+// returned by _kern_mutex_lock() and _kern_mutex_switch_lock(), when the
+// thread has been moved to another mutex by _kern_mutex_requeue() and now
+// holds that one
+#define B_USER_MUTEX_REQUEUED		1
+
+
 // mutex value flags
 #define B_USER_MUTEX_LOCKED		0x01
 #define B_USER_MUTEX_WAITING	0x02
@@ -21,5 +21,9 @@ struct user_thread {
 										// signals are deferred
 };
 
+// user_thread::flags
+#define USER_THREAD_VFORK_CHILD		0x01
+	// set in the child of vfork(), which shares its parent's memory
+
 
 #endif	/* _SYSTEM_USER_THREAD_DEFS_H */
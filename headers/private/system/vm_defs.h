@@ -53,5 +53,17 @@ enum {
 
 #define MEMORY_TYPE_SHIFT		28
 
+// statistics of the compressed swap tier
+struct compressed_swap_info {
+	uint64	max_pool_size;		// in bytes
+	uint64	pool_size;			// memory used for compressed pages, in bytes
+	uint64	stored_pages;
+	uint64	compressed_size;	// size of the compressed data, in bytes
+	uint64	stores;
+	uint64	loads;
+	uint64	rejected_pages;		// pages that didn't compress well enough
+	uint64	pool_full;			// pages rejected since the pool was full
+};
+
 
 #endif	/* _SYSTEM_VM_DEFS_H */
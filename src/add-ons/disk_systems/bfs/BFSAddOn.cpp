@@ -240,6 +240,9 @@ BFSPartitionHandle::Repair(bool checkOnly)
 		//printf("will fix any severe errors!\n");
 		result.flags |= BFS_FIX_BITMAP_ERRORS | BFS_REMOVE_WRONG_TYPES
 			| BFS_REMOVE_INVALID | BFS_FIX_NAME_MISMATCHES | BFS_FIX_BPLUSTREES;
+	} else {
+		// nothing needs to be fixed, so we can use several threads
+		result.flags |= BFS_CHECK_PARALLEL;
 	}
 
 	// start checking
@@ -16,6 +16,7 @@
 #include <algorithm>
 
 #include <device_manager.h>
+#include <driver_settings.h>
 #include <Drivers.h>
 
 #include <AutoDeleter.h>
@@ -30,6 +31,7 @@
 
 #include "dma_resources.h"
 #include "io_requests.h"
+#include "IOSchedulerDeadline.h"
 #include "IOSchedulerSimple.h"
 
 
@@ -70,6 +72,26 @@ static mutex sDeviceListLock = MUTEX_INITIALIZER("ram disk device list");
 static uint64 sUsedRawDeviceIDs = 0;
 
 
+/*!	Returns whether the "io_scheduler" setting in the "ram_disk" driver
+	settings file asks for the deadline I/O scheduler; the simple one is
+	used by default.
+*/
+static bool
+use_deadline_io_scheduler()
+{
+	void* handle = load_driver_settings("ram_disk");
+	if (handle == NULL)
+		return false;
+
+	const char* scheduler = get_driver_parameter(handle, "io_scheduler", NULL,
+		NULL);
+	bool deadline = scheduler != NULL && strcmp(scheduler, "deadline") == 0;
+
+	unload_driver_settings(handle);
+	return deadline;
+}
+
+
 static int32	allocate_raw_device_id();
 static void		free_raw_device_id(int32 id);
 
@@ -268,7 +290,10 @@ struct RawDevice : Device, DoublyLinkedListLinkImpl<RawDevice> {
 			return error;
 		}
 
-		fIOScheduler = new(std::nothrow) IOSchedulerSimple(fDMAResource);
+		if (use_deadline_io_scheduler())
+			fIOScheduler = new(std::nothrow) IOSchedulerDeadline(fDMAResource);
+		else
+			fIOScheduler = new(std::nothrow) IOSchedulerSimple(fDMAResource);
 		if (fIOScheduler == NULL) {
 			Unprepare();
 			return B_NO_MEMORY;
@@ -61,7 +61,8 @@ Attribute::CheckAccess(const char* name, int openMode)
 	// shouldn't be allowed.
 	// TODO: we might think about allowing to update those values, but
 	//	really change their corresponding values in the bfs_inode structure
-	if (name[0] == FILE_NAME_NAME && name[1] == '\0'
+	if ((name[0] == FILE_NAME_NAME && name[1] == '\0')
+		|| (name[0] == INLINE_DATA_NAME && name[1] == '\0')
 // TODO: reenable this check -- some WonderBrush locale files used them
 /*		|| !strcmp(name, "name")
 		|| !strcmp(name, "last_modified")
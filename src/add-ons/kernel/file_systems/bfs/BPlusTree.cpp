@@ -12,6 +12,10 @@
 
 #include "BPlusTree.h"
 
+#if !_BOOT_MODE
+#	include <algorithm>
+#endif
+
 #include <file_systems/QueryParserUtils.h>
 
 #include "Debug.h"
@@ -72,6 +76,20 @@ private:
 } _PACKED;
 
 
+#if !_BOOT_MODE
+static const uint32 kNodeBlockCacheSize = 64;
+	// number of node locations a tree remembers
+
+static const size_t kMaxBuilderMemory = 16 * 1024 * 1024;
+	// the keys of a TreeBuilder may not use more memory than this
+
+static const uint64 kEstimateScale = 1 << 24;
+	// the precision of the key positions computed by EstimateKey()
+static const int32 kMaxEstimateDuplicateNodes = 8;
+	// duplicate chains of a key are not followed further when estimating
+#endif
+
+
 #ifdef DEBUG
 class NodeChecker {
 public:
@@ -425,10 +443,8 @@ CachedNode::InternalSetTo(Transaction* transaction, off_t offset)
 	fNode = NULL;
 	fOffset = offset;
 
-	off_t fileOffset;
-	block_run run;
 	if (offset < fTree->fStream->Size()
-		&& fTree->fStream->FindBlockRun(offset, run, fileOffset) == B_OK) {
+		&& fTree->_FindNodeBlock(offset, fBlockNumber) == B_OK) {
 
 #if !_BOOT_MODE
 		Volume* volume = fTree->fStream->GetVolume();
@@ -436,8 +452,6 @@ CachedNode::InternalSetTo(Transaction* transaction, off_t offset)
 		Volume* volume = &fTree->fStream->GetVolume();
 #endif
 
-		int32 blockOffset = (offset - fileOffset) / volume->BlockSize();
-		fBlockNumber = volume->ToBlock(run) + blockOffset;
 		uint8* block = NULL;
 
 #if !_BOOT_MODE
@@ -466,9 +480,8 @@ CachedNode::InternalSetTo(Transaction* transaction, off_t offset)
 
 		if (block != NULL) {
 			// The node is somewhere in that block...
-			// (confusing offset calculation)
-			fNode = (bplustree_node*)(block + offset
-				- (fileOffset + (blockOffset << volume->BlockShift())));
+			fNode = (bplustree_node*)(block
+				+ (offset & (volume->BlockSize() - 1)));
 		} else
 			REPORT_ERROR(B_IO_ERROR);
 	}
@@ -582,9 +595,11 @@ CachedNode::Allocate(Transaction& transaction, bplustree_node** _node,
 BPlusTree::BPlusTree(Transaction& transaction, Inode* stream, int32 nodeSize)
 	:
 	fStream(NULL),
-	fInTransaction(false)
+	fInTransaction(false),
+	fNodeBlocks(NULL)
 {
 	mutex_init(&fIteratorLock, "bfs b+tree iterator");
+	mutex_init(&fNodeBlockLock, "bfs b+tree node blocks");
 	SetTo(transaction, stream);
 }
 #endif // !_BOOT_MODE
@@ -597,6 +612,8 @@ BPlusTree::BPlusTree(Inode* stream)
 {
 #if !_BOOT_MODE
 	mutex_init(&fIteratorLock, "bfs b+tree iterator");
+	mutex_init(&fNodeBlockLock, "bfs b+tree node blocks");
+	fNodeBlocks = NULL;
 #endif
 
 	SetTo(stream);
@@ -613,6 +630,8 @@ BPlusTree::BPlusTree()
 {
 #if !_BOOT_MODE
 	mutex_init(&fIteratorLock, "bfs b+tree iterator");
+	mutex_init(&fNodeBlockLock, "bfs b+tree node blocks");
+	fNodeBlocks = NULL;
 #endif
 }
 
@@ -632,6 +651,9 @@ BPlusTree::~BPlusTree()
 
 	mutex_destroy(&fIteratorLock);
 
+	mutex_destroy(&fNodeBlockLock);
+	free(fNodeBlocks);
+
 	ASSERT(!fInTransaction);
 #endif // !_BOOT_MODE
 }
@@ -645,6 +667,7 @@ BPlusTree::SetTo(Transaction& transaction, Inode* stream, int32 nodeSize)
 	// initializes in-memory B+Tree
 
 	fStream = stream;
+	_InvalidateNodeBlocks();
 
 	CachedNode cached(this);
 	bplustree_header* header = cached.SetToWritableHeader(transaction);
@@ -695,6 +718,9 @@ BPlusTree::SetTo(Inode* stream)
 		RETURN_ERROR(fStatus = B_BAD_VALUE);
 
 	fStream = stream;
+#if !_BOOT_MODE
+	_InvalidateNodeBlocks();
+#endif
 
 	// get on-disk B+Tree header
 
@@ -952,6 +978,9 @@ void
 BPlusTree::TransactionDone(bool success)
 {
 	if (!success) {
+		// the tree's data stream might have been changed as well
+		_InvalidateNodeBlocks();
+
 		// update header from disk
 		CachedNode cached(this);
 		const bplustree_header* header = cached.SetToHeader();
@@ -1100,7 +1129,102 @@ BPlusTree::_FindKey(const bplustree_node* node, const uint8* key,
 }
 
 
+/*!	Translates the offset of a node in the tree to the block it is stored
+	in. The result is remembered, so that the data stream doesn't have to
+	be walked again for the nodes that are used most often, like the upper
+	levels of the tree, or the current node of an iterator.
+*/
+status_t
+BPlusTree::_FindNodeBlock(off_t offset, off_t& _block)
+{
+#if !_BOOT_MODE
+	uint32 slot = (offset / BPLUSTREE_NODE_SIZE) % kNodeBlockCacheSize;
+
+	MutexLocker locker(fNodeBlockLock);
+	if (fNodeBlocks != NULL && fNodeBlocks[slot].offset == offset) {
+		_block = fNodeBlocks[slot].block;
+		return B_OK;
+	}
+	locker.Unlock();
+
+	Volume* volume = fStream->GetVolume();
+#else
+	Volume* volume = &fStream->GetVolume();
+#endif
+
+	off_t fileOffset;
+	block_run run;
+	status_t status = fStream->FindBlockRun(offset, run, fileOffset);
+	if (status != B_OK)
+		return status;
+
+	_block = volume->ToBlock(run)
+		+ ((offset - fileOffset) >> volume->BlockShift());
+
+#if !_BOOT_MODE
+	locker.Lock();
+	if (fNodeBlocks == NULL) {
+		fNodeBlocks = (node_block*)malloc(
+			sizeof(node_block) * kNodeBlockCacheSize);
+		if (fNodeBlocks == NULL)
+			return B_OK;
+
+		for (uint32 i = 0; i < kNodeBlockCacheSize; i++)
+			fNodeBlocks[i].offset = BPLUSTREE_NULL;
+	}
+
+	fNodeBlocks[slot].offset = offset;
+	fNodeBlocks[slot].block = _block;
+#endif
+	return B_OK;
+}
+
+
 #if !_BOOT_MODE
+/*!	Forgets all node locations; must be called whenever the blocks of the
+	tree's data stream might have changed.
+*/
+void
+BPlusTree::_InvalidateNodeBlocks()
+{
+	MutexLocker _(fNodeBlockLock);
+
+	if (fNodeBlocks != NULL) {
+		for (uint32 i = 0; i < kNodeBlockCacheSize; i++)
+			fNodeBlocks[i].offset = BPLUSTREE_NULL;
+	}
+}
+
+
+/*!	Returns the number of values stored for the duplicate \a link. Chains
+	of duplicate nodes are only followed for \a maxNodes nodes.
+*/
+off_t
+BPlusTree::_CountDuplicates(off_t link, int32 maxNodes)
+{
+	CachedNode cached(this);
+	off_t offset = bplustree_node::FragmentOffset(link);
+	const bplustree_node* node = cached.SetTo(offset, false);
+	if (node == NULL)
+		return 1;
+
+	if (bplustree_node::LinkType(link) == BPLUSTREE_DUPLICATE_FRAGMENT)
+		return node->CountDuplicates(link, true);
+
+	off_t count = 0;
+	for (int32 i = 0; i < maxNodes; i++) {
+		count += node->CountDuplicates(offset, false);
+
+		offset = node->RightLink();
+		if (offset == BPLUSTREE_NULL
+			|| (node = cached.SetTo(offset, false)) == NULL)
+			break;
+	}
+
+	return count;
+}
+
+
 /*!	Prepares the stack to contain all nodes that were passed while
 	following the key, from the root node to the leaf node that could
 	or should contain that key.
@@ -2326,6 +2450,95 @@ BPlusTree::Find(const uint8* key, uint16 keyLength, off_t* _value)
 }
 
 
+#if !_BOOT_MODE
+/*!	Estimates how many entries the tree contains, and how many of them are
+	smaller than, or equal to \a key. Only a single path from the root to a
+	leaf (and the duplicates in that leaf) is read to find that out.
+	The interior nodes serve as a histogram of the key distribution: every
+	child of a node is assumed to contain the same number of entries as the
+	leaf that was reached.
+	Since this is derived from the tree itself, the estimate follows all
+	changes to the tree without any bookkeeping.
+*/
+status_t
+BPlusTree::EstimateKey(const uint8* key, uint16 keyLength,
+	key_estimate& _estimate)
+{
+	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
+		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH
+		|| key == NULL)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	InodeReadLocker locker(fStream);
+
+	// the position of the leaf, as a fraction of kEstimateScale
+	uint64 position = 0;
+	uint64 width = kEstimateScale;
+	off_t leaves = 1;
+
+	off_t nodeOffset = fHeader.RootNode();
+	CachedNode cached(this);
+	const bplustree_node* node;
+
+	while ((node = cached.SetTo(nodeOffset)) != NULL) {
+		uint16 keyIndex = 0;
+		off_t nextOffset;
+		status_t status = _FindKey(node, key, keyLength, &keyIndex,
+			&nextOffset);
+		if (status != B_OK && status != B_ENTRY_NOT_FOUND)
+			return status;
+
+		uint32 numKeys = node->NumKeys();
+
+		if (node->OverflowLink() != BPLUSTREE_NULL) {
+			// the key index is also the index of the child we follow, the
+			// overflow link being the last one
+			position += width * keyIndex / (numKeys + 1);
+			width /= numKeys + 1;
+			leaves *= numKeys + 1;
+
+			if (nextOffset == nodeOffset)
+				RETURN_ERROR(B_ERROR);
+
+			nodeOffset = nextOffset;
+			continue;
+		}
+
+		off_t leafEntries = 0;
+		off_t leafBefore = 0;
+		_estimate.equal = 0;
+
+		// Only the first duplicate node of the other keys is counted, as
+		// reading long duplicate chains of all keys would be too expensive
+		const off_t* values = node->Values();
+		for (uint32 i = 0; i < numKeys; i++) {
+			bool isKey = i == keyIndex && status == B_OK;
+			off_t value = BFS_ENDIAN_TO_HOST_INT64(values[i]);
+			off_t count = bplustree_node::IsDuplicate(value)
+				? _CountDuplicates(value,
+					isKey ? kMaxEstimateDuplicateNodes : 1) : 1;
+
+			if (i < keyIndex)
+				leafBefore += count;
+			else if (isKey)
+				_estimate.equal = count;
+			leafEntries += count;
+		}
+
+		_estimate.entries = leaves * leafEntries;
+		_estimate.before = _estimate.entries * position / kEstimateScale
+			+ leafBefore;
+
+		if (_estimate.entries < _estimate.before + _estimate.equal)
+			_estimate.entries = _estimate.before + _estimate.equal;
+
+		return B_OK;
+	}
+	RETURN_ERROR(B_ERROR);
+}
+#endif	// !_BOOT_MODE
+
+
 #if !_BOOT_MODE
 status_t
 BPlusTree::_ValidateChildren(TreeCheck& check, uint32 level, off_t offset,
@@ -2893,6 +3106,440 @@ TreeIterator::Dump()
 #endif
 
 
+//	#pragma mark - TreeBuilder
+
+
+#if !_BOOT_MODE
+struct TreeBuilder::Entry {
+	off_t		value;
+	uint32		keyOffset;
+	uint16		keyLength;
+};
+
+
+struct TreeBuilder::EntryLess {
+	EntryLess(TreeBuilder* builder)
+		:
+		fBuilder(builder)
+	{
+	}
+
+	bool operator()(const Entry& a, const Entry& b) const
+	{
+		int32 compare = fBuilder->_CompareEntries(a, b);
+		if (compare != 0)
+			return compare < 0;
+
+		return a.value < b.value;
+	}
+
+private:
+	TreeBuilder*	fBuilder;
+};
+
+
+TreeBuilder::TreeBuilder(BPlusTree* tree)
+	:
+	fTree(tree),
+	fEntries(NULL),
+	fCount(0),
+	fMaxCount(0),
+	fKeys(NULL),
+	fKeysSize(0),
+	fMaxKeysSize(0),
+	fLevelCount(0)
+{
+	for (int32 i = 0; i < kMaxLevels; i++)
+		fLevels[i].node = NULL;
+}
+
+
+TreeBuilder::~TreeBuilder()
+{
+	_MakeEmpty();
+}
+
+
+/*!	Adds a key to the set of keys the tree will be built from.
+	Returns \c B_NO_MEMORY if the builder cannot hold any more keys. The keys
+	that were added so far can still be written with Finish(), but all
+	remaining keys must be inserted into the tree one by one afterwards.
+*/
+status_t
+TreeBuilder::Add(const uint8* key, uint16 keyLength, off_t value)
+{
+	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
+		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH
+		|| key == NULL)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	if (fCount == fMaxCount) {
+		int32 maxCount = fMaxCount > 0 ? fMaxCount * 2 : 1024;
+		if (maxCount * sizeof(Entry) + fMaxKeysSize > kMaxBuilderMemory)
+			return B_NO_MEMORY;
+
+		Entry* entries = (Entry*)realloc(fEntries, maxCount * sizeof(Entry));
+		if (entries == NULL)
+			return B_NO_MEMORY;
+
+		fEntries = entries;
+		fMaxCount = maxCount;
+	}
+
+	if (fKeysSize + keyLength > fMaxKeysSize) {
+		size_t maxSize = fMaxKeysSize > 0 ? fMaxKeysSize * 2 : 16384;
+		if (fMaxCount * sizeof(Entry) + maxSize > kMaxBuilderMemory)
+			return B_NO_MEMORY;
+
+		uint8* keys = (uint8*)realloc(fKeys, maxSize);
+		if (keys == NULL)
+			return B_NO_MEMORY;
+
+		fKeys = keys;
+		fMaxKeysSize = maxSize;
+	}
+
+	Entry& entry = fEntries[fCount++];
+	entry.value = value;
+	entry.keyOffset = fKeysSize;
+	entry.keyLength = keyLength;
+
+	memcpy(fKeys + fKeysSize, key, keyLength);
+	fKeysSize += keyLength;
+
+	return B_OK;
+}
+
+
+/*!	Sorts the keys, and writes them into the tree, which must be empty.
+	Since the tree might be too large for a single transaction, this method
+	starts its own transactions; the caller must not have one running. The
+	tree stays empty until the new root is written at the very end.
+	Keys that are already part of the tree are inserted one by one after
+	the tree has been built; they will become duplicates, or cause
+	\c B_NAME_IN_USE to be returned if the tree doesn't allow them.
+*/
+status_t
+TreeBuilder::Finish()
+{
+	if (fCount == 0)
+		return B_OK;
+
+	std::sort(fEntries, fEntries + fCount, EntryLess(this));
+
+	Inode* stream = fTree->fStream;
+	Transaction transaction(stream->GetVolume(), stream->BlockNumber());
+	stream->WriteLockInTransaction(transaction);
+
+	CachedNode cached(fTree);
+	const bplustree_node* root = cached.SetTo(fTree->fHeader.RootNode());
+	if (root == NULL)
+		RETURN_ERROR(B_IO_ERROR);
+	if (!root->IsLeaf() || root->NumKeys() != 0)
+		RETURN_ERROR(B_BAD_VALUE);
+	cached.Unset();
+
+	// Write the leaves, and with them all index nodes but the last one on
+	// each level. Duplicates are moved to the start of the array, which
+	// has already been processed at this point.
+
+	status_t status = B_OK;
+	int32 duplicates = 0;
+
+	for (int32 i = 0; i < fCount; i++) {
+		Entry& entry = fEntries[i];
+		if (i > 0 && _CompareEntries(fEntries[i - 1], entry) == 0) {
+			fEntries[duplicates++] = entry;
+			continue;
+		}
+
+		if (transaction.IsTooLarge()) {
+			status = _RestartTransaction(transaction);
+			if (status != B_OK)
+				return status;
+		}
+
+		status = _AddKey(transaction, 0, fKeys + entry.keyOffset,
+			entry.keyLength, entry.value);
+		if (status != B_OK)
+			return status;
+	}
+
+	// Write the last node of every level; the top one becomes the new root
+
+	for (int32 level = 0; level < fLevelCount; level++) {
+		if (level == fLevelCount - 1) {
+			status = _WriteRoot(transaction, level);
+			break;
+		}
+
+		const uint8* key;
+		uint16 keyLength;
+		if (level == 0) {
+			bplustree_node* node = fLevels[level].node;
+			key = node->KeyAt(node->NumKeys() - 1, &keyLength);
+		} else {
+			fLevels[level].node->overflow_link = HOST_ENDIAN_TO_BFS_INT64(
+				fLevels[level].value);
+			key = fLevels[level].key;
+			keyLength = fLevels[level].keyLength;
+		}
+
+		status = _WriteNode(transaction, level, key, keyLength, true);
+		if (status != B_OK)
+			break;
+	}
+	if (status != B_OK)
+		return status;
+
+	for (int32 i = 0; i < duplicates; i++) {
+		if (transaction.IsTooLarge()) {
+			status = _RestartTransaction(transaction);
+			if (status != B_OK)
+				return status;
+		}
+
+		Entry& entry = fEntries[i];
+		status = fTree->Insert(transaction, fKeys + entry.keyOffset,
+			entry.keyLength, entry.value);
+		if (status != B_OK)
+			return status;
+	}
+
+	status = transaction.Done();
+	if (status == B_OK)
+		_MakeEmpty();
+
+	return status;
+}
+
+
+int32
+TreeBuilder::_CompareEntries(const Entry& a, const Entry& b)
+{
+	return fTree->_CompareKeys(fKeys + a.keyOffset, a.keyLength,
+		fKeys + b.keyOffset, b.keyLength);
+}
+
+
+/*!	Returns whether or not the key still fits into the node. An eighth of
+	every node is left empty, so that the first keys that are inserted later
+	on don't split the nodes right away.
+*/
+bool
+TreeBuilder::_Fits(const bplustree_node* node, uint16 keyLength) const
+{
+	int32 size = fTree->fNodeSize;
+
+	return int32(key_align(sizeof(bplustree_node) + node->AllKeyLength()
+			+ keyLength) + (node->NumKeys() + 1)
+			* (sizeof(uint16) + sizeof(off_t))) <= size - size / 8;
+}
+
+
+status_t
+TreeBuilder::_RestartTransaction(Transaction& transaction)
+{
+	Inode* stream = fTree->fStream;
+
+	status_t status = transaction.Done();
+	if (status == B_OK)
+		status = transaction.Start(stream->GetVolume(), stream->BlockNumber());
+	if (status != B_OK)
+		return status;
+
+	stream->WriteLockInTransaction(transaction);
+	return B_OK;
+}
+
+
+/*!	Allocates the first node of a level. */
+status_t
+TreeBuilder::_StartLevel(Transaction& transaction, int32 level)
+{
+	if (level >= kMaxLevels)
+		RETURN_ERROR(B_BAD_DATA);
+
+	bplustree_node* node = (bplustree_node*)malloc(fTree->fNodeSize);
+	if (node == NULL)
+		return B_NO_MEMORY;
+
+	CachedNode cached(fTree);
+	bplustree_node* unused;
+	off_t offset;
+	status_t status = cached.Allocate(transaction, &unused, &offset);
+	if (status != B_OK) {
+		free(node);
+		return status;
+	}
+
+	node->Initialize();
+
+	fLevels[level].node = node;
+	fLevels[level].offset = offset;
+	fLevels[level].previous = BPLUSTREE_NULL;
+	fLevels[level].hasKey = false;
+
+	fLevelCount = level + 1;
+	return B_OK;
+}
+
+
+/*!	Adds a key to the node that is currently built on the given level.
+	On the leaf level, the key is added directly. On index levels, it is kept
+	back until the next key arrives: if that doesn't fit anymore, the kept
+	back key's value becomes the overflow link of the node instead.
+*/
+status_t
+TreeBuilder::_AddKey(Transaction& transaction, int32 level, const uint8* key,
+	uint16 keyLength, off_t value)
+{
+	if (level == fLevelCount) {
+		status_t status = _StartLevel(transaction, level);
+		if (status != B_OK)
+			return status;
+	}
+
+	Level& current = fLevels[level];
+
+	if (level == 0) {
+		if (!_Fits(current.node, keyLength)) {
+			uint16 lastLength;
+			const uint8* lastKey = current.node->KeyAt(
+				current.node->NumKeys() - 1, &lastLength);
+
+			status_t status = _WriteNode(transaction, level, lastKey,
+				lastLength, false);
+			if (status != B_OK)
+				return status;
+		}
+
+		fTree->_InsertKey(current.node, current.node->NumKeys(),
+			(uint8*)key, keyLength, value);
+		return B_OK;
+	}
+
+	if (current.hasKey) {
+		if (_Fits(current.node, current.keyLength)) {
+			fTree->_InsertKey(current.node, current.node->NumKeys(),
+				current.key, current.keyLength, current.value);
+		} else {
+			current.node->overflow_link = HOST_ENDIAN_TO_BFS_INT64(
+				current.value);
+
+			status_t status = _WriteNode(transaction, level, current.key,
+				current.keyLength, false);
+			if (status != B_OK)
+				return status;
+		}
+	}
+
+	memcpy(current.key, key, keyLength);
+	current.keyLength = keyLength;
+	current.value = value;
+	current.hasKey = true;
+	return B_OK;
+}
+
+
+/*!	Writes the node that is currently built on the given level, and adds
+	\a key, its largest one, to the level above. Unless this is the \a last
+	node of its level, the node that follows it is allocated as well.
+*/
+status_t
+TreeBuilder::_WriteNode(Transaction& transaction, int32 level,
+	const uint8* key, uint16 keyLength, bool last)
+{
+	Level& current = fLevels[level];
+
+	off_t nextOffset = BPLUSTREE_NULL;
+	if (!last) {
+		CachedNode cached(fTree);
+		bplustree_node* unused;
+		status_t status = cached.Allocate(transaction, &unused, &nextOffset);
+		if (status != B_OK)
+			return status;
+	}
+
+	current.node->left_link = HOST_ENDIAN_TO_BFS_INT64(current.previous);
+	current.node->right_link = HOST_ENDIAN_TO_BFS_INT64(nextOffset);
+
+	CachedNode cached(fTree);
+	bplustree_node* node = cached.SetToWritable(transaction, current.offset,
+		false);
+	if (node == NULL)
+		RETURN_ERROR(B_IO_ERROR);
+
+	memcpy(node, current.node, fTree->fNodeSize);
+	cached.Unset();
+
+	status_t status = _AddKey(transaction, level + 1, key, keyLength,
+		current.offset);
+	if (status != B_OK)
+		return status;
+
+	current.previous = current.offset;
+	current.offset = nextOffset;
+	current.node->Initialize();
+	return B_OK;
+}
+
+
+/*!	Writes the only node of the top level into the place of the empty root
+	node, and frees the node that had been allocated for it.
+*/
+status_t
+TreeBuilder::_WriteRoot(Transaction& transaction, int32 level)
+{
+	Level& current = fLevels[level];
+	if (level > 0) {
+		current.node->overflow_link = HOST_ENDIAN_TO_BFS_INT64(
+			current.value);
+	}
+
+	CachedNode cached(fTree);
+	bplustree_node* root = cached.SetToWritable(transaction,
+		fTree->fHeader.RootNode(), false);
+	if (root == NULL)
+		RETURN_ERROR(B_IO_ERROR);
+
+	memcpy(root, current.node, fTree->fNodeSize);
+
+	if (cached.SetToWritable(transaction, current.offset, false) == NULL)
+		RETURN_ERROR(B_IO_ERROR);
+
+	status_t status = cached.Free(transaction, current.offset);
+	if (status != B_OK)
+		return status;
+
+	bplustree_header* header = cached.SetToWritableHeader(transaction);
+	if (header == NULL)
+		RETURN_ERROR(B_IO_ERROR);
+
+	header->max_number_of_levels = HOST_ENDIAN_TO_BFS_INT32(fLevelCount);
+	return B_OK;
+}
+
+
+void
+TreeBuilder::_MakeEmpty()
+{
+	free(fEntries);
+	free(fKeys);
+	fEntries = NULL;
+	fKeys = NULL;
+	fCount = fMaxCount = 0;
+	fKeysSize = fMaxKeysSize = 0;
+
+	for (int32 i = 0; i < fLevelCount; i++) {
+		free(fLevels[i].node);
+		fLevels[i].node = NULL;
+	}
+	fLevelCount = 0;
+}
+#endif // !_BOOT_MODE
+
+
 // #pragma mark -
 
 
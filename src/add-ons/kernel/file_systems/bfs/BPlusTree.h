@@ -157,6 +157,22 @@ struct node_and_key {
 	off_t	nodeOffset;
 	uint16	keyIndex;
 };
+
+// remembers in which block a node is stored
+struct node_block {
+	off_t	offset;
+	off_t	block;
+};
+
+// where a key is in the tree, see BPlusTree::EstimateKey()
+struct key_estimate {
+	off_t	entries;
+		// all entries in the tree
+	off_t	before;
+		// entries with a smaller key
+	off_t	equal;
+		// entries with the same key
+};
 #endif // !_BOOT_MODE
 
 
@@ -290,6 +306,10 @@ public:
 									off_t* value);
 
 #if !_BOOT_MODE
+			status_t			EstimateKey(const uint8* key,
+									uint16 keyLength,
+									key_estimate& _estimate);
+
 	static	int32				TypeCodeToKeyType(type_code code);
 	static	int32				ModeToKeyType(mode_t mode);
 
@@ -308,7 +328,12 @@ private:
 			status_t			_FindKey(const bplustree_node* node,
 									const uint8* key, uint16 keyLength,
 									uint16* index = NULL, off_t* next = NULL);
+			status_t			_FindNodeBlock(off_t offset, off_t& _block);
 #if !_BOOT_MODE
+			void				_InvalidateNodeBlocks();
+			off_t				_CountDuplicates(off_t link,
+									int32 maxNodes);
+
 			status_t			_SeekDown(Stack<node_and_key>& stack,
 									const uint8* key, uint16 keyLength);
 
@@ -354,6 +379,7 @@ private:
 
 private:
 			friend class TreeIterator;
+			friend class TreeBuilder;
 			friend class CachedNode;
 			friend class TreeCheck;
 
@@ -367,6 +393,9 @@ private:
 #if !_BOOT_MODE
 			mutex				fIteratorLock;
 			SinglyLinkedList<TreeIterator> fIterators;
+
+			mutex				fNodeBlockLock;
+			node_block*			fNodeBlocks;
 #endif
 };
 
@@ -421,6 +450,69 @@ private:
 };
 
 
+#if !_BOOT_MODE
+/*!	Creates the contents of an empty tree from a set of keys at once. The
+	keys may be added in any order; they are sorted in memory, and then
+	written into densely packed nodes from the leaves upwards, without
+	having to split a single node.
+*/
+class TreeBuilder {
+public:
+								TreeBuilder(BPlusTree* tree);
+								~TreeBuilder();
+
+			status_t			Add(const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			Finish();
+
+			int32				CountKeys() const { return fCount; }
+
+private:
+			struct Entry;
+			struct EntryLess;
+
+			struct Level {
+				bplustree_node*	node;
+				off_t			offset;
+				off_t			previous;
+				uint8			key[BPLUSTREE_MAX_KEY_LENGTH];
+				uint16			keyLength;
+				off_t			value;
+				bool			hasKey;
+			};
+
+			int32				_CompareEntries(const Entry& a,
+									const Entry& b);
+			bool				_Fits(const bplustree_node* node,
+									uint16 keyLength) const;
+			status_t			_RestartTransaction(Transaction& transaction);
+			status_t			_StartLevel(Transaction& transaction,
+									int32 level);
+			status_t			_AddKey(Transaction& transaction, int32 level,
+									const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			_WriteNode(Transaction& transaction,
+									int32 level, const uint8* key,
+									uint16 keyLength, bool last);
+			status_t			_WriteRoot(Transaction& transaction,
+									int32 level);
+			void				_MakeEmpty();
+
+	static	const int32			kMaxLevels = 16;
+
+			BPlusTree*			fTree;
+			Entry*				fEntries;
+			int32				fCount;
+			int32				fMaxCount;
+			uint8*				fKeys;
+			size_t				fKeysSize;
+			size_t				fMaxKeysSize;
+			Level				fLevels[kMaxLevels];
+			int32				fLevelCount;
+};
+#endif // !_BOOT_MODE
+
+
 //	#pragma mark - BPlusTree's inline functions
 //	(most of them may not be needed)
 
@@ -12,7 +12,10 @@
 #include "bfs_control.h"
 #include "BPlusTree.h"
 #include "Debug.h"
+#include "ExtentStream.h"
+#include "FreeExtentIndex.h"
 #include "Inode.h"
+#include "NameTrigrams.h"
 #include "Volume.h"
 
 
@@ -172,29 +175,131 @@ private:
 struct check_index {
 	check_index()
 		:
-		inode(NULL)
+		inode(NULL),
+		builder(NULL)
 	{
 	}
 
 	char				name[B_FILE_NAME_LENGTH];
 	block_run			run;
 	Inode*				inode;
+	TreeBuilder*		builder;
 };
 
 
+//!	The result of checking a single node by one of the check threads.
+struct check_result {
+	char				name[B_FILE_NAME_LENGTH];
+	ino_t				inode;
+	uint32				mode;
+	uint32				errors;
+	status_t			status;
+};
+
+
+static const int32 kCheckResultQueueSize = 256;
+
+
 struct check_cookie {
 	check_cookie()
+		:
+		busy_threads(0),
+		waiting_threads(0),
+		running_threads(0),
+		stopping(false),
+		work_sem(-1),
+		free_sem(-1),
+		result_sem(-1),
+		first_result(0),
+		result_count(0),
+		thread_status(B_OK),
+		results_done(false)
 	{
+		mutex_init(&lock, "bfs check");
+	}
+
+	~check_cookie()
+	{
+		mutex_destroy(&lock);
 	}
 
 	uint32				pass;
 	block_run			current;
 	Inode*				parent;
-	mode_t				parent_mode;
 	Stack<block_run>	stack;
 	TreeIterator*		iterator;
 	check_control		control;
 	Stack<check_index*>	indices;
+
+	// The stack is shared with the check threads, if there are any; the
+	// lock protects it, and everything below.
+	mutex				lock;
+	int32				busy_threads;
+	int32				waiting_threads;
+	int32				running_threads;
+	bool				stopping;
+	sem_id				work_sem;
+	sem_id				free_sem;
+	sem_id				result_sem;
+	check_result		results[kCheckResultQueueSize];
+	int32				first_result;
+	int32				result_count;
+	status_t			thread_status;
+	bool				results_done;
+		// all results have been passed on, and the threads are done
+};
+
+
+/*!	Checks the blocks of an extent stream. Since extents can span several
+	allocation groups, they are split into block_runs for this.
+*/
+class CheckExtentVisitor : public ExtentVisitor {
+public:
+	CheckExtentVisitor(BlockAllocator& allocator, Volume* volume,
+			check_control& control)
+		:
+		fAllocator(allocator),
+		fVolume(volume),
+		fControl(control)
+	{
+	}
+
+	virtual status_t VisitNode(off_t block)
+	{
+		fControl.stats.indirect_array_blocks++;
+		return fAllocator.CheckBlockRun(fVolume->ToBlockRun(block),
+			"extent node", true, &fControl);
+	}
+
+	virtual status_t VisitExtent(off_t offset, off_t start, off_t length)
+	{
+		fControl.stats.direct_block_runs++;
+		fControl.stats.blocks_in_direct += length;
+
+		while (length > 0) {
+			off_t groupEnd = ((start >> fVolume->AllocationGroupShift()) + 1)
+				<< fVolume->AllocationGroupShift();
+			off_t runLength = min_c(min_c(length, groupEnd - start),
+				MAX_BLOCK_RUN_LENGTH);
+
+			block_run run = fVolume->ToBlockRun(start);
+			run.length = HOST_ENDIAN_TO_BFS_INT16(runLength);
+
+			status_t status = fAllocator.CheckBlockRun(run, "extent", true,
+				&fControl);
+			if (status != B_OK)
+				return status;
+
+			start += runLength;
+			length -= runLength;
+		}
+		return B_OK;
+	}
+
+private:
+	BlockAllocator&	fAllocator;
+	Volume*			fVolume;
+	check_control&	fControl;
 };
 
 
@@ -222,9 +327,17 @@ private:
 };
 
 
+static const int32 kMaxVolumeExtents = 65536;
+	// Limits the memory the free extent indices of a volume use together to
+	// about 3.5 MB; the groups that would need more fall back to the bitmap.
+static const int32 kMaxAllocationTries = 8;
+	// How often an allocation is retried when the run found was taken
+
+
 class AllocationGroup {
 public:
 	AllocationGroup();
+	~AllocationGroup();
 
 	void AddFreeRange(int32 start, int32 blocks);
 	bool IsFull() const { return fFreeBits == 0; }
@@ -248,6 +361,12 @@ private:
 	int32	fLargestStart;
 	int32	fLargestLength;
 	bool	fLargestValid;
+
+	FreeExtentIndex fExtents;
+		// all free ranges of this group, if valid
+
+	mutex	fLock;
+		// protects the bitmap blocks of this group, and the fields above
 };
 
 
@@ -379,6 +498,13 @@ AllocationGroup::AllocationGroup()
 	fFreeBits(0),
 	fLargestValid(false)
 {
+	mutex_init(&fLock, "bfs allocation group");
+}
+
+
+AllocationGroup::~AllocationGroup()
+{
+	mutex_destroy(&fLock);
 }
 
 
@@ -398,6 +524,7 @@ AllocationGroup::AddFreeRange(int32 start, int32 blocks)
 	}
 
 	fFreeBits += blocks;
+	fExtents.Add(start, blocks);
 }
 
 
@@ -405,7 +532,7 @@ AllocationGroup::AddFreeRange(int32 start, int32 blocks)
 	Doesn't check if the run is valid or already allocated partially, nor
 	does it maintain the free ranges hints or the volume's used blocks count.
 	It only does the low-level work of allocating some bits in the block bitmap.
-	Assumes that the block bitmap lock is hold.
+	Assumes that the group's lock is held.
 */
 status_t
 AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
@@ -418,6 +545,7 @@ AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
 	if (start == fFirstFree)
 		fFirstFree = start + length;
 	fFreeBits -= length;
+	fExtents.Remove(start, length);
 
 	if (fLargestValid) {
 		bool cut = false;
@@ -474,7 +602,7 @@ AllocationGroup::Allocate(Transaction& transaction, uint16 start, int32 length)
 	Doesn't check if the run is valid or was not completely allocated, nor
 	does it maintain the free ranges hints or the volume's used blocks count.
 	It only does the low-level work of freeing some bits in the block bitmap.
-	Assumes that the block bitmap lock is hold.
+	Assumes that the group's lock is held.
 */
 status_t
 AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
@@ -486,6 +614,7 @@ AllocationGroup::Free(Transaction& transaction, uint16 start, int32 length)
 	if (fFirstFree > start)
 		fFirstFree = start;
 	fFreeBits += length;
+	fExtents.Add(start, length);
 
 	// The range to be freed cannot be part of the valid largest range
 	ASSERT(!fLargestValid || start + length <= fLargestStart
@@ -537,16 +666,21 @@ BlockAllocator::BlockAllocator(Volume* volume)
 	:
 	fVolume(volume),
 	fGroups(NULL),
+	fExtentBudget(kMaxVolumeExtents),
 	fCheckBitmap(NULL),
-	fCheckCookie(NULL)
+	fCheckCookie(NULL),
+	fCheckThreadCount(0),
+	fInitialized(false)
 {
 	recursive_lock_init(&fLock, "bfs allocator");
+	mutex_init(&fUsedBlocksLock, "bfs used blocks");
 }
 
 
 BlockAllocator::~BlockAllocator()
 {
 	recursive_lock_destroy(&fLock);
+	mutex_destroy(&fUsedBlocksLock);
 	delete[] fGroups;
 }
 
@@ -563,6 +697,9 @@ BlockAllocator::Initialize(bool full)
 	if (fGroups == NULL)
 		return B_NO_MEMORY;
 
+	for (int32 i = 0; i < fNumGroups; i++)
+		fGroups[i].fExtents.SetBudget(&fExtentBudget);
+
 	if (!full)
 		return B_OK;
 
@@ -621,6 +758,8 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 		fGroups[i].fFirstFree = fGroups[i].fLargestStart = 0;
 		fGroups[i].fFreeBits = fGroups[i].fLargestLength = fGroups[i].fNumBits;
 		fGroups[i].fLargestValid = true;
+		fGroups[i].fExtents.MakeEmpty();
+		fGroups[i].fExtents.Add(0, fGroups[i].fNumBits);
 
 		offset += fBlocksPerGroup;
 	}
@@ -636,6 +775,7 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 	fVolume->SuperBlock().used_blocks
 		= HOST_ENDIAN_TO_BFS_INT64(reservedBlocks);
 
+	fInitialized = true;
 	return B_OK;
 }
 
@@ -718,6 +858,8 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 					"bitmap/log!\n"));
 				volume->Panic();
 			} else {
+				// the reserved area may have covered more than one free range
+				allocator->_RebuildExtents(groups[0]);
 				transaction.Done();
 				FATAL(("Space for block bitmap or log area was not "
 					"reserved!\n"));
@@ -734,6 +876,7 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 		volume->SuperBlock().used_blocks = HOST_ENDIAN_TO_BFS_INT64(usedBlocks);
 	}
 
+	allocator->fInitialized = true;
 	return B_OK;
 }
 
@@ -764,8 +907,35 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 	FUNCTION_START(("group = %ld, start = %u, maximum = %u, minimum = %u\n",
 		groupIndex, start, maximum, minimum));
 
+	_WaitForInitialization();
+
+	// The search has to be repeated when the run it found has been taken
+	// by the time its group could be locked again. As long as the journal
+	// serializes all transactions, this only happens when a free extent
+	// index turned out to be out of sync, and has been rebuilt.
+	status_t status = B_BUSY;
+	for (int32 tries = 0; tries < kMaxAllocationTries && status == B_BUSY;
+			tries++) {
+		status = _AllocateBlocks(transaction, groupIndex, start, maximum,
+			minimum, run);
+	}
+
+	if (status == B_BUSY) {
+		FATAL(("could not allocate blocks in group %" B_PRId32 " after %"
+			B_PRId32 " tries!\n", groupIndex, kMaxAllocationTries));
+	}
+	return status;
+}
+
+
+/*!	Does the work for AllocateBlocks(). Returns \c B_BUSY, if the run found
+	was no longer free when it was to be allocated.
+*/
+status_t
+BlockAllocator::_AllocateBlocks(Transaction& transaction, int32 groupIndex,
+	uint16 start, uint16 maximum, uint16 minimum, block_run& run)
+{
 	AllocationBlock cached(fVolume);
-	RecursiveLocker lock(fLock);
 
 	uint32 bitsPerFullBlock = fVolume->BlockSize() << 3;
 
@@ -773,11 +943,22 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 	int32 bestGroup = -1;
 	int32 bestStart = -1;
 	int32 bestLength = -1;
+	bool bestFromIndex = false;
+
+	// Only the group that is currently searched is locked
+	MutexLocker groupLocker;
+	int32 lockedGroup = -1;
 
 	for (int32 i = 0; i < fNumGroups + 1; i++, groupIndex++, start = 0) {
 		groupIndex = groupIndex % fNumGroups;
 		AllocationGroup& group = fGroups[groupIndex];
 
+		if (lockedGroup != groupIndex) {
+			cached.Unset();
+			groupLocker.SetTo(group.fLock, false);
+			lockedGroup = groupIndex;
+		}
+
 		CHECK_ALLOCATION_GROUP(groupIndex);
 
 		if (start >= group.NumBits() || group.IsFull())
@@ -789,6 +970,25 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 		if (start < group.fFirstFree)
 			start = group.fFirstFree;
 
+		if (group.fExtents.IsValid()) {
+			// The free extent index knows all free ranges of this group,
+			// there is no need to look at the bitmap
+			int32 extentStart;
+			int32 extentLength;
+			if (group.fExtents.FindRun(start, maximum, extentStart,
+					extentLength)
+				&& extentLength > bestLength) {
+				bestGroup = groupIndex;
+				bestStart = extentStart;
+				bestLength = extentLength;
+				bestFromIndex = true;
+
+				if (bestLength >= maximum)
+					break;
+			}
+			continue;
+		}
+
 		if (group.fLargestValid) {
 			if (group.fLargestLength < bestLength)
 				continue;
@@ -798,6 +998,7 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 					bestGroup = groupIndex;
 					bestStart = group.fLargestStart;
 					bestLength = group.fLargestLength;
+					bestFromIndex = false;
 
 					if (bestLength >= maximum)
 						break;
@@ -841,6 +1042,7 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 						bestGroup = groupIndex;
 						bestStart = currentStart;
 						bestLength = currentLength;
+						bestFromIndex = false;
 						break;
 					}
 				} else {
@@ -850,6 +1052,7 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 							bestGroup = groupIndex;
 							bestStart = currentStart;
 							bestLength = currentLength;
+							bestFromIndex = false;
 						}
 						if (currentLength > groupLargestLength) {
 							groupLargestStart = currentStart;
@@ -885,6 +1088,7 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 				bestGroup = groupIndex;
 				bestStart = currentStart;
 				bestLength = currentLength;
+				bestFromIndex = false;
 			}
 			if (canFindGroupLargest && currentLength > groupLargestLength) {
 				groupLargestStart = currentStart;
@@ -915,17 +1119,48 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 		bestLength = round_down(bestLength, minimum);
 	}
 
+	run.allocation_group = HOST_ENDIAN_TO_BFS_INT32(bestGroup);
+	run.start = HOST_ENDIAN_TO_BFS_INT16(bestStart);
+	run.length = HOST_ENDIAN_TO_BFS_INT16(bestLength);
+
+	bool stillLocked = lockedGroup == bestGroup;
+	if (!stillLocked) {
+		// The group has been unlocked after it was searched, someone else
+		// might have allocated from this range in the mean time.
+		cached.Unset();
+		groupLocker.SetTo(fGroups[bestGroup].fLock, false);
+	}
+
+	// Runs from the free extent index are verified as well, as the index
+	// must never let us allocate blocks that are already in use
+	if (!stillLocked || bestFromIndex) {
+		status_t status = CheckBlocks(fVolume->ToBlock(run), bestLength,
+			false);
+		if (status == B_BAD_DATA) {
+			if (bestFromIndex) {
+				// The index would return the same run again, unless it is
+				// rebuilt; the group is locked again at this point.
+				if (stillLocked) {
+					FATAL(("free extent index of group %" B_PRId32 " is out "
+						"of sync with the block bitmap!\n", bestGroup));
+				}
+				_RebuildExtents(fGroups[bestGroup]);
+			}
+
+			return B_BUSY;
+		}
+		if (status != B_OK)
+			return status;
+	}
+
 	if (fGroups[bestGroup].Allocate(transaction, bestStart, bestLength) != B_OK)
 		RETURN_ERROR(B_IO_ERROR);
 
 	CHECK_ALLOCATION_GROUP(bestGroup);
 
-	run.allocation_group = HOST_ENDIAN_TO_BFS_INT32(bestGroup);
-	run.start = HOST_ENDIAN_TO_BFS_INT16(bestStart);
-	run.length = HOST_ENDIAN_TO_BFS_INT16(bestLength);
+	groupLocker.Unlock();
 
-	fVolume->SuperBlock().used_blocks
-		= HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() + bestLength);
+	_AddUsedBlocks(bestLength);
 		// We are not writing back the disk's superblock - it's
 		// either done by the journaling code, or when the disk
 		// is unmounted.
@@ -992,7 +1227,16 @@ BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
 
 	// Are there already allocated blocks? (then just try to allocate near the
 	// last one)
-	if (inode->Size() > 0) {
+	if (inode->HasExtents()) {
+		// just continue behind the last extent
+		off_t end;
+		if (ExtentStream(inode).GetEnd(end) == B_OK) {
+			block_run last = fVolume->ToBlockRun(end);
+			group = last.AllocationGroup();
+			start = last.Start();
+		} else
+			group = inode->BlockRun().AllocationGroup() + 1;
+	} else if (inode->Size() > 0) {
 		const data_stream& data = inode->Node().data;
 		// TODO: we currently don't care for when the data stream
 		// is already grown into the indirect ranges
@@ -1020,10 +1264,47 @@ BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
 }
 
 
+/*!	Allocates exactly the blocks of \a run, and fails with \c B_BUSY if any
+	of them is already in use. This is used to grow the log area in place.
+*/
+status_t
+BlockAllocator::AllocateRun(Transaction& transaction, block_run run)
+{
+	_WaitForInitialization();
+
+	int32 group = run.AllocationGroup();
+	if (group < 0 || group >= fNumGroups || run.Length() == 0
+		|| uint32(run.Start() + run.Length()) > fGroups[group].NumBits())
+		return B_BAD_VALUE;
+
+	MutexLocker groupLocker(fGroups[group].fLock);
+
+	status_t status = CheckBlocks(fVolume->ToBlock(run), run.Length(), false);
+	if (status != B_OK)
+		return status == B_BAD_DATA ? B_BUSY : status;
+
+	if (fGroups[group].Allocate(transaction, run.Start(), run.Length())
+			!= B_OK)
+		RETURN_ERROR(B_IO_ERROR);
+
+	CHECK_ALLOCATION_GROUP(group);
+
+	groupLocker.Unlock();
+
+	_AddUsedBlocks(run.Length());
+
+	block_cache_discard(fVolume->BlockCache(), fVolume->ToBlock(run),
+		run.Length());
+
+	T(Allocate(run));
+	return B_OK;
+}
+
+
 status_t
 BlockAllocator::Free(Transaction& transaction, block_run run)
 {
-	RecursiveLocker lock(fLock);
+	_WaitForInitialization();
 
 	int32 group = run.AllocationGroup();
 	uint16 start = run.Start();
@@ -1053,6 +1334,9 @@ BlockAllocator::Free(Transaction& transaction, block_run run)
 		DEBUGGER(("tried to free reserved block"));
 		return B_BAD_VALUE;
 	}
+
+	MutexLocker groupLocker(fGroups[group].fLock);
+
 #ifdef DEBUG
 	if (CheckBlockRun(run) != B_OK)
 		return B_BAD_DATA;
@@ -1072,12 +1356,71 @@ BlockAllocator::Free(Transaction& transaction, block_run run)
 	}
 #endif
 
-	fVolume->SuperBlock().used_blocks =
-		HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() - run.Length());
+	groupLocker.Unlock();
+
+	_AddUsedBlocks(-(int32)run.Length());
 	return B_OK;
 }
 
 
+/*!	Waits until the initializer thread has read in the block bitmap; it
+	holds the allocator lock until it's done.
+*/
+void
+BlockAllocator::_WaitForInitialization()
+{
+	if (fInitialized)
+		return;
+
+	RecursiveLocker _(fLock);
+}
+
+
+void
+BlockAllocator::_AddUsedBlocks(int32 count)
+{
+	MutexLocker _(fUsedBlocksLock);
+	fVolume->SuperBlock().used_blocks
+		= HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() + count);
+}
+
+
+/*!	Rebuilds the free extent index of the group from its block bitmap.
+	If the group is too fragmented, the index will remain invalid, and
+	the bitmap will be searched directly.
+	Assumes that the group's lock is held.
+*/
+void
+BlockAllocator::_RebuildExtents(AllocationGroup& group)
+{
+	group.fExtents.MakeEmpty();
+
+	AllocationBlock cached(fVolume);
+	int32 start = -1;
+	int32 range = 0;
+	int32 bit = 0;
+
+	for (uint32 block = 0; block < group.NumBlocks(); block++) {
+		if (cached.SetTo(group, block) != B_OK) {
+			group.fExtents.Invalidate();
+			return;
+		}
+
+		for (uint32 i = 0; i < cached.NumBlockBits(); i++, bit++) {
+			if (cached.IsUsed(i)) {
+				if (range > 0) {
+					group.fExtents.Add(start, range);
+					range = 0;
+				}
+			} else if (range++ == 0)
+				start = bit;
+		}
+	}
+	if (range > 0)
+		group.fExtents.Add(start, range);
+}
+
+
 size_t
 BlockAllocator::BitmapSize() const
 {
@@ -1121,9 +1464,9 @@ void
 BlockAllocator::_CheckGroup(int32 groupIndex) const
 {
 	AllocationBlock cached(fVolume);
-	ASSERT_LOCKED_RECURSIVE(&fLock);
 
 	AllocationGroup& group = fGroups[groupIndex];
+	ASSERT_LOCKED_MUTEX(&group.fLock);
 
 	int32 currentStart = 0, currentLength = 0;
 	int32 firstFree = -1;
@@ -1219,6 +1562,12 @@ BlockAllocator::Trim(uint64 offset, uint64 size, uint64& trimmedSize)
 	for (int32 groupIndex = 0; groupIndex <= lastGroup; groupIndex++) {
 		AllocationGroup& group = fGroups[groupIndex];
 
+		// Nothing must be allocated from the group while we trim what we
+		// think is free. Only this group is locked, though, so that the
+		// others can still be allocated from during the lengthy trimming.
+		cached.Unset();
+		MutexLocker groupLocker(group.fLock);
+
 		for (uint32 block = firstBlock; block < group.NumBlocks(); block++) {
 			cached.SetTo(group, block);
 
@@ -1243,12 +1592,22 @@ BlockAllocator::Trim(uint64 offset, uint64 size, uint64& trimmedSize)
 			}
 		}
 
+		// the ranges have to be trimmed before the group is unlocked
+		if (freeLength > 0 || trimData->range_count > 0) {
+			status_t status = _TrimNext(*trimData, kTrimRanges,
+				firstFree << blockShift, freeLength << blockShift, true,
+				trimmedSize);
+			if (status != B_OK)
+				return status;
+
+			freeLength = 0;
+		}
+
 		firstBlock = 0;
 		firstBit = 0;
 	}
 
-	return _TrimNext(*trimData, kTrimRanges, firstFree << blockShift,
-		freeLength << blockShift, true, trimmedSize);
+	return B_OK;
 }
 
 
@@ -1279,17 +1638,23 @@ BlockAllocator::StartChecking(const check_control* control)
 	if (!_IsValidCheckControl(control))
 		return B_BAD_VALUE;
 
-	fVolume->GetJournal(0)->Lock(NULL, true);
-		// Lock the volume's journal
+	// In read-only mode, the volume can be changed while we check it
+	bool readOnly = (control->flags & BFS_CHECK_READ_ONLY) != 0;
+	if (!readOnly) {
+		fVolume->GetJournal(0)->Lock(NULL, true);
+			// Lock the volume's journal
+	}
 
 	recursive_lock_lock(&fLock);
 
 	size_t size = BitmapSize();
-	fCheckBitmap = (uint32*)malloc(size);
-	if (fCheckBitmap == NULL) {
-		recursive_lock_unlock(&fLock);
-		fVolume->GetJournal(0)->Unlock(NULL, true);
-		return B_NO_MEMORY;
+	if (!readOnly) {
+		fCheckBitmap = (uint32*)malloc(size);
+		if (fCheckBitmap == NULL) {
+			recursive_lock_unlock(&fLock);
+			fVolume->GetJournal(0)->Unlock(NULL, true);
+			return B_NO_MEMORY;
+		}
 	}
 
 	fCheckCookie = new(std::nothrow) check_cookie();
@@ -1297,7 +1662,8 @@ BlockAllocator::StartChecking(const check_control* control)
 		free(fCheckBitmap);
 		fCheckBitmap = NULL;
 		recursive_lock_unlock(&fLock);
-		fVolume->GetJournal(0)->Unlock(NULL, true);
+		if (!readOnly)
+			fVolume->GetJournal(0)->Unlock(NULL, true);
 
 		return B_NO_MEMORY;
 	}
@@ -1305,11 +1671,17 @@ BlockAllocator::StartChecking(const check_control* control)
 	memcpy(&fCheckCookie->control, control, sizeof(check_control));
 	memset(&fCheckCookie->control.stats, 0, sizeof(control->stats));
 
-	// initialize bitmap
-	memset(fCheckBitmap, 0, size);
-	for (int32 block = fVolume->Log().Start() + fVolume->Log().Length();
-			block-- > 0;) {
-		_SetCheckBitmapAt(block);
+	if (readOnly) {
+		// we can't fix anything while others are using the volume
+		fCheckCookie->control.flags
+			&= BFS_CHECK_PARALLEL | BFS_CHECK_READ_ONLY;
+	} else {
+		// initialize bitmap
+		memset(fCheckBitmap, 0, size);
+		for (int32 block = fVolume->Log().Start() + fVolume->Log().Length();
+				block-- > 0;) {
+			_SetCheckBitmapAt(block);
+		}
 	}
 
 	fCheckCookie->pass = BFS_CHECK_PASS_BITMAP;
@@ -1318,13 +1690,32 @@ BlockAllocator::StartChecking(const check_control* control)
 	fCheckCookie->iterator = NULL;
 	fCheckCookie->control.stats.block_size = fVolume->BlockSize();
 
+	// Only use several threads if they don't have to fix anything, as
+	// that needs transactions
+	bool parallel = (fCheckCookie->control.flags & BFS_CHECK_PARALLEL) != 0
+		&& (fCheckCookie->control.flags & (BFS_CHECK_PARALLEL
+			| BFS_CHECK_READ_ONLY)) == fCheckCookie->control.flags;
+
 	// Put removed vnodes to the stack -- they are not reachable by traversing
-	// the file system anymore.
-	InodeList::Iterator iterator = fVolume->RemovedInodes().GetIterator();
-	while (Inode* inode = iterator.Next()) {
-		fCheckCookie->stack.Push(inode->BlockRun());
+	// the file system anymore. (They only matter for the check bitmap.)
+	// The check threads must not get them, though: if one of them held
+	// the last reference to such an inode, putting it would start a
+	// transaction, and wait for the journal lock we are holding. Instead,
+	// they are checked right away; as long as the journal is locked, they
+	// cannot leave the list, and don't need a reference.
+	if (!readOnly) {
+		InodeList::Iterator iterator = fVolume->RemovedInodes().GetIterator();
+		while (Inode* inode = iterator.Next()) {
+			if (parallel)
+				CheckInode(inode, NULL, &fCheckCookie->control);
+			else
+				fCheckCookie->stack.Push(inode->BlockRun());
+		}
 	}
 
+	if (!parallel || _StartCheckThreads() != B_OK)
+		fCheckCookie->control.flags &= ~BFS_CHECK_PARALLEL;
+
 	// TODO: check reserved area in bitmap!
 
 	return B_OK;
@@ -1337,6 +1728,11 @@ BlockAllocator::StopChecking(check_control* control)
 	if (fCheckCookie == NULL)
 		return B_NO_INIT;
 
+	bool readOnly
+		= (fCheckCookie->control.flags & BFS_CHECK_READ_ONLY) != 0;
+
+	_StopCheckThreads();
+
 	if (fCheckCookie->iterator != NULL) {
 		delete fCheckCookie->iterator;
 		fCheckCookie->iterator = NULL;
@@ -1376,7 +1772,8 @@ BlockAllocator::StopChecking(check_control* control)
 	delete fCheckCookie;
 	fCheckCookie = NULL;
 	recursive_lock_unlock(&fLock);
-	fVolume->GetJournal(0)->Unlock(NULL, true);
+	if (!readOnly)
+		fVolume->GetJournal(0)->Unlock(NULL, true);
 
 	return B_OK;
 }
@@ -1411,6 +1808,9 @@ BlockAllocator::CheckNextNode(check_control* control)
 		check_control*	fTarget;
 	} copyControl(&fCheckCookie->control, control);
 
+	if ((fCheckCookie->control.flags & BFS_CHECK_PARALLEL) != 0)
+		return _GetCheckResult();
+
 	while (true) {
 		if (fCheckCookie->iterator == NULL) {
 			if (!fCheckCookie->stack.Pop(&fCheckCookie->current)) {
@@ -1433,6 +1833,15 @@ BlockAllocator::CheckNextNode(check_control* control)
 					continue;
 				}
 
+				if (fCheckCookie->pass == BFS_CHECK_PASS_INDEX) {
+					// All keys have been collected, write the indices
+					status_t status = _LoadIndices();
+					if (status != B_OK) {
+						fCheckCookie->control.status = status;
+						return status;
+					}
+				}
+
 				fCheckCookie->control.status = B_ENTRY_NOT_FOUND;
 				return B_ENTRY_NOT_FOUND;
 			}
@@ -1451,7 +1860,8 @@ BlockAllocator::CheckNextNode(check_control* control)
 			if (!inode->IsContainer()) {
 				// Check file
 				fCheckCookie->control.errors = 0;
-				fCheckCookie->control.status = CheckInode(inode, NULL);
+				fCheckCookie->control.status = CheckInode(inode, NULL,
+					&fCheckCookie->control);
 
 				if (inode->GetName(fCheckCookie->control.name) < B_OK)
 					strcpy(fCheckCookie->control.name, "(node has no name)");
@@ -1468,7 +1878,6 @@ BlockAllocator::CheckNextNode(check_control* control)
 			}
 
 			fCheckCookie->parent = inode;
-			fCheckCookie->parent_mode = inode->Mode();
 
 			// get iterator for the next directory
 			fCheckCookie->iterator = new(std::nothrow) TreeIterator(tree);
@@ -1480,7 +1889,8 @@ BlockAllocator::CheckNextNode(check_control* control)
 
 			// check the inode of the directory
 			fCheckCookie->control.errors = 0;
-			fCheckCookie->control.status = CheckInode(inode, NULL);
+			fCheckCookie->control.status = CheckInode(inode, NULL,
+				&fCheckCookie->control);
 
 			if (inode->GetName(fCheckCookie->control.name) != B_OK)
 				strcpy(fCheckCookie->control.name, "(dir has no name)");
@@ -1492,8 +1902,11 @@ BlockAllocator::CheckNextNode(check_control* control)
 		uint16 length;
 		ino_t id;
 
+		InodeReadLocker locker(fCheckCookie->parent);
 		status_t status = fCheckCookie->iterator->GetNextEntry(name, &length,
 			B_FILE_NAME_LENGTH, &id);
+		locker.Unlock();
+
 		if (status != B_OK) {
 			// we no longer need this iterator
 			delete fCheckCookie->iterator;
@@ -1520,99 +1933,456 @@ BlockAllocator::CheckNextNode(check_control* control)
 		if (!strcmp(name, ".") || !strcmp(name, ".."))
 			continue;
 
-		// fill in the control data as soon as we have them
-		strlcpy(fCheckCookie->control.name, name, B_FILE_NAME_LENGTH);
-		fCheckCookie->control.inode = id;
-		fCheckCookie->control.errors = 0;
+		if (_CheckEntry(fCheckCookie->control, fCheckCookie->parent,
+				fCheckCookie->iterator->Tree(), name, id))
+			return B_OK;
+	}
+	// is never reached
+}
 
-		Vnode vnode(fVolume, id);
-		Inode* inode;
-		if (vnode.Get(&inode) != B_OK) {
-			FATAL(("Could not open inode ID %" B_PRIdINO "!\n", id));
-			fCheckCookie->control.errors |= BFS_COULD_NOT_OPEN;
 
-			if ((fCheckCookie->control.flags & BFS_REMOVE_INVALID) != 0) {
-				status = _RemoveInvalidNode(fCheckCookie->parent,
-					fCheckCookie->iterator->Tree(), NULL, name);
-			} else
-				status = B_ERROR;
+/*!	Checks the entry \a name of the directory \a parent, and fills in
+	\a control with the results. Directories are not checked right away, but
+	are pushed on the stack instead; in this case, \c false is returned, as
+	there is nothing to report yet.
+*/
+bool
+BlockAllocator::_CheckEntry(check_control& control, Inode* parent,
+	BPlusTree* tree, const char* name, ino_t id)
+{
+	// fill in the control data as soon as we have them
+	strlcpy(control.name, name, B_FILE_NAME_LENGTH);
+	control.inode = id;
+	control.errors = 0;
 
-			fCheckCookie->control.status = status;
-			return B_OK;
+	status_t status;
+	Vnode vnode(fVolume, id);
+	Inode* inode;
+	if (vnode.Get(&inode) != B_OK) {
+		if ((control.flags & BFS_CHECK_READ_ONLY) != 0) {
+			// the entry might just have been removed
+			InodeReadLocker locker(parent);
+			off_t foundID;
+			if (tree->Find((uint8*)name, (uint16)strlen(name), &foundID)
+					!= B_OK || foundID != id)
+				return false;
 		}
 
-		// check if the inode's name is the same as in the b+tree
-		if (fCheckCookie->pass == BFS_CHECK_PASS_BITMAP
-			&& inode->IsRegularNode()) {
-			RecursiveLocker locker(inode->SmallDataLock());
-			NodeGetter node(fVolume, inode);
-
-			const char* localName = inode->Name(node.Node());
-			if (localName == NULL || strcmp(localName, name)) {
-				fCheckCookie->control.errors |= BFS_NAMES_DONT_MATCH;
-				FATAL(("Names differ: tree \"%s\", inode \"%s\"\n", name,
-					localName));
-
-				if ((fCheckCookie->control.flags & BFS_FIX_NAME_MISMATCHES)
-						!= 0) {
-					// Rename the inode
-					Transaction transaction(fVolume, inode->BlockNumber());
-
-					// Note, this may need extra blocks, but the inode will
-					// only be checked afterwards, so that it won't be lost
-					status = inode->SetName(transaction, name);
-					if (status == B_OK)
-						status = inode->WriteBack(transaction);
-					if (status == B_OK)
-						status = transaction.Done();
-					if (status != B_OK) {
-						fCheckCookie->control.status = status;
-						return B_OK;
-					}
+		FATAL(("Could not open inode ID %" B_PRIdINO "!\n", id));
+		control.errors |= BFS_COULD_NOT_OPEN;
+
+		if ((control.flags & BFS_REMOVE_INVALID) != 0)
+			status = _RemoveInvalidNode(parent, tree, NULL, name);
+		else
+			status = B_ERROR;
+
+		control.status = status;
+		return true;
+	}
+
+	// check if the inode's name is the same as in the b+tree
+	if (control.pass == BFS_CHECK_PASS_BITMAP && inode->IsRegularNode()) {
+		RecursiveLocker locker(inode->SmallDataLock());
+		NodeGetter node(fVolume, inode);
+
+		const char* localName = inode->Name(node.Node());
+		if (localName == NULL || strcmp(localName, name)) {
+			control.errors |= BFS_NAMES_DONT_MATCH;
+			FATAL(("Names differ: tree \"%s\", inode \"%s\"\n", name,
+				localName));
+
+			if ((control.flags & BFS_FIX_NAME_MISMATCHES) != 0) {
+				// Rename the inode
+				Transaction transaction(fVolume, inode->BlockNumber());
+
+				// Note, this may need extra blocks, but the inode will
+				// only be checked afterwards, so that it won't be lost
+				status = inode->SetName(transaction, name);
+				if (status == B_OK)
+					status = inode->WriteBack(transaction);
+				if (status == B_OK)
+					status = transaction.Done();
+				if (status != B_OK) {
+					control.status = status;
+					return true;
 				}
 			}
 		}
+	}
 
-		fCheckCookie->control.mode = inode->Mode();
-
-		// Check for the correct mode of the node (if the mode of the
-		// file don't fit to its parent, there is a serious problem)
-		if (fCheckCookie->pass == BFS_CHECK_PASS_BITMAP
-			&& (((fCheckCookie->parent_mode & S_ATTR_DIR) != 0
-					&& !inode->IsAttribute())
-				|| ((fCheckCookie->parent_mode & S_INDEX_DIR) != 0
-					&& !inode->IsIndex())
-				|| (is_directory(fCheckCookie->parent_mode)
-					&& !inode->IsRegularNode()))) {
-			FATAL(("inode at %" B_PRIdOFF " is of wrong type: %o (parent "
-				"%o at %" B_PRIdOFF ")!\n", inode->BlockNumber(),
-				inode->Mode(), fCheckCookie->parent_mode,
-				fCheckCookie->parent->BlockNumber()));
-
-			// if we are allowed to fix errors, we should remove the file
-			if ((fCheckCookie->control.flags & BFS_REMOVE_WRONG_TYPES) != 0
-				&& (fCheckCookie->control.flags & BFS_FIX_BITMAP_ERRORS)
-						!= 0) {
-				status = _RemoveInvalidNode(fCheckCookie->parent, NULL,
-					inode, name);
-			} else
-				status = B_ERROR;
-
-			fCheckCookie->control.errors |= BFS_WRONG_TYPE;
-			fCheckCookie->control.status = status;
-			return B_OK;
+	control.mode = inode->Mode();
+
+	// Check for the correct mode of the node (if the mode of the
+	// file don't fit to its parent, there is a serious problem)
+	mode_t parentMode = parent->Mode();
+	if (control.pass == BFS_CHECK_PASS_BITMAP
+		&& (((parentMode & S_ATTR_DIR) != 0 && !inode->IsAttribute())
+			|| ((parentMode & S_INDEX_DIR) != 0 && !inode->IsIndex())
+			|| (is_directory(parentMode) && !inode->IsRegularNode()))) {
+		FATAL(("inode at %" B_PRIdOFF " is of wrong type: %o (parent "
+			"%o at %" B_PRIdOFF ")!\n", inode->BlockNumber(),
+			inode->Mode(), parentMode, parent->BlockNumber()));
+
+		// if we are allowed to fix errors, we should remove the file
+		if ((control.flags & BFS_REMOVE_WRONG_TYPES) != 0
+			&& (control.flags & BFS_FIX_BITMAP_ERRORS) != 0) {
+			status = _RemoveInvalidNode(parent, NULL, inode, name);
+		} else
+			status = B_ERROR;
+
+		control.errors |= BFS_WRONG_TYPE;
+		control.status = status;
+		return true;
+	}
+
+	// push the directory on the stack so that it will be scanned later
+	if (inode->IsContainer() && !inode->IsIndex()) {
+		_PushCheckNode(inode->BlockRun());
+		return false;
+	}
+
+	// check it now
+	control.status = CheckInode(inode, name, &control);
+	return true;
+}
+
+
+void
+BlockAllocator::_PushCheckNode(block_run run)
+{
+	MutexLocker locker(fCheckCookie->lock);
+	fCheckCookie->stack.Push(run);
+
+	if (fCheckCookie->waiting_threads > 0) {
+		fCheckCookie->waiting_threads--;
+		release_sem(fCheckCookie->work_sem);
+	}
+}
+
+
+/*!	Gets the next node for a check thread, and waits for one if there is
+	none yet, but other threads are still working. Returns \c false when
+	there is nothing left to do.
+*/
+bool
+BlockAllocator::_PopCheckNode(block_run& run)
+{
+	MutexLocker locker(fCheckCookie->lock);
+
+	while (!fCheckCookie->stopping) {
+		if (fCheckCookie->stack.Pop(&run)) {
+			fCheckCookie->busy_threads++;
+			return true;
 		}
+		if (fCheckCookie->busy_threads == 0)
+			return false;
 
-		// push the directory on the stack so that it will be scanned later
-		if (inode->IsContainer() && !inode->IsIndex())
-			fCheckCookie->stack.Push(inode->BlockRun());
-		else {
-			// check it now
-			fCheckCookie->control.status = CheckInode(inode, name);
-			return B_OK;
+		fCheckCookie->waiting_threads++;
+		locker.Unlock();
+
+		if (acquire_sem(fCheckCookie->work_sem) != B_OK)
+			return false;
+
+		locker.Lock();
+	}
+
+	return false;
+}
+
+
+void
+BlockAllocator::_CheckNodeDone()
+{
+	MutexLocker locker(fCheckCookie->lock);
+
+	if (--fCheckCookie->busy_threads == 0 && fCheckCookie->stack.IsEmpty()
+		&& fCheckCookie->waiting_threads > 0) {
+		// we are done, wake up everyone so that they can quit
+		release_sem_etc(fCheckCookie->work_sem,
+			fCheckCookie->waiting_threads, 0);
+		fCheckCookie->waiting_threads = 0;
+	}
+}
+
+
+/*!	Starts the threads for a parallel check. The nodes they check are then
+	retrieved via _GetCheckResult() one by one.
+*/
+status_t
+BlockAllocator::_StartCheckThreads()
+{
+#ifdef FS_SHELL
+	// The FS shell doesn't know the number of CPUs
+	int32 count = 4;
+#else
+	int32 count = 1;
+	system_info info;
+	if (get_system_info(&info) == B_OK)
+		count = info.cpu_count;
+#endif
+	if (count > kMaxCheckThreads)
+		count = kMaxCheckThreads;
+	if (count < 2)
+		return B_NOT_SUPPORTED;
+
+	fCheckCookie->work_sem = create_sem(0, "bfs check work");
+	fCheckCookie->free_sem = create_sem(kCheckResultQueueSize,
+		"bfs check free results");
+	fCheckCookie->result_sem = create_sem(0, "bfs check results");
+	if (fCheckCookie->work_sem < 0 || fCheckCookie->free_sem < 0
+		|| fCheckCookie->result_sem < 0) {
+		_StopCheckThreads();
+		return B_NO_MORE_SEMS;
+	}
+
+	for (int32 i = 0; i < count; i++) {
+		thread_id thread = spawn_kernel_thread(&BlockAllocator::_CheckThread,
+			"bfs checker", B_NORMAL_PRIORITY, this);
+		if (thread < 0)
+			break;
+
+		fCheckThreads[fCheckThreadCount++] = thread;
+	}
+	if (fCheckThreadCount == 0) {
+		_StopCheckThreads();
+		return B_NO_MORE_THREADS;
+	}
+
+	fCheckCookie->running_threads = fCheckThreadCount;
+
+	for (int32 i = 0; i < fCheckThreadCount; i++)
+		resume_thread(fCheckThreads[i]);
+
+	return B_OK;
+}
+
+
+void
+BlockAllocator::_StopCheckThreads()
+{
+	MutexLocker locker(fCheckCookie->lock);
+	fCheckCookie->stopping = true;
+	locker.Unlock();
+
+	// wakes up all threads that are waiting for work or free result slots
+	delete_sem(fCheckCookie->work_sem);
+	delete_sem(fCheckCookie->free_sem);
+
+	for (int32 i = 0; i < fCheckThreadCount; i++) {
+		status_t result;
+		wait_for_thread(fCheckThreads[i], &result);
+	}
+	fCheckThreadCount = 0;
+
+	delete_sem(fCheckCookie->result_sem);
+	fCheckCookie->work_sem = -1;
+	fCheckCookie->free_sem = -1;
+	fCheckCookie->result_sem = -1;
+}
+
+
+/*static*/ status_t
+BlockAllocator::_CheckThread(void* _self)
+{
+	BlockAllocator* self = (BlockAllocator*)_self;
+	self->_CheckNodes();
+	return B_OK;
+}
+
+
+//!	The main loop of a check thread.
+void
+BlockAllocator::_CheckNodes()
+{
+	check_control control;
+	memset(&control, 0, sizeof(check_control));
+	control.pass = BFS_CHECK_PASS_BITMAP;
+	control.flags = fCheckCookie->control.flags;
+
+	block_run run;
+	while (_PopCheckNode(run)) {
+		_CheckNodeAndEntries(control, run);
+		_CheckNodeDone();
+	}
+
+	MutexLocker locker(fCheckCookie->lock);
+
+	// add our stats to the overall ones
+	check_control& total = fCheckCookie->control;
+	total.stats.missing += control.stats.missing;
+	total.stats.already_set += control.stats.already_set;
+	total.stats.direct_block_runs += control.stats.direct_block_runs;
+	total.stats.indirect_block_runs += control.stats.indirect_block_runs;
+	total.stats.indirect_array_blocks += control.stats.indirect_array_blocks;
+	total.stats.double_indirect_block_runs
+		+= control.stats.double_indirect_block_runs;
+	total.stats.double_indirect_array_blocks
+		+= control.stats.double_indirect_array_blocks;
+	total.stats.blocks_in_direct += control.stats.blocks_in_direct;
+	total.stats.blocks_in_indirect += control.stats.blocks_in_indirect;
+	total.stats.blocks_in_double_indirect
+		+= control.stats.blocks_in_double_indirect;
+	total.stats.partial_block_runs += control.stats.partial_block_runs;
+
+	if (--fCheckCookie->running_threads == 0) {
+		// let _GetCheckResult() know that we're done
+		release_sem(fCheckCookie->result_sem);
+	}
+}
+
+
+/*!	Checks the node at \a run, and if it's a directory, all of its entries
+	as well. Subdirectories are left to the other check threads.
+*/
+void
+BlockAllocator::_CheckNodeAndEntries(check_control& control, block_run run)
+{
+	Vnode vnode(fVolume, run);
+	Inode* inode;
+	if (vnode.Get(&inode) != B_OK) {
+		FATAL(("check: Could not open inode at %" B_PRIdOFF "\n",
+			fVolume->ToBlock(run)));
+		return;
+	}
+
+	control.inode = inode->ID();
+	control.mode = inode->Mode();
+	control.errors = 0;
+	control.status = CheckInode(inode, NULL, &control);
+
+	if (inode->GetName(control.name) != B_OK) {
+		strcpy(control.name, inode->IsContainer()
+			? "(dir has no name)" : "(node has no name)");
+	}
+
+	if (!_AddCheckResult(control) || !inode->IsContainer())
+		return;
+
+	BPlusTree* tree = inode->Tree();
+	if (tree == NULL) {
+		FATAL(("check: could not open b+tree from inode at %" B_PRIdOFF
+			"\n", fVolume->ToBlock(run)));
+		return;
+	}
+
+	TreeIterator iterator(tree);
+
+	while (!fCheckCookie->stopping) {
+		char name[B_FILE_NAME_LENGTH];
+		uint16 length;
+		ino_t id;
+
+		InodeReadLocker locker(inode);
+		status_t status = iterator.GetNextEntry(name, &length,
+			B_FILE_NAME_LENGTH, &id);
+		locker.Unlock();
+
+		if (status != B_OK) {
+			if (status != B_ENTRY_NOT_FOUND) {
+				// Like in CheckNextNode(), this lets the whole run fail
+				MutexLocker cookieLocker(fCheckCookie->lock);
+				fCheckCookie->thread_status = status;
+				fCheckCookie->stopping = true;
+				if (fCheckCookie->waiting_threads > 0) {
+					release_sem_etc(fCheckCookie->work_sem,
+						fCheckCookie->waiting_threads, 0);
+					fCheckCookie->waiting_threads = 0;
+				}
+			}
+			return;
 		}
+
+		// ignore "." and ".." entries
+		if (!strcmp(name, ".") || !strcmp(name, ".."))
+			continue;
+
+		if (_CheckEntry(control, inode, tree, name, id)
+			&& !_AddCheckResult(control))
+			return;
 	}
-	// is never reached
+}
+
+
+/*!	Queues the results of the node that was just checked for
+	_GetCheckResult(), and waits for room in the queue, if necessary.
+	Returns \c false if the check is being stopped.
+*/
+bool
+BlockAllocator::_AddCheckResult(const check_control& control)
+{
+	if (acquire_sem(fCheckCookie->free_sem) != B_OK)
+		return false;
+
+	MutexLocker locker(fCheckCookie->lock);
+
+	check_result& result = fCheckCookie->results[(fCheckCookie->first_result
+		+ fCheckCookie->result_count) % kCheckResultQueueSize];
+	fCheckCookie->result_count++;
+
+	strlcpy(result.name, control.name, B_FILE_NAME_LENGTH);
+	result.inode = control.inode;
+	result.mode = control.mode;
+	result.errors = control.errors;
+	result.status = control.status;
+
+	locker.Unlock();
+	release_sem(fCheckCookie->result_sem);
+	return true;
+}
+
+
+//!	Reports the next node checked by the check threads.
+status_t
+BlockAllocator::_GetCheckResult()
+{
+	check_control& control = fCheckCookie->control;
+	if (fCheckCookie->results_done) {
+		// the last release of the result semaphore has already been used up
+		return control.status;
+	}
+
+	status_t status = acquire_sem(fCheckCookie->result_sem);
+	if (status != B_OK)
+		return status;
+
+	MutexLocker locker(fCheckCookie->lock);
+
+	if (fCheckCookie->result_count == 0) {
+		// all threads are done
+		fCheckCookie->results_done = true;
+		if (fCheckCookie->thread_status != B_OK)
+			control.status = fCheckCookie->thread_status;
+		else
+			control.status = B_ENTRY_NOT_FOUND;
+		return control.status;
+	}
+
+	const check_result& result
+		= fCheckCookie->results[fCheckCookie->first_result];
+	fCheckCookie->first_result
+		= (fCheckCookie->first_result + 1) % kCheckResultQueueSize;
+	fCheckCookie->result_count--;
+
+	strlcpy(control.name, result.name, B_FILE_NAME_LENGTH);
+	control.inode = result.inode;
+	control.mode = result.mode;
+	control.errors = result.errors;
+	control.status = result.status;
+
+	locker.Unlock();
+	release_sem(fCheckCookie->free_sem);
+	return B_OK;
+}
+
+
+bool
+BlockAllocator::IsCheckThread(thread_id thread) const
+{
+	for (int32 i = 0; i < fCheckThreadCount; i++) {
+		if (fCheckThreads[i] == thread)
+			return true;
+	}
+	return false;
 }
 
 
@@ -1663,22 +2433,27 @@ BlockAllocator::_CheckBitmapIsUsedAt(off_t block) const
 }
 
 
-void
+/*!	Marks \a block as used in the check bitmap, and returns whether or not
+	it had been marked already. Since several check threads may update the
+	bitmap at the same time, this is done atomically.
+*/
+bool
 BlockAllocator::_SetCheckBitmapAt(off_t block)
 {
 	size_t size = BitmapSize();
 	uint32 index = block / 32;	// 32bit resolution
 	if (index > size / 4)
-		return;
+		return false;
 
-	fCheckBitmap[index] |= HOST_ENDIAN_TO_BFS_INT32(1UL << (block & 0x1f));
+	int32 mask = HOST_ENDIAN_TO_BFS_INT32(1UL << (block & 0x1f));
+	return (atomic_or((int32*)&fCheckBitmap[index], mask) & mask) != 0;
 }
 
 
 status_t
 BlockAllocator::_WriteBackCheckBitmap()
 {
-	if (fVolume->IsReadOnly())
+	if (fVolume->IsReadOnly() || fCheckBitmap == NULL)
 		return B_OK;
 
 	// calculate the number of used blocks in the check bitmap
@@ -1746,6 +2521,12 @@ BlockAllocator::_WriteBackCheckBitmap()
 			}
 			transaction.Done();
 		}
+
+		// the free extent indices no longer match the bitmap
+		for (int32 i = 0; i < fNumGroups; i++) {
+			MutexLocker locker(fGroups[i].fLock);
+			_RebuildExtents(fGroups[i]);
+		}
 	}
 
 	return B_OK;
@@ -1793,7 +2574,8 @@ BlockAllocator::CheckBlocks(off_t start, off_t length, bool allocated)
 
 
 status_t
-BlockAllocator::CheckBlockRun(block_run run, const char* type, bool allocated)
+BlockAllocator::CheckBlockRun(block_run run, const char* type, bool allocated,
+	check_control* control)
 {
 	if (run.AllocationGroup() < 0 || run.AllocationGroup() >= fNumGroups
 		|| run.Start() > fGroups[run.AllocationGroup()].fNumBits
@@ -1802,10 +2584,10 @@ BlockAllocator::CheckBlockRun(block_run run, const char* type, bool allocated)
 		|| run.length == 0) {
 		PRINT(("%s: block_run(%ld, %u, %u) is invalid!\n", type,
 			run.AllocationGroup(), run.Start(), run.Length()));
-		if (fCheckCookie == NULL)
+		if (control == NULL)
 			return B_BAD_DATA;
 
-		fCheckCookie->control.errors |= BFS_INVALID_BLOCK_RUN;
+		control->errors |= BFS_INVALID_BLOCK_RUN;
 		return B_OK;
 	}
 
@@ -1830,7 +2612,7 @@ BlockAllocator::CheckBlockRun(block_run run, const char* type, bool allocated)
 
 		while (length < run.Length() && pos < cached.NumBlockBits()) {
 			if (cached.IsUsed(pos) != allocated) {
-				if (fCheckCookie == NULL) {
+				if (control == NULL) {
 					PRINT(("%s: block_run(%ld, %u, %u) is only partially "
 						"allocated (pos = %ld, length = %ld)!\n", type,
 						run.AllocationGroup(), run.Start(), run.Length(),
@@ -1839,9 +2621,9 @@ BlockAllocator::CheckBlockRun(block_run run, const char* type, bool allocated)
 				}
 				if (firstMissing == -1) {
 					firstMissing = firstGroupBlock + pos + block * bitsPerBlock;
-					fCheckCookie->control.errors |= BFS_MISSING_BLOCKS;
+					control->errors |= BFS_MISSING_BLOCKS;
 				}
-				fCheckCookie->control.stats.missing++;
+				control->stats.missing++;
 			} else if (firstMissing != -1) {
 				PRINT(("%s: block_run(%ld, %u, %u): blocks %Ld - %Ld are "
 					"%sallocated!\n", type, run.AllocationGroup(), run.Start(),
@@ -1851,18 +2633,18 @@ BlockAllocator::CheckBlockRun(block_run run, const char* type, bool allocated)
 				firstMissing = -1;
 			}
 
-			if (fCheckBitmap != NULL) {
+			if (control != NULL && fCheckBitmap != NULL) {
 				// Set the block in the check bitmap as well, but have a look
 				// if it is already allocated first
 				uint32 offset = pos + block * bitsPerBlock;
-				if (_CheckBitmapIsUsedAt(firstGroupBlock + offset)) {
+				if (_SetCheckBitmapAt(firstGroupBlock + offset)) {
 					if (firstSet == -1) {
 						firstSet = firstGroupBlock + offset;
-						fCheckCookie->control.errors |= BFS_BLOCKS_ALREADY_SET;
+						control->errors |= BFS_BLOCKS_ALREADY_SET;
 						dprintf("block %" B_PRIdOFF " is already set!!!\n",
 							firstGroupBlock + offset);
 					}
-					fCheckCookie->control.stats.already_set++;
+					control->stats.already_set++;
 				} else {
 					if (firstSet != -1) {
 						FATAL(("%s: block_run(%d, %u, %u): blocks %" B_PRIdOFF
@@ -1872,7 +2654,6 @@ BlockAllocator::CheckBlockRun(block_run run, const char* type, bool allocated)
 							firstGroupBlock + offset - 1));
 						firstSet = -1;
 					}
-					_SetCheckBitmapAt(firstGroupBlock + offset);
 				}
 			}
 			length++;
@@ -1901,9 +2682,13 @@ BlockAllocator::CheckBlockRun(block_run run, const char* type, bool allocated)
 
 
 status_t
-BlockAllocator::CheckInode(Inode* inode, const char* name)
+BlockAllocator::CheckInode(Inode* inode, const char* name,
+	check_control* control)
 {
-	if (fCheckCookie != NULL && fCheckBitmap == NULL)
+	if (fCheckCookie == NULL || control == NULL)
+		return B_NO_INIT;
+	if (fCheckBitmap == NULL
+		&& (control->flags & BFS_CHECK_READ_ONLY) == 0)
 		return B_NO_INIT;
 	if (inode == NULL)
 		return B_BAD_VALUE;
@@ -1911,18 +2696,23 @@ BlockAllocator::CheckInode(Inode* inode, const char* name)
 	switch (fCheckCookie->pass) {
 		case BFS_CHECK_PASS_BITMAP:
 		{
-			status_t status = _CheckInodeBlocks(inode, name);
+			// When checking a volume in use, the inode must not change
+			// while we look at it
+			InodeReadLocker locker((control->flags & BFS_CHECK_READ_ONLY) != 0
+				? inode : NULL);
+
+			status_t status = _CheckInodeBlocks(inode, name, control);
 			if (status != B_OK)
 				return status;
 
 			// Check the B+tree as well
 			if (inode->IsContainer()) {
 				bool repairErrors
-					= (fCheckCookie->control.flags & BFS_FIX_BPLUSTREES) != 0;
+					= (control->flags & BFS_FIX_BPLUSTREES) != 0;
 				bool errorsFound = false;
 				status = inode->Tree()->Validate(repairErrors, errorsFound);
 				if (errorsFound) {
-					fCheckCookie->control.errors |= BFS_INVALID_BPLUSTREE;
+					control->errors |= BFS_INVALID_BPLUSTREE;
 					if (inode->IsIndex() && name != NULL && repairErrors) {
 						// We completely rebuild corrupt indices
 						check_index* index = new(std::nothrow) check_index;
@@ -1948,15 +2738,16 @@ BlockAllocator::CheckInode(Inode* inode, const char* name)
 
 
 status_t
-BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
+BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name,
+	check_control* control)
 {
-	status_t status = CheckBlockRun(inode->BlockRun(), "inode");
+	status_t status = CheckBlockRun(inode->BlockRun(), "inode", true, control);
 	if (status != B_OK)
 		return status;
 
 	// If the inode has an attribute directory, push it on the stack
 	if (!inode->Attributes().IsZero())
-		fCheckCookie->stack.Push(inode->Attributes());
+		_PushCheckNode(inode->Attributes());
 
 	if (inode->IsSymLink() && (inode->Flags() & INODE_LONG_SYMLINK) == 0) {
 		// symlinks may not have a valid data stream
@@ -1966,6 +2757,21 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 		return B_OK;
 	}
 
+	if (inode->HasInlineData()) {
+		// the data is stored in the small_data section of the inode
+		return B_OK;
+	}
+
+	if (inode->HasExtents()) {
+		CheckExtentVisitor visitor(*this, fVolume, *control);
+		status = ExtentStream(inode).Visit(visitor);
+		if (status == B_BAD_DATA) {
+			control->errors |= BFS_INVALID_BLOCK_RUN;
+			return B_OK;
+		}
+		return status;
+	}
+
 	data_stream* data = &inode->Node().data;
 
 	// check the direct range
@@ -1975,12 +2781,13 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 			if (data->direct[i].IsZero())
 				break;
 
-			status = CheckBlockRun(data->direct[i], "direct");
+			status = CheckBlockRun(data->direct[i], "direct", true,
+				control);
 			if (status < B_OK)
 				return status;
 
-			fCheckCookie->control.stats.direct_block_runs++;
-			fCheckCookie->control.stats.blocks_in_direct
+			control->stats.direct_block_runs++;
+			control->stats.blocks_in_direct
 				+= data->direct[i].Length();
 		}
 	}
@@ -1990,7 +2797,7 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 	// check the indirect range
 
 	if (data->max_indirect_range) {
-		status = CheckBlockRun(data->indirect, "indirect");
+		status = CheckBlockRun(data->indirect, "indirect", true, control);
 		if (status < B_OK)
 			return status;
 
@@ -2007,15 +2814,16 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 				if (runs[index].IsZero())
 					break;
 
-				status = CheckBlockRun(runs[index], "indirect->run");
+				status = CheckBlockRun(runs[index], "indirect->run", true,
+					control);
 				if (status < B_OK)
 					return status;
 
-				fCheckCookie->control.stats.indirect_block_runs++;
-				fCheckCookie->control.stats.blocks_in_indirect
+				control->stats.indirect_block_runs++;
+				control->stats.blocks_in_indirect
 					+= runs[index].Length();
 			}
-			fCheckCookie->control.stats.indirect_array_blocks++;
+			control->stats.indirect_array_blocks++;
 
 			if (index < runsPerBlock)
 				break;
@@ -2025,7 +2833,8 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 	// check the double indirect range
 
 	if (data->max_double_indirect_range) {
-		status = CheckBlockRun(data->double_indirect, "double indirect");
+		status = CheckBlockRun(data->double_indirect, "double indirect", true,
+			control);
 		if (status != B_OK)
 			return status;
 
@@ -2048,7 +2857,8 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 			if (indirect.IsZero())
 				return B_OK;
 
-			status = CheckBlockRun(indirect, "double indirect->runs");
+			status = CheckBlockRun(indirect, "double indirect->runs", true,
+				control);
 			if (status != B_OK)
 				return status;
 
@@ -2068,17 +2878,17 @@ BlockAllocator::_CheckInodeBlocks(Inode* inode, const char* name)
 						return B_OK;
 
 					status = CheckBlockRun(runs[index % runsPerBlock],
-						"double indirect->runs->run");
+						"double indirect->runs->run", true, control);
 					if (status != B_OK)
 						return status;
 
-					fCheckCookie->control.stats.double_indirect_block_runs++;
-					fCheckCookie->control.stats.blocks_in_double_indirect
+					control->stats.double_indirect_block_runs++;
+					control->stats.blocks_in_double_indirect
 						+= runs[index % runsPerBlock].Length();
 				} while ((++index % runsPerBlock) != 0);
 			}
 
-			fCheckCookie->control.stats.double_indirect_array_blocks++;
+			control->stats.double_indirect_array_blocks++;
 		}
 	}
 
@@ -2112,6 +2922,10 @@ BlockAllocator::_PrepareIndices()
 		if (status != B_OK)
 			return status;
 
+		// The keys are collected, and the tree is built at once in the
+		// end; if that's not possible, they are inserted one by one
+		index->builder = new(std::nothrow) TreeBuilder(tree);
+
 		index->inode = inode;
 		vnode.Keep();
 		count++;
@@ -2130,6 +2944,7 @@ BlockAllocator::_FreeIndices()
 			put_vnode(fVolume->FSVolume(),
 				fVolume->ToVnode(index->inode->BlockRun()));
 		}
+		delete index->builder;
 	}
 	fCheckCookie->indices.MakeEmpty();
 }
@@ -2138,46 +2953,72 @@ BlockAllocator::_FreeIndices()
 status_t
 BlockAllocator::_AddInodeToIndex(Inode* inode)
 {
-	Transaction transaction(fVolume, inode->BlockNumber());
+	Transaction transaction;
 
 	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
 		check_index* index = fCheckCookie->indices.Array()[i];
 		if (index->inode == NULL)
 			continue;
 
-		index->inode->WriteLockInTransaction(transaction);
+		uint8 key[BPLUSTREE_MAX_KEY_LENGTH];
+		size_t keyLength;
 
-		BPlusTree* tree = index->inode->Tree();
-		if (tree == NULL)
-			return B_ERROR;
+		if (!strcmp(index->name, "name")) {
+			if (!inode->InNameIndex())
+				continue;
 
-		status_t status = B_OK;
+			if (inode->GetName((char*)key, sizeof(key)) != B_OK)
+				return B_ERROR;
 
-		if (!strcmp(index->name, "name")) {
-			if (inode->InNameIndex()) {
-				char name[B_FILE_NAME_LENGTH];
-				if (inode->GetName(name, B_FILE_NAME_LENGTH) != B_OK)
-					return B_ERROR;
+			keyLength = strlen((char*)key);
+		} else if (!strcmp(index->name, kNameTrigramIndex)) {
+			if (!inode->InNameIndex())
+				continue;
+
+			char name[B_FILE_NAME_LENGTH];
+			if (inode->GetName(name, sizeof(name)) != B_OK)
+				return B_ERROR;
+
+			// too large for the stack
+			NameTrigrams* trigrams = new(std::nothrow) NameTrigrams;
+			if (trigrams == NULL)
+				return B_NO_MEMORY;
+			ObjectDeleter<NameTrigrams> trigramsDeleter(trigrams);
 
-				status = tree->Insert(transaction, name, inode->ID());
+			trigrams->SetToName(name);
+
+			for (int32 j = 0; j < trigrams->CountTrigrams(); j++) {
+				NameTrigrams::GetKey(trigrams->TrigramAt(j), key);
+
+				status_t status = _AddKeyToIndex(transaction, index, inode,
+					key, kTrigramLength);
+				if (status != B_OK)
+					return status;
 			}
+			continue;
 		} else if (!strcmp(index->name, "last_modified")) {
-			if (inode->InLastModifiedIndex()) {
-				status = tree->Insert(transaction, inode->OldLastModified(),
-					inode->ID());
-			}
+			if (!inode->InLastModifiedIndex())
+				continue;
+
+			int64 lastModified = inode->OldLastModified();
+			memcpy(key, &lastModified, sizeof(int64));
+			keyLength = sizeof(int64);
 		} else if (!strcmp(index->name, "size")) {
-			if (inode->InSizeIndex())
-				status = tree->Insert(transaction, inode->Size(), inode->ID());
+			if (!inode->InSizeIndex())
+				continue;
+
+			int64 size = inode->Size();
+			memcpy(key, &size, sizeof(int64));
+			keyLength = sizeof(int64);
 		} else {
-			uint8 key[BPLUSTREE_MAX_KEY_LENGTH];
-			size_t keyLength = BPLUSTREE_MAX_KEY_LENGTH;
+			keyLength = BPLUSTREE_MAX_KEY_LENGTH;
 			if (inode->ReadAttribute(index->name, B_ANY_TYPE, 0, key,
-					&keyLength) == B_OK) {
-				status = tree->Insert(transaction, key, keyLength, inode->ID());
-			}
+					&keyLength) != B_OK)
+				continue;
 		}
 
+		status_t status = _AddKeyToIndex(transaction, index, inode, key,
+			keyLength);
 		if (status != B_OK)
 			return status;
 	}
@@ -2186,6 +3027,70 @@ BlockAllocator::_AddInodeToIndex(Inode* inode)
 }
 
 
+status_t
+BlockAllocator::_AddKeyToIndex(Transaction& transaction, check_index* index,
+	Inode* inode, const uint8* key, size_t keyLength)
+{
+	status_t status;
+
+	if (index->builder != NULL) {
+		status = index->builder->Add(key, keyLength, inode->ID());
+		if (status != B_NO_MEMORY)
+			return status;
+
+		// The builder cannot take any more keys; write the ones it has,
+		// and insert all remaining ones directly
+		status = transaction.Done();
+		if (status == B_OK)
+			status = index->builder->Finish();
+
+		delete index->builder;
+		index->builder = NULL;
+
+		if (status != B_OK)
+			return status;
+	}
+
+	if (!transaction.IsStarted()) {
+		status = transaction.Start(fVolume, inode->BlockNumber());
+		if (status != B_OK)
+			return status;
+	}
+
+	index->inode->WriteLockInTransaction(transaction);
+
+	BPlusTree* tree = index->inode->Tree();
+	if (tree == NULL)
+		return B_ERROR;
+
+	return tree->Insert(transaction, key, keyLength, inode->ID());
+}
+
+
+/*!	Builds the indices from the keys that were collected for them during
+	the index pass.
+*/
+status_t
+BlockAllocator::_LoadIndices()
+{
+	for (int32 i = 0; i < fCheckCookie->indices.CountItems(); i++) {
+		check_index* index = fCheckCookie->indices.Array()[i];
+		if (index->builder == NULL)
+			continue;
+
+		status_t status = index->builder->Finish();
+
+		delete index->builder;
+		index->builder = NULL;
+
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
 status_t
 BlockAllocator::_AddTrim(fs_trim_data& trimData, uint32 maxRanges,
 	uint64 offset, uint64 size)
@@ -2244,6 +3149,8 @@ BlockAllocator::Dump(int32 index)
 {
 	kprintf("allocation groups: %" B_PRId32 " (base %p)\n", fNumGroups, fGroups);
 	kprintf("blocks per group: %" B_PRId32 "\n", fBlocksPerGroup);
+	kprintf("free extents: %" B_PRId32 " (max %" B_PRId32 ")\n",
+		fExtentBudget.CountExtents(), kMaxVolumeExtents);
 
 	for (int32 i = 0; i < fNumGroups; i++) {
 		if (index != -1 && i != index)
@@ -2260,6 +3167,9 @@ BlockAllocator::Dump(int32 index)
 			group.fLargestValid ? "" : "  (invalid)");
 		kprintf("      largest length: %" B_PRId32 "\n", group.fLargestLength);
 		kprintf("      free bits:      %" B_PRId32 "\n", group.fFreeBits);
+		kprintf("      free extents:   %" B_PRId32 "%s\n",
+			group.fExtents.CountExtents(),
+			group.fExtents.IsValid() ? "" : "  (invalid)");
 	}
 }
 
@@ -8,6 +8,8 @@
 
 #include "system_dependencies.h"
 
+#include "FreeExtentIndex.h"
+
 
 class AllocationGroup;
 class BPlusTree;
@@ -18,11 +20,14 @@ struct disk_super_block;
 struct block_run;
 struct check_control;
 struct check_cookie;
+struct check_index;
 
 
 //#define DEBUG_ALLOCATION_GROUPS
 //#define DEBUG_FRAGMENTER
 
+static const int32 kMaxCheckThreads = 8;
+
 
 class BlockAllocator {
 public:
@@ -45,6 +50,8 @@ public:
 			status_t		AllocateBlocks(Transaction& transaction,
 								int32 group, uint16 start, uint16 numBlocks,
 								uint16 minimum, block_run& run);
+			status_t		AllocateRun(Transaction& transaction,
+								block_run run);
 
 			status_t		Trim(uint64 offset, uint64 size,
 								uint64& trimmedSize);
@@ -57,8 +64,11 @@ public:
 								bool allocated = true);
 			status_t		CheckBlockRun(block_run run,
 								const char* type = NULL,
-								bool allocated = true);
-			status_t		CheckInode(Inode* inode, const char* name);
+								bool allocated = true,
+								check_control* control = NULL);
+			status_t		CheckInode(Inode* inode, const char* name,
+								check_control* control);
+			bool			IsCheckThread(thread_id thread) const;
 
 			size_t			BitmapSize() const;
 
@@ -77,12 +87,30 @@ private:
 #endif
 			bool			_IsValidCheckControl(const check_control* control);
 			bool			_CheckBitmapIsUsedAt(off_t block) const;
-			void			_SetCheckBitmapAt(off_t block);
-			status_t		_CheckInodeBlocks(Inode* inode, const char* name);
+			bool			_SetCheckBitmapAt(off_t block);
+			status_t		_CheckInodeBlocks(Inode* inode, const char* name,
+								check_control* control);
+			bool			_CheckEntry(check_control& control,
+								Inode* parent, BPlusTree* tree,
+								const char* name, ino_t id);
+			void			_PushCheckNode(block_run run);
+			bool			_PopCheckNode(block_run& run);
+			void			_CheckNodeDone();
+			status_t		_StartCheckThreads();
+			void			_StopCheckThreads();
+			void			_CheckNodes();
+			void			_CheckNodeAndEntries(check_control& control,
+								block_run run);
+			bool			_AddCheckResult(const check_control& control);
+			status_t		_GetCheckResult();
 			status_t		_FinishBitmapPass();
 			status_t		_PrepareIndices();
 			void			_FreeIndices();
 			status_t		_AddInodeToIndex(Inode* inode);
+			status_t		_AddKeyToIndex(Transaction& transaction,
+								check_index* index, Inode* inode,
+								const uint8* key, size_t keyLength);
+			status_t		_LoadIndices();
 			status_t		_WriteBackCheckBitmap();
 			status_t		_AddTrim(fs_trim_data& trimData, uint32 maxRanges,
 								uint64 offset, uint64 size);
@@ -90,18 +118,34 @@ private:
 								uint64 offset, uint64 size, bool force,
 								uint64& trimmedSize);
 
+			status_t		_AllocateBlocks(Transaction& transaction,
+								int32 group, uint16 start, uint16 numBlocks,
+								uint16 minimum, block_run& run);
+			void			_WaitForInitialization();
+			void			_AddUsedBlocks(int32 count);
+			void			_RebuildExtents(AllocationGroup& group);
+
 	static	status_t		_Initialize(BlockAllocator* self);
+	static	status_t		_CheckThread(void* self);
 
 private:
 			Volume*			fVolume;
 			recursive_lock	fLock;
+				// only protects initialization and checking; the groups
+				// have their own locks
+			mutex			fUsedBlocksLock;
 			AllocationGroup* fGroups;
 			int32			fNumGroups;
 			uint32			fBlocksPerGroup;
 			uint32			fNumBlocks;
 
+			FreeExtentBudget fExtentBudget;
+
 			uint32*			fCheckBitmap;
 			check_cookie*	fCheckCookie;
+			thread_id		fCheckThreads[kMaxCheckThreads];
+			int32			fCheckThreadCount;
+			bool			fInitialized;
 };
 
 #ifdef BFS_DEBUGGER_COMMANDS
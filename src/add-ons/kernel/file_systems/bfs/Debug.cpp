@@ -66,6 +66,7 @@ dump_super_block(const disk_super_block* superBlock)
 	kprintf("  num_ags        = %u\n", (unsigned)superBlock->AllocationGroups());
 	kprintf("  flags          = %#08x (%s)\n", (int)superBlock->Flags(),
 		get_tupel(superBlock->Flags()));
+	kprintf("  features       = %#08x\n", (int)superBlock->Features());
 	dump_block_run("  log_blocks     = ", superBlock->log_blocks);
 	kprintf("  log_start      = %" B_PRIdOFF "\n", superBlock->LogStart());
 	kprintf("  log_end        = %" B_PRIdOFF "\n", superBlock->LogEnd());
@@ -107,6 +108,26 @@ dump_data_stream(const data_stream* stream)
 }
 
 
+void
+dump_extent_stream(const extent_stream* stream)
+{
+	kprintf("extent_stream:\n");
+	kprintf("  magic     = %#04x %s\n", (int)stream->header.Magic(),
+		stream->header.Magic() == EXTENT_HEADER_MAGIC ? "valid" : "INVALID");
+	kprintf("  count     = %u\n", (unsigned)stream->header.Count());
+	kprintf("  max_count = %u\n", (unsigned)stream->header.MaxCount());
+	kprintf("  depth     = %u\n", (unsigned)stream->header.Depth());
+	for (int i = 0; i < stream->header.Count() && i < NUM_INODE_EXTENTS;
+			i++) {
+		kprintf("  extents[%d] = %" B_PRIdOFF " -> %" B_PRIdOFF
+			" (%" B_PRIdOFF ")\n", i, stream->extents[i].Offset(),
+			stream->extents[i].Start(), stream->extents[i].Length());
+	}
+	kprintf("  max_range = %" B_PRIdOFF "\n", stream->MaxRange());
+	kprintf("  size      = %" B_PRIdOFF "\n", stream->Size());
+}
+
+
 void
 dump_inode(const bfs_inode* inode)
 {
@@ -135,7 +156,10 @@ dump_inode(const bfs_inode* inode)
 	kprintf("  short_symlink      = %s\n",
 		S_ISLNK(inode->Mode()) && (inode->Flags() & INODE_LONG_SYMLINK) == 0
 			? inode->short_symlink : "-");
-	dump_data_stream(&(inode->data));
+	if ((inode->Flags() & INODE_EXTENTS) != 0)
+		dump_extent_stream(&(inode->extent_data));
+	else
+		dump_data_stream(&(inode->data));
 	kprintf("  --\n  pad[0]             = %08x\n", (int)inode->pad[0]);
 	kprintf("  pad[1]             = %08x\n", (int)inode->pad[1]);
 }
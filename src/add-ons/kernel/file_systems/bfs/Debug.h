@@ -93,6 +93,7 @@
 	extern void dump_block_run(const char *prefix, const block_run &run);
 	extern void dump_super_block(const disk_super_block *superBlock);
 	extern void dump_data_stream(const data_stream *stream);
+	extern void dump_extent_stream(const extent_stream *stream);
 	extern void dump_inode(const bfs_inode *inode);
 	extern void dump_bplustree_header(const bplustree_header *header);
 	extern void dump_bplustree_node(const bplustree_node *node,
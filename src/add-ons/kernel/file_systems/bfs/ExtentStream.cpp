@@ -0,0 +1,559 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+//! extent tree of extent based data streams
+
+
+#include "ExtentStream.h"
+
+#include "CachedBlock.h"
+#include "Debug.h"
+#include "Inode.h"
+
+
+static inline void
+set_extent(stream_extent& extent, off_t offset, off_t start, off_t length)
+{
+	extent.offset = HOST_ENDIAN_TO_BFS_INT64(offset);
+	extent.start = HOST_ENDIAN_TO_BFS_INT64(start);
+	extent.length = HOST_ENDIAN_TO_BFS_INT64(length);
+}
+
+
+static inline void
+set_count(extent_header& header, uint16 count)
+{
+	header.count = HOST_ENDIAN_TO_BFS_INT16(count);
+}
+
+
+//	#pragma mark -
+
+
+ExtentVisitor::~ExtentVisitor()
+{
+}
+
+
+//	#pragma mark -
+
+
+ExtentStream::ExtentStream(Inode* inode)
+	:
+	fVolume(inode->GetVolume()),
+	fInode(inode),
+	fStream(inode->Node().extent_data),
+	fNodeCount(extent_node::MaxCount(inode->GetVolume()->BlockSize()))
+{
+}
+
+
+/*static*/ void
+ExtentStream::Initialize(extent_stream& stream)
+{
+	off_t size = stream.Size();
+
+	memset(&stream, 0, sizeof(extent_stream));
+	stream.header.magic = HOST_ENDIAN_TO_BFS_INT16(EXTENT_HEADER_MAGIC);
+	stream.header.max_count = HOST_ENDIAN_TO_BFS_INT16(NUM_INODE_EXTENTS);
+	stream.size = HOST_ENDIAN_TO_BFS_INT64(size);
+}
+
+
+/*!	Finds the extent that contains the file block \a block, and returns its
+	file \a offset, as well as its \a start, and \a length, in blocks.
+*/
+status_t
+ExtentStream::FindExtent(off_t block, off_t& offset, off_t& start,
+	off_t& length)
+{
+	if (!fStream.header.IsValid(NUM_INODE_EXTENTS))
+		RETURN_ERROR(B_BAD_DATA);
+
+	const extent_header* header = &fStream.header;
+	const stream_extent* extents = fStream.extents;
+	CachedBlock cached(fVolume);
+
+	while (true) {
+		int32 index = find_extent(extents, header->Count(), block);
+		if (index < 0)
+			return B_ENTRY_NOT_FOUND;
+
+		if (header->Depth() == 0) {
+			if (block >= extents[index].End())
+				return B_ENTRY_NOT_FOUND;
+
+			offset = extents[index].Offset();
+			start = extents[index].Start();
+			length = extents[index].Length();
+
+			if (start <= 0 || length <= 0
+				|| start + length > fVolume->NumBlocks())
+				RETURN_ERROR(B_BAD_DATA);
+
+			return B_OK;
+		}
+
+		const extent_node* node = _GetNode(cached, extents[index].Start(),
+			header->Depth() - 1);
+		if (node == NULL)
+			RETURN_ERROR(B_BAD_DATA);
+
+		header = &node->header;
+		extents = node->extents;
+	}
+}
+
+
+/*!	Returns the block on disk that follows the last extent of the stream.
+	This is where the stream should preferably continue.
+*/
+status_t
+ExtentStream::GetEnd(off_t& block)
+{
+	if (!fStream.header.IsValid(NUM_INODE_EXTENTS))
+		RETURN_ERROR(B_BAD_DATA);
+
+	const extent_header* header = &fStream.header;
+	const stream_extent* extents = fStream.extents;
+	CachedBlock cached(fVolume);
+
+	while (header->Count() > 0) {
+		const stream_extent& last = extents[header->Count() - 1];
+		if (header->Depth() == 0) {
+			block = last.Start() + last.Length();
+			return B_OK;
+		}
+
+		const extent_node* node = _GetNode(cached, last.Start(),
+			header->Depth() - 1);
+		if (node == NULL)
+			RETURN_ERROR(B_BAD_DATA);
+
+		header = &node->header;
+		extents = node->extents;
+	}
+
+	return B_ENTRY_NOT_FOUND;
+}
+
+
+/*!	Appends \a length blocks starting at \a start to the stream; \a offset
+	must be the current end of the stream. If the blocks directly follow the
+	last extent, that one is just extended.
+	The inode must be written back by the caller.
+*/
+status_t
+ExtentStream::Append(Transaction& transaction, off_t offset, off_t start,
+	off_t length)
+{
+	if (!fStream.header.IsValid(NUM_INODE_EXTENTS))
+		RETURN_ERROR(B_BAD_DATA);
+
+	off_t newNode;
+	status_t status = _Append(transaction, NULL, &fStream.header,
+		fStream.extents, offset, start, length, newNode);
+	if (status != B_OK || newNode < 0)
+		return status;
+
+	// The root is full; move its entries into a new node, and let the root
+	// point to that one, and the new node
+
+	uint16 depth = fStream.header.Depth();
+	if (depth + 1 >= MAX_EXTENT_TREE_DEPTH)
+		RETURN_ERROR(EFBIG);
+
+	off_t block;
+	status = _CreateNode(transaction, depth, fStream.extents,
+		fStream.header.Count(), block);
+	if (status != B_OK) {
+		_FreeNode(transaction, newNode, depth, false);
+		return status;
+	}
+
+	off_t firstOffset = fStream.extents[0].Offset();
+	memset(fStream.extents, 0, sizeof(fStream.extents));
+	set_extent(fStream.extents[0], firstOffset, block, 0);
+	set_extent(fStream.extents[1], offset, newNode, 0);
+	set_count(fStream.header, 2);
+	fStream.header.depth = HOST_ENDIAN_TO_BFS_INT16(depth + 1);
+
+	return B_OK;
+}
+
+
+/*!	Frees all blocks of the stream behind the file block \a blocks, and
+	removes the extents, and tree nodes that are no longer needed.
+	The inode must be written back by the caller.
+*/
+status_t
+ExtentStream::Truncate(Transaction& transaction, off_t blocks)
+{
+	if (!fStream.header.IsValid(NUM_INODE_EXTENTS))
+		RETURN_ERROR(B_BAD_DATA);
+
+	status_t status = _Truncate(transaction, NULL, &fStream.header,
+		fStream.extents, blocks);
+	if (status != B_OK)
+		return status;
+
+	return _Collapse(transaction);
+}
+
+
+/*!	Passes all extents of the stream in file order, and all blocks used by
+	the tree to the \a visitor. Also makes sure that the stream does not have
+	any holes, and that the tree is sorted.
+*/
+status_t
+ExtentStream::Visit(ExtentVisitor& visitor)
+{
+	if (!fStream.header.IsValid(NUM_INODE_EXTENTS))
+		RETURN_ERROR(B_BAD_DATA);
+
+	off_t offset = 0;
+	status_t status = _Visit(visitor, &fStream.header, fStream.extents,
+		offset);
+	if (status != B_OK)
+		return status;
+
+	if (offset != fStream.MaxRange() >> fVolume->BlockShift())
+		RETURN_ERROR(B_BAD_DATA);
+
+	return B_OK;
+}
+
+
+const extent_node*
+ExtentStream::_GetNode(CachedBlock& cached, off_t block, uint16 depth)
+{
+	if (block <= 0 || block >= fVolume->NumBlocks())
+		return NULL;
+
+	const extent_node* node = (const extent_node*)cached.SetTo(block);
+	if (node == NULL || !node->header.IsValid(fNodeCount)
+		|| node->header.Depth() != depth) {
+		FATAL(("extent node %" B_PRIdOFF " of inode %" B_PRIdINO
+			" is corrupt!\n", block, fInode->ID()));
+		return NULL;
+	}
+
+	return node;
+}
+
+
+/*!	Appends the extent to the subtree below \a header. If there is no room
+	left in it, a new subtree is created for the extent, and the block of
+	its root is returned in \a _newNode, so that the caller can add it next
+	to this one; otherwise, \a _newNode is set to -1.
+	\a cached holds the node, or is \c NULL for the root in the inode.
+*/
+status_t
+ExtentStream::_Append(Transaction& transaction, CachedBlock* cached,
+	extent_header* header, stream_extent* extents, off_t offset, off_t start,
+	off_t length, off_t& _newNode)
+{
+	_newNode = -1;
+
+	uint16 count = header->Count();
+	uint16 depth = header->Depth();
+
+	if (depth == 0) {
+		if (count > 0) {
+			stream_extent& last = extents[count - 1];
+			if (last.End() != offset)
+				RETURN_ERROR(B_BAD_DATA);
+
+			if (last.Start() + last.Length() == start) {
+				if (cached != NULL && cached->MakeWritable(transaction) != B_OK)
+					RETURN_ERROR(B_IO_ERROR);
+
+				last.length = HOST_ENDIAN_TO_BFS_INT64(last.Length() + length);
+				return B_OK;
+			}
+		}
+
+		stream_extent extent;
+		set_extent(extent, offset, start, length);
+
+		if (count == header->MaxCount())
+			return _CreateNode(transaction, 0, &extent, 1, _newNode);
+
+		if (cached != NULL && cached->MakeWritable(transaction) != B_OK)
+			RETURN_ERROR(B_IO_ERROR);
+
+		extents[count] = extent;
+		set_count(*header, count + 1);
+		return B_OK;
+	}
+
+	if (count == 0)
+		RETURN_ERROR(B_BAD_DATA);
+
+	CachedBlock cachedChild(fVolume);
+	extent_node* child = const_cast<extent_node*>(_GetNode(cachedChild,
+		extents[count - 1].Start(), depth - 1));
+	if (child == NULL)
+		RETURN_ERROR(B_BAD_DATA);
+
+	off_t newChild;
+	status_t status = _Append(transaction, &cachedChild, &child->header,
+		child->extents, offset, start, length, newChild);
+	if (status != B_OK || newChild < 0)
+		return status;
+
+	// add the new child to this node, or start another subtree
+
+	stream_extent extent;
+	set_extent(extent, offset, newChild, 0);
+
+	if (count == header->MaxCount()) {
+		status = _CreateNode(transaction, depth, &extent, 1, _newNode);
+		if (status != B_OK)
+			_FreeNode(transaction, newChild, depth - 1, false);
+		return status;
+	}
+
+	if (cached != NULL && cached->MakeWritable(transaction) != B_OK)
+		RETURN_ERROR(B_IO_ERROR);
+
+	extents[count] = extent;
+	set_count(*header, count + 1);
+	return B_OK;
+}
+
+
+/*!	Allocates a new node close to the inode, and fills it with the \a count
+	\a extents.
+*/
+status_t
+ExtentStream::_CreateNode(Transaction& transaction, uint16 depth,
+	const stream_extent* extents, uint16 count, off_t& _block)
+{
+	block_run run;
+	status_t status = fVolume->AllocateForInode(transaction,
+		&fInode->BlockRun(), fInode->Mode(), run);
+	if (status != B_OK)
+		return status;
+
+	CachedBlock cached(fVolume);
+	extent_node* node = (extent_node*)cached.SetToWritable(transaction,
+		run, true);
+	if (node == NULL) {
+		fVolume->Free(transaction, run);
+		RETURN_ERROR(B_IO_ERROR);
+	}
+
+	memset(node, 0, fVolume->BlockSize());
+	node->header.magic = HOST_ENDIAN_TO_BFS_INT16(EXTENT_HEADER_MAGIC);
+	node->header.max_count = HOST_ENDIAN_TO_BFS_INT16(fNodeCount);
+	node->header.depth = HOST_ENDIAN_TO_BFS_INT16(depth);
+	set_count(node->header, count);
+	memcpy(node->extents, extents, count * sizeof(stream_extent));
+
+	_block = fVolume->ToBlock(run);
+	return B_OK;
+}
+
+
+status_t
+ExtentStream::_Truncate(Transaction& transaction, CachedBlock* cached,
+	extent_header* header, stream_extent* extents, off_t blocks)
+{
+	uint16 depth = header->Depth();
+	uint16 count = header->Count();
+	status_t status = B_OK;
+
+	while (count > 0) {
+		stream_extent& last = extents[count - 1];
+
+		if (depth > 0 && last.Offset() < blocks) {
+			// only parts of this subtree need to go
+			CachedBlock cachedChild(fVolume);
+			extent_node* child = const_cast<extent_node*>(_GetNode(
+				cachedChild, last.Start(), depth - 1));
+			if (child == NULL) {
+				status = B_BAD_DATA;
+				break;
+			}
+
+			status = _Truncate(transaction, &cachedChild, &child->header,
+				child->extents, blocks);
+			break;
+		}
+		if (depth == 0 && last.End() <= blocks)
+			break;
+
+		if (cached != NULL && cached->MakeWritable(transaction) != B_OK) {
+			status = B_IO_ERROR;
+			break;
+		}
+
+		if (depth > 0)
+			status = _FreeNode(transaction, last.Start(), depth - 1);
+		else if (last.Offset() < blocks) {
+			// free the end of the extent
+			off_t keep = blocks - last.Offset();
+			status = _FreeBlocks(transaction, last.Start() + keep,
+				last.Length() - keep);
+			if (status == B_OK)
+				last.length = HOST_ENDIAN_TO_BFS_INT64(keep);
+			break;
+		} else
+			status = _FreeBlocks(transaction, last.Start(), last.Length());
+
+		if (status != B_OK)
+			break;
+
+		memset(&last, 0, sizeof(stream_extent));
+		count--;
+	}
+
+	if (count != header->Count())
+		set_count(*header, count);
+
+	return status;
+}
+
+
+/*!	Frees the node at \a block, and all nodes below it. The blocks of the
+	extents are only freed if \a freeExtents is \c true.
+*/
+status_t
+ExtentStream::_FreeNode(Transaction& transaction, off_t block, uint16 depth,
+	bool freeExtents)
+{
+	CachedBlock cached(fVolume);
+	const extent_node* node = _GetNode(cached, block, depth);
+	if (node == NULL)
+		RETURN_ERROR(B_BAD_DATA);
+
+	for (uint16 i = 0; i < node->header.Count(); i++) {
+		const stream_extent& extent = node->extents[i];
+
+		status_t status = B_OK;
+		if (depth > 0) {
+			status = _FreeNode(transaction, extent.Start(), depth - 1,
+				freeExtents);
+		} else if (freeExtents)
+			status = _FreeBlocks(transaction, extent.Start(), extent.Length());
+		if (status != B_OK)
+			return status;
+	}
+
+	cached.Unset();
+	return fVolume->Free(transaction, fVolume->ToBlockRun(block));
+}
+
+
+/*!	Frees the blocks of an extent, which has to be split into block_runs for
+	the block allocator.
+*/
+status_t
+ExtentStream::_FreeBlocks(Transaction& transaction, off_t start,
+	off_t length)
+{
+	while (length > 0) {
+		off_t groupEnd = ((start >> fVolume->AllocationGroupShift()) + 1)
+			<< fVolume->AllocationGroupShift();
+		off_t runLength = min_c(min_c(length, groupEnd - start),
+			MAX_BLOCK_RUN_LENGTH);
+
+		block_run run = fVolume->ToBlockRun(start);
+		run.length = HOST_ENDIAN_TO_BFS_INT16(runLength);
+
+		status_t status = fVolume->Free(transaction, run);
+		if (status != B_OK)
+			return status;
+
+		start += runLength;
+		length -= runLength;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Moves the extents back into the inode when the tree has become small
+	enough again.
+*/
+status_t
+ExtentStream::_Collapse(Transaction& transaction)
+{
+	while (fStream.header.Depth() > 0) {
+		if (fStream.header.Count() == 0) {
+			fStream.header.depth = 0;
+			break;
+		}
+		if (fStream.header.Count() > 1)
+			break;
+
+		off_t block = fStream.extents[0].Start();
+
+		CachedBlock cached(fVolume);
+		const extent_node* node = _GetNode(cached, block,
+			fStream.header.Depth() - 1);
+		if (node == NULL)
+			RETURN_ERROR(B_BAD_DATA);
+
+		uint16 count = node->header.Count();
+		if (count > NUM_INODE_EXTENTS)
+			break;
+
+		memset(fStream.extents, 0, sizeof(fStream.extents));
+		memcpy(fStream.extents, node->extents, count * sizeof(stream_extent));
+		set_count(fStream.header, count);
+		fStream.header.depth = node->header.depth;
+
+		cached.Unset();
+
+		status_t status = fVolume->Free(transaction,
+			fVolume->ToBlockRun(block));
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
+status_t
+ExtentStream::_Visit(ExtentVisitor& visitor, const extent_header* header,
+	const stream_extent* extents, off_t& offset)
+{
+	uint16 depth = header->Depth();
+
+	for (uint16 i = 0; i < header->Count(); i++) {
+		const stream_extent& extent = extents[i];
+		if (extent.Offset() != offset)
+			RETURN_ERROR(B_BAD_DATA);
+
+		status_t status;
+		if (depth == 0) {
+			if (extent.Start() <= 0 || extent.Length() <= 0
+				|| extent.Start() + extent.Length() > fVolume->NumBlocks())
+				RETURN_ERROR(B_BAD_DATA);
+
+			status = visitor.VisitExtent(extent.Offset(), extent.Start(),
+				extent.Length());
+			offset += extent.Length();
+		} else {
+			CachedBlock cached(fVolume);
+			const extent_node* node = _GetNode(cached, extent.Start(),
+				depth - 1);
+			if (node == NULL || node->header.Count() == 0)
+				RETURN_ERROR(B_BAD_DATA);
+
+			status = visitor.VisitNode(extent.Start());
+			if (status == B_OK)
+				status = _Visit(visitor, &node->header, node->extents, offset);
+		}
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
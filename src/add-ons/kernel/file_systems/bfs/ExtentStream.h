@@ -0,0 +1,83 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef EXTENT_STREAM_H
+#define EXTENT_STREAM_H
+
+
+#include "system_dependencies.h"
+
+#include "bfs.h"
+
+
+class CachedBlock;
+class Inode;
+class Transaction;
+class Volume;
+
+
+class ExtentVisitor {
+public:
+	virtual						~ExtentVisitor();
+
+	virtual	status_t			VisitNode(off_t block) = 0;
+	virtual	status_t			VisitExtent(off_t offset, off_t start,
+									off_t length) = 0;
+};
+
+
+/*!	Accesses the extent tree of an inode that has the INODE_EXTENTS flag set.
+	Since data streams only grow and shrink at their end, extents are only
+	ever appended to, or removed from the right-most path of the tree.
+*/
+class ExtentStream {
+public:
+								ExtentStream(Inode* inode);
+
+	static	void				Initialize(extent_stream& stream);
+
+			status_t			FindExtent(off_t block, off_t& offset,
+									off_t& start, off_t& length);
+			status_t			GetEnd(off_t& block);
+
+			status_t			Append(Transaction& transaction, off_t offset,
+									off_t start, off_t length);
+			status_t			Truncate(Transaction& transaction,
+									off_t blocks);
+
+			status_t			Visit(ExtentVisitor& visitor);
+
+private:
+			const extent_node*	_GetNode(CachedBlock& cached, off_t block,
+									uint16 depth);
+			status_t			_Append(Transaction& transaction,
+									CachedBlock* cached, extent_header* header,
+									stream_extent* extents, off_t offset,
+									off_t start, off_t length, off_t& _newNode);
+			status_t			_CreateNode(Transaction& transaction,
+									uint16 depth, const stream_extent* extents,
+									uint16 count, off_t& _block);
+			status_t			_Truncate(Transaction& transaction,
+									CachedBlock* cached, extent_header* header,
+									stream_extent* extents, off_t blocks);
+			status_t			_FreeNode(Transaction& transaction,
+									off_t block, uint16 depth,
+									bool freeExtents = true);
+			status_t			_FreeBlocks(Transaction& transaction,
+									off_t start, off_t length);
+			status_t			_Collapse(Transaction& transaction);
+			status_t			_Visit(ExtentVisitor& visitor,
+									const extent_header* header,
+									const stream_extent* extents,
+									off_t& offset);
+
+			Volume*				fVolume;
+			Inode*				fInode;
+			extent_stream&		fStream;
+			uint16				fNodeCount;
+				// the maximum number of extents in a node block
+};
+
+
+#endif	// EXTENT_STREAM_H
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+//! In-memory index of the free ranges of an allocation group
+
+
+#include "FreeExtentIndex.h"
+
+#include <new>
+
+
+static const int32 kMaxExtents = 8192;
+	// Limits the memory used per allocation group (about 450 KB with the
+	// 56 bytes an extent needs on 64 bit); groups that are more fragmented
+	// than that fall back to the block bitmap.
+
+
+FreeExtentBudget::FreeExtentBudget(int32 maxExtents)
+	:
+	fCount(0),
+	fMaxExtents(maxExtents)
+{
+}
+
+
+//	#pragma mark -
+
+
+FreeExtentIndex::FreeExtentIndex()
+	:
+	fBudget(NULL),
+	fCount(0),
+	fValid(true)
+{
+}
+
+
+FreeExtentIndex::~FreeExtentIndex()
+{
+	MakeEmpty();
+}
+
+
+/*!	Removes all extents from the index, and makes it valid again. */
+void
+FreeExtentIndex::MakeEmpty()
+{
+	while (FreeExtent* extent = fByOffset.FindMin()) {
+		_Remove(extent);
+		_Free(extent);
+	}
+
+	fValid = true;
+}
+
+
+void
+FreeExtentIndex::Invalidate()
+{
+	MakeEmpty();
+	fValid = false;
+}
+
+
+/*!	Adds the range to the index, and merges it with its neighbours if
+	possible. The range must not overlap with any range in the index.
+*/
+void
+FreeExtentIndex::Add(int32 start, int32 length)
+{
+	if (!fValid || length <= 0)
+		return;
+
+	FreeExtent* previous = fByOffset.FindClosest(start, false, false);
+	FreeExtent* next = fByOffset.FindClosest(start, true, false);
+
+	if ((previous != NULL && previous->End() > start)
+		|| (next != NULL && start + length > next->start)) {
+		// the index doesn't match the block bitmap anymore
+		Invalidate();
+		return;
+	}
+
+	bool joinPrevious = previous != NULL && previous->End() == start;
+	bool joinNext = next != NULL && next->start == start + length;
+
+	if (joinPrevious && joinNext) {
+		int32 end = next->End();
+		_Remove(next);
+		_Free(next);
+		_Resize(previous, previous->start, end - previous->start);
+	} else if (joinPrevious) {
+		_Resize(previous, previous->start, previous->length + length);
+	} else if (joinNext) {
+		_Resize(next, start, next->length + length);
+	} else {
+		FreeExtent* extent = _Allocate(start, length);
+		if (extent == NULL) {
+			Invalidate();
+			return;
+		}
+
+		_Insert(extent);
+	}
+}
+
+
+/*!	Removes the range from the index. It must be part of a single extent. */
+void
+FreeExtentIndex::Remove(int32 start, int32 length)
+{
+	if (!fValid || length <= 0)
+		return;
+
+	FreeExtent* extent = fByOffset.FindClosest(start, false, true);
+	if (extent == NULL || start + length > extent->End()) {
+		// the index doesn't match the block bitmap anymore
+		Invalidate();
+		return;
+	}
+
+	int32 end = extent->End();
+
+	if (extent->start == start && end == start + length) {
+		_Remove(extent);
+		_Free(extent);
+	} else if (extent->start == start) {
+		_Resize(extent, start + length, end - start - length);
+	} else if (end == start + length) {
+		_Resize(extent, extent->start, start - extent->start);
+	} else {
+		// the range is in the middle of the extent, we need to split it
+		FreeExtent* tail = _Allocate(start + length, end - start - length);
+		if (tail == NULL) {
+			Invalidate();
+			return;
+		}
+
+		_Resize(extent, extent->start, start - extent->start);
+		_Insert(tail);
+	}
+}
+
+
+/*!	Looks for a free range of \a wanted blocks. If the extent that contains
+	\a start is large enough, the range will start there, so that files can
+	grow contiguously. Otherwise, the smallest extent that is large enough is
+	chosen.
+	If there is no extent that is large enough, the largest one is returned.
+	Returns \c false if the index is empty.
+*/
+bool
+FreeExtentIndex::FindRun(int32 start, int32 wanted, int32& _start,
+	int32& _length)
+{
+	FreeExtent* extent = fByOffset.FindClosest(start, false, true);
+	if (extent != NULL && extent->End() - start >= wanted) {
+		_start = start;
+		_length = extent->End() - start;
+		return true;
+	}
+
+	// best fit
+	extent = fBySize.FindClosest(FreeExtentSizeKey(wanted, -1), true, true);
+	if (extent == NULL)
+		extent = fBySize.FindMax();
+	if (extent == NULL)
+		return false;
+
+	_start = extent->start;
+	_length = extent->length;
+	return true;
+}
+
+
+int32
+FreeExtentIndex::LargestExtent()
+{
+	FreeExtent* extent = fBySize.FindMax();
+	return extent != NULL ? extent->length : 0;
+}
+
+
+FreeExtent*
+FreeExtentIndex::_Allocate(int32 start, int32 length)
+{
+	if (fCount >= kMaxExtents)
+		return NULL;
+	if (fBudget != NULL && !fBudget->Acquire())
+		return NULL;
+
+	FreeExtent* extent = new(std::nothrow) FreeExtent;
+	if (extent == NULL) {
+		if (fBudget != NULL)
+			fBudget->Release();
+		return NULL;
+	}
+
+	extent->start = start;
+	extent->length = length;
+	return extent;
+}
+
+
+void
+FreeExtentIndex::_Free(FreeExtent* extent)
+{
+	delete extent;
+	if (fBudget != NULL)
+		fBudget->Release();
+}
+
+
+void
+FreeExtentIndex::_Insert(FreeExtent* extent)
+{
+	fByOffset.Insert(extent);
+	fBySize.Insert(extent);
+	fCount++;
+}
+
+
+void
+FreeExtentIndex::_Remove(FreeExtent* extent)
+{
+	fByOffset.Remove(extent);
+	fBySize.Remove(extent);
+	fCount--;
+}
+
+
+void
+FreeExtentIndex::_Resize(FreeExtent* extent, int32 start, int32 length)
+{
+	// both keys may change, so the extent has to be reinserted
+	_Remove(extent);
+	extent->start = start;
+	extent->length = length;
+	_Insert(extent);
+}
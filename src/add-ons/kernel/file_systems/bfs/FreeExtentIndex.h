@@ -0,0 +1,172 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef FREE_EXTENT_INDEX_H
+#define FREE_EXTENT_INDEX_H
+
+
+#ifdef FS_SHELL
+#	include "fssh_api_wrapper.h"
+#	include <kernel/util/SplayTree.h>
+#else
+#	include <SupportDefs.h>
+#	include <util/SplayTree.h>
+#endif
+
+
+struct FreeExtent {
+	int32						start;
+	int32						length;
+	SplayTreeLink<FreeExtent>	offsetLink;
+	SplayTreeLink<FreeExtent>	sizeLink;
+
+	int32 End() const { return start + length; }
+};
+
+
+struct FreeExtentSizeKey {
+	int32	length;
+	int32	start;
+
+	FreeExtentSizeKey(int32 length, int32 start)
+		:
+		length(length),
+		start(start)
+	{
+	}
+};
+
+
+struct FreeExtentOffsetDefinition {
+	typedef int32		KeyType;
+	typedef FreeExtent	NodeType;
+
+	static KeyType GetKey(const FreeExtent* node)
+	{
+		return node->start;
+	}
+
+	static SplayTreeLink<FreeExtent>* GetLink(FreeExtent* node)
+	{
+		return &node->offsetLink;
+	}
+
+	static int Compare(KeyType key, const FreeExtent* node)
+	{
+		if (key == node->start)
+			return 0;
+		return key < node->start ? -1 : 1;
+	}
+};
+
+
+struct FreeExtentSizeDefinition {
+	typedef FreeExtentSizeKey	KeyType;
+	typedef FreeExtent			NodeType;
+
+	static KeyType GetKey(const FreeExtent* node)
+	{
+		return FreeExtentSizeKey(node->length, node->start);
+	}
+
+	static SplayTreeLink<FreeExtent>* GetLink(FreeExtent* node)
+	{
+		return &node->sizeLink;
+	}
+
+	static int Compare(const KeyType& key, const FreeExtent* node)
+	{
+		if (key.length != node->length)
+			return key.length < node->length ? -1 : 1;
+		if (key.start != node->start)
+			return key.start < node->start ? -1 : 1;
+		return 0;
+	}
+};
+
+
+/*!	Limits the number of extents the indices of all allocation groups of a
+	volume may keep together.
+*/
+class FreeExtentBudget {
+public:
+								FreeExtentBudget(int32 maxExtents);
+
+	inline	bool				Acquire();
+	inline	void				Release();
+
+			int32				CountExtents() const { return fCount; }
+
+private:
+			int32				fCount;
+			int32				fMaxExtents;
+};
+
+
+/*!	Keeps the free ranges of an allocation group in memory, sorted both by
+	their offset and by their size.
+	If the index cannot be maintained (because it would grow too large, the
+	budget it shares with the other groups is used up, or there is no memory
+	left), it becomes invalid, and the block bitmap has to be used instead.
+*/
+class FreeExtentIndex {
+public:
+								FreeExtentIndex();
+								~FreeExtentIndex();
+
+			void				SetBudget(FreeExtentBudget* budget)
+									{ fBudget = budget; }
+
+			void				MakeEmpty();
+			void				Invalidate();
+			bool				IsValid() const { return fValid; }
+
+			void				Add(int32 start, int32 length);
+			void				Remove(int32 start, int32 length);
+
+			bool				FindRun(int32 start, int32 wanted,
+									int32& _start, int32& _length);
+
+			int32				CountExtents() const { return fCount; }
+			int32				LargestExtent();
+
+private:
+			FreeExtent*			_Allocate(int32 start, int32 length);
+			void				_Free(FreeExtent* extent);
+			void				_Insert(FreeExtent* extent);
+			void				_Remove(FreeExtent* extent);
+			void				_Resize(FreeExtent* extent, int32 start,
+									int32 length);
+
+private:
+	typedef SplayTree<FreeExtentOffsetDefinition> OffsetTree;
+	typedef SplayTree<FreeExtentSizeDefinition> SizeTree;
+
+			OffsetTree			fByOffset;
+			SizeTree			fBySize;
+			FreeExtentBudget*	fBudget;
+			int32				fCount;
+			bool				fValid;
+};
+
+
+inline bool
+FreeExtentBudget::Acquire()
+{
+	if (atomic_add(&fCount, 1) < fMaxExtents)
+		return true;
+
+	atomic_add(&fCount, -1);
+	return false;
+}
+
+
+inline void
+FreeExtentBudget::Release()
+{
+	atomic_add(&fCount, -1);
+}
+
+
+#endif	// FREE_EXTENT_INDEX_H
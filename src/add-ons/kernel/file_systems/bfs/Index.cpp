@@ -15,6 +15,7 @@
 #include "Volume.h"
 #include "Inode.h"
 #include "BPlusTree.h"
+#include "NameTrigrams.h"
 
 
 Index::Index(Volume* volume)
@@ -302,8 +303,138 @@ Index::UpdateName(Transaction& transaction, const char* oldName,
 
 	uint16 oldLength = oldName != NULL ? strlen(oldName) : 0;
 	uint16 newLength = newName != NULL ? strlen(newName) : 0;
-	return Update(transaction, "name", B_STRING_TYPE, (uint8*)oldName,
-		oldLength, (uint8*)newName, newLength, inode);
+	status_t status = Update(transaction, "name", B_STRING_TYPE,
+		(uint8*)oldName, oldLength, (uint8*)newName, newLength, inode);
+	if (status != B_OK)
+		return status;
+
+	return _UpdateNameTrigrams(transaction, oldName, newName, inode);
+}
+
+
+/*!	Adds the trigrams of all names in the name index to this index, which
+	must be a newly created name trigram index.
+	Names that are changed while this is running may end up in the index
+	twice; queries ignore the surplus entries.
+*/
+status_t
+Index::FillNameTrigrams()
+{
+	BPlusTree* tree = fNode != NULL ? fNode->Tree() : NULL;
+	if (tree == NULL)
+		return B_BAD_VALUE;
+
+	Index names(fVolume);
+	if (names.SetTo("name") != B_OK)
+		return B_OK;
+
+	BPlusTree* namesTree = names.Node()->Tree();
+	if (namesTree == NULL)
+		return B_BAD_VALUE;
+
+	NameTrigrams* trigrams = new(std::nothrow) NameTrigrams;
+	if (trigrams == NULL)
+		return B_NO_MEMORY;
+	ObjectDeleter<NameTrigrams> trigramsDeleter(trigrams);
+
+	TreeIterator iterator(namesTree);
+	char name[B_FILE_NAME_LENGTH];
+	uint16 length;
+	off_t id;
+	status_t status;
+
+	while ((status = iterator.GetNextEntry(name, &length, sizeof(name), &id))
+			== B_OK) {
+		trigrams->SetToName(name);
+
+		Transaction transaction(fVolume, fNode->BlockNumber());
+		fNode->WriteLockInTransaction(transaction);
+
+		for (int32 i = 0; i < trigrams->CountTrigrams(); i++) {
+			uint8 key[kTrigramLength];
+			NameTrigrams::GetKey(trigrams->TrigramAt(i), key);
+
+			status = tree->Insert(transaction, key, kTrigramLength, id);
+			if (status != B_OK)
+				return status;
+		}
+
+		status = transaction.Done();
+		if (status != B_OK)
+			return status;
+	}
+
+	return status == B_ENTRY_NOT_FOUND ? B_OK : status;
+}
+
+
+/*!	Updates the name trigram index, if there is one. Only the trigrams that
+	differ between the old and the new name are changed.
+*/
+status_t
+Index::_UpdateNameTrigrams(Transaction& transaction, const char* oldName,
+	const char* newName, Inode* inode)
+{
+	Index index(fVolume);
+	if (index.SetTo(kNameTrigramIndex) != B_OK
+		|| index.Type() != B_STRING_TYPE)
+		return B_OK;
+
+	BPlusTree* tree = index.Node()->Tree();
+	if (tree == NULL)
+		return B_BAD_VALUE;
+
+	// too large for the stack
+	NameTrigrams* trigrams = new(std::nothrow) NameTrigrams[2];
+	if (trigrams == NULL)
+		return B_NO_MEMORY;
+	ArrayDeleter<NameTrigrams> trigramsDeleter(trigrams);
+
+	NameTrigrams& oldTrigrams = trigrams[0];
+	NameTrigrams& newTrigrams = trigrams[1];
+	oldTrigrams.SetToName(oldName);
+	newTrigrams.SetToName(newName);
+
+	index.Node()->WriteLockInTransaction(transaction);
+
+	int32 oldIndex = 0;
+	int32 newIndex = 0;
+	while (oldIndex < oldTrigrams.CountTrigrams()
+		|| newIndex < newTrigrams.CountTrigrams()) {
+		uint32 oldTrigram = oldIndex < oldTrigrams.CountTrigrams()
+			? oldTrigrams.TrigramAt(oldIndex) : ~(uint32)0;
+		uint32 newTrigram = newIndex < newTrigrams.CountTrigrams()
+			? newTrigrams.TrigramAt(newIndex) : ~(uint32)0;
+
+		uint8 key[kTrigramLength];
+		status_t status;
+
+		if (oldTrigram == newTrigram) {
+			oldIndex++;
+			newIndex++;
+			continue;
+		} else if (oldTrigram < newTrigram) {
+			NameTrigrams::GetKey(oldTrigram, key);
+			status = tree->Remove(transaction, key, kTrigramLength,
+				inode->ID());
+			if (status == B_ENTRY_NOT_FOUND) {
+				INFORM(("Could not find value in index \"%s\"!\n",
+					kNameTrigramIndex));
+				status = B_OK;
+			}
+			oldIndex++;
+		} else {
+			NameTrigrams::GetKey(newTrigram, key);
+			status = tree->Insert(transaction, key, kTrigramLength,
+				inode->ID());
+			newIndex++;
+		}
+
+		if (status != B_OK)
+			RETURN_ERROR(status);
+	}
+
+	return B_OK;
 }
 
 
@@ -41,6 +41,7 @@ public:
 			status_t		UpdateName(Transaction& transaction,
 								const char* oldName, const char* newName,
 								Inode* inode);
+			status_t		FillNameTrigrams();
 
 			status_t		InsertSize(Transaction& transaction, Inode* inode);
 			status_t		RemoveSize(Transaction& transaction, Inode* inode);
@@ -58,6 +59,10 @@ private:
 							Index& operator=(const Index& other);
 								// no implementation
 
+			status_t		_UpdateNameTrigrams(Transaction& transaction,
+								const char* oldName, const char* newName,
+								Inode* inode);
+
 private:
 			Volume*			fVolume;
 			Inode*			fNode;
@@ -10,6 +10,7 @@
 #include "Debug.h"
 #include "Inode.h"
 #include "BPlusTree.h"
+#include "ExtentStream.h"
 #include "Index.h"
 
 
@@ -303,6 +304,33 @@ InodeAllocator::_TransactionListener(int32 id, int32 event, void* _inode)
 //	#pragma mark -
 
 
+//!	Flushes all blocks of an extent stream.
+class SyncExtentVisitor : public ExtentVisitor {
+public:
+	SyncExtentVisitor(Volume* volume)
+		:
+		fVolume(volume)
+	{
+	}
+
+	virtual status_t VisitNode(off_t block)
+	{
+		return B_OK;
+	}
+
+	virtual status_t VisitExtent(off_t offset, off_t start, off_t length)
+	{
+		return block_cache_sync_etc(fVolume->BlockCache(), start, length);
+	}
+
+private:
+	Volume*	fVolume;
+};
+
+
+//	#pragma mark -
+
+
 status_t
 bfs_inode::InitCheck(Volume* volume) const
 {
@@ -325,6 +353,12 @@ bfs_inode::InitCheck(Volume* volume) const
 	if (Flags() & INODE_DELETED)
 		return B_NOT_ALLOWED;
 
+	// extent streams are only allowed on volumes that support them
+	if ((Flags() & INODE_EXTENTS) != 0
+		&& (!volume->HasExtents()
+			|| !extent_data.header.IsValid(NUM_INODE_EXTENTS)))
+		RETURN_ERROR(B_BAD_DATA);
+
 	// TODO: Add some tests to check the integrity of the other stuff here,
 	// especially for the data_stream!
 
@@ -546,7 +580,9 @@ Inode::_MakeSpaceForSmallData(Transaction& transaction, bfs_inode* node,
 		int32 index = 0, maxIndex = 0;
 		for (; !item->IsLast(node); item = item->Next(), index++) {
 			// should not remove those
-			if (*item->Name() == FILE_NAME_NAME || !strcmp(name, item->Name()))
+			if (*item->Name() == FILE_NAME_NAME
+				|| *item->Name() == INLINE_DATA_NAME
+				|| !strcmp(name, item->Name()))
 				continue;
 
 			if (max == NULL || max->Size() < item->Size()) {
@@ -942,6 +978,19 @@ Inode::SetName(Transaction& transaction, const char* name)
 	NodeGetter node(fVolume, transaction, this);
 	const char nameTag[2] = {FILE_NAME_NAME, 0};
 
+	if (HasInlineData()) {
+		// Rather move the inline data out of the inode than any attributes
+		status_t status = _AddSmallData(transaction, node, nameTag,
+			FILE_NAME_TYPE, 0, (uint8*)name, strlen(name));
+		if (status != B_DEVICE_FULL)
+			return status;
+
+		WriteLockInTransaction(transaction);
+		status = _PromoteInlineData(transaction);
+		if (status != B_OK)
+			return status;
+	}
+
 	return _AddSmallData(transaction, node, nameTag, FILE_NAME_TYPE, 0,
 		(uint8*)name, strlen(name), true);
 }
@@ -1099,6 +1148,15 @@ Inode::WriteAttribute(Transaction& transaction, const char* name, int32 type,
 		// create a real attribute file
 		status = _AddSmallData(transaction, node, name, type, pos, buffer,
 			*_length);
+		if (status == B_DEVICE_FULL && HasInlineData()) {
+			// attributes take precedence over inline file data
+			WriteLockInTransaction(transaction);
+			status = _PromoteInlineData(transaction);
+			if (status == B_OK) {
+				status = _AddSmallData(transaction, node, name, type, pos,
+					buffer, *_length);
+			}
+		}
 		if (status == B_DEVICE_FULL) {
 			if (smallData != NULL) {
 				// remove the old attribute from the small data section - there
@@ -1211,6 +1269,9 @@ Inode::WriteAttribute(Transaction& transaction, const char* name, int32 type,
 status_t
 Inode::RemoveAttribute(Transaction& transaction, const char* name)
 {
+	if (name[0] == INLINE_DATA_NAME && name[1] == '\0')
+		return B_NOT_ALLOWED;
+
 	Index index(fVolume);
 	bool hasIndex = index.SetTo(name) == B_OK;
 	NodeGetter node(fVolume, this);
@@ -1372,8 +1433,9 @@ Inode::ContainerContentsChanged(Transaction& transaction)
 off_t
 Inode::AllocatedSize() const
 {
-	if (IsSymLink() && (Flags() & INODE_LONG_SYMLINK) == 0) {
-		// This symlink does not have a data stream
+	if ((IsSymLink() && (Flags() & INODE_LONG_SYMLINK) == 0)
+		|| HasInlineData()) {
+		// This inode does not have a data stream
 		return Node().InodeSize();
 	}
 
@@ -1381,7 +1443,10 @@ Inode::AllocatedSize() const
 	uint32 blockSize = fVolume->BlockSize();
 	off_t size = blockSize;
 
-	if (data.MaxDoubleIndirectRange() != 0) {
+	if (HasExtents()) {
+		// the blocks of the extent tree are not accounted for
+		size += Node().extent_data.MaxRange();
+	} else if (data.MaxDoubleIndirectRange() != 0) {
 		off_t doubleIndirectSize = data.MaxDoubleIndirectRange()
 			- data.MaxIndirectRange();
 		int32 indirectSize = double_indirect_max_indirect_size(
@@ -1415,6 +1480,30 @@ Inode::AllocatedSize() const
 status_t
 Inode::FindBlockRun(off_t pos, block_run& run, off_t& offset)
 {
+	if (HasExtents()) {
+		off_t block;
+		off_t length;
+		status_t status = FindExtent(pos, block, length, offset);
+		if (status != B_OK)
+			return status;
+
+		// A block_run can neither leave its allocation group, nor be longer
+		// than MAX_BLOCK_RUN_LENGTH, so we only return the part of the
+		// extent that starts at "pos"
+		off_t index = (pos - offset) >> fVolume->BlockShift();
+		block += index;
+		length -= index;
+
+		off_t groupEnd = ((block >> fVolume->AllocationGroupShift()) + 1)
+			<< fVolume->AllocationGroupShift();
+		run = fVolume->ToBlockRun(block);
+		run.length = HOST_ENDIAN_TO_BFS_INT16(min_c(min_c(length,
+			groupEnd - block), MAX_BLOCK_RUN_LENGTH));
+		offset += index << fVolume->BlockShift();
+
+		return fVolume->ValidateBlockRun(run);
+	}
+
 	data_stream* data = &Node().data;
 
 	// find matching block run
@@ -1511,6 +1600,38 @@ Inode::FindBlockRun(off_t pos, block_run& run, off_t& offset)
 }
 
 
+/*!	Finds the contiguous range of blocks where "pos" is located in the
+	stream of the inode. "block" is set to its first block on disk, "length"
+	to its number of blocks, and "offset" to its file offset.
+	For streams that don't use extents, this is just the block_run that
+	contains "pos".
+	The caller has to make sure that "pos" is inside the stream.
+*/
+status_t
+Inode::FindExtent(off_t pos, off_t& block, off_t& length, off_t& offset)
+{
+	if (!HasExtents()) {
+		block_run run;
+		status_t status = FindBlockRun(pos, run, offset);
+		if (status != B_OK)
+			return status;
+
+		block = fVolume->ToBlock(run);
+		length = run.Length();
+		return B_OK;
+	}
+
+	off_t blockOffset;
+	status_t status = ExtentStream(this).FindExtent(
+		pos >> fVolume->BlockShift(), blockOffset, block, length);
+	if (status != B_OK)
+		return status;
+
+	offset = blockOffset << fVolume->BlockShift();
+	return B_OK;
+}
+
+
 status_t
 Inode::ReadAt(off_t pos, uint8* buffer, size_t* _length)
 {
@@ -1527,6 +1648,9 @@ Inode::ReadAt(off_t pos, uint8* buffer, size_t* _length)
 		return B_NO_ERROR;
 	}
 
+	if (HasInlineData())
+		return _ReadInlineData(pos, buffer, _length);
+
 	locker.Unlock();
 
 	return file_cache_read(FileCache(), NULL, pos, buffer, _length);
@@ -1556,6 +1680,38 @@ Inode::WriteAt(Transaction& transaction, off_t pos, const uint8* buffer,
 
 	locker.Unlock();
 
+	if (HasInlineData()) {
+		// inline data is part of the inode, and therefore always logged
+		if (!transaction.IsStarted())
+			transaction.Start(fVolume, BlockNumber());
+		WriteLockInTransaction(transaction);
+
+		if (HasInlineData()) {
+			off_t size = max_c(Size(), pos + (off_t)length);
+			status_t status = _SetInlineData(transaction, size, pos, buffer,
+				length);
+			if (status == B_OK) {
+				// the file cache must know the size, or it will cut off
+				// any access once the data has been moved out of the inode
+				file_cache_set_size(FileCache(), size);
+				file_map_set_size(Map(), size);
+				status = WriteBack(transaction);
+			}
+			if (status == B_DEVICE_FULL) {
+				// it doesn't fit anymore, continue with a real data stream
+				status = _PromoteInlineData(transaction);
+				if (status != B_OK) {
+					*_length = 0;
+					return status;
+				}
+			} else {
+				if (status != B_OK)
+					*_length = 0;
+				return status;
+			}
+		}
+	}
+
 	// the transaction doesn't have to be started already
 	if (changeSize && !transaction.IsStarted())
 		transaction.Start(fVolume, BlockNumber());
@@ -1623,6 +1779,11 @@ Inode::WriteAt(Transaction& transaction, off_t pos, const uint8* buffer,
 status_t
 Inode::FillGapWithZeros(off_t pos, off_t newSize)
 {
+	if (HasInlineData()) {
+		// inline data is always cleared when it grows
+		return B_OK;
+	}
+
 	while (pos < newSize) {
 		size_t size;
 		if (newSize > pos + 1024 * 1024 * 1024)
@@ -1641,6 +1802,201 @@ Inode::FillGapWithZeros(off_t pos, off_t newSize)
 }
 
 
+/*!	Moves the inline data of this inode into a regular data stream, so that
+	it can be accessed through the file map.
+*/
+status_t
+Inode::PromoteInlineData()
+{
+	Transaction transaction(fVolume, BlockNumber());
+	WriteLockInTransaction(transaction);
+
+	if (!HasInlineData())
+		return B_OK;
+
+	status_t status = _PromoteInlineData(transaction);
+	if (status == B_OK)
+		status = transaction.Done();
+
+	return status;
+}
+
+
+/*!	Copies the inline data of this inode to \a buffer, which may be a userland
+	buffer.
+	You need to hold the inode's lock when you call this method.
+*/
+status_t
+Inode::_ReadInlineData(off_t pos, uint8* buffer, size_t* _length)
+{
+	size_t length = *_length;
+	if (pos >= Size() || length == 0) {
+		*_length = 0;
+		return B_OK;
+	}
+	if ((uint64)pos + (uint64)length > (uint64)Size())
+		length = Size() - pos;
+
+	// copy the data first, so that we don't fault with the locks held
+	uint8* data = (uint8*)malloc(length);
+	if (data == NULL)
+		RETURN_ERROR(B_NO_MEMORY);
+	MemoryDeleter dataDeleter(data);
+
+	{
+		NodeGetter node(fVolume, this);
+		if (node.Node() == NULL)
+			RETURN_ERROR(B_IO_ERROR);
+
+		RecursiveLocker locker(fSmallDataLock);
+
+		const char nameTag[2] = {INLINE_DATA_NAME, 0};
+		small_data* item = FindSmallData(node.Node(), nameTag);
+		if (item == NULL || item->DataSize() < pos + length)
+			RETURN_ERROR(B_BAD_DATA);
+
+		memcpy(data, item->Data() + pos, length);
+	}
+
+	status_t status = user_memcpy(buffer, data, length);
+	if (status != B_OK)
+		return status;
+
+	*_length = length;
+	return B_OK;
+}
+
+
+/*!	Resizes the inline data of this inode to \a size bytes, and copies
+	\a length bytes from \a buffer (which may be a userland buffer) to \a pos.
+	If \a buffer is \c NULL, zeros are written instead.
+	Returns \c B_DEVICE_FULL if the data doesn't fit into the small_data
+	section without moving any attributes out of it; the inline data is left
+	untouched in this case.
+	Note that you need to write back the inode yourself after having called
+	that method.
+*/
+status_t
+Inode::_SetInlineData(Transaction& transaction, off_t size, off_t pos,
+	const uint8* buffer, size_t length)
+{
+	if (size > fVolume->InodeSize())
+		return B_DEVICE_FULL;
+
+	NodeGetter node(fVolume, transaction, this);
+	if (node.WritableNode() == NULL)
+		RETURN_ERROR(B_IO_ERROR);
+
+	const char nameTag[2] = {INLINE_DATA_NAME, 0};
+	status_t status;
+
+	if (size == 0) {
+		status = _RemoveSmallData(transaction, node, nameTag);
+		if (status != B_OK && status != B_ENTRY_NOT_FOUND)
+			return status;
+	} else {
+		uint8* data = (uint8*)malloc(size);
+		if (data == NULL)
+			RETURN_ERROR(B_NO_MEMORY);
+		MemoryDeleter dataDeleter(data);
+
+		memset(data, 0, size);
+
+		{
+			RecursiveLocker locker(fSmallDataLock);
+
+			small_data* item = FindSmallData(node.Node(), nameTag);
+			if (item != NULL)
+				memcpy(data, item->Data(), min_c(item->DataSize(), size));
+		}
+
+		if (buffer != NULL && length > 0) {
+			status = user_memcpy(data + pos, buffer, length);
+			if (status != B_OK)
+				return status;
+		}
+
+		status = _AddSmallData(transaction, node, nameTag, INLINE_DATA_TYPE,
+			0, data, size);
+		if (status != B_OK)
+			return status;
+	}
+
+	Node().data.size = HOST_ENDIAN_TO_BFS_INT64(size);
+	return B_OK;
+}
+
+
+/*!	Moves the inline data of this inode into a newly allocated data stream.
+	The data is written directly to disk, as this may be called from the
+	file cache's I/O path.
+	The inode must be write locked in the \a transaction.
+*/
+status_t
+Inode::_PromoteInlineData(Transaction& transaction)
+{
+	off_t size = Size();
+	size_t bufferSize = round_up(size, fVolume->BlockSize());
+
+	uint8* data = NULL;
+	MemoryDeleter dataDeleter;
+	if (size > 0) {
+		data = (uint8*)malloc(bufferSize);
+		if (data == NULL)
+			RETURN_ERROR(B_NO_MEMORY);
+		dataDeleter.SetTo(data);
+
+		memset(data, 0, bufferSize);
+
+		size_t length = size;
+		status_t status = _ReadInlineData(0, data, &length);
+		if (status != B_OK)
+			return status;
+	}
+
+	status_t status = _SetInlineData(transaction, 0, 0, NULL, 0);
+	if (status != B_OK)
+		return status;
+
+	Node().flags &= ~HOST_ENDIAN_TO_BFS_INT32(INODE_INLINE_DATA);
+
+	if (size > 0) {
+		status = _GrowStream(transaction, size);
+		if (status != B_OK)
+			return status;
+
+		// The size doesn't change, but make sure the file cache and map agree
+		file_cache_set_size(FileCache(), size);
+		file_map_set_size(Map(), size);
+
+		off_t pos = 0;
+		while (pos < (off_t)bufferSize) {
+			block_run run;
+			off_t offset;
+			status = FindBlockRun(pos, run, offset);
+			if (status != B_OK)
+				return status;
+
+			size_t runLength = ((uint32)run.Length() << fVolume->BlockShift())
+				- (pos - offset);
+			if (runLength > bufferSize - pos)
+				runLength = bufferSize - pos;
+
+			if (write_pos(fVolume->Device(),
+					fVolume->ToOffset(run) + pos - offset, data + pos,
+					runLength) != (ssize_t)runLength)
+				RETURN_ERROR(B_IO_ERROR);
+
+			pos += runLength;
+		}
+
+		file_map_invalidate(Map(), 0, size);
+	}
+
+	return WriteBack(transaction);
+}
+
+
 /*!	Allocates \a length blocks, and clears their contents. Growing
 	the indirect and double indirect range uses this method.
 	The allocated block_run is saved in "run"
@@ -1682,9 +2038,10 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 
 	// is the data stream already large enough to hold the new size?
 	// (can be the case with preallocated blocks)
-	if (size < data->MaxDirectRange()
-		|| size < data->MaxIndirectRange()
-		|| size < data->MaxDoubleIndirectRange()) {
+	if (HasExtents() ? size < Node().extent_data.MaxRange()
+		: (size < data->MaxDirectRange()
+			|| size < data->MaxIndirectRange()
+			|| size < data->MaxDoubleIndirectRange())) {
 		data->size = HOST_ENDIAN_TO_BFS_INT64(size);
 		return B_OK;
 	}
@@ -1692,7 +2049,9 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 	// how many bytes are still needed? (unused ranges are always zero)
 	uint16 minimum = 1;
 	off_t bytes;
-	if (data->Size() < data->MaxDoubleIndirectRange()) {
+	if (HasExtents())
+		bytes = size - Node().extent_data.MaxRange();
+	else if (data->Size() < data->MaxDoubleIndirectRange()) {
 		bytes = size - data->MaxDoubleIndirectRange();
 		// The double indirect range can only handle multiples of
 		// its base length
@@ -1755,6 +2114,11 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 		}
 	}
 
+	if (HasExtents()) {
+		return _GrowExtentStream(transaction, size, blocksNeeded,
+			blocksRequested);
+	}
+
 	while (blocksNeeded > 0) {
 		// the requested blocks do not need to be returned with a
 		// single allocation, so we need to iterate until we have
@@ -2145,6 +2509,9 @@ Inode::_FreeStreamArray(Transaction& transaction, block_run* array,
 status_t
 Inode::_ShrinkStream(Transaction& transaction, off_t size)
 {
+	if (HasExtents())
+		return _ShrinkExtentStream(transaction, size);
+
 	data_stream* data = &Node().data;
 	status_t status;
 
@@ -2205,6 +2572,70 @@ Inode::_ShrinkStream(Transaction& transaction, off_t size)
 }
 
 
+/*!	Allocates \a blocksNeeded blocks for an extent stream, and appends them
+	to it; more blocks are requested from the allocator if the stream should
+	get some preallocated space.
+*/
+status_t
+Inode::_GrowExtentStream(Transaction& transaction, off_t size,
+	off_t blocksNeeded, off_t blocksRequested)
+{
+	extent_stream* data = &Node().extent_data;
+	ExtentStream stream(this);
+
+	while (blocksNeeded > 0) {
+		block_run run;
+		status_t status = fVolume->Allocate(transaction, this, blocksRequested,
+			run);
+		if (status != B_OK)
+			return status;
+
+		status = stream.Append(transaction,
+			data->MaxRange() >> fVolume->BlockShift(), fVolume->ToBlock(run),
+			run.Length());
+		if (status != B_OK) {
+			fVolume->Free(transaction, run);
+			return status;
+		}
+
+		blocksNeeded -= run.Length();
+		// don't preallocate if the first allocation was already too small
+		blocksRequested = blocksNeeded;
+
+		data->max_range = HOST_ENDIAN_TO_BFS_INT64(data->MaxRange()
+			+ ((uint32)run.Length() << fVolume->BlockShift()));
+		data->size = HOST_ENDIAN_TO_BFS_INT64(blocksNeeded > 0
+			? data->MaxRange() : size);
+	}
+
+	data->size = HOST_ENDIAN_TO_BFS_INT64(size);
+	return B_OK;
+}
+
+
+/*!	Frees all blocks of an extent stream that are no longer needed for
+	\a size bytes, including its preallocated blocks.
+*/
+status_t
+Inode::_ShrinkExtentStream(Transaction& transaction, off_t size)
+{
+	extent_stream* data = &Node().extent_data;
+	off_t blocks = (size + fVolume->BlockSize() - 1) >> fVolume->BlockShift();
+
+	if (data->MaxRange() > blocks << fVolume->BlockShift()) {
+		status_t status = ExtentStream(this).Truncate(transaction, blocks);
+		if (status != B_OK)
+			return status;
+
+		data->max_range = HOST_ENDIAN_TO_BFS_INT64(
+			blocks << fVolume->BlockShift());
+	}
+
+	data->size = HOST_ENDIAN_TO_BFS_INT64(size);
+	return B_OK;
+}
+
+
 status_t
 Inode::SetFileSize(Transaction& transaction, off_t size)
 {
@@ -2218,8 +2649,23 @@ Inode::SetFileSize(Transaction& transaction, off_t size)
 
 	T(Resize(this, oldSize, size, false));
 
-	// should the data stream grow or shrink?
 	status_t status;
+	if (HasInlineData()) {
+		status = _SetInlineData(transaction, size, 0, NULL, 0);
+		if (status == B_OK) {
+			file_cache_set_size(FileCache(), size);
+			file_map_set_size(Map(), size);
+			return WriteBack(transaction);
+		}
+		if (status != B_DEVICE_FULL)
+			return status;
+
+		status = _PromoteInlineData(transaction);
+		if (status != B_OK)
+			return status;
+	}
+
+	// should the data stream grow or shrink?
 	if (size > oldSize) {
 		status = _GrowStream(transaction, size);
 		if (status < B_OK) {
@@ -2264,6 +2710,9 @@ Inode::NeedsTrimming() const
 
 	off_t roundedSize = round_up(Size(), fVolume->BlockSize());
 
+	if (HasExtents())
+		return Node().extent_data.MaxRange() > roundedSize;
+
 	return Node().data.MaxDirectRange() > roundedSize
 		|| Node().data.MaxIndirectRange() > roundedSize
 		|| Node().data.MaxDoubleIndirectRange() > roundedSize;
@@ -2273,8 +2722,9 @@ Inode::NeedsTrimming() const
 status_t
 Inode::TrimPreallocation(Transaction& transaction)
 {
-	T(Resize(this, max_c(Node().data.MaxDirectRange(),
-		Node().data.MaxIndirectRange()), Size(), true));
+	T(Resize(this, HasExtents() ? Node().extent_data.MaxRange()
+		: max_c(Node().data.MaxDirectRange(), Node().data.MaxIndirectRange()),
+		Size(), true));
 
 	status_t status = _ShrinkStream(transaction, Size());
 	if (status < B_OK)
@@ -2336,6 +2786,11 @@ Inode::Sync()
 
 	InodeReadLocker locker(this);
 
+	if (HasExtents()) {
+		SyncExtentVisitor visitor(fVolume);
+		return ExtentStream(this).Visit(visitor);
+	}
+
 	data_stream* data = &Node().data;
 	status_t status = B_OK;
 
@@ -2674,6 +3129,17 @@ Inode::Create(Transaction& transaction, Inode* parent, const char* name,
 
 	node->type = HOST_ENDIAN_TO_BFS_INT32(type);
 
+	// On volumes that support it, files keep their data in the inode until
+	// it's too large to fit there
+	if (inode->IsFile() && volume->HasInlineData())
+		node->flags |= HOST_ENDIAN_TO_BFS_INT32(INODE_INLINE_DATA);
+
+	// On volumes that support it, the data of files is kept in extents
+	if (inode->IsFile() && volume->HasExtents()) {
+		node->flags |= HOST_ENDIAN_TO_BFS_INT32(INODE_EXTENTS);
+		ExtentStream::Initialize(node->extent_data);
+	}
+
 	inode->WriteBack(transaction);
 		// make sure the initialized node is available to others
 
@@ -2826,6 +3292,9 @@ AttributeIterator::GetNext(char* name, size_t* _length, uint32* _type,
 			if (item->NameSize() == FILE_NAME_NAME_LENGTH
 				&& *item->Name() == FILE_NAME_NAME)
 				continue;
+			if (item->NameSize() == INLINE_DATA_NAME_LENGTH
+				&& *item->Name() == INLINE_DATA_NAME)
+				continue;
 
 			if (index >= fCurrentSmallData)
 				break;
@@ -71,6 +71,11 @@ public:
 			bool				IsLongSymLink() const
 									{ return (Flags() & INODE_LONG_SYMLINK)
 										!= 0; }
+			bool				HasInlineData() const
+									{ return (Flags() & INODE_INLINE_DATA)
+										!= 0; }
+			bool				HasExtents() const
+									{ return (Flags() & INODE_EXTENTS) != 0; }
 
 			bool				HasUserAccessableStream() const
 									{ return IsFile(); }
@@ -137,6 +142,8 @@ public:
 			// manipulating the data stream
 			status_t			FindBlockRun(off_t pos, block_run& run,
 									off_t& offset);
+			status_t			FindExtent(off_t pos, off_t& block,
+									off_t& length, off_t& offset);
 
 			status_t			ReadAt(off_t pos, uint8* buffer, size_t* length);
 			status_t			WriteAt(Transaction& transaction, off_t pos,
@@ -152,6 +159,8 @@ public:
 			status_t			Free(Transaction& transaction);
 			status_t			Sync();
 
+			status_t			PromoteInlineData();
+
 			bfs_inode&			Node() { return fNode; }
 			const bfs_inode&	Node() const { return fNode; }
 
@@ -229,6 +238,14 @@ private:
 									const char* name, bool hasIndex,
 									Index* index);
 
+			// inline data
+			status_t			_ReadInlineData(off_t pos, uint8* buffer,
+									size_t* _length);
+			status_t			_SetInlineData(Transaction& transaction,
+									off_t size, off_t pos, const uint8* buffer,
+									size_t length);
+			status_t			_PromoteInlineData(Transaction& transaction);
+
 			void				_AddIterator(AttributeIterator* iterator);
 			void				_RemoveIterator(AttributeIterator* iterator);
 
@@ -246,6 +263,11 @@ private:
 									off_t size);
 			status_t			_ShrinkStream(Transaction& transaction,
 									off_t size);
+			status_t			_GrowExtentStream(Transaction& transaction,
+									off_t size, off_t blocksNeeded,
+									off_t blocksRequested);
+			status_t			_ShrinkExtentStream(Transaction& transaction,
+									off_t size);
 
 private:
 			rw_lock				fLock;
@@ -304,9 +326,10 @@ class InodeReadLocker {
 public:
 	InodeReadLocker(Inode* inode)
 		:
-		fLock(&inode->Lock())
+		fLock(inode != NULL ? &inode->Lock() : NULL)
 	{
-		rw_lock_read_lock(fLock);
+		if (fLock != NULL)
+			rw_lock_read_lock(fLock);
 	}
 
 	~InodeReadLocker()
@@ -13,6 +13,12 @@
 #include "Inode.h"
 
 
+static const uint32 kMinLogSize = 128;
+	// a log needs to be able to hold a few transactions, at least
+static const uint32 kMaxLogSize = 65535;
+	// the log is a single block_run
+
+
 struct run_array {
 	int32		count;
 	int32		max_runs;
@@ -405,10 +411,24 @@ Journal::Journal(Volume* volume)
 	fUsed(0),
 	fUnwrittenTransactions(0),
 	fHasSubtransaction(false),
-	fSeparateSubTransactions(false)
+	fSeparateSubTransactions(false),
+	fTransactionSequence(0),
+	fCommittedSequence(0),
+	fWriterThread(-1),
+	fTerminating(false)
 {
 	recursive_lock_init(&fLock, "bfs journal");
 	mutex_init(&fEntriesLock, "bfs journal entries");
+
+	// The log writer thread is optional; without it, the log will only be
+	// flushed when it is full, or on sync.
+	fWriterSem = create_sem(0, "bfs log writer");
+	if (fWriterSem >= 0) {
+		fWriterThread = spawn_kernel_thread(&Journal::_LogWriter,
+			"bfs log writer", B_NORMAL_PRIORITY, this);
+		if (fWriterThread >= 0)
+			resume_thread(fWriterThread);
+	}
 }
 
 
@@ -416,6 +436,16 @@ Journal::~Journal()
 {
 	FlushLogAndBlocks();
 
+	if (fWriterThread >= 0) {
+		fTerminating = true;
+		release_sem(fWriterSem);
+
+		status_t result;
+		wait_for_thread(fWriterThread, &result);
+	}
+	if (fWriterSem >= 0)
+		delete_sem(fWriterSem);
+
 	recursive_lock_destroy(&fLock);
 	mutex_destroy(&fEntriesLock);
 }
@@ -686,18 +716,29 @@ Journal::_TransactionIdle(int32 transactionID, int32 event, void* _journal)
 {
 	// The current transaction seems to be idle - flush it. We can't do this
 	// in this thread, as flushing the log can produce new transaction events.
-	thread_id id = spawn_kernel_thread(&Journal::_FlushLog, "bfs log flusher",
-		B_NORMAL_PRIORITY, _journal);
-	if (id > 0)
-		resume_thread(id);
+	Journal* journal = (Journal*)_journal;
+	release_sem_etc(journal->fWriterSem, 1, B_DO_NOT_RESCHEDULE);
 }
 
 
+/*!	The log writer thread writes back the batched transactions once they have
+	become idle. Since any number of completed transactions are collected in
+	the current cache transaction, they all end up in a single log entry.
+*/
 /*static*/ status_t
-Journal::_FlushLog(void* _journal)
+Journal::_LogWriter(void* _journal)
 {
 	Journal* journal = (Journal*)_journal;
-	return journal->_FlushLog(false, false);
+
+	while (true) {
+		status_t status = acquire_sem(journal->fWriterSem);
+		if (status != B_OK || journal->fTerminating)
+			break;
+
+		journal->_FlushLog(true, false);
+	}
+
+	return B_OK;
 }
 
 
@@ -764,6 +805,7 @@ Journal::_WriteTransactionToLog()
 			cache_end_transaction(fVolume->BlockCache(), fTransactionID, NULL,
 				NULL);
 			fUnwrittenTransactions = 0;
+			fCommittedSequence = fTransactionSequence;
 		}
 		return B_OK;
 	}
@@ -903,6 +945,7 @@ Journal::_WriteTransactionToLog()
 		cache_end_transaction(fVolume->BlockCache(), fTransactionID,
 			_TransactionWritten, logEntry);
 		fUnwrittenTransactions = 0;
+		fCommittedSequence = fTransactionSequence;
 	}
 
 	return status;
@@ -952,6 +995,152 @@ Journal::FlushLogAndBlocks()
 }
 
 
+/*!	Makes sure that all transactions that were completed before this method
+	was called are written to the log. This implements a group commit: if
+	several threads commit at the same time, the first one to get the lock
+	writes back all of the batched transactions in one log entry, and the
+	others find their transactions already committed, and return without
+	doing any I/O.
+	Must not be called from inside a transaction, as that transaction could
+	not be committed yet.
+*/
+status_t
+Journal::Commit()
+{
+	if (recursive_lock_get_recursion(&fLock) > 0)
+		return B_NOT_ALLOWED;
+
+	int32 sequence = atomic_get(&fTransactionSequence);
+	status_t status = B_OK;
+
+	while (atomic_get(&fCommittedSequence) - sequence < 0) {
+		status = recursive_lock_lock(&fLock);
+		if (status != B_OK)
+			return status;
+
+		if (fCommittedSequence - sequence < 0) {
+			if (fUnwrittenTransactions != 0 && _TransactionSize() != 0)
+				status = _WriteTransactionToLog();
+			else
+				fCommittedSequence = fTransactionSequence;
+		}
+
+		recursive_lock_unlock(&fLock);
+
+		if (status != B_OK) {
+			FATAL(("committing log entry failed: %s\n", strerror(status)));
+			return status;
+		}
+	}
+
+	return B_OK;
+}
+
+
+/*!	Changes the size of the log area to \a length blocks. The log has to
+	stay where it is, right after the block bitmap, so it can only grow if
+	the blocks following it are unused.
+	The whole log is flushed before it is resized.
+*/
+status_t
+Journal::ResizeLog(uint32 length)
+{
+	if (length < kMinLogSize || length > kMaxLogSize)
+		return B_BAD_VALUE;
+	if (fVolume->IsReadOnly())
+		return B_READ_ONLY_DEVICE;
+
+	block_run log = fVolume->Log();
+	if (length == log.Length())
+		return B_OK;
+
+	if (length > log.Length()) {
+		// reserve the blocks after the current log first
+		block_run run = block_run::Run(log.AllocationGroup(),
+			log.Start() + log.Length(), length - log.Length());
+
+		Transaction transaction(fVolume, 0);
+		status_t status = fVolume->Allocator().AllocateRun(transaction, run);
+		if (status != B_OK)
+			return status;
+
+		status = transaction.Done();
+		if (status != B_OK)
+			return status;
+
+		status = _SetLogSize(length);
+		if (status != B_OK) {
+			// give the blocks back
+			Transaction undo(fVolume, 0);
+			if (fVolume->Allocator().Free(undo, run) == B_OK)
+				undo.Done();
+		}
+		return status;
+	}
+
+	// When shrinking the log, the blocks can only be freed after the new
+	// size is on disk; if we crash in between, checkfs will free them.
+	status_t status = _SetLogSize(length);
+	if (status != B_OK)
+		return status;
+
+	Transaction transaction(fVolume, 0);
+	status = fVolume->Allocator().Free(transaction,
+		block_run::Run(log.AllocationGroup(), log.Start() + length,
+			log.Length() - length));
+	if (status == B_OK)
+		status = transaction.Done();
+
+	return status;
+}
+
+
+/*!	Writes back the complete log, and then changes its size in the
+	superblock to \a length blocks.
+*/
+status_t
+Journal::_SetLogSize(uint32 length)
+{
+	RecursiveLocker locker(fLock);
+
+	if (recursive_lock_get_recursion(&fLock) > 1)
+		return B_BUSY;
+
+	// empty the log
+	status_t status = B_OK;
+	if (fUnwrittenTransactions != 0 && _TransactionSize() != 0)
+		status = _WriteTransactionToLog();
+	if (status == B_OK)
+		status = fVolume->FlushDevice();
+	if (status != B_OK)
+		return status;
+
+	if (fVolume->LogStart() != fVolume->LogEnd() || !fEntries.IsEmpty())
+		return B_BUSY;
+
+	uint32 position = fVolume->LogEnd() % length;
+
+	disk_super_block& superBlock = fVolume->SuperBlock();
+	superBlock.log_blocks.length = HOST_ENDIAN_TO_BFS_INT16(length);
+	superBlock.log_start = superBlock.log_end
+		= HOST_ENDIAN_TO_BFS_INT64(position);
+
+	status = fVolume->WriteSuperBlock();
+	if (status != B_OK)
+		return status;
+
+	ioctl(fVolume->Device(), B_FLUSH_DRIVE_CACHE);
+
+	fVolume->LogStart() = position;
+	fVolume->LogEnd() = position;
+	fLogSize = length;
+	fMaxTransactionSize = fLogSize / 2 - 5;
+
+	INFORM(("log resized to %" B_PRIu32 " blocks\n", length));
+	return B_OK;
+}
+
+
 status_t
 Journal::Lock(Transaction* owner, bool separateSubTransactions)
 {
@@ -1066,6 +1255,8 @@ Journal::_TransactionDone(bool success)
 		return B_OK;
 	}
 
+	atomic_add(&fTransactionSequence, 1);
+
 	// Up to a maximum size, we will just batch several
 	// transactions together to improve speed
 	uint32 size = _TransactionSize();
@@ -1104,6 +1295,8 @@ Journal::Dump()
 	kprintf("  transaction ID:       %" B_PRId32 "\n", fTransactionID);
 	kprintf("  has subtransaction:   %d\n", fHasSubtransaction);
 	kprintf("  separate sub-trans.:  %d\n", fSeparateSubTransactions);
+	kprintf("  sequence:             %" B_PRId32 " (committed %" B_PRId32
+		")\n", fTransactionSequence, fCommittedSequence);
 	kprintf("entries:\n");
 	kprintf("  address        id  start length\n");
 
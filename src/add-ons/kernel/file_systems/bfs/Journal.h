@@ -36,10 +36,13 @@ public:
 			bool			CurrentTransactionTooLarge() const;
 
 			status_t		FlushLogAndBlocks();
+			status_t		Commit();
+			status_t		ResizeLog(uint32 length);
 			Volume*			GetVolume() const { return fVolume; }
 			int32			TransactionID() const { return fTransactionID; }
 
 	inline	uint32			FreeLogBlocks() const;
+			uint32			LogSize() const { return fLogSize; }
 
 #ifdef BFS_DEBUGGER_COMMANDS
 			void			Dump();
@@ -55,12 +58,13 @@ private:
 			status_t		_CheckRunArray(const run_array* array);
 			status_t		_ReplayRunArray(int32* start);
 			status_t		_TransactionDone(bool success);
+			status_t		_SetLogSize(uint32 length);
 
 	static	void			_TransactionWritten(int32 transactionID,
 								int32 event, void* _logEntry);
 	static	void			_TransactionIdle(int32 transactionID, int32 event,
 								void* _journal);
-	static	status_t		_FlushLog(void* _journal);
+	static	status_t		_LogWriter(void* _journal);
 
 private:
 			Volume*			fVolume;
@@ -76,6 +80,11 @@ private:
 			int32			fTransactionID;
 			bool			fHasSubtransaction;
 			bool			fSeparateSubTransactions;
+			int32			fTransactionSequence;
+			int32			fCommittedSequence;
+			sem_id			fWriterSem;
+			thread_id		fWriterThread;
+			bool			fTerminating;
 };
 
 
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+//! Trigrams of file names for the name trigram index
+
+
+#include "NameTrigrams.h"
+
+
+static inline uint8
+fold(uint8 c)
+{
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+
+/*!	Parses the set starting at \a pattern (after the opening bracket), and
+	returns the character it stands for, if it only contains the upper and
+	lower case versions of a single ASCII character, or -1 if not.
+	\a pattern is moved behind the set.
+*/
+static int32
+parse_set(const char*& pattern)
+{
+	int32 result = -1;
+	bool single = pattern[0] != '^' && pattern[0] != '!';
+
+	while (pattern[0] != '\0' && pattern[0] != ']') {
+		if (pattern[0] == '\\' && pattern[1] != '\0')
+			pattern++;
+
+		uint8 c = *pattern++;
+		if (c >= 0x80 || (pattern[0] == '-' && pattern[1] != ']'
+				&& pattern[1] != '\0')) {
+			// UTF-8 characters and ranges
+			single = false;
+		} else if (result < 0)
+			result = fold(c);
+		else if (result != fold(c))
+			single = false;
+	}
+
+	if (pattern[0] == ']')
+		pattern++;
+
+	return single ? result : -1;
+}
+
+
+//	#pragma mark -
+
+
+NameTrigrams::NameTrigrams()
+	:
+	fCount(0),
+	fRun(0),
+	fRunLength(0)
+{
+}
+
+
+void
+NameTrigrams::SetToName(const char* name)
+{
+	fCount = 0;
+	_Break();
+
+	if (name != NULL) {
+		while (name[0] != '\0')
+			_Push(*name++);
+	}
+
+	_Finish();
+}
+
+
+/*!	Collects the trigrams of all parts of the pattern that only match a
+	single character (ignoring its case).
+*/
+void
+NameTrigrams::SetToPattern(const char* pattern)
+{
+	fCount = 0;
+	_Break();
+
+	while (pattern[0] != '\0') {
+		char c = *pattern++;
+		switch (c) {
+			case '*':
+			case '?':
+				_Break();
+				break;
+
+			case '[':
+			{
+				int32 set = parse_set(pattern);
+				if (set < 0)
+					_Break();
+				else
+					_Push(set);
+				break;
+			}
+
+			case '\\':
+				if (pattern[0] == '\0') {
+					_Break();
+					break;
+				}
+				c = *pattern++;
+				// supposed to fall through
+			default:
+				_Push(c);
+				break;
+		}
+	}
+
+	_Finish();
+}
+
+
+/*static*/ void
+NameTrigrams::GetKey(uint32 trigram, uint8* key)
+{
+	key[0] = trigram >> 16;
+	key[1] = trigram >> 8;
+	key[2] = trigram;
+}
+
+
+void
+NameTrigrams::_Push(uint8 c)
+{
+	fRun = ((fRun << 8) | fold(c)) & 0xffffff;
+	if (++fRunLength >= kTrigramLength && fCount < kMaxNameTrigrams)
+		fTrigrams[fCount++] = fRun;
+}
+
+
+//!	Sorts the trigrams, and removes the duplicates.
+void
+NameTrigrams::_Finish()
+{
+	int32 count = 0;
+	for (int32 i = 0; i < fCount; i++) {
+		uint32 trigram = fTrigrams[i];
+
+		int32 index = count;
+		while (index > 0 && fTrigrams[index - 1] > trigram)
+			index--;
+		if (index > 0 && fTrigrams[index - 1] == trigram)
+			continue;
+
+		for (int32 j = count; j > index; j--)
+			fTrigrams[j] = fTrigrams[j - 1];
+		fTrigrams[index] = trigram;
+		count++;
+	}
+
+	fCount = count;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef NAME_TRIGRAMS_H
+#define NAME_TRIGRAMS_H
+
+
+#ifdef FS_SHELL
+#	include "fssh_api_wrapper.h"
+#else
+#	include <SupportDefs.h>
+#endif
+
+
+// The name of the optional index that contains the trigrams of all names
+// in the name index. It must be a string index.
+static const char* const kNameTrigramIndex = "name:trigrams";
+
+static const int32 kTrigramLength = 3;
+static const int32 kMaxNameTrigrams = 256;
+
+
+/*!	The sorted set of trigrams of a file name; all names are folded to lower
+	case ASCII for this. For a query pattern, it contains the trigrams that
+	every name matching the pattern must contain.
+	A trigram is stored in the lower 24 bits of an uint32, so that the order
+	of the numbers is the same as the one of their keys.
+*/
+class NameTrigrams {
+public:
+							NameTrigrams();
+
+			void			SetToName(const char* name);
+			void			SetToPattern(const char* pattern);
+
+			int32			CountTrigrams() const { return fCount; }
+			uint32			TrigramAt(int32 index) const
+								{ return fTrigrams[index]; }
+
+	static	void			GetKey(uint32 trigram, uint8* key);
+
+private:
+			void			_Push(uint8 c);
+			void			_Break() { fRunLength = 0; }
+			void			_Finish();
+
+			uint32			fTrigrams[kMaxNameTrigrams];
+			int32			fCount;
+			uint32			fRun;
+			int32			fRunLength;
+};
+
+
+#endif	// NAME_TRIGRAMS_H
@@ -15,6 +15,9 @@
 
 #include "Query.h"
 
+#include <algorithm>
+#include <stdarg.h>
+
 #include <file_systems/QueryParserUtils.h>
 #include <query_private.h>
 
@@ -23,6 +26,7 @@
 #include "Debug.h"
 #include "Index.h"
 #include "Inode.h"
+#include "NameTrigrams.h"
 #include "Volume.h"
 
 
@@ -59,6 +63,21 @@ enum ops {
 };
 
 
+static const off_t kUnusableCost = 1LL << 62;
+	// the cost of an equation that cannot be used to start a query with
+static const off_t kMaxFilterEntries = 32768;
+	// the maximum number of entries of an index that are collected to
+	// filter out non-matching entries of another index
+static const off_t kMaxFilterRatio = 16;
+	// an index is only used as a filter if it has at most this many times
+	// the entries of the index the query is driven by
+static const off_t kTrigramCandidateCost = 4;
+	// every entry found in the name trigram index has to be loaded to check
+	// its name, which is more expensive than comparing an index key
+static const int32 kMaxTrigramEstimates = 8;
+	// the number of trigrams of a pattern that are considered
+
+
 union value {
 	int64	Int64;
 	uint64	Uint64;
@@ -70,6 +89,21 @@ union value {
 };
 
 
+/*!	Collects the text of a query plan, see Query::Explain().
+*/
+class PlanPrinter {
+public:
+						PlanPrinter(char* buffer, size_t size);
+
+			void		Print(const char* format, ...);
+
+private:
+			char*		fBuffer;
+			size_t		fSize;
+			size_t		fLength;
+};
+
+
 /*!	Abstract base class for the operator/equation classes.
 */
 class Term {
@@ -86,12 +120,16 @@ public:
 							int32 type = 0, const uint8* key = NULL,
 							size_t size = 0) = 0;
 	virtual	void		Complement() = 0;
+	virtual	bool		DependsOn(const char* attribute) const = 0;
 
-	virtual	void		CalculateScore(Index& index) = 0;
-	virtual	int32		Score() const = 0;
+	virtual	void		CalculateCost(Index& index,
+							bool queryNonIndexed) = 0;
+	virtual	off_t		Cost() const = 0;
 
 	virtual	status_t	InitCheck() = 0;
 
+	virtual	void		PrintTo(PlanPrinter& printer) = 0;
+
 #ifdef DEBUG
 	virtual	void		PrintToStream() = 0;
 #endif
@@ -107,7 +145,7 @@ protected:
 	Although an Equation object is quite independent from the volume on which
 	the query is run, there are some dependencies that are produced while
 	querying:
-	The type/size of the value, the score, and if it has an index or not.
+	The type/size of the value, the cost, and if it has an index or not.
 	So you could run more than one query on the same volume, but it might return
 	wrong values when it runs concurrently on another volume.
 	That's not an issue right now, because we run single-threaded and don't use
@@ -127,14 +165,26 @@ public:
 							int32 type = 0, const uint8* key = NULL,
 							size_t size = 0);
 	virtual void		Complement();
+	virtual	bool		DependsOn(const char* attribute) const
+							{ return strcmp(fAttribute, attribute) == 0; }
 
 			status_t	PrepareQuery(Volume* volume, Index& index,
 							TreeIterator** iterator, bool queryNonIndexed);
 			status_t	GetNextMatching(Volume* volume, TreeIterator* iterator,
 							struct dirent* dirent, size_t bufferSize);
 
-	virtual	void		CalculateScore(Index &index);
-	virtual	int32		Score() const { return fScore; }
+	virtual	void		CalculateCost(Index& index, bool queryNonIndexed);
+	virtual	off_t		Cost() const { return fCost; }
+			bool		HasIndex() const { return fHasIndex; }
+
+			void		SetUseFilter(bool useFilter);
+			bool		UsesFilter() const { return fUseFilter; }
+			status_t	BuildFilter(Volume* volume);
+			bool		HasFilter() const { return fFilterCount >= 0; }
+			bool		FilterContains(off_t id) const;
+
+	virtual	void		PrintTo(PlanPrinter& printer);
+			void		Explain(PlanPrinter& printer);
 
 #ifdef DEBUG
 	virtual	void		PrintToStream();
@@ -150,6 +200,12 @@ private:
 			uint8*		Value() const { return (uint8*)&fValue; }
 			status_t	MatchEmptyString();
 
+			void		_CalculateTrigramCost(Index& index);
+			const char*	_IndexName() const;
+			status_t	_GetNextIndexEntry(TreeIterator* iterator,
+							off_t& _id);
+			bool		_MatchesFilters(off_t id);
+
 			char*		fAttribute;
 			char*		fString;
 			union value fValue;
@@ -158,8 +214,20 @@ private:
 			bool		fIsPattern;
 			bool		fIsSpecialTime;
 
-			int32		fScore;
+			off_t		fCost;
+			off_t		fEntries;
+				// the entries of the index that is scanned
 			bool		fHasIndex;
+
+			bool		fUseTrigram;
+			uint32		fTrigram;
+			off_t		fPreviousID;
+
+			bool		fUseFilter;
+			off_t*		fFilter;
+			int32		fFilterCount;
+				// the sorted IDs of all entries that match in the index,
+				// or -1 if there is no filter
 };
 
 
@@ -178,12 +246,17 @@ public:
 							int32 type = 0, const uint8* key = NULL,
 							size_t size = 0);
 	virtual	void		Complement();
+	virtual	bool		DependsOn(const char* attribute) const
+							{ return fLeft->DependsOn(attribute)
+								|| fRight->DependsOn(attribute); }
 
-	virtual	void		CalculateScore(Index& index);
-	virtual	int32		Score() const;
+	virtual	void		CalculateCost(Index& index, bool queryNonIndexed);
+	virtual	off_t		Cost() const;
 
 	virtual	status_t	InitCheck();
 
+	virtual	void		PrintTo(PlanPrinter& printer);
+
 #ifdef DEBUG
 	virtual	void		PrintToStream();
 #endif
@@ -198,6 +271,65 @@ private:
 };
 
 
+/*!	Returns the other child of the parent of \a term, if the parent is an
+	&&-operator, or \c NULL otherwise.
+*/
+static Term*
+and_sibling(Term* term)
+{
+	Operator* parent = (Operator*)term->Parent();
+	if (parent == NULL || parent->Op() != OP_AND)
+		return NULL;
+
+	return parent->Left() == term ? parent->Right() : parent->Left();
+}
+
+
+static const char*
+operator_symbol(int8 op)
+{
+	switch (op) {
+		case OP_EQUAL: return "==";
+		case OP_UNEQUAL: return "!=";
+		case OP_GREATER_THAN: return ">";
+		case OP_GREATER_THAN_OR_EQUAL: return ">=";
+		case OP_LESS_THAN: return "<";
+		case OP_LESS_THAN_OR_EQUAL: return "<=";
+	}
+	return "???";
+}
+
+
+//	#pragma mark -
+
+
+PlanPrinter::PlanPrinter(char* buffer, size_t size)
+	:
+	fBuffer(buffer),
+	fSize(size),
+	fLength(0)
+{
+	if (fSize > 0)
+		fBuffer[0] = '\0';
+}
+
+
+void
+PlanPrinter::Print(const char* format, ...)
+{
+	if (fLength + 1 >= fSize)
+		return;
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(fBuffer + fLength, fSize - fLength, format, args);
+	va_end(args);
+
+	if (length > 0)
+		fLength = min_c(fLength + length, fSize - 1);
+}
+
+
 //	#pragma mark -
 
 
@@ -207,7 +339,16 @@ Equation::Equation(char** expr)
 	fAttribute(NULL),
 	fString(NULL),
 	fType(0),
-	fIsPattern(false)
+	fIsPattern(false),
+	fCost(kUnusableCost),
+	fEntries(0),
+	fHasIndex(false),
+	fUseTrigram(false),
+	fTrigram(0),
+	fPreviousID(-1),
+	fUseFilter(false),
+	fFilter(NULL),
+	fFilterCount(-1)
 {
 	char* string = *expr;
 	char* start = string;
@@ -341,6 +482,7 @@ Equation::~Equation()
 {
 	free(fAttribute);
 	free(fString);
+	free(fFilter);
 }
 
 
@@ -633,37 +775,175 @@ Equation::Match(Inode* inode, const char* attributeName, int32 type,
 }
 
 
+/*!	Estimates how many entries of the index have to be read when the query
+	is started with this equation. The B+tree of the index is used as a
+	histogram of its keys, see BPlusTree::EstimateKey().
+	Equations that cannot be used for that at all get kUnusableCost.
+*/
 void
-Equation::CalculateScore(Index &index)
+Equation::CalculateCost(Index& index, bool queryNonIndexed)
 {
-	// As always, these values could be tuned and refined.
-	// And the code could also need some real world testing :-)
+	fCost = kUnusableCost;
+	fEntries = 0;
+	fUseTrigram = false;
 
-	// do we have to operate on a "foreign" index?
-	if (fOp == OP_UNEQUAL || index.SetTo(fAttribute) < B_OK) {
-		fScore = 0;
+	status_t status = index.SetTo(fAttribute);
+	if (status != B_OK && !queryNonIndexed)
+		return;
+
+	// Like in PrepareQuery(), OP_UNEQUAL and attributes without an index
+	// have to go through the whole "name" index
+	type_code type = status == B_OK ? index.Type() : B_STRING_TYPE;
+	fHasIndex = status == B_OK && fOp != OP_UNEQUAL;
+	if (!fHasIndex && index.SetTo("name") != B_OK)
+		return;
+
+	if (ConvertValue(type) != B_OK)
+		return;
+
+	BPlusTree* tree = index.Node()->Tree();
+	if (tree == NULL)
+		return;
+
+	// the key doesn't matter for the total number of entries
+	union value zero;
+	memset(&zero, 0, sizeof(zero));
+	key_estimate estimate;
+	if (tree->EstimateKey((uint8*)&zero, max_c(index.KeySize(), 1),
+			estimate) != B_OK)
+		return;
+
+	fEntries = estimate.entries;
+	fCost = fEntries;
+	if (!fHasIndex)
+		return;
+
+	if (fIsPattern) {
+		// only the entries starting with the beginning of the pattern
+		// need to be looked at
+		int32 keySize = getFirstPatternSymbol(fString);
+		if (keySize > 0) {
+			uint8 key[BPLUSTREE_MAX_KEY_LENGTH];
+			keySize = min_c(keySize, BPLUSTREE_MAX_KEY_LENGTH - 1);
+			memcpy(key, fValue.String, keySize);
+
+			key_estimate last;
+			key[keySize] = 0xff;
+			if (tree->EstimateKey(key, keySize, estimate) == B_OK
+				&& tree->EstimateKey(key, keySize + 1, last) == B_OK)
+				fCost = max_c(last.before - estimate.before, 0);
+		}
+
+		if (!strcmp(fAttribute, "name"))
+			_CalculateTrigramCost(index);
 		return;
 	}
 
-	// if we have a pattern, how much does it help our search?
-	if (fIsPattern)
-		fScore = getFirstPatternSymbol(fString) << 3;
-	else {
-		// Score by operator
-		if (fOp == OP_EQUAL)
-			// higher than pattern="255 chars+*"
-			fScore = 2048;
-		else
-			// the pattern search is regarded cheaper when you have at
-			// least one character to set your index to
-			fScore = 5;
+	int32 keySize = index.KeySize();
+	if (keySize == 0 && fType == B_STRING_TYPE)
+		keySize = max_c(strlen(fValue.String), 1);
+	if (keySize == 0)
+		return;
+
+	off_t before;
+	off_t equal;
+	if (fIsSpecialTime) {
+		// all shifted values that belong to the unshifted one are equal
+		off_t value = fValue.Int64 << INODE_TIME_SHIFT;
+		if (tree->EstimateKey((uint8*)&value, keySize, estimate) != B_OK)
+			return;
+
+		before = estimate.before;
+		value = (fValue.Int64 + 1) << INODE_TIME_SHIFT;
+		if (tree->EstimateKey((uint8*)&value, keySize, estimate) != B_OK)
+			return;
+
+		equal = max_c(estimate.before - before, 0);
+	} else {
+		if (tree->EstimateKey(Value(), keySize, estimate) != B_OK)
+			return;
+
+		before = estimate.before;
+		equal = estimate.equal;
 	}
 
-	// take index size into account (1024 is the current node size
-	// in our B+trees)
-	// 2048 * 2048 == 4194304 is the maximum score (for an empty
-	// tree, since the header + 1 node are already 2048 bytes)
-	fScore = fScore * ((2048 * 1024LL) / index.Node()->Size());
+	switch (fOp) {
+		case OP_EQUAL:
+			fCost = equal;
+			break;
+		case OP_GREATER_THAN:
+			fCost = fEntries - before - equal;
+			break;
+		case OP_GREATER_THAN_OR_EQUAL:
+			fCost = fEntries - before;
+			break;
+		case OP_LESS_THAN:
+			fCost = before;
+			break;
+		case OP_LESS_THAN_OR_EQUAL:
+			fCost = before + equal;
+			break;
+	}
+
+	fCost = max_c(min_c(fCost, fEntries), 0);
+}
+
+
+/*!	Checks if fewer entries have to be read when the names matching the
+	pattern are looked up in the name trigram index, rather than in the name
+	index. If so, the trigram of the pattern with the fewest entries is used
+	to run the query.
+*/
+void
+Equation::_CalculateTrigramCost(Index& index)
+{
+	if (index.SetTo(kNameTrigramIndex) != B_OK
+		|| index.Type() != B_STRING_TYPE)
+		return;
+
+	BPlusTree* tree = index.Node()->Tree();
+	if (tree == NULL)
+		return;
+
+	NameTrigrams* trigrams = new(std::nothrow) NameTrigrams;
+	if (trigrams == NULL)
+		return;
+	ObjectDeleter<NameTrigrams> trigramsDeleter(trigrams);
+
+	trigrams->SetToPattern(fString);
+
+	int32 count = min_c(trigrams->CountTrigrams(), kMaxTrigramEstimates);
+	for (int32 i = 0; i < count; i++) {
+		uint8 key[kTrigramLength];
+		NameTrigrams::GetKey(trigrams->TrigramAt(i), key);
+
+		key_estimate estimate;
+		if (tree->EstimateKey(key, kTrigramLength, estimate) != B_OK)
+			continue;
+
+		off_t cost = estimate.equal * kTrigramCandidateCost;
+		if (cost < fCost) {
+			fCost = cost;
+			fEntries = estimate.entries;
+			fTrigram = trigrams->TrigramAt(i);
+			fUseTrigram = true;
+		}
+	}
+
+	if (fUseTrigram) {
+		// the names still need to be matched against the pattern
+		fHasIndex = false;
+	}
+}
+
+
+const char*
+Equation::_IndexName() const
+{
+	if (fUseTrigram)
+		return kNameTrigramIndex;
+
+	return fHasIndex ? fAttribute : "name";
 }
 
 
@@ -671,6 +951,28 @@ status_t
 Equation::PrepareQuery(Volume* /*volume*/, Index& index,
 	TreeIterator** iterator, bool queryNonIndexed)
 {
+	if (fUseTrigram && index.SetTo(kNameTrigramIndex) == B_OK) {
+		// every name that matches the pattern contains the trigram
+		fHasIndex = false;
+		fPreviousID = -1;
+
+		if (ConvertValue(B_STRING_TYPE) != B_OK)
+			return B_BAD_VALUE;
+
+		BPlusTree* tree = index.Node()->Tree();
+		if (tree == NULL)
+			return B_ERROR;
+
+		*iterator = new(std::nothrow) TreeIterator(tree);
+		if (*iterator == NULL)
+			return B_NO_MEMORY;
+
+		uint8 key[kTrigramLength];
+		NameTrigrams::GetKey(fTrigram, key);
+		return (*iterator)->Find(key, kTrigramLength);
+	}
+	fUseTrigram = false;
+
 	status_t status = index.SetTo(fAttribute);
 
 	// if we should query attributes without an index, we can just proceed here
@@ -764,21 +1066,37 @@ Equation::PrepareQuery(Volume* /*volume*/, Index& index,
 }
 
 
+/*!	Returns the ID of the next entry of the index that matches the equation,
+	if it has its own index, or just the next entry otherwise.
+*/
 status_t
-Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
-	struct dirent* dirent, size_t bufferSize)
+Equation::_GetNextIndexEntry(TreeIterator* iterator, off_t& _id)
 {
 	while (true) {
 		union value indexValue;
 		uint16 keyLength;
 		uint16 duplicate;
-		off_t offset;
 
 		status_t status = iterator->GetNextEntry(&indexValue, &keyLength,
-			(uint16)sizeof(indexValue), &offset, &duplicate);
+			(uint16)sizeof(indexValue), &_id, &duplicate);
 		if (status != B_OK)
 			return status;
 
+		if (fUseTrigram) {
+			uint8 key[kTrigramLength];
+			NameTrigrams::GetKey(fTrigram, key);
+			if (duplicate < 2 && (keyLength != kTrigramLength
+					|| memcmp(&indexValue, key, kTrigramLength) != 0))
+				return B_ENTRY_NOT_FOUND;
+
+			// a name may have been added twice while the index was filled
+			if (_id == fPreviousID)
+				continue;
+
+			fPreviousID = _id;
+			return B_OK;
+		}
+
 		// only compare against the index entry when this is the correct
 		// index for the equation
 		if (fHasIndex && duplicate < 2
@@ -797,6 +1115,44 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 			continue;
 		}
 
+		return B_OK;
+	}
+}
+
+
+/*!	Checks \a id against the filters of the other equations this one is
+	combined with by &&-operators.
+*/
+bool
+Equation::_MatchesFilters(off_t id)
+{
+	for (Term* term = this; term->Parent() != NULL; term = term->Parent()) {
+		Term* other = and_sibling(term);
+		if (other != NULL && other->Op() > OP_EQUATION
+			&& ((Equation*)other)->HasFilter()
+			&& !((Equation*)other)->FilterContains(id))
+			return false;
+	}
+
+	return true;
+}
+
+
+status_t
+Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
+	struct dirent* dirent, size_t bufferSize)
+{
+	while (true) {
+		off_t offset;
+		status_t status = _GetNextIndexEntry(iterator, offset);
+		if (status != B_OK)
+			return status;
+
+		// the filters are checked before the inode is loaded, as they
+		// usually rule out most entries
+		if (!_MatchesFilters(offset))
+			continue;
+
 		Vnode vnode(volume, offset);
 		Inode* inode;
 		if ((status = vnode.Get(&inode)) != B_OK) {
@@ -841,6 +1197,13 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 						parent));
 					break;
 				}
+				if (other->Op() > OP_EQUATION
+					&& ((Equation*)other)->HasFilter()) {
+					// has already been checked
+					term = (Term*)parent;
+					continue;
+				}
+
 				status = other->Match(inode);
 				if (status < 0) {
 					REPORT_ERROR(status);
@@ -871,6 +1234,146 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 }
 
 
+void
+Equation::SetUseFilter(bool useFilter)
+{
+	free(fFilter);
+	fFilter = NULL;
+	fFilterCount = -1;
+	fUseFilter = useFilter;
+}
+
+
+/*!	Collects the IDs of all entries that match the equation in its index,
+	so that the entries of another index can be checked against them without
+	having to load their inodes.
+	If the index contains too many matching entries, B_BUFFER_OVERFLOW is
+	returned, and the equation is matched the usual way.
+*/
+status_t
+Equation::BuildFilter(Volume* volume)
+{
+	SetUseFilter(true);
+
+	Index index(volume);
+	TreeIterator* iterator = NULL;
+	status_t status = PrepareQuery(volume, index, &iterator, false);
+	if (status == B_ENTRY_NOT_FOUND && iterator != NULL) {
+		// there is no matching entry at all
+		delete iterator;
+		fFilterCount = 0;
+		return B_OK;
+	}
+	if (status != B_OK) {
+		delete iterator;
+		SetUseFilter(false);
+		return status;
+	}
+
+	int32 count = 0;
+	int32 size = 0;
+	off_t id;
+	while ((status = _GetNextIndexEntry(iterator, id)) == B_OK) {
+		if (count == size) {
+			if (size == kMaxFilterEntries) {
+				status = B_BUFFER_OVERFLOW;
+				break;
+			}
+
+			size = size == 0 ? 256 : min_c(size * 2, kMaxFilterEntries);
+			off_t* filter = (off_t*)realloc(fFilter, size * sizeof(off_t));
+			if (filter == NULL) {
+				status = B_NO_MEMORY;
+				break;
+			}
+			fFilter = filter;
+		}
+
+		fFilter[count++] = id;
+	}
+
+	delete iterator;
+
+	if (status != B_ENTRY_NOT_FOUND) {
+		SetUseFilter(false);
+		return status;
+	}
+
+	std::sort(fFilter, fFilter + count);
+	fFilterCount = count;
+	return B_OK;
+}
+
+
+bool
+Equation::FilterContains(off_t id) const
+{
+	int32 first = 0;
+	int32 last = fFilterCount - 1;
+	while (first <= last) {
+		int32 middle = (first + last) / 2;
+		if (fFilter[middle] == id)
+			return true;
+		if (fFilter[middle] < id)
+			first = middle + 1;
+		else
+			last = middle - 1;
+	}
+	return false;
+}
+
+
+void
+Equation::PrintTo(PlanPrinter& printer)
+{
+	printer.Print("%s %s \"%s\"", fAttribute, operator_symbol(fOp), fString);
+}
+
+
+/*!	Describes how the query is run when it is started with this equation.
+*/
+void
+Equation::Explain(PlanPrinter& printer)
+{
+	if (fCost == kUnusableCost) {
+		printer.Print("skip ");
+		PrintTo(printer);
+		printer.Print(" (no index)\n");
+		return;
+	}
+
+	printer.Print("scan index \"%s\" for ", _IndexName());
+	PrintTo(printer);
+	if (fUseTrigram) {
+		uint8 key[kTrigramLength];
+		NameTrigrams::GetKey(fTrigram, key);
+		printer.Print(" (trigram \"%.3s\", about %" B_PRIdOFF " of %"
+			B_PRIdOFF " entries)\n", (char*)key,
+			fCost / kTrigramCandidateCost, fEntries);
+	} else {
+		printer.Print(" (about %" B_PRIdOFF " of %" B_PRIdOFF " entries)\n",
+			fCost, fEntries);
+	}
+
+	for (Term* term = this; term->Parent() != NULL; term = term->Parent()) {
+		Term* other = and_sibling(term);
+		if (other == NULL)
+			continue;
+
+		if (other->Op() > OP_EQUATION && ((Equation*)other)->UsesFilter()) {
+			printer.Print("    intersect with index \"%s\" for ",
+				((Equation*)other)->fAttribute);
+			other->PrintTo(printer);
+			printer.Print(" (about %" B_PRIdOFF " entries)\n", other->Cost());
+		} else {
+			printer.Print("    match ");
+			other->PrintTo(printer);
+			printer.Print("\n");
+		}
+	}
+}
+
+
 //	#pragma mark -
 
 
@@ -905,10 +1408,10 @@ Operator::Match(Inode* inode, const char* attribute, int32 type,
 
 		return fRight->Match(inode, attribute, type, key, size);
 	} else {
-		// choose the term with the better score for OP_OR
+		// start with the term that is more likely to match for OP_OR
 		Term* first;
 		Term* second;
-		if (fRight->Score() > fLeft->Score()) {
+		if (fRight->Cost() < fLeft->Cost()) {
 			first = fLeft;
 			second = fRight;
 		} else {
@@ -939,29 +1442,23 @@ Operator::Complement()
 
 
 void
-Operator::CalculateScore(Index &index)
+Operator::CalculateCost(Index& index, bool queryNonIndexed)
 {
-	fLeft->CalculateScore(index);
-	fRight->CalculateScore(index);
+	fLeft->CalculateCost(index, queryNonIndexed);
+	fRight->CalculateCost(index, queryNonIndexed);
 }
 
 
-int32
-Operator::Score() const
+off_t
+Operator::Cost() const
 {
 	if (fOp == OP_AND) {
-		// return the one with the better score
-		if (fRight->Score() > fLeft->Score())
-			return fRight->Score();
-
-		return fLeft->Score();
+		// only the cheaper one needs to be scanned
+		return min_c(fLeft->Cost(), fRight->Cost());
 	}
 
-	// for OP_OR, be honest, and return the one with the worse score
-	if (fRight->Score() < fLeft->Score())
-		return fRight->Score();
-
-	return fLeft->Score();
+	// for OP_OR, both have to be scanned
+	return min_c(fLeft->Cost() + fRight->Cost(), kUnusableCost);
 }
 
 
@@ -977,6 +1474,17 @@ Operator::InitCheck()
 }
 
 
+void
+Operator::PrintTo(PlanPrinter& printer)
+{
+	printer.Print("(");
+	fLeft->PrintTo(printer);
+	printer.Print(fOp == OP_AND ? " && " : " || ");
+	fRight->PrintTo(printer);
+	printer.Print(")");
+}
+
+
 #if 0
 Term*
 Operator::Copy() const
@@ -1043,16 +1551,7 @@ Operator::PrintToStream()
 void
 Equation::PrintToStream()
 {
-	const char* symbol = "???";
-	switch (fOp) {
-		case OP_EQUAL: symbol = "=="; break;
-		case OP_UNEQUAL: symbol = "!="; break;
-		case OP_GREATER_THAN: symbol = ">"; break;
-		case OP_GREATER_THAN_OR_EQUAL: symbol = ">="; break;
-		case OP_LESS_THAN: symbol = "<"; break;
-		case OP_LESS_THAN_OR_EQUAL: symbol = "<="; break;
-	}
-	__out("[\"%s\" %s \"%s\"]", fAttribute, symbol, fString);
+	__out("[\"%s\" %s \"%s\"]", fAttribute, operator_symbol(fOp), fString);
 }
 
 #endif	// DEBUG
@@ -1228,7 +1727,8 @@ Query::Query(Volume* volume, Expression* expression, uint32 flags)
 		return;
 
 	// create index on the stack and delete it afterwards
-	fExpression->Root()->CalculateScore(fIndex);
+	fExpression->Root()->CalculateCost(fIndex,
+		(fFlags & B_QUERY_NON_INDEXED) != 0);
 	fIndex.Unset();
 
 	Rewind();
@@ -1270,9 +1770,9 @@ Query::Rewind()
 				stack.Push(op->Left());
 				stack.Push(op->Right());
 			} else {
-				// For OP_AND, we can use the scoring system to decide which
-				// path to add
-				if (op->Right()->Score() > op->Left()->Score())
+				// For OP_AND, only the path with the lower cost needs to
+				// be added
+				if (op->Right()->Cost() < op->Left()->Cost())
 					stack.Push(op->Right());
 				else
 					stack.Push(op->Left());
@@ -1282,10 +1782,85 @@ Query::Rewind()
 			FATAL(("Unknown term on stack or stack error"));
 	}
 
+	_PlanFilters();
 	return B_OK;
 }
 
 
+/*!	Returns a textual description of how the query is going to be run. */
+status_t
+Query::Explain(char* buffer, size_t size)
+{
+	if (fExpression == NULL || fExpression->Root() == NULL)
+		return B_BAD_VALUE;
+
+	PlanPrinter printer(buffer, size);
+
+	// the stack is worked on from the top
+	Equation** equations = fStack.Array();
+	for (int32 i = fStack.CountItems(); i-- > 0;)
+		equations[i]->Explain(printer);
+
+	return B_OK;
+}
+
+
+/*!	Decides which of the equations that are combined with the ones on the
+	stack by &&-operators are checked against their own index rather than
+	against every inode the query comes across. That pays off when their
+	index has to be read much less than the one the query is started with.
+*/
+void
+Query::_PlanFilters()
+{
+	Equation** equations = fStack.Array();
+	int32 count = fStack.CountItems();
+
+	for (int32 pass = 0; pass < 2; pass++) {
+		for (int32 i = 0; i < count; i++) {
+			off_t cost = equations[i]->Cost();
+
+			for (Term* term = equations[i]; term->Parent() != NULL;
+					term = term->Parent()) {
+				Term* other = and_sibling(term);
+				if (other == NULL || other->Op() <= OP_EQUATION)
+					continue;
+
+				Equation* equation = (Equation*)other;
+				if (pass == 0) {
+					equation->SetUseFilter(false);
+					continue;
+				}
+
+				if (cost != kUnusableCost && equation->HasIndex()
+					&& equation->Cost() <= kMaxFilterEntries
+					&& equation->Cost() <= cost * kMaxFilterRatio)
+					equation->SetUseFilter(true);
+			}
+		}
+	}
+}
+
+
+/*!	Builds the filters of the equations that have been chosen for it in
+	_PlanFilters(), and that the current equation depends on.
+*/
+void
+Query::_BuildFilters()
+{
+	for (Term* term = fCurrent; term->Parent() != NULL;
+			term = term->Parent()) {
+		Term* other = and_sibling(term);
+		if (other == NULL || other->Op() <= OP_EQUATION)
+			continue;
+
+		Equation* equation = (Equation*)other;
+		if (equation->UsesFilter() && !equation->HasFilter())
+			equation->BuildFilter(fVolume);
+	}
+}
+
+
 status_t
 Query::GetNextEntry(struct dirent* dirent, size_t size)
 {
@@ -1306,6 +1881,8 @@ Query::GetNextEntry(struct dirent* dirent, size_t size)
 
 			if (status != B_OK)
 				return status;
+
+			_BuildFilters();
 		}
 		if (fCurrent == NULL)
 			RETURN_ERROR(B_ERROR);
@@ -1339,16 +1916,32 @@ Query::SetLiveMode(port_id port, int32 token)
 }
 
 
+/*!	Returns whether or not a change of the specified attribute can change
+	the result of this query, or has to be reported to its listener.
+*/
+bool
+Query::DependsOn(const char* attribute) const
+{
+	if (fPort < 0 || fExpression == NULL)
+		return false;
+
+	return (fFlags & B_ATTR_CHANGE_NOTIFICATION) != 0
+		|| fExpression->Root()->DependsOn(attribute);
+}
+
+
+/*!	Evaluates the query for the old and the new value of the attribute,
+	and queues the notifications for its listener with the volume.
+	You must hold the volume's query lock when calling this method.
+*/
 void
 Query::LiveUpdate(Inode* inode, const char* attribute, int32 type,
 	const uint8* oldKey, size_t oldLength, const uint8* newKey,
 	size_t newLength)
 {
-	if (fPort < 0 || fExpression == NULL || attribute == NULL)
+	if (attribute == NULL || !DependsOn(attribute))
 		return;
 
-	// TODO: check if the attribute is part of the query at all...
-
 	status_t oldStatus = fExpression->Root()->Match(inode, attribute, type,
 		oldKey, oldLength);
 	status_t newStatus = fExpression->Root()->Match(inode, attribute, type,
@@ -1382,22 +1975,25 @@ Query::LiveUpdate(Inode* inode, const char* attribute, int32 type,
 			nameBuffer[0] = '\0';
 		name = nameBuffer;
 	} else {
-		// a shortcut to prevent having to scan the attribute section
-		name = (const char*)newKey;
+		// a shortcut to prevent having to scan the attribute section; when
+		// the entry is removed, there is only the old name left
+		name = (const char*)(newKey != NULL ? newKey : oldKey);
+		if (name == NULL)
+			return;
 	}
 
 	// notify query listeners
 
-	if (stillInQuery) {
-		notify_query_attr_changed(fPort, fToken, fVolume->ID(),
-			fVolume->ToVnode(inode->Parent()), name, inode->ID());
-	} else if (entryCreated) {
-		notify_query_entry_created(fPort, fToken, fVolume->ID(),
-			fVolume->ToVnode(inode->Parent()), name, inode->ID());
-	} else {
-		notify_query_entry_removed(fPort, fToken, fVolume->ID(),
-			fVolume->ToVnode(inode->Parent()), name, inode->ID());
-	}
+	int32 opcode;
+	if (stillInQuery)
+		opcode = B_ATTR_CHANGED;
+	else if (entryCreated)
+		opcode = B_ENTRY_CREATED;
+	else
+		opcode = B_ENTRY_REMOVED;
+
+	fVolume->NotifyQuery(this, opcode, fVolume->ToVnode(inode->Parent()),
+		name, inode->ID());
 }
 
 
@@ -1422,9 +2018,8 @@ Query::LiveUpdateRenameMove(Inode* inode, ino_t oldDirectoryID,
 	// The entry stays in the query, notify query listeners about the rename
 	// or move
 
-	notify_query_entry_removed(fPort, fToken, fVolume->ID(),
-		oldDirectoryID, oldName, inode->ID());
-
-	notify_query_entry_created(fPort, fToken, fVolume->ID(),
-		newDirectoryID, newName, inode->ID());
+	fVolume->NotifyQuery(this, B_ENTRY_REMOVED, oldDirectoryID, oldName,
+		inode->ID());
+	fVolume->NotifyQuery(this, B_ENTRY_CREATED, newDirectoryID, newName,
+		inode->ID());
 }
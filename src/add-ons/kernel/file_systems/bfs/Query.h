@@ -50,8 +50,12 @@ public:
 
 			status_t		Rewind();
 			status_t		GetNextEntry(struct dirent* , size_t size);
+			status_t		Explain(char* buffer, size_t size);
 
 			void			SetLiveMode(port_id port, int32 token);
+			port_id			Port() const { return fPort; }
+			int32			Token() const { return fToken; }
+			bool			DependsOn(const char* attribute) const;
 			void			LiveUpdate(Inode* inode, const char* attribute,
 								int32 type, const uint8* oldKey,
 								size_t oldLength, const uint8* newKey,
@@ -63,6 +67,10 @@ public:
 
 			Expression*		GetExpression() const { return fExpression; }
 
+private:
+			void			_PlanFilters();
+			void			_BuildFilters();
+
 private:
 			Volume*			fVolume;
 			Expression*		fExpression;
@@ -26,6 +26,35 @@ static const int32 kDesiredAllocationGroups = 56;
 	// file on a 1 GB disk without the need for double indirect
 	// blocks).
 
+static const bigtime_t kQueryNotificationDelay = 50000;
+	// Live query notifications are collected for this long before they
+	// are sent, so that they are sent in batches, and changes that cancel
+	// each other out never reach the listeners.
+static const int32 kMaxQueryNotificationLookBack = 64;
+	// The number of pending notifications that are searched for one that
+	// can be merged with a new notification.
+
+
+static void
+send_query_notification(dev_t device, port_id port, int32 token, int32 opcode,
+	ino_t directory, const char* name, ino_t node)
+{
+	switch (opcode) {
+		case B_ENTRY_CREATED:
+			notify_query_entry_created(port, token, device, directory, name,
+				node);
+			break;
+		case B_ENTRY_REMOVED:
+			notify_query_entry_removed(port, token, device, directory, name,
+				node);
+			break;
+		case B_ATTR_CHANGED:
+			notify_query_attr_changed(port, token, device, directory, name,
+				node);
+			break;
+	}
+}
+
 
 class DeviceOpener {
 public:
@@ -281,16 +310,40 @@ Volume::Volume(fs_volume* volume)
 	fRootNode(NULL),
 	fIndicesNode(NULL),
 	fDirtyCachedBlocks(0),
+	fQueryNotifierThread(-1),
+	fTerminating(false),
 	fFlags(0),
 	fCheckingThread(-1)
 {
 	mutex_init(&fLock, "bfs volume");
 	mutex_init(&fQueryLock, "bfs queries");
+
+	// Without the notifier thread (if it cannot be spawned), the
+	// notifications are sent right after the queries have been updated.
+	fQueryNotifierSem = create_sem(0, "bfs query notifier");
+	if (fQueryNotifierSem >= 0) {
+		fQueryNotifierThread = spawn_kernel_thread(&Volume::_QueryNotifier,
+			"bfs query notifier", B_NORMAL_PRIORITY, this);
+		if (fQueryNotifierThread >= 0)
+			resume_thread(fQueryNotifierThread);
+	}
 }
 
 
 Volume::~Volume()
 {
+	if (fQueryNotifierThread >= 0) {
+		fTerminating = true;
+		release_sem(fQueryNotifierSem);
+
+		status_t result;
+		wait_for_thread(fQueryNotifierThread, &result);
+	}
+	if (fQueryNotifierSem >= 0)
+		delete_sem(fQueryNotifierSem);
+
+	_SendQueryNotifications();
+
 	mutex_destroy(&fQueryLock);
 	mutex_destroy(&fLock);
 }
@@ -348,6 +401,12 @@ Volume::Mount(const char* deviceName, uint32 flags)
 		return B_BAD_VALUE;
 	}
 
+	if ((fSuperBlock.Features() & ~SUPER_BLOCK_KNOWN_FEATURES) != 0) {
+		FATAL(("unknown features %#" B_PRIx32 ", volume read-only.\n",
+			fSuperBlock.Features() & ~SUPER_BLOCK_KNOWN_FEATURES));
+		fFlags |= VOLUME_READ_ONLY;
+	}
+
 	// initialize short hands to the superblock (to save byte swapping)
 	fBlockSize = fSuperBlock.BlockSize();
 	fBlockShift = fSuperBlock.BlockShift();
@@ -545,6 +604,17 @@ Volume::AllocateForInode(Transaction& transaction, const Inode* parent,
 }
 
 
+/*!	Returns whether or not the current thread is checking the volume; this
+	includes the threads the block allocator uses for parallel checks.
+*/
+bool
+Volume::IsCheckingThread() const
+{
+	thread_id thread = find_thread(NULL);
+	return thread == fCheckingThread || fBlockAllocator.IsCheckThread(thread);
+}
+
+
 status_t
 Volume::WriteSuperBlock()
 {
@@ -556,12 +626,31 @@ Volume::WriteSuperBlock()
 }
 
 
+/*!	Evaluates the live queries for a change of the \a attribute of \a inode,
+	and queues the resulting notifications (see NotifyQuery()).
+
+	Only sending the notifications is deferred to the query notifier thread;
+	the queries themselves have to be evaluated right here, while the
+	caller's transaction still holds the inode:
+	- Besides the old and new key, a query may depend on any other
+	  attribute of the inode. Those are only consistent with the change
+	  as long as the inode is locked in the transaction; evaluated later,
+	  the queries would see the state after subsequent changes, and report
+	  entries entering or leaving a query in states that never existed.
+	- The inode cannot be referenced until then: Inode::Create() updates
+	  the indices before the vnode is published, and remove_vnode() frees
+	  an unpublished vnode regardless of its references. Likewise, the
+	  indices are updated from bfs_remove_vnode() when the last reference
+	  is already gone.
+	Queries that don't depend on the attribute are skipped cheaply, so
+	only the changes that are of interest to a live query pay for this.
+*/
 void
 Volume::UpdateLiveQueries(Inode* inode, const char* attribute, int32 type,
 	const uint8* oldKey, size_t oldLength, const uint8* newKey,
 	size_t newLength)
 {
-	MutexLocker _(fQueryLock);
+	MutexLocker locker(fQueryLock);
 
 	SinglyLinkedList<Query>::Iterator iterator = fQueries.GetIterator();
 	while (iterator.HasNext()) {
@@ -569,6 +658,11 @@ Volume::UpdateLiveQueries(Inode* inode, const char* attribute, int32 type,
 		query->LiveUpdate(inode, attribute, type, oldKey, oldLength, newKey,
 			newLength);
 	}
+
+	locker.Unlock();
+
+	if (fQueryNotifierThread < 0)
+		_SendQueryNotifications();
 }
 
 
@@ -576,7 +670,7 @@ void
 Volume::UpdateLiveQueriesRenameMove(Inode* inode, ino_t oldDirectoryID,
 	const char* oldName, ino_t newDirectoryID, const char* newName)
 {
-	MutexLocker _(fQueryLock);
+	MutexLocker locker(fQueryLock);
 
 	size_t oldLength = strlen(oldName);
 	size_t newLength = strlen(newName);
@@ -587,6 +681,11 @@ Volume::UpdateLiveQueriesRenameMove(Inode* inode, ino_t oldDirectoryID,
 		query->LiveUpdateRenameMove(inode, oldDirectoryID, oldName, oldLength,
 			newDirectoryID, newName, newLength);
 	}
+
+	locker.Unlock();
+
+	if (fQueryNotifierThread < 0)
+		_SendQueryNotifications();
 }
 
 
@@ -598,8 +697,15 @@ Volume::UpdateLiveQueriesRenameMove(Inode* inode, ino_t oldDirectoryID,
 bool
 Volume::CheckForLiveQuery(const char* attribute)
 {
-	// TODO: check for a live query that depends on the specified attribute
-	return true;
+	MutexLocker _(fQueryLock);
+
+	SinglyLinkedList<Query>::Iterator iterator = fQueries.GetIterator();
+	while (iterator.HasNext()) {
+		if (iterator.Next()->DependsOn(attribute))
+			return true;
+	}
+
+	return false;
 }
 
 
@@ -616,6 +722,130 @@ Volume::RemoveQuery(Query* query)
 {
 	MutexLocker _(fQueryLock);
 	fQueries.Remove(query);
+
+	// drop the notifications that have not been sent yet
+	query_notification* notification = fQueryNotifications.First();
+	while (notification != NULL) {
+		query_notification* next = fQueryNotifications.GetNext(notification);
+		if (notification->query == query) {
+			fQueryNotifications.Remove(notification);
+			delete notification;
+		}
+		notification = next;
+	}
+}
+
+
+/*!	Queues a notification for the listener of a live query; they are sent
+	in batches by the query notifier thread, outside of the transaction
+	that caused them.
+	The query lock must be held when calling this method.
+*/
+void
+Volume::NotifyQuery(Query* query, int32 opcode, ino_t directory,
+	const char* name, ino_t node)
+{
+	ASSERT_LOCKED_MUTEX(&fQueryLock);
+
+	if (_CoalesceQueryNotification(query, opcode, directory, name, node))
+		return;
+
+	query_notification* notification
+		= new(std::nothrow) query_notification;
+	if (notification == NULL) {
+		// send it right away, then
+		send_query_notification(ID(), query->Port(), query->Token(), opcode,
+			directory, name, node);
+		return;
+	}
+
+	notification->query = query;
+	notification->port = query->Port();
+	notification->token = query->Token();
+	notification->opcode = opcode;
+	notification->directory = directory;
+	notification->node = node;
+	strlcpy(notification->name, name, sizeof(notification->name));
+
+	bool wasEmpty = fQueryNotifications.IsEmpty();
+	fQueryNotifications.Add(notification);
+
+	if (wasEmpty && fQueryNotifierThread >= 0)
+		release_sem_etc(fQueryNotifierSem, 1, B_DO_NOT_RESCHEDULE);
+}
+
+
+/*!	Merges the new notification with a pending one for the same entry, if
+	possible. An entry that is added, and then removed again (or the other
+	way around), does not change the result of the query at all, and an
+	attribute change does not need to be reported for an entry that is
+	added anyway, or twice.
+	A pending attribute change is always kept, though: if the entry is
+	removed, and then added again, the listeners would miss it otherwise.
+	Returns \c true if the new notification does not need to be queued
+	anymore.
+*/
+bool
+Volume::_CoalesceQueryNotification(Query* query, int32 opcode,
+	ino_t directory, const char* name, ino_t node)
+{
+	query_notification* pending = fQueryNotifications.Last();
+	for (int32 i = 0; pending != NULL && i < kMaxQueryNotificationLookBack;
+			i++, pending = fQueryNotifications.GetPrevious(pending)) {
+		if (pending->query != query || pending->node != node
+			|| pending->directory != directory
+			|| strcmp(pending->name, name) != 0)
+			continue;
+
+		if (opcode == B_ATTR_CHANGED || pending->opcode == opcode)
+			return true;
+		if (pending->opcode == B_ATTR_CHANGED)
+			return false;
+
+		// The new notification cancels out the pending one
+		fQueryNotifications.Remove(pending);
+		delete pending;
+		return true;
+	}
+
+	return false;
+}
+
+
+void
+Volume::_SendQueryNotifications()
+{
+	QueryNotificationList notifications;
+
+	MutexLocker locker(fQueryLock);
+	notifications.MoveFrom(&fQueryNotifications);
+	locker.Unlock();
+
+	while (query_notification* notification = notifications.RemoveHead()) {
+		send_query_notification(ID(), notification->port,
+			notification->token, notification->opcode,
+			notification->directory, notification->name, notification->node);
+		delete notification;
+	}
+}
+
+
+/*static*/ status_t
+Volume::_QueryNotifier(void* _volume)
+{
+	Volume* volume = (Volume*)_volume;
+
+	while (true) {
+		status_t status = acquire_sem(volume->fQueryNotifierSem);
+		if (status != B_OK || volume->fTerminating)
+			break;
+
+		// collect the notifications of some more changes before sending
+		snooze(kQueryNotificationDelay);
+		volume->_SendQueryNotifications();
+	}
+
+	return B_OK;
 }
 
 
@@ -696,6 +926,13 @@ Volume::Initialize(int fd, const char* name, uint32 blockSize,
 
 	fSuperBlock.Initialize(name, numBlocks, blockSize);
 
+	uint32 features = 0;
+	if ((flags & VOLUME_EXTENTS) != 0)
+		features |= SUPER_BLOCK_FEATURE_EXTENTS;
+	if ((flags & VOLUME_INLINE_DATA) != 0)
+		features |= SUPER_BLOCK_FEATURE_INLINE_DATA;
+	fSuperBlock.features = HOST_ENDIAN_TO_BFS_INT32(features);
+
 	// initialize short hands to the superblock (to save byte swapping)
 	fBlockSize = fSuperBlock.BlockSize();
 	fBlockShift = fSuperBlock.BlockShift();
@@ -23,11 +23,27 @@ enum volume_flags {
 
 enum volume_initialize_flags {
 	VOLUME_NO_INDICES	= 0x0001,
+	VOLUME_EXTENTS		= 0x0002,
+	VOLUME_INLINE_DATA	= 0x0004,
 };
 
 typedef DoublyLinkedList<Inode> InodeList;
 
 
+struct query_notification
+	: DoublyLinkedListLinkImpl<query_notification> {
+	Query*			query;
+	port_id			port;
+	int32			token;
+	int32			opcode;
+	ino_t			directory;
+	ino_t			node;
+	char			name[B_FILE_NAME_LENGTH];
+};
+
+typedef DoublyLinkedList<query_notification> QueryNotificationList;
+
+
 class Volume {
 public:
 							Volume(fs_volume* volume);
@@ -43,6 +59,12 @@ public:
 			bool			IsValidSuperBlock() const;
 			bool			IsValidInodeBlock(off_t block) const;
 			bool			IsReadOnly() const;
+			bool			HasExtents() const
+								{ return (fSuperBlock.Features()
+									& SUPER_BLOCK_FEATURE_EXTENTS) != 0; }
+			bool			HasInlineData() const
+								{ return (fSuperBlock.Features()
+									& SUPER_BLOCK_FEATURE_INLINE_DATA) != 0; }
 			void			Panic();
 			mutex&			Lock();
 
@@ -112,8 +134,7 @@ public:
 			status_t		Free(Transaction& transaction, block_run run);
 			void			SetCheckingThread(thread_id thread)
 								{ fCheckingThread = thread; }
-			bool			IsCheckingThread() const
-								{ return find_thread(NULL) == fCheckingThread; }
+			bool			IsCheckingThread() const;
 
 			// cache access
 			status_t		WriteSuperBlock();
@@ -131,6 +152,9 @@ public:
 			bool			CheckForLiveQuery(const char* attribute);
 			void			AddQuery(Query* query);
 			void			RemoveQuery(Query* query);
+			void			NotifyQuery(Query* query, int32 opcode,
+								ino_t directory, const char* name,
+								ino_t node);
 
 			status_t		Sync();
 			Journal*		GetJournal(off_t refBlock) const;
@@ -144,6 +168,12 @@ public:
 private:
 			status_t		_EraseUnusedBootBlock();
 
+			bool			_CoalesceQueryNotification(Query* query,
+								int32 opcode, ino_t directory,
+								const char* name, ino_t node);
+			void			_SendQueryNotifications();
+	static	status_t		_QueryNotifier(void* _volume);
+
 protected:
 			fs_volume*		fVolume;
 			int				fDevice;
@@ -167,6 +197,10 @@ protected:
 
 			mutex			fQueryLock;
 			SinglyLinkedList<Query> fQueries;
+			QueryNotificationList fQueryNotifications;
+			sem_id			fQueryNotifierSem;
+			thread_id		fQueryNotifierThread;
+			bool			fTerminating;
 
 			uint32			fFlags;
 
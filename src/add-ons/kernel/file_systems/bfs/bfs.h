@@ -76,7 +76,8 @@ struct disk_super_block {
 	int32		magic3;
 	inode_addr	root_dir;
 	inode_addr	indices;
-	int32		_reserved[8];
+	uint32		features;
+	int32		_reserved[7];
 	int32		pad_to_block[87];
 		// this also contains parts of the boot block
 
@@ -95,6 +96,7 @@ struct disk_super_block {
 	int32 AllocationGroupShift() const
 		{ return BFS_ENDIAN_TO_HOST_INT32(ag_shift); }
 	int32 Flags() const { return BFS_ENDIAN_TO_HOST_INT32(flags); }
+	uint32 Features() const { return BFS_ENDIAN_TO_HOST_INT32(features); }
 	off_t LogStart() const { return BFS_ENDIAN_TO_HOST_INT64(log_start); }
 	off_t LogEnd() const { return BFS_ENDIAN_TO_HOST_INT64(log_end); }
 
@@ -112,6 +114,12 @@ struct disk_super_block {
 #define SUPER_BLOCK_DISK_CLEAN		'CLEN'		/* CLEN */
 #define SUPER_BLOCK_DISK_DIRTY		'DIRT'		/* DIRT */
 
+// features that change the on-disk format
+#define SUPER_BLOCK_FEATURE_EXTENTS		0x00000001	// see INODE_EXTENTS
+#define SUPER_BLOCK_FEATURE_INLINE_DATA	0x00000002	// see INODE_INLINE_DATA
+#define SUPER_BLOCK_KNOWN_FEATURES \
+	(SUPER_BLOCK_FEATURE_EXTENTS | SUPER_BLOCK_FEATURE_INLINE_DATA)
+
 //**************************************
 
 #define NUM_DIRECT_BLOCKS			12
@@ -140,6 +148,69 @@ struct data_stream {
 #define NUM_ARRAY_BLOCKS			4
 #define DOUBLE_INDIRECT_ARRAY_SIZE	4096
 
+// Inodes with the INODE_EXTENTS flag use an extent_stream instead of the
+// data_stream: a tree of extents that can cover any number of contiguous
+// blocks, even across allocation group borders. Its root is stored in the
+// inode, all other nodes use a single block each. Offsets and lengths are
+// in blocks.
+
+#define EXTENT_HEADER_MAGIC			0xe7e5
+#define NUM_INODE_EXTENTS			5
+#define MAX_EXTENT_TREE_DEPTH		8
+
+struct extent_header {
+	uint16		magic;
+	uint16		count;
+	uint16		max_count;
+	uint16		depth;
+		// zero for leaves, the entries of other nodes point to their children
+
+	uint16 Magic() const { return BFS_ENDIAN_TO_HOST_INT16(magic); }
+	uint16 Count() const { return BFS_ENDIAN_TO_HOST_INT16(count); }
+	uint16 MaxCount() const { return BFS_ENDIAN_TO_HOST_INT16(max_count); }
+	uint16 Depth() const { return BFS_ENDIAN_TO_HOST_INT16(depth); }
+
+	inline bool IsValid(uint16 maxCount) const;
+} _PACKED;
+
+struct stream_extent {
+	int64		offset;
+		// in the file
+	int64		start;
+		// on disk, or the block of the child node
+	int64		length;
+		// unused for the entries of inner nodes
+
+	off_t Offset() const { return BFS_ENDIAN_TO_HOST_INT64(offset); }
+	off_t Start() const { return BFS_ENDIAN_TO_HOST_INT64(start); }
+	off_t Length() const { return BFS_ENDIAN_TO_HOST_INT64(length); }
+	off_t End() const { return Offset() + Length(); }
+} _PACKED;
+
+struct extent_node {
+	extent_header	header;
+	stream_extent	extents[0];
+
+	static uint16 MaxCount(uint32 blockSize)
+		{ return (blockSize - sizeof(extent_header))
+			/ sizeof(stream_extent); }
+} _PACKED;
+
+struct extent_stream {
+	extent_header	header;
+	stream_extent	extents[NUM_INODE_EXTENTS];
+	int64		max_range;
+		// the allocated size of the stream, in bytes
+	int64		size;
+		// shares its position with data_stream::size
+
+	off_t MaxRange() const { return BFS_ENDIAN_TO_HOST_INT64(max_range); }
+	off_t Size() const { return BFS_ENDIAN_TO_HOST_INT64(size); }
+} _PACKED;
+
+inline int32 find_extent(const stream_extent* extents, uint16 count,
+	off_t offset);
+
 //**************************************
 
 struct bfs_inode;
@@ -171,6 +242,11 @@ struct small_data {
 #define FILE_NAME_NAME			0x13
 #define FILE_NAME_NAME_LENGTH	1
 
+// so is the data of small files (see INODE_INLINE_DATA)
+#define INLINE_DATA_TYPE		'RAWT'
+#define INLINE_DATA_NAME		0x14
+#define INLINE_DATA_NAME_LENGTH	1
+
 
 //**************************************
 
@@ -204,6 +280,8 @@ struct bfs_inode {
 
 	union {
 		data_stream		data;
+		extent_stream	extent_data;
+			// if INODE_EXTENTS is set
 		char 			short_symlink[SHORT_SYMLINK_NAME_LENGTH];
 	};
 	bigtime_t	status_change_time;
@@ -253,6 +331,8 @@ enum inode_flags {
 	INODE_DELETED			= 0x00000010,
 	INODE_NOT_READY			= 0x00000020,	// used during Inode construction
 	INODE_LONG_SYMLINK		= 0x00000040,	// symlink in data stream
+	INODE_INLINE_DATA		= 0x00000080,	// data in small_data section
+	INODE_EXTENTS			= 0x00000100,	// uses an extent_stream
 
 	INODE_PERMANENT_FLAGS	= 0x0000ffff,
 
@@ -355,6 +435,38 @@ block_run::Run(int32 group, uint16 start, uint16 length)
 }
 
 
+//	#pragma mark - extent inline functions
+
+
+inline bool
+extent_header::IsValid(uint16 maxCount) const
+{
+	return Magic() == EXTENT_HEADER_MAGIC && MaxCount() == maxCount
+		&& Count() <= maxCount && Depth() < MAX_EXTENT_TREE_DEPTH;
+}
+
+
+/*!	Returns the index of the last of the \a count sorted \a extents that
+	starts at or before \a offset, or -1 if there is none.
+*/
+inline int32
+find_extent(const stream_extent* extents, uint16 count, off_t offset)
+{
+	int32 first = 0;
+	int32 last = (int32)count - 1;
+
+	while (first <= last) {
+		int32 middle = (first + last) / 2;
+		if (extents[middle].Offset() <= offset)
+			first = middle + 1;
+		else
+			last = middle - 1;
+	}
+
+	return last;
+}
+
+
 //	#pragma mark - small_data inline functions
 
 
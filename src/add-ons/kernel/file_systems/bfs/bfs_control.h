@@ -29,6 +29,26 @@ struct update_boot_block {
 	uint32			length;
 };
 
+/* ioctl to change the size of the log area - parameter is a uint32 *
+ * with the new size in blocks. The log can only grow if the blocks following
+ * it are unused.
+ */
+#define BFS_IOCTL_RESIZE_LOG		14205
+
+/* ioctl to find out how a query would be run - parameter is a
+ * struct explain_query. The plan is returned as null terminated text with
+ * one line per step, and is truncated if it doesn't fit into the buffer.
+ */
+#define BFS_IOCTL_EXPLAIN_QUERY		14206
+
+struct explain_query {
+	const char*		query;
+	uint32			query_length;
+	uint32			flags;
+	char*			plan;
+	uint32			plan_size;
+};
+
 /* ioctls to use the "chkbfs" feature from the outside
  * all calls use a struct check_result as single parameter
  */
@@ -84,6 +104,16 @@ struct check_control {
 	 */
 #define BFS_FIX_NAME_MISMATCHES	8
 #define BFS_FIX_BPLUSTREES		16
+#define BFS_CHECK_PARALLEL		32
+	/* checks the nodes with several threads at once, and reports them in
+	 * no particular order. This is only done if no errors are to be fixed.
+	 */
+#define BFS_CHECK_READ_ONLY		64
+	/* checks a volume while it is in use, without blocking any writers.
+	 * No errors are fixed, and since the blocks of a node can only be
+	 * compared with the block bitmap, not with those of other nodes, the
+	 * "already_set", and "freed" stats are not filled in.
+	 */
 
 /* values for the errors field */
 #define BFS_MISSING_BLOCKS		1
@@ -11,6 +11,7 @@
 #include "Volume.h"
 #include "Inode.h"
 #include "Index.h"
+#include "NameTrigrams.h"
 #include "BPlusTree.h"
 #include "Query.h"
 #include "Attribute.h"
@@ -107,6 +108,89 @@ iterative_io_finished_hook(void* cookie, io_request* request, status_t status,
 }
 
 
+/*!	Inline data has no file map; before the data can be accessed via
+	the file cache I/O hooks, it has to be moved into a data stream.
+*/
+static status_t
+prepare_file_map_access(Volume* volume, Inode* inode)
+{
+	if (!inode->HasInlineData())
+		return B_OK;
+	if (volume->IsReadOnly())
+		return B_NOT_SUPPORTED;
+
+	return inode->PromoteInlineData();
+}
+
+
+#ifndef FS_SHELL
+//!	Serves a read request on a read-only volume from the inline data.
+static status_t
+read_inline_data(Inode* inode, io_request* request)
+{
+	size_t length = io_request_length(request);
+	uint8* buffer = (uint8*)malloc(length);
+	if (buffer == NULL) {
+		notify_io_request(request, B_NO_MEMORY);
+		return B_NO_MEMORY;
+	}
+	MemoryDeleter bufferDeleter(buffer);
+
+	memset(buffer, 0, length);
+
+	size_t bytesRead = length;
+	status_t status = inode->ReadAt(io_request_offset(request), buffer,
+		&bytesRead);
+	if (status == B_OK)
+		status = write_to_io_request(request, buffer, length);
+
+	notify_io_request(request, status);
+	return status;
+}
+#endif
+
+
+static const uint32 kMaxExplainLength = 65536;
+	// for both the query, and the plan of a BFS_IOCTL_EXPLAIN_QUERY
+
+
+//!	Serves a BFS_IOCTL_EXPLAIN_QUERY request.
+static status_t
+explain_query_plan(Volume* volume, const explain_query& explain)
+{
+	char* queryString = (char*)malloc(explain.query_length + 1);
+	if (queryString == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter queryDeleter(queryString);
+
+	if (user_memcpy(queryString, explain.query, explain.query_length)
+			!= B_OK)
+		return B_BAD_ADDRESS;
+	queryString[explain.query_length] = '\0';
+
+	Expression expression(queryString);
+	if (expression.InitCheck() != B_OK)
+		return B_BAD_VALUE;
+
+	uint32 size = min_c(explain.plan_size, kMaxExplainLength);
+	char* plan = (char*)malloc(size);
+	if (plan == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter planDeleter(plan);
+
+	// the query is never run, so it can't be a live query
+	Query query(volume, &expression, explain.flags & B_QUERY_NON_INDEXED);
+	status_t status = query.Explain(plan, size);
+	if (status != B_OK)
+		return status;
+
+	if (user_memcpy(explain.plan, plan, strlen(plan) + 1) != B_OK)
+		return B_BAD_ADDRESS;
+
+	return B_OK;
+}
+
+
 //	#pragma mark - Scanning
 
 
@@ -404,12 +488,15 @@ bfs_read_pages(fs_volume* _volume, fs_vnode* _node, void* _cookie,
 	if (inode->FileCache() == NULL)
 		RETURN_ERROR(B_BAD_VALUE);
 
+	status_t status = prepare_file_map_access(volume, inode);
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
 	InodeReadLocker _(inode);
 
 	uint32 vecIndex = 0;
 	size_t vecOffset = 0;
 	size_t bytesLeft = *_numBytes;
-	status_t status;
 
 	while (true) {
 		file_io_vec fileVecs[8];
@@ -449,12 +536,15 @@ bfs_write_pages(fs_volume* _volume, fs_vnode* _node, void* _cookie,
 	if (inode->FileCache() == NULL)
 		RETURN_ERROR(B_BAD_VALUE);
 
+	status_t status = prepare_file_map_access(volume, inode);
+	if (status != B_OK)
+		RETURN_ERROR(status);
+
 	InodeReadLocker _(inode);
 
 	uint32 vecIndex = 0;
 	size_t vecOffset = 0;
 	size_t bytesLeft = *_numBytes;
-	status_t status;
 
 	while (true) {
 		file_io_vec fileVecs[8];
@@ -501,6 +591,19 @@ bfs_io(fs_volume* _volume, fs_vnode* _node, void* _cookie, io_request* request)
 		RETURN_ERROR(B_BAD_VALUE);
 	}
 
+#ifndef FS_SHELL
+	if (inode->HasInlineData() && volume->IsReadOnly())
+		return read_inline_data(inode, request);
+#endif
+
+	status_t status = prepare_file_map_access(volume, inode);
+	if (status != B_OK) {
+#ifndef FS_SHELL
+		notify_io_request(request, status);
+#endif
+		RETURN_ERROR(status);
+	}
+
 	// We lock the node here and will unlock it in the "finished" hook.
 	rw_lock_read_lock(&inode->Lock());
 
@@ -518,19 +621,19 @@ bfs_get_file_map(fs_volume* _volume, fs_vnode* _node, off_t offset, size_t size,
 
 	int32 blockShift = volume->BlockShift();
 	uint32 index = 0, max = *_count;
-	block_run run;
+	off_t block;
+	off_t length;
 	off_t fileOffset;
 
 	//FUNCTION_START(("offset = %Ld, size = %lu\n", offset, size));
 
 	while (true) {
-		status_t status = inode->FindBlockRun(offset, run, fileOffset);
+		status_t status = inode->FindExtent(offset, block, length, fileOffset);
 		if (status != B_OK)
 			return status;
 
-		vecs[index].offset = volume->ToOffset(run) + offset - fileOffset;
-		vecs[index].length = ((uint32)run.Length() << blockShift)
-			- offset + fileOffset;
+		vecs[index].offset = (block << blockShift) + offset - fileOffset;
+		vecs[index].length = (length << blockShift) - offset + fileOffset;
 
 		// are we already done?
 		if ((uint64)size <= (uint64)vecs[index].length
@@ -587,6 +690,8 @@ bfs_lookup(fs_volume* _volume, fs_vnode* _directory, const char* file,
 	status = tree->Find((uint8*)file, (uint16)strlen(file), _vnodeID);
 	if (status != B_OK) {
 		//PRINT(("bfs_walk() could not find %Ld:\"%s\": %s\n", directory->BlockNumber(), file, strerror(status)));
+		if (status == B_ENTRY_NOT_FOUND)
+			entry_cache_add_missing(volume->ID(), directory->ID(), file);
 		return status;
 	}
 
@@ -719,6 +824,29 @@ bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 
 			return volume->WriteSuperBlock();
 		}
+		case BFS_IOCTL_RESIZE_LOG:
+		{
+			uint32 length;
+			if (bufferLength != sizeof(uint32))
+				return B_BAD_VALUE;
+			if (user_memcpy(&length, buffer, sizeof(uint32)) != B_OK)
+				return B_BAD_ADDRESS;
+
+			return volume->GetJournal(0)->ResizeLog(length);
+		}
+		case BFS_IOCTL_EXPLAIN_QUERY:
+		{
+			explain_query explain;
+			if (bufferLength != sizeof(explain_query))
+				return B_BAD_VALUE;
+			if (user_memcpy(&explain, buffer, sizeof(explain_query)) != B_OK)
+				return B_BAD_ADDRESS;
+			if (explain.query_length > kMaxExplainLength
+				|| explain.plan_size == 0)
+				return B_BAD_VALUE;
+
+			return explain_query_plan(volume, explain);
+		}
 
 #ifdef DEBUG_FRAGMENTER
 		case 56741:
@@ -777,8 +905,15 @@ bfs_fsync(fs_volume* _volume, fs_vnode* _node)
 {
 	FUNCTION();
 
+	Volume* volume = (Volume*)_volume->private_volume;
 	Inode* inode = (Inode*)_node->private_node;
-	return inode->Sync();
+
+	status_t status = inode->Sync();
+	if (status != B_OK)
+		return status;
+
+	// make sure the inode's metadata changes are on disk, too
+	return volume->GetJournal(0)->Commit();
 }
 
 
@@ -1022,6 +1157,8 @@ bfs_create_symlink(fs_volume* _volume, fs_vnode* _directory, const char* name,
 	} else {
 		link->Node().flags |= HOST_ENDIAN_TO_BFS_INT32(INODE_LONG_SYMLINK
 			| INODE_LOGGED);
+		if (volume->HasInlineData())
+			link->Node().flags |= HOST_ENDIAN_TO_BFS_INT32(INODE_INLINE_DATA);
 
 		// links usually don't have a file cache attached - but we now need one
 		link->SetFileCache(file_cache_create(volume->ID(), link->ID(), 0));
@@ -2121,6 +2258,21 @@ bfs_create_index(fs_volume* _volume, const char* name, uint32 type,
 	if (status == B_OK)
 		status = transaction.Done();
 
+	if (status == B_OK && !strcmp(name, kNameTrigramIndex)
+		&& index.Type() == B_STRING_TYPE) {
+		// unlike other indices, this one can be filled right away
+		status = index.FillNameTrigrams();
+		if (status != B_OK) {
+			// an incomplete index would let queries miss files
+			index.Unset();
+
+			if (transaction.Start(volume,
+					volume->ToBlock(volume->Indices())) == B_OK
+				&& volume->IndicesNode()->Remove(transaction, name) == B_OK)
+				transaction.Done();
+		}
+	}
+
 	RETURN_ERROR(status);
 }
 
@@ -8,6 +8,7 @@
 
 #ifdef FS_SHELL
 
+#include <algorithm>
 #include <new>
 
 #include "fssh_api_wrapper.h"
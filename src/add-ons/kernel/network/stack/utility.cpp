@@ -15,6 +15,7 @@
 #include <condition_variable.h>
 #include <net_buffer.h>
 #include <syscall_restart.h>
+#include <thread.h>
 #include <util/AutoLock.h>
 
 #include "stack_private.h"
@@ -459,6 +460,10 @@ fifo_socket_enqueue_buffer(net_fifo* fifo, net_socket* socket, uint8 event,
 static status_t
 timer_thread(void* /*data*/)
 {
+	// None of the network timers need to be exact, so let the timeouts of
+	// this thread be coalesced with other timers.
+	thread_set_timer_slack(1000);
+
 	status_t status = B_OK;
 
 	do {
@@ -820,7 +820,7 @@ thread_popup(void *arg)
 
 	// Scheduler modes
 	static const char* schedulerModes[] = { B_TRANSLATE_MARK("Low latency"),
-		B_TRANSLATE_MARK("Power saving") };
+		B_TRANSLATE_MARK("Power saving"), B_TRANSLATE_MARK("Throughput") };
 	unsigned int modesCount = sizeof(schedulerModes) / sizeof(const char*);
 	int32 currentMode = get_scheduler_mode();
 	for (unsigned int i = 0; i < modesCount; i++) {
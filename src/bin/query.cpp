@@ -13,6 +13,7 @@
  */
 
 
+#include <Directory.h>
 #include <Entry.h>
 #include <LocaleRoster.h>
 #include <Path.h>
@@ -21,11 +22,15 @@
 #include <Volume.h>
 #include <VolumeRoster.h>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "bfs_control.h"
+
 
 extern const char *__progname;
 static const char *kProgramName = __progname;
@@ -35,15 +40,18 @@ static bool sAllVolumes = false;		// Query all volumes?
 static bool sEscapeMetaChars = true;	// Escape metacharacters?
 static bool sFilesOnly = false;			// Show only files?
 static bool sLocalizedAppNames = false;	// match localized names
+static bool sExplain = false;			// Show the query plan only?
 
 
 void
 usage(void)
 {
-	printf("usage: %s [ -ef ] [ -a || -v <path-to-volume> ] expression\n"
+	printf("usage: %s [ -efx ] [ -a || -v <path-to-volume> ] expression\n"
 		"  -e\t\tdon't escape meta-characters\n"
 		"  -f\t\tshow only files (ie. no directories or symbolic links)\n"
 		"  -l\t\tmatch expression with localized application names\n"
+		"  -x\t\tshow how the query would be run instead of its results\n"
+		"\t\t(BFS only)\n"
 		"  -a\t\tperform the query on all volumes\n"
 		"  -v <file>\tperform the query on just one volume; <file> can be any\n"
 		"\t\tfile on that volume. Defaults to the current volume.\n"
@@ -53,9 +61,56 @@ usage(void)
 }
 
 
+void
+explain_query(BVolume &volume, const char *predicate)
+{
+	BDirectory root;
+	BEntry entry;
+	BPath path;
+	if (volume.GetRootDirectory(&root) != B_OK
+		|| root.GetEntry(&entry) != B_OK
+		|| entry.GetPath(&path) != B_OK) {
+		fprintf(stderr, "%s: could not get volume root\n", kProgramName);
+		return;
+	}
+
+	int fd = open(path.Path(), O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: could not open %s: %s\n", kProgramName,
+			path.Path(), strerror(errno));
+		return;
+	}
+
+	char plan[4096];
+	struct explain_query explain;
+	explain.query = predicate;
+	explain.query_length = strlen(predicate);
+	explain.flags = 0;
+	explain.plan = plan;
+	explain.plan_size = sizeof(plan);
+
+	if (ioctl(fd, BFS_IOCTL_EXPLAIN_QUERY, &explain, sizeof(explain)) != 0) {
+		if (errno == B_BAD_VALUE)
+			fprintf(stderr, "%s: bad query expression\n", kProgramName);
+		else {
+			fprintf(stderr, "%s: could not explain query on %s: %s\n",
+				kProgramName, path.Path(), strerror(errno));
+		}
+	} else
+		printf("%s:\n%s", path.Path(), plan);
+
+	close(fd);
+}
+
+
 void
 perform_query(BVolume &volume, const char *predicate)
 {
+	if (sExplain) {
+		explain_query(volume, predicate);
+		return;
+	}
+
 	BQuery query;
 	query.SetVolume(&volume);
 
@@ -124,7 +179,7 @@ main(int argc, char **argv)
 
 	// Parse command-line arguments.
 	int opt;
-	while ((opt = getopt(argc, argv, "efalv:")) != -1) {
+	while ((opt = getopt(argc, argv, "efalxv:")) != -1) {
 		switch(opt) {
 			case 'e':
 				sEscapeMetaChars = false;
@@ -138,6 +193,9 @@ main(int argc, char **argv)
 			case 'l':
 				sLocalizedAppNames = true;
 				break;
+			case 'x':
+				sExplain = true;
+				break;
 			case 'v':
 				strlcpy(volumePath, optarg, B_FILE_NAME_LENGTH);
 				break;
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <OS.h>
+
+#include <scheduler_defs.h>
+#include <syscalls.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+extern const char* __progname;
+
+
+static void
+usage(bool failure)
+{
+	fprintf(failure ? stderr : stdout,
+		"Usage: %s [list]\n"
+		"       %s create [-p <parent>] [-w <weight>] [-q <quota> -P <period>]"
+			" <name>\n"
+		"       %s set [-w <weight>] [-q <quota> -P <period>] <group>\n"
+		"       %s delete <group>\n"
+		"       %s move <group> <team> ...\n"
+		"       %s get <team>\n"
+		"\n"
+		"Manages scheduling groups. Sibling groups share the CPU time of their\n"
+		"parent according to their weights (default %d). A group can also be\n"
+		"limited to a quota of CPU time per period (both in microseconds).\n"
+		"New teams are put into the group of their parent team.\n",
+		__progname, __progname, __progname, __progname, __progname,
+		__progname, SCHEDULER_GROUP_DEFAULT_WEIGHT);
+
+	exit(failure ? 1 : 0);
+}
+
+
+static bool
+find_group(int32 id, scheduler_group_info& info)
+{
+	int32 cookie = 0;
+	while (_kern_get_next_scheduler_group_info(&cookie, &info) == B_OK) {
+		if (info.id == id)
+			return true;
+	}
+
+	return false;
+}
+
+
+static int
+list_groups()
+{
+	printf("    ID  parent  name                  weight  teams  penalty"
+		"       quota/period          usage      throttled\n");
+
+	scheduler_group_info info;
+	int32 cookie = 0;
+	while (_kern_get_next_scheduler_group_info(&cookie, &info) == B_OK) {
+		char limit[32];
+		if (info.quota > 0) {
+			snprintf(limit, sizeof(limit), "%" B_PRId64 "/%" B_PRId64,
+				info.quota, info.period);
+		} else
+			strlcpy(limit, "-", sizeof(limit));
+
+		char teams[16];
+		if (info.team_count >= 0)
+			snprintf(teams, sizeof(teams), "%" B_PRId32, info.team_count);
+		else
+			strlcpy(teams, "-", sizeof(teams));
+
+		char parent[16];
+		if (info.parent >= 0)
+			snprintf(parent, sizeof(parent), "%" B_PRId32, info.parent);
+		else
+			strlcpy(parent, "-", sizeof(parent));
+
+		printf("%6" B_PRId32 "  %6s  %-20s  %6" B_PRId32 "  %5s  %7" B_PRId32
+			"  %17s  %11.3fs  %11.3fs\n", info.id, parent, info.name,
+			info.weight, teams, info.penalty, limit, info.usage / 1000000.0,
+			info.throttled_time / 1000000.0);
+	}
+
+	return 0;
+}
+
+
+static int
+set_limits(int32 group, int32 weight, bigtime_t quota, bigtime_t period)
+{
+	status_t status = _kern_set_scheduler_group_limits(group, weight, quota,
+		period);
+	if (status != B_OK) {
+		fprintf(stderr, "%s: Could not set the limits of group %" B_PRId32
+			": %s\n", __progname, group, strerror(status));
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc < 2 || !strcmp(argv[1], "list"))
+		return list_groups();
+
+	const char* command = argv[1];
+	if (!strcmp(command, "--help") || !strcmp(command, "-h"))
+		usage(false);
+
+	argc--;
+	argv++;
+
+	int32 parent = SCHEDULER_ROOT_GROUP;
+	int32 weight = -1;
+	bigtime_t quota = -1;
+	bigtime_t period = 0;
+
+	int option;
+	while ((option = getopt(argc, argv, "p:w:q:P:h")) != -1) {
+		switch (option) {
+			case 'p':
+				parent = strtol(optarg, NULL, 0);
+				break;
+			case 'w':
+				weight = strtol(optarg, NULL, 0);
+				break;
+			case 'q':
+				quota = strtoll(optarg, NULL, 0);
+				break;
+			case 'P':
+				period = strtoll(optarg, NULL, 0);
+				break;
+			case 'h':
+				usage(false);
+				break;
+			default:
+				usage(true);
+				break;
+		}
+	}
+
+	if (!strcmp(command, "create")) {
+		if (optind + 1 != argc)
+			usage(true);
+
+		int32 group = _kern_create_scheduler_group(argv[optind], parent);
+		if (group < 0) {
+			fprintf(stderr, "%s: Could not create group: %s\n", __progname,
+				strerror(group));
+			return 1;
+		}
+
+		if ((weight >= 0 || quota >= 0)
+			&& set_limits(group, weight >= 0
+					? weight : SCHEDULER_GROUP_DEFAULT_WEIGHT,
+				quota >= 0 ? quota : 0, period) != 0) {
+			_kern_delete_scheduler_group(group);
+			return 1;
+		}
+
+		printf("%" B_PRId32 "\n", group);
+		return 0;
+	}
+
+	if (!strcmp(command, "set")) {
+		if (optind + 1 != argc)
+			usage(true);
+
+		int32 group = strtol(argv[optind], NULL, 0);
+		scheduler_group_info info;
+		if (!find_group(group, info)) {
+			fprintf(stderr, "%s: No group %" B_PRId32 "\n", __progname, group);
+			return 1;
+		}
+
+		// keep what hasn't been specified
+		if (weight < 0)
+			weight = info.weight;
+		if (quota < 0) {
+			quota = info.quota;
+			if (period == 0)
+				period = info.period;
+		}
+
+		return set_limits(group, weight, quota, period);
+	}
+
+	if (!strcmp(command, "delete")) {
+		if (optind + 1 != argc)
+			usage(true);
+
+		int32 group = strtol(argv[optind], NULL, 0);
+		status_t status = _kern_delete_scheduler_group(group);
+		if (status != B_OK) {
+			fprintf(stderr, "%s: Could not delete group %" B_PRId32 ": %s\n",
+				__progname, group, strerror(status));
+			return 1;
+		}
+		return 0;
+	}
+
+	if (!strcmp(command, "move")) {
+		if (optind + 2 > argc)
+			usage(true);
+
+		int32 group = strtol(argv[optind], NULL, 0);
+		int result = 0;
+		for (int i = optind + 1; i < argc; i++) {
+			team_id team = strtol(argv[i], NULL, 0);
+			status_t status = _kern_set_team_scheduler_group(team, group);
+			if (status != B_OK) {
+				fprintf(stderr, "%s: Could not move team %" B_PRId32 " to group"
+					" %" B_PRId32 ": %s\n", __progname, team, group,
+					strerror(status));
+				result = 1;
+			}
+		}
+		return result;
+	}
+
+	if (!strcmp(command, "get")) {
+		if (optind + 1 != argc)
+			usage(true);
+
+		team_id team = strtol(argv[optind], NULL, 0);
+		int32 group = _kern_get_team_scheduler_group(team);
+		if (group < 0) {
+			fprintf(stderr, "%s: Could not get the group of team %" B_PRId32
+				": %s\n", __progname, team, strerror(group));
+			return 1;
+		}
+
+		printf("%" B_PRId32 "\n", group);
+		return 0;
+	}
+
+	usage(true);
+	return 1;
+}
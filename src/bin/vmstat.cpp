@@ -11,6 +11,9 @@
 
 #include <system_info.h>
 
+#include <syscalls.h>
+#include <vm_defs.h>
+
 
 static struct option const kLongOptions[] = {
 	{"periodic", no_argument, 0, 'p'},
@@ -82,6 +85,21 @@ main(int argc, char** argv)
 	printf("free swap space:\t%Lu\n", info.free_swap_pages * B_PAGE_SIZE);
 	printf("page faults:\t\t%lu\n", info.page_faults);
 
+	compressed_swap_info compressedInfo;
+	if (_kern_get_compressed_swap_info(&compressedInfo) == B_OK
+		&& compressedInfo.max_pool_size > 0) {
+		printf("compressed swap pool:\t%" B_PRIu64 " of %" B_PRIu64 "\n",
+			compressedInfo.pool_size, compressedInfo.max_pool_size);
+		printf("compressed pages:\t%" B_PRIu64 " (%" B_PRIu64 " bytes)\n",
+			compressedInfo.stored_pages, compressedInfo.compressed_size);
+		printf("compressed stores:\t%" B_PRIu64 "\n", compressedInfo.stores);
+		printf("compressed loads:\t%" B_PRIu64 "\n", compressedInfo.loads);
+		printf("uncompressible pages:\t%" B_PRIu64 "\n",
+			compressedInfo.rejected_pages);
+		printf("pool full rejections:\t%" B_PRIu64 "\n",
+			compressedInfo.pool_full);
+	}
+
 	if (periodically) {
 		puts("\npage faults  used memory    used swap  block cache");
 		system_info lastInfo = info;
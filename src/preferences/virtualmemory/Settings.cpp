@@ -21,6 +21,7 @@
 #include <File.h>
 #include <FindDirectory.h>
 #include <Path.h>
+#include <String.h>
 #include <VolumeRoster.h>
 
 #include <driver_settings.h>
@@ -214,6 +215,21 @@ Settings::WriteSwapSettings()
 	path.Append("kernel/drivers");
 	path.Append(kVirtualMemorySettings);
 
+	// keep the compressed swap settings, which can't be changed here
+	BString compressedSwap;
+	void* settings = load_driver_settings(kVirtualMemorySettings);
+	if (settings != NULL) {
+		const char* enabled = get_driver_parameter(settings,
+			"compressed_swap", NULL, NULL);
+		const char* size = get_driver_parameter(settings,
+			"compressed_swap_size", NULL, NULL);
+		if (enabled != NULL)
+			compressedSwap << "compressed_swap " << enabled << "\n";
+		if (size != NULL)
+			compressedSwap << "compressed_swap_size " << size << "\n";
+		unload_driver_settings(settings);
+	}
+
 	BFile file;
 	if (file.SetTo(path.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE)
 		!= B_OK)
@@ -232,6 +248,7 @@ Settings::WriteSwapSettings()
 		info.total_blocks * info.block_size);
 
 	file.Write(buffer, strlen(buffer));
+	file.Write(compressedSwap.String(), compressedSwap.Length());
 	return B_OK;
 }
 
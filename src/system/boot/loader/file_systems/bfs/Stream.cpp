@@ -103,6 +103,58 @@ CachedBlock::SetTo(block_run run)
 }
 
 
+/*!	Finds the extent that contains \a pos, and returns the part of it that
+	starts at \a pos as a block_run.
+*/
+static status_t
+find_extent_block_run(Volume& volume, const extent_stream& stream, off_t pos,
+	block_run& run, off_t& offset)
+{
+	if (!stream.header.IsValid(NUM_INODE_EXTENTS))
+		return B_BAD_DATA;
+
+	off_t block = pos >> volume.BlockShift();
+	const extent_header* header = &stream.header;
+	const stream_extent* extents = stream.extents;
+	CachedBlock cached(volume);
+
+	while (true) {
+		int32 index = find_extent(extents, header->Count(), block);
+		if (index < 0)
+			return B_ENTRY_NOT_FOUND;
+
+		if (header->Depth() == 0) {
+			const stream_extent& extent = extents[index];
+			if (block >= extent.End())
+				return B_ENTRY_NOT_FOUND;
+
+			// a block_run cannot leave its allocation group
+			off_t start = extent.Start() + block - extent.Offset();
+			off_t groupEnd = ((start >> volume.AllocationGroupShift()) + 1)
+				<< volume.AllocationGroupShift();
+
+			run = volume.ToBlockRun(start);
+			run.length = HOST_ENDIAN_TO_BFS_INT16(min_c(min_c(
+				extent.End() - block, groupEnd - start), MAX_BLOCK_RUN_LENGTH));
+			offset = block << volume.BlockShift();
+			return volume.ValidateBlockRun(run);
+		}
+
+		uint16 depth = header->Depth();
+		const extent_node* node
+			= (const extent_node*)cached.SetTo(extents[index].Start());
+		if (node == NULL)
+			return B_IO_ERROR;
+		if (!node->header.IsValid(extent_node::MaxCount(volume.BlockSize()))
+			|| node->header.Depth() != depth - 1)
+			return B_BAD_DATA;
+
+		header = &node->header;
+		extents = node->extents;
+	}
+}
+
+
 //	#pragma mark -
 
 
@@ -193,9 +245,39 @@ Stream::ReadLink(char* buffer, size_t bufferSize)
 }
 
 
+/*!	Reads from the data of a small file that is stored in the small_data
+	section of its inode.
+*/
+status_t
+Stream::ReadInlineData(off_t pos, uint8* buffer, size_t length)
+{
+	CachedBlock cached(fVolume);
+	bfs_inode* node = (bfs_inode*)cached.SetTo(inode_num);
+	if (node == NULL)
+		return B_IO_ERROR;
+
+	small_data* item = node->SmallDataStart();
+	for (; !item->IsLast(node); item = item->Next()) {
+		if (*item->Name() == INLINE_DATA_NAME
+			&& item->NameSize() == INLINE_DATA_NAME_LENGTH) {
+			if (pos + length > item->DataSize())
+				return B_BAD_DATA;
+
+			memcpy(buffer, item->Data() + pos, length);
+			return B_OK;
+		}
+	}
+
+	return B_BAD_DATA;
+}
+
+
 status_t
 Stream::FindBlockRun(off_t pos, block_run& run, off_t& offset)
 {
+	if ((Flags() & INODE_EXTENTS) != 0)
+		return find_extent_block_run(fVolume, extent_data, pos, run, offset);
+
 	// find matching block run
 
 	if (data.MaxDirectRange() > 0 && pos >= data.MaxDirectRange()) {
@@ -308,6 +390,12 @@ Stream::ReadAt(off_t pos, uint8* buffer, size_t* _length)
 	if (pos + length > data.Size())
 		length = data.Size() - pos;
 
+	if ((Flags() & INODE_INLINE_DATA) != 0) {
+		status_t status = ReadInlineData(pos, buffer, length);
+		*_length = status == B_OK ? length : 0;
+		return status;
+	}
+
 	block_run run;
 	off_t offset;
 	if (FindBlockRun(pos, run, offset) < B_OK) {
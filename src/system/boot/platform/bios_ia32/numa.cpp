@@ -0,0 +1,166 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "numa.h"
+
+#include <KernelExport.h>
+
+#include <kernel.h>
+#include <boot/stage2.h>
+#include <arch/x86/arch_acpi.h>
+
+#include "acpi.h"
+#include "mmu.h"
+
+
+//#define TRACE_NUMA
+#ifdef TRACE_NUMA
+#	define TRACE(x) dprintf x
+#else
+#	define TRACE(x) ;
+#endif
+
+
+static uint32 sProximityDomains[MAX_MEMORY_NODES];
+
+
+/*!	Maps an ACPI proximity domain to a dense memory node index. Returns
+	\c MAX_MEMORY_NODES if there are already too many nodes.
+*/
+static uint32
+memory_node_for_domain(uint32 domain)
+{
+	for (uint32 i = 0; i < gKernelArgs.num_memory_nodes; i++) {
+		if (sProximityDomains[i] == domain)
+			return i;
+	}
+
+	if (gKernelArgs.num_memory_nodes == MAX_MEMORY_NODES) {
+		TRACE(("numa: too many proximity domains, ignoring %lu\n", domain));
+		return MAX_MEMORY_NODES;
+	}
+
+	sProximityDomains[gKernelArgs.num_memory_nodes] = domain;
+	return gKernelArgs.num_memory_nodes++;
+}
+
+
+static void
+set_cpu_memory_node(uint32 apicID, uint32 domain)
+{
+	for (uint32 i = 0; i < gKernelArgs.num_cpus; i++) {
+		if (gKernelArgs.arch_args.cpu_apic_id[i] != apicID)
+			continue;
+
+		uint32 node = memory_node_for_domain(domain);
+		if (node < MAX_MEMORY_NODES)
+			gKernelArgs.cpu_memory_node[i] = node;
+
+		TRACE(("numa: cpu %lu (apic %lu) is in node %lu\n", i, apicID, node));
+		return;
+	}
+}
+
+
+static void
+add_memory_node_range(uint64 start, uint64 size, uint32 domain)
+{
+	if (gKernelArgs.num_memory_node_ranges == MAX_MEMORY_NODE_RANGES) {
+		TRACE(("numa: too many memory ranges, ignoring %#llx - %#llx\n",
+			start, start + size));
+		return;
+	}
+
+	uint32 node = memory_node_for_domain(domain);
+	if (node >= MAX_MEMORY_NODES)
+		return;
+
+	memory_node_addr_range& range
+		= gKernelArgs.memory_node_range[gKernelArgs.num_memory_node_ranges++];
+	range.start = start;
+	range.size = size;
+	range.node = node;
+
+	TRACE(("numa: memory %#llx - %#llx is in node %lu\n", start, start + size,
+		node));
+}
+
+
+void
+numa_init(void)
+{
+	gKernelArgs.num_memory_nodes = 0;
+	gKernelArgs.num_memory_node_ranges = 0;
+
+	acpi_srat* srat = (acpi_srat*)acpi_find_table(ACPI_SRAT_SIGNATURE);
+	if (srat == NULL) {
+		TRACE(("numa: no SRAT found, assuming uniform memory access\n"));
+		return;
+	}
+
+	acpi_apic* entry = (acpi_apic*)((uint8*)srat + sizeof(acpi_srat));
+	acpi_apic* end = (acpi_apic*)((uint8*)srat + srat->header.length);
+	while (entry < end && entry->length != 0) {
+		switch (entry->type) {
+			case ACPI_SRAT_PROCESSOR_AFFINITY:
+			{
+				acpi_srat_processor_affinity* affinity
+					= (acpi_srat_processor_affinity*)entry;
+				if ((affinity->flags & ACPI_SRAT_AFFINITY_ENABLED) == 0)
+					break;
+
+				uint32 domain = affinity->proximity_domain_low
+					| (affinity->proximity_domain_high[0] << 8)
+					| (affinity->proximity_domain_high[1] << 16)
+					| (affinity->proximity_domain_high[2] << 24);
+				set_cpu_memory_node(affinity->apic_id, domain);
+				break;
+			}
+
+			case ACPI_SRAT_X2_APIC_AFFINITY:
+			{
+				acpi_srat_x2_apic_affinity* affinity
+					= (acpi_srat_x2_apic_affinity*)entry;
+				if ((affinity->flags & ACPI_SRAT_AFFINITY_ENABLED) == 0)
+					break;
+
+				set_cpu_memory_node(affinity->x2apic_id,
+					affinity->proximity_domain);
+				break;
+			}
+
+			case ACPI_SRAT_MEMORY_AFFINITY:
+			{
+				acpi_srat_memory_affinity* affinity
+					= (acpi_srat_memory_affinity*)entry;
+				if ((affinity->flags & ACPI_SRAT_AFFINITY_ENABLED) == 0
+					|| affinity->range_length == 0) {
+					break;
+				}
+
+				add_memory_node_range(affinity->base_address,
+					affinity->range_length, affinity->proximity_domain);
+				break;
+			}
+
+			default:
+				break;
+		}
+
+		entry = (acpi_apic*)((uint8*)entry + entry->length);
+	}
+
+	if (gKernelArgs.num_memory_nodes < 2) {
+		// a single node is no different from not knowing at all
+		gKernelArgs.num_memory_nodes = 0;
+		gKernelArgs.num_memory_node_ranges = 0;
+		for (uint32 i = 0; i < SMP_MAX_CPUS; i++)
+			gKernelArgs.cpu_memory_node[i] = 0;
+		return;
+	}
+
+	dprintf("numa: found %lu memory nodes\n", gKernelArgs.num_memory_nodes);
+}
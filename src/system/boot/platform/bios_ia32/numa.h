@@ -0,0 +1,20 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <SupportDefs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void numa_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* NUMA_H */
@@ -25,6 +25,7 @@
 #include "long.h"
 #include "mmu.h"
 #include "multiboot.h"
+#include "numa.h"
 #include "serial.h"
 #include "smp.h"
 
@@ -203,6 +204,7 @@ _start(void)
 	apm_init();
 	acpi_init();
 	smp_init();
+	numa_init();
 	hpet_init();
 	dump_multiboot_info();
 	main(&args);
@@ -16,6 +16,7 @@
 #include <real_time_clock.h>
 #include <team.h>
 #include <thread_types.h>
+#include <timer.h>
 #include <UserEvent.h>
 #include <util/AutoLock.h>
 
@@ -385,7 +386,10 @@ SystemTimeUserTimer::ScheduleKernelTimer(bigtime_t now,
 	fTimer.schedule_time = std::max(fNextTime, (bigtime_t)0);
 	fTimer.period = 0;
 
-	add_timer(&fTimer, &HandleTimerHook, fTimer.schedule_time, timerFlags);
+	add_timer_etc(&fTimer, &HandleTimerHook, fTimer.schedule_time, timerFlags,
+		DEFAULT_USER_TIMER_SLACK);
+		// Periodic timers compute fNextTime from the previous schedule time,
+		// so the slack doesn't accumulate.
 
 	fScheduled = true;
 }
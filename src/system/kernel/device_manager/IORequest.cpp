@@ -747,6 +747,7 @@ IORequest::Init(off_t offset, generic_size_t firstVecOffset,
 	fBuffer->SetVecs(firstVecOffset, vecs, count, length, flags);
 
 	fOwner = NULL;
+	fDeadline = 0;
 	fOffset = offset;
 	fLength = length;
 	fRelativeParentOffset = 0;
@@ -1387,6 +1388,7 @@ IORequest::Dump() const
 	kprintf("io_request at %p\n", this);
 
 	kprintf("  owner:             %p\n", fOwner);
+	kprintf("  deadline:          %" B_PRIdBIGTIME "\n", fDeadline);
 	kprintf("  parent:            %p\n", fParent);
 	kprintf("  status:            %s\n", strerror(fStatus));
 	kprintf("  mutex:             %p\n", &fLock);
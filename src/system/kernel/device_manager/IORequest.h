@@ -231,6 +231,10 @@ struct IORequest : IORequestChunk, DoublyLinkedListLinkImpl<IORequest> {
 									{ fOwner = owner; }
 			IORequestOwner*		Owner() const	{ return fOwner; }
 
+			void				SetDeadline(bigtime_t deadline)
+									{ fDeadline = deadline; }
+			bigtime_t			Deadline() const	{ return fDeadline; }
+
 			status_t			CreateSubRequest(off_t parentOffset,
 									off_t offset, generic_size_t length,
 									IORequest*& subRequest);
@@ -327,6 +331,7 @@ private:
 
 			mutex				fLock;
 			IORequestOwner*		fOwner;
+			bigtime_t			fDeadline;
 			IOBuffer*			fBuffer;
 			off_t				fOffset;
 			generic_size_t		fLength;
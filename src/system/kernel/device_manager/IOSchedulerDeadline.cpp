@@ -0,0 +1,867 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A deadline I/O scheduler.
+
+	Requests are submitted to per-CPU queues, so that ScheduleRequest() never
+	contends on the scheduler lock. The scheduler thread collects them into
+	three FIFO queues sorted by deadline: synchronous requests (someone is
+	blocked on them, or they come from the page writer), asynchronous reads,
+	and asynchronous writes.
+
+	Synchronous requests are always served first. Reads and writes are served
+	in batches in elevator order; a batch prefers the request that directly
+	follows the previous one on disk, so that contiguous requests end up in
+	back-to-back operations. Reads are preferred over writes, but writes are
+	only passed over a limited number of times in a row. Whenever the oldest
+	request of any queue has missed its deadline, it is served immediately.
+*/
+
+
+#include "IOSchedulerDeadline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <heap.h>
+#include <smp.h>
+#include <thread.h>
+
+#include "IOSchedulerRoster.h"
+
+
+//#define TRACE_IO_SCHEDULER
+#ifdef TRACE_IO_SCHEDULER
+#	define TRACE(x...) dprintf(x)
+#else
+#	define TRACE(x...) ;
+#endif
+
+
+static const bigtime_t kExpireTimes[] = {
+	50000,		// synchronous requests
+	500000,		// reads
+	5000000		// writes
+};
+static const int32 kBatchSize = 16;
+	// number of requests taken from the read or write queue in a row
+static const int32 kMaxStarvedWrites = 2;
+	// number of read batches that may pass over pending writes
+static const bigtime_t kBusyRetryInterval = 10000;
+	// how long to wait before retrying when DMA resources were exhausted
+
+
+IOSchedulerDeadline::IOSchedulerDeadline(DMAResource* resource)
+	:
+	IOScheduler(resource),
+	fSchedulerThread(-1),
+	fRequestNotifierThread(-1),
+	fSubmissionQueues(NULL),
+	fSubmissionQueueCount(0),
+	fSubmittedRequests(0),
+	fSchedulerWaiting(0),
+	fCurrentRequest(NULL),
+	fBlockSize(0),
+	fPendingOperations(0),
+	fIterationBandwidth(0),
+	fLastOffset(0),
+	fBatchQueue(READ_QUEUE),
+	fBatchCount(0),
+	fStarvedWrites(0),
+	fTerminating(false)
+{
+	mutex_init(&fLock, "I/O deadline scheduler");
+	B_INITIALIZE_SPINLOCK(&fFinisherLock);
+
+	fNewRequestCondition.Init(this, "I/O new request");
+	fFinishedOperationCondition.Init(this, "I/O finished operation");
+	fFinishedRequestCondition.Init(this, "I/O finished request");
+
+	for (int32 i = 0; i < QUEUE_COUNT; i++)
+		fQueuedRequests[i] = 0;
+}
+
+
+IOSchedulerDeadline::~IOSchedulerDeadline()
+{
+	// shutdown threads
+	MutexLocker locker(fLock);
+	InterruptsSpinLocker finisherLocker(fFinisherLock);
+	fTerminating = true;
+
+	fNewRequestCondition.NotifyAll();
+	fFinishedOperationCondition.NotifyAll();
+	fFinishedRequestCondition.NotifyAll();
+
+	finisherLocker.Unlock();
+	locker.Unlock();
+
+	if (fSchedulerThread >= 0)
+		wait_for_thread(fSchedulerThread, NULL);
+
+	if (fRequestNotifierThread >= 0)
+		wait_for_thread(fRequestNotifierThread, NULL);
+
+	// The requests that are still waiting in the submission queues or in
+	// our own queues won't be executed anymore -- finish them, so that no
+	// one waits for them forever.
+	mutex_lock(&fLock);
+	_CollectSubmittedRequests();
+
+	IORequestList requests;
+	if (fCurrentRequest != NULL) {
+		requests.Add(fCurrentRequest);
+		fCurrentRequest = NULL;
+	}
+	for (int32 i = 0; i < QUEUE_COUNT; i++) {
+		requests.MoveFrom(&fQueues[i]);
+		fQueuedRequests[i] = 0;
+	}
+
+	// destroy our belongings
+	mutex_destroy(&fLock);
+
+	while (IORequest* request = requests.RemoveHead())
+		request->SetStatusAndNotify(B_CANCELED);
+
+	while (IOOperation* operation = fUnusedOperations.RemoveHead())
+		delete operation;
+
+	if (fSubmissionQueues != NULL) {
+		for (int32 i = 0; i < fSubmissionQueueCount; i++)
+			fSubmissionQueues[i].~SubmissionQueue();
+		free(fSubmissionQueues);
+	}
+}
+
+
+status_t
+IOSchedulerDeadline::Init(const char* name)
+{
+	status_t error = IOScheduler::Init(name);
+	if (error != B_OK)
+		return error;
+
+	size_t count = fDMAResource != NULL ? fDMAResource->BufferCount() : 16;
+	for (size_t i = 0; i < count; i++) {
+		IOOperation* operation = new(std::nothrow) IOOperation;
+		if (operation == NULL)
+			return B_NO_MEMORY;
+
+		fUnusedOperations.Add(operation);
+	}
+
+	// one submission queue per CPU, each on its own cache line
+	fSubmissionQueueCount = smp_get_num_cpus();
+	fSubmissionQueues = (SubmissionQueue*)memalign(CACHE_LINE_SIZE,
+		sizeof(SubmissionQueue) * fSubmissionQueueCount);
+	if (fSubmissionQueues == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = 0; i < fSubmissionQueueCount; i++) {
+		new(&fSubmissionQueues[i]) SubmissionQueue;
+		B_INITIALIZE_SPINLOCK(&fSubmissionQueues[i].lock);
+	}
+
+	if (fDMAResource != NULL)
+		fBlockSize = fDMAResource->BlockSize();
+	if (fBlockSize == 0)
+		fBlockSize = 512;
+
+	// TODO: Use a device speed dependent bandwidth!
+	fIterationBandwidth = fBlockSize * 8192;
+
+	// start threads
+	char buffer[B_OS_NAME_LENGTH];
+	strlcpy(buffer, name, sizeof(buffer));
+	strlcat(buffer, " scheduler ", sizeof(buffer));
+	size_t nameLength = strlen(buffer);
+	snprintf(buffer + nameLength, sizeof(buffer) - nameLength, "%" B_PRId32,
+		fID);
+	fSchedulerThread = spawn_kernel_thread(&_SchedulerThread, buffer,
+		B_NORMAL_PRIORITY + 2, (void *)this);
+	if (fSchedulerThread < B_OK)
+		return fSchedulerThread;
+
+	strlcpy(buffer, name, sizeof(buffer));
+	strlcat(buffer, " notifier ", sizeof(buffer));
+	nameLength = strlen(buffer);
+	snprintf(buffer + nameLength, sizeof(buffer) - nameLength, "%" B_PRId32,
+		fID);
+	fRequestNotifierThread = spawn_kernel_thread(&_RequestNotifierThread,
+		buffer, B_NORMAL_PRIORITY + 2, (void *)this);
+	if (fRequestNotifierThread < B_OK)
+		return fRequestNotifierThread;
+
+	resume_thread(fSchedulerThread);
+	resume_thread(fRequestNotifierThread);
+
+	return B_OK;
+}
+
+
+status_t
+IOSchedulerDeadline::ScheduleRequest(IORequest* request)
+{
+	TRACE("%p->IOSchedulerDeadline::ScheduleRequest(%p)\n", this, request);
+
+	IOBuffer* buffer = request->Buffer();
+
+	if (buffer->IsVirtual()) {
+		status_t status = buffer->LockMemory(request->TeamID(),
+			request->IsWrite());
+		if (status != B_OK) {
+			request->SetStatusAndNotify(status);
+			return status;
+		}
+	}
+
+	request->SetDeadline(system_time() + kExpireTimes[_QueueFor(request)]);
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_SCHEDULED, this,
+		request);
+
+	// Hand the request over to the scheduler thread via the submission queue
+	// of the current CPU. The scheduler lock isn't needed for this.
+	InterruptsLocker interruptsLocker;
+	SubmissionQueue& queue
+		= fSubmissionQueues[smp_get_current_cpu() % fSubmissionQueueCount];
+	SpinLocker queueLocker(queue.lock);
+	queue.requests.Add(request);
+	queueLocker.Unlock();
+	interruptsLocker.Unlock();
+
+	atomic_add(&fSubmittedRequests, 1);
+
+	// only wake up the scheduler if it is actually waiting
+	if (atomic_get(&fSchedulerWaiting) != 0)
+		fNewRequestCondition.NotifyAll();
+
+	return B_OK;
+}
+
+
+void
+IOSchedulerDeadline::AbortRequest(IORequest* request, status_t status)
+{
+	// Only requests that haven't been started yet can be aborted; the
+	// others will be finished by their pending operations.
+	MutexLocker locker(fLock);
+	_CollectSubmittedRequests();
+
+	if (!_RemoveQueuedRequest(request))
+		return;
+
+	locker.Unlock();
+
+	request->SetStatusAndNotify(status);
+}
+
+
+void
+IOSchedulerDeadline::OperationCompleted(IOOperation* operation,
+	status_t status, generic_size_t transferredBytes)
+{
+	InterruptsSpinLocker _(fFinisherLock);
+
+	// finish operation only once
+	if (operation->Status() <= 0)
+		return;
+
+	operation->SetStatus(status);
+
+	// set the bytes transferred (of the net data)
+	generic_size_t partialBegin
+		= operation->OriginalOffset() - operation->Offset();
+	operation->SetTransferredBytes(
+		transferredBytes > partialBegin ? transferredBytes - partialBegin : 0);
+
+	fCompletedOperations.Add(operation);
+	fFinishedOperationCondition.NotifyAll();
+}
+
+
+void
+IOSchedulerDeadline::Dump() const
+{
+	static const char* const kQueueNames[] = { "sync", "read", "write" };
+
+	kprintf("IOSchedulerDeadline at %p\n", this);
+	kprintf("  DMA resource:       %p\n", fDMAResource);
+	kprintf("  submitted requests: %" B_PRId32 "\n", fSubmittedRequests);
+	kprintf("  current request:    %p\n", fCurrentRequest);
+	kprintf("  last offset:        %" B_PRIdOFF "\n", fLastOffset);
+	kprintf("  batch:              %s, %" B_PRId32 " requests\n",
+		kQueueNames[fBatchQueue], fBatchCount);
+	kprintf("  starved writes:     %" B_PRId32 "\n", fStarvedWrites);
+
+	for (int32 i = 0; i < QUEUE_COUNT; i++) {
+		kprintf("  %s queue (%" B_PRId32 "):", kQueueNames[i],
+			fQueuedRequests[i]);
+		for (IORequestList::ConstIterator it = fQueues[i].GetIterator();
+				IORequest* request = it.Next();) {
+			kprintf(" %p", request);
+		}
+		kprintf("\n");
+	}
+
+	kprintf("  dispatched requests:");
+	for (IORequestList::ConstIterator it = fDispatchedRequests.GetIterator();
+			IORequest* request = it.Next();) {
+		kprintf(" %p", request);
+	}
+	kprintf("\n");
+}
+
+
+int32
+IOSchedulerDeadline::_QueueFor(IORequest* request) const
+{
+	// Requests without a finished callback are waited for synchronously, as
+	// are the ones of the page writer.
+	if ((request->Flags() & B_VIP_IO_REQUEST) != 0
+		|| request->FinishedCallback() == NULL) {
+		return SYNC_QUEUE;
+	}
+
+	return request->IsWrite() ? WRITE_QUEUE : READ_QUEUE;
+}
+
+
+/*!	Moves the requests from the per-CPU submission queues to the scheduling
+	queues. Must be called with \c fLock held.
+*/
+void
+IOSchedulerDeadline::_CollectSubmittedRequests()
+{
+	if (atomic_get(&fSubmittedRequests) == 0)
+		return;
+
+	for (int32 i = 0; i < fSubmissionQueueCount; i++) {
+		SubmissionQueue& submissionQueue = fSubmissionQueues[i];
+
+		IORequestList requests;
+		InterruptsSpinLocker locker(submissionQueue.lock);
+		requests.MoveFrom(&submissionQueue.requests);
+		locker.Unlock();
+
+		while (IORequest* request = requests.RemoveHead()) {
+			atomic_add(&fSubmittedRequests, -1);
+
+			// Keep the queue sorted by deadline -- requests from different
+			// CPUs may arrive slightly out of order.
+			int32 queue = _QueueFor(request);
+			IORequest* next = NULL;
+			for (IORequest* other = fQueues[queue].Tail();
+					other != NULL && other->Deadline() > request->Deadline();
+					other = fQueues[queue].GetPrevious(other)) {
+				next = other;
+			}
+
+			fQueues[queue].InsertBefore(next, request);
+			fQueuedRequests[queue]++;
+		}
+	}
+}
+
+
+/*!	Returns the request of the given queue that should be served next in
+	elevator order. Must be called with \c fLock held.
+*/
+IORequest*
+IOSchedulerDeadline::_ElevatorNext(int32 queue) const
+{
+	IORequest* next = NULL;
+	IORequest* lowest = NULL;
+
+	for (IORequestList::ConstIterator it = fQueues[queue].GetIterator();
+			IORequest* request = it.Next();) {
+		off_t offset = request->Offset();
+		if (offset == fLastOffset) {
+			// directly continues the previous request
+			return request;
+		}
+
+		if (offset > fLastOffset && (next == NULL || offset < next->Offset()))
+			next = request;
+		if (lowest == NULL || offset < lowest->Offset())
+			lowest = request;
+	}
+
+	// if there is nothing left in the current direction, start over
+	return next != NULL ? next : lowest;
+}
+
+
+IORequest*
+IOSchedulerDeadline::_DequeueRequest(int32 queue, IORequest* request)
+{
+	fQueues[queue].Remove(request);
+	fQueuedRequests[queue]--;
+	return request;
+}
+
+
+/*!	Chooses the request to be served next and removes it from its queue.
+	Must be called with \c fLock held.
+*/
+IORequest*
+IOSchedulerDeadline::_NextRequest()
+{
+	// If the oldest request of any queue has expired, it goes first.
+	bigtime_t now = system_time();
+	int32 expiredQueue = -1;
+	for (int32 i = 0; i < QUEUE_COUNT; i++) {
+		IORequest* head = fQueues[i].Head();
+		if (head != NULL && head->Deadline() <= now
+			&& (expiredQueue < 0
+				|| head->Deadline() < fQueues[expiredQueue].Head()->Deadline())) {
+			expiredQueue = i;
+		}
+	}
+
+	if (expiredQueue >= 0) {
+		TRACE("IOSchedulerDeadline: request %p expired\n",
+			fQueues[expiredQueue].Head());
+		return _DequeueRequest(expiredQueue, fQueues[expiredQueue].Head());
+	}
+
+	// Someone is waiting for synchronous requests.
+	if (!fQueues[SYNC_QUEUE].IsEmpty())
+		return _DequeueRequest(SYNC_QUEUE, _ElevatorNext(SYNC_QUEUE));
+
+	// Continue the current batch, if possible.
+	if (fBatchCount < kBatchSize && !fQueues[fBatchQueue].IsEmpty()) {
+		fBatchCount++;
+		return _DequeueRequest(fBatchQueue, _ElevatorNext(fBatchQueue));
+	}
+
+	// Start a new batch. Reads are preferred, but writes must not starve.
+	bool readsPending = !fQueues[READ_QUEUE].IsEmpty();
+	bool writesPending = !fQueues[WRITE_QUEUE].IsEmpty();
+	if (!readsPending && !writesPending)
+		return NULL;
+
+	if (readsPending
+		&& (!writesPending || fStarvedWrites < kMaxStarvedWrites)) {
+		if (writesPending)
+			fStarvedWrites++;
+		fBatchQueue = READ_QUEUE;
+	} else {
+		fStarvedWrites = 0;
+		fBatchQueue = WRITE_QUEUE;
+	}
+
+	fBatchCount = 1;
+	return _DequeueRequest(fBatchQueue, _ElevatorNext(fBatchQueue));
+}
+
+
+/*!	Removes a request that has not been started yet from its queue.
+	Must be called with \c fLock held.
+*/
+bool
+IOSchedulerDeadline::_RemoveQueuedRequest(IORequest* request)
+{
+	for (int32 i = 0; i < QUEUE_COUNT; i++) {
+		if (fQueues[i].Contains(request)) {
+			_DequeueRequest(i, request);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*!	Must not be called with the fLock held. */
+void
+IOSchedulerDeadline::_Finisher()
+{
+	while (true) {
+		InterruptsSpinLocker locker(fFinisherLock);
+		IOOperation* operation = fCompletedOperations.RemoveHead();
+		if (operation == NULL)
+			return;
+
+		locker.Unlock();
+
+		TRACE("IOSchedulerDeadline::_Finisher(): operation: %p\n", operation);
+
+		bool operationFinished = operation->Finish();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_FINISHED,
+			this, operation->Parent(), operation);
+			// Notify for every time the operation is passed to the I/O hook,
+			// not only when it is fully finished.
+
+		if (!operationFinished) {
+			TRACE("  operation: %p not finished yet\n", operation);
+			MutexLocker _(fLock);
+			operation->SetTransferredBytes(0);
+			fResubmittedOperations.Add(operation);
+			fPendingOperations--;
+			continue;
+		}
+
+		// notify request and remove operation
+		IORequest* request = operation->Parent();
+
+		generic_size_t operationOffset
+			= operation->OriginalOffset() - request->Offset();
+		request->OperationFinished(operation, operation->Status(),
+			operation->TransferredBytes() < operation->OriginalLength(),
+			operation->Status() == B_OK
+				? operationOffset + operation->OriginalLength()
+				: operationOffset);
+
+		// recycle the operation
+		MutexLocker _(fLock);
+		if (fDMAResource != NULL)
+			fDMAResource->RecycleBuffer(operation->Buffer());
+
+		fPendingOperations--;
+		fUnusedOperations.Add(operation);
+
+		// If the request is done, we need to perform its notifications.
+		if (request->IsFinished()) {
+			if (request->Status() == B_OK && request->RemainingBytes() > 0) {
+				// The request has been processed OK so far, but it isn't really
+				// finished yet.
+				request->SetUnfinished();
+			} else {
+				if (request == fCurrentRequest)
+					fCurrentRequest = NULL;
+				else
+					fDispatchedRequests.Remove(request);
+
+				_NotifyRequestFinished(request);
+			}
+		}
+	}
+}
+
+
+/*!	Called with \c fFinisherLock held.
+*/
+bool
+IOSchedulerDeadline::_FinisherWorkPending()
+{
+	return !fCompletedOperations.IsEmpty();
+}
+
+
+/*!	Must be called with \c fLock held. */
+void
+IOSchedulerDeadline::_NotifyRequestFinished(IORequest* request)
+{
+	if (request->HasCallbacks()) {
+		// The request has callbacks that may take some time to perform, so we
+		// hand it over to the request notifier.
+		fFinishedRequests.Add(request);
+		fFinishedRequestCondition.NotifyAll();
+	} else {
+		// No callbacks -- finish the request right now.
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+			this, request);
+		request->NotifyFinished();
+	}
+}
+
+
+bool
+IOSchedulerDeadline::_PrepareRequestOperations(IORequest* request,
+	IOOperationList& operations, int32& operationsPrepared, off_t quantum,
+	off_t& usedBandwidth)
+{
+	usedBandwidth = 0;
+
+	if (fDMAResource != NULL) {
+		while (quantum >= (off_t)fBlockSize && request->RemainingBytes() > 0) {
+			IOOperation* operation = fUnusedOperations.RemoveHead();
+			if (operation == NULL)
+				return false;
+
+			status_t status = fDMAResource->TranslateNext(request, operation,
+				quantum);
+			if (status != B_OK) {
+				operation->SetParent(NULL);
+				fUnusedOperations.Add(operation);
+
+				// B_BUSY means some resource (DMABuffers or
+				// DMABounceBuffers) was temporarily unavailable. That's OK,
+				// we'll retry later.
+				if (status == B_BUSY)
+					return false;
+
+				_AbortCurrentRequest(request, operations, operationsPrepared,
+					status);
+				return true;
+			}
+
+			off_t bandwidth = operation->Length();
+			quantum -= bandwidth;
+			usedBandwidth += bandwidth;
+
+			operations.Add(operation);
+			operationsPrepared++;
+		}
+	} else {
+		// TODO: If the device has block size restrictions, we might need to use
+		// a bounce buffer.
+		IOOperation* operation = fUnusedOperations.RemoveHead();
+		if (operation == NULL)
+			return false;
+
+		status_t status = operation->Prepare(request);
+		if (status != B_OK) {
+			operation->SetParent(NULL);
+			fUnusedOperations.Add(operation);
+			_AbortCurrentRequest(request, operations, operationsPrepared,
+				status);
+			return true;
+		}
+
+		operation->SetOriginalRange(request->Offset(), request->Length());
+		request->Advance(request->Length());
+
+		off_t bandwidth = operation->Length();
+		quantum -= bandwidth;
+		usedBandwidth += bandwidth;
+
+		operations.Add(operation);
+		operationsPrepared++;
+	}
+
+	return true;
+}
+
+
+/*!	Fails the current request after its translation failed. Since operations
+	are only prepared once all operations of the previous iteration have
+	finished, all of the request's remaining operations are still in
+	\a operations. Must be called with \c fLock held.
+*/
+void
+IOSchedulerDeadline::_AbortCurrentRequest(IORequest* request,
+	IOOperationList& operations, int32& operationsPrepared, status_t status)
+{
+	IOOperation* operation = operations.Head();
+	while (operation != NULL) {
+		IOOperation* nextOperation = operations.GetNext(operation);
+		if (operation->Parent() == request) {
+			operations.Remove(operation);
+			operationsPrepared--;
+
+			request->OperationFinished(operation, status, true,
+				operation->OriginalOffset() - request->Offset());
+
+			if (fDMAResource != NULL)
+				fDMAResource->RecycleBuffer(operation->Buffer());
+			fUnusedOperations.Add(operation);
+		}
+
+		operation = nextOperation;
+	}
+
+	fCurrentRequest = NULL;
+
+	if (request->IsFinished())
+		_NotifyRequestFinished(request);
+	else
+		request->SetStatusAndNotify(status);
+}
+
+
+/*!	Waits until new requests have been submitted, or finished operations need
+	to be processed. Must be called with \c fLock held, returns with it
+	unlocked.
+*/
+void
+IOSchedulerDeadline::_WaitForWork(MutexLocker& locker)
+{
+	ConditionVariableEntry entry;
+	fNewRequestCondition.Add(&entry);
+	atomic_set(&fSchedulerWaiting, 1);
+
+	// If we still have queued requests, we couldn't prepare any operations
+	// for them, since the DMA resources were exhausted.
+	bool requestsPending = fCurrentRequest != NULL;
+	for (int32 i = 0; i < QUEUE_COUNT; i++)
+		requestsPending |= !fQueues[i].IsEmpty();
+
+	InterruptsSpinLocker finisherLocker(fFinisherLock);
+	bool finisherWorkPending = _FinisherWorkPending();
+	finisherLocker.Unlock();
+	locker.Unlock();
+
+	if (fTerminating || finisherWorkPending
+		|| atomic_get(&fSubmittedRequests) > 0) {
+		// nothing to wait for -- just remove the entry again
+		entry.Wait(B_RELATIVE_TIMEOUT, 0);
+	} else if (requestsPending)
+		entry.Wait(B_CAN_INTERRUPT | B_RELATIVE_TIMEOUT, kBusyRetryInterval);
+	else
+		entry.Wait(B_CAN_INTERRUPT);
+
+	atomic_set(&fSchedulerWaiting, 0);
+	_Finisher();
+}
+
+
+status_t
+IOSchedulerDeadline::_Scheduler()
+{
+	while (!fTerminating) {
+		MutexLocker locker(fLock);
+
+		_CollectSubmittedRequests();
+
+		IOOperationList operations;
+		int32 operationCount = 0;
+		bool resourcesAvailable = true;
+		off_t iterationBandwidth = fIterationBandwidth;
+
+		// Operations that need another pass (e.g. the write phase of a
+		// partial block write) go first.
+		while (IOOperation* operation = fResubmittedOperations.RemoveHead()) {
+			operations.Add(operation);
+			operationCount++;
+			iterationBandwidth -= operation->Length();
+		}
+
+		while (resourcesAvailable && iterationBandwidth >= (off_t)fBlockSize) {
+			if (fCurrentRequest == NULL) {
+				fCurrentRequest = _NextRequest();
+				if (fCurrentRequest == NULL)
+					break;
+
+				TRACE("IOSchedulerDeadline::_Scheduler(): next request %p, "
+					"offset %" B_PRIdOFF "\n", fCurrentRequest,
+					fCurrentRequest->Offset());
+			}
+
+			IORequest* request = fCurrentRequest;
+			off_t bandwidth = 0;
+			resourcesAvailable = _PrepareRequestOperations(request, operations,
+				operationCount, iterationBandwidth, bandwidth);
+			iterationBandwidth -= bandwidth;
+
+			if (request == fCurrentRequest && request->RemainingBytes() == 0) {
+				// All operations have been prepared; the request will be
+				// finished by the last one of them.
+				fCurrentRequest = NULL;
+				fDispatchedRequests.Add(request);
+				fLastOffset = request->Offset() + request->Length();
+			}
+		}
+
+		if (operations.IsEmpty()) {
+			_WaitForWork(locker);
+			continue;
+		}
+
+		fPendingOperations = operationCount;
+
+		locker.Unlock();
+
+		// execute the operations
+		while (IOOperation* operation = operations.RemoveHead()) {
+			TRACE("IOSchedulerDeadline::_Scheduler(): calling callback for "
+				"operation %p\n", operation);
+
+			IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_STARTED,
+				this, operation->Parent(), operation);
+
+			fIOCallback(fIOCallbackData, operation);
+
+			_Finisher();
+		}
+
+		// wait for all operations to finish
+		while (!fTerminating) {
+			locker.Lock();
+
+			if (fPendingOperations == 0)
+				break;
+
+			// Before waiting first check whether any finisher work has to be
+			// done.
+			InterruptsSpinLocker finisherLocker(fFinisherLock);
+			if (_FinisherWorkPending()) {
+				finisherLocker.Unlock();
+				locker.Unlock();
+				_Finisher();
+				continue;
+			}
+
+			// wait for finished operations
+			ConditionVariableEntry entry;
+			fFinishedOperationCondition.Add(&entry);
+
+			finisherLocker.Unlock();
+			locker.Unlock();
+
+			entry.Wait(B_CAN_INTERRUPT);
+			_Finisher();
+		}
+	}
+
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerDeadline::_SchedulerThread(void *_self)
+{
+	IOSchedulerDeadline *self = (IOSchedulerDeadline *)_self;
+	return self->_Scheduler();
+}
+
+
+status_t
+IOSchedulerDeadline::_RequestNotifier()
+{
+	while (true) {
+		MutexLocker locker(fLock);
+
+		// get a request
+		IORequest* request = fFinishedRequests.RemoveHead();
+
+		if (request == NULL) {
+			if (fTerminating)
+				return B_OK;
+
+			ConditionVariableEntry entry;
+			fFinishedRequestCondition.Add(&entry);
+
+			locker.Unlock();
+
+			entry.Wait();
+			continue;
+		}
+
+		locker.Unlock();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+			this, request);
+
+		// notify the request
+		request->NotifyFinished();
+	}
+
+	// never can get here
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerDeadline::_RequestNotifierThread(void *_self)
+{
+	IOSchedulerDeadline *self = (IOSchedulerDeadline*)_self;
+	return self->_RequestNotifier();
+}
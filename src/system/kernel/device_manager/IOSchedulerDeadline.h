@@ -0,0 +1,109 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef IO_SCHEDULER_DEADLINE_H
+#define IO_SCHEDULER_DEADLINE_H
+
+
+#include <KernelExport.h>
+
+#include <condition_variable.h>
+#include <cpu.h>
+#include <lock.h>
+#include <util/AutoLock.h>
+
+#include "dma_resources.h"
+#include "IOScheduler.h"
+
+
+class IOSchedulerDeadline : public IOScheduler {
+public:
+								IOSchedulerDeadline(DMAResource* resource);
+	virtual						~IOSchedulerDeadline();
+
+	virtual	status_t			Init(const char* name);
+
+	virtual	status_t			ScheduleRequest(IORequest* request);
+
+	virtual	void				AbortRequest(IORequest* request,
+									status_t status = B_CANCELED);
+	virtual	void				OperationCompleted(IOOperation* operation,
+									status_t status,
+									generic_size_t transferredBytes);
+									// called by the driver when the operation
+									// has been completed successfully or failed
+									// for some reason
+
+	virtual	void				Dump() const;
+
+private:
+			enum {
+				SYNC_QUEUE = 0,
+				READ_QUEUE,
+				WRITE_QUEUE,
+				QUEUE_COUNT
+			};
+
+			struct SubmissionQueue {
+				spinlock		lock;
+				IORequestList	requests;
+			} CACHE_LINE_ALIGN;
+
+			int32				_QueueFor(IORequest* request) const;
+			void				_CollectSubmittedRequests();
+			IORequest*			_ElevatorNext(int32 queue) const;
+			IORequest*			_DequeueRequest(int32 queue,
+									IORequest* request);
+			IORequest*			_NextRequest();
+			bool				_RemoveQueuedRequest(IORequest* request);
+
+			void				_Finisher();
+			bool				_FinisherWorkPending();
+			void				_NotifyRequestFinished(IORequest* request);
+			bool				_PrepareRequestOperations(IORequest* request,
+									IOOperationList& operations,
+									int32& operationsPrepared, off_t quantum,
+									off_t& usedBandwidth);
+			void				_AbortCurrentRequest(IORequest* request,
+									IOOperationList& operations,
+									int32& operationsPrepared,
+									status_t status);
+			void				_WaitForWork(MutexLocker& locker);
+			status_t			_Scheduler();
+	static	status_t			_SchedulerThread(void* self);
+			status_t			_RequestNotifier();
+	static	status_t			_RequestNotifierThread(void* self);
+
+private:
+			spinlock			fFinisherLock;
+			mutex				fLock;
+			thread_id			fSchedulerThread;
+			thread_id			fRequestNotifierThread;
+			SubmissionQueue*	fSubmissionQueues;
+			int32				fSubmissionQueueCount;
+			int32				fSubmittedRequests;
+			int32				fSchedulerWaiting;
+			IORequestList		fQueues[QUEUE_COUNT];
+			int32				fQueuedRequests[QUEUE_COUNT];
+			IORequest*			fCurrentRequest;
+			IORequestList		fDispatchedRequests;
+			IORequestList		fFinishedRequests;
+			ConditionVariable	fNewRequestCondition;
+			ConditionVariable	fFinishedOperationCondition;
+			ConditionVariable	fFinishedRequestCondition;
+			IOOperationList		fUnusedOperations;
+			IOOperationList		fResubmittedOperations;
+			IOOperationList		fCompletedOperations;
+			generic_size_t		fBlockSize;
+			int32				fPendingOperations;
+			off_t				fIterationBandwidth;
+			off_t				fLastOffset;
+			int32				fBatchQueue;
+			int32				fBatchCount;
+			int32				fStarvedWrites;
+	volatile bool				fTerminating;
+};
+
+
+#endif	// IO_SCHEDULER_DEADLINE_H
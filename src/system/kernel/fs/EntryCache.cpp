@@ -8,8 +8,11 @@
 
 #include <new>
 
+#include <heap.h>
 
-static const int32 kEntriesPerGeneration = 1024;
+
+static const int32 kEntriesPerGeneration = 128;
+	// per shard, i.e. the whole cache holds up to 16 * 8 * 128 entries
 
 static const int32 kEntryNotInArray = -1;
 static const int32 kEntryRemoved = -2;
@@ -45,10 +48,10 @@ EntryCacheGeneration::Init()
 }
 
 
-// #pragma mark - EntryCache
+// #pragma mark - EntryCacheShard
 
 
-EntryCache::EntryCache()
+EntryCacheShard::EntryCacheShard()
 	:
 	fCurrentGeneration(0)
 {
@@ -58,7 +61,7 @@ EntryCache::EntryCache()
 }
 
 
-EntryCache::~EntryCache()
+EntryCacheShard::~EntryCacheShard()
 {
 	// delete entries
 	EntryCacheEntry* entry = fEntries.Clear(true);
@@ -73,7 +76,7 @@ EntryCache::~EntryCache()
 
 
 status_t
-EntryCache::Init()
+EntryCacheShard::Init()
 {
 	status_t error = fEntries.Init();
 	if (error != B_OK)
@@ -90,15 +93,14 @@ EntryCache::Init()
 
 
 status_t
-EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID)
+EntryCacheShard::Add(const EntryCacheKey& key, ino_t nodeID, bool missing)
 {
-	EntryCacheKey key(dirID, name);
-
 	WriteLocker _(fLock);
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
 	if (entry != NULL) {
 		entry->node_id = nodeID;
+		entry->missing = missing;
 		if (entry->generation != fCurrentGeneration) {
 			if (entry->index >= 0) {
 				fGenerations[entry->generation].entries[entry->index] = NULL;
@@ -108,15 +110,17 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID)
 		return B_OK;
 	}
 
-	entry = (EntryCacheEntry*)malloc(sizeof(EntryCacheEntry) + strlen(name));
+	entry = (EntryCacheEntry*)malloc(sizeof(EntryCacheEntry)
+		+ strlen(key.name));
 	if (entry == NULL)
 		return B_NO_MEMORY;
 
 	entry->node_id = nodeID;
-	entry->dir_id = dirID;
+	entry->dir_id = key.dir_id;
 	entry->generation = fCurrentGeneration;
 	entry->index = kEntryNotInArray;
-	strcpy(entry->name, name);
+	entry->missing = missing;
+	strcpy(entry->name, key.name);
 
 	fEntries.Insert(entry);
 
@@ -127,10 +131,8 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID)
 
 
 status_t
-EntryCache::Remove(ino_t dirID, const char* name)
+EntryCacheShard::Remove(const EntryCacheKey& key)
 {
-	EntryCacheKey key(dirID, name);
-
 	WriteLocker writeLocker(fLock);
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
@@ -155,22 +157,28 @@ EntryCache::Remove(ino_t dirID, const char* name)
 
 
 bool
-EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID)
+EntryCacheShard::Lookup(const EntryCacheKey& key, ino_t& _nodeID,
+	bool& _missing)
 {
-	EntryCacheKey key(dirID, name);
-
 	ReadLocker readLocker(fLock);
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
 	if (entry == NULL)
 		return false;
 
+	_nodeID = entry->node_id;
+	_missing = entry->missing;
+
+	// Recently used entries don't need to be touched at all, so that
+	// concurrent lookups of hot entries only share the lock.
+	if (atomic_get(&entry->generation) == fCurrentGeneration)
+		return true;
+
 	int32 oldGeneration = atomic_get_and_set(&entry->generation,
 			fCurrentGeneration);
 	if (oldGeneration == fCurrentGeneration || entry->index < 0) {
 		// The entry is already in the current generation or is being moved to
 		// it by another thread.
-		_nodeID = entry->node_id;
 		return true;
 	}
 
@@ -179,11 +187,10 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID)
 	entry->index = kEntryNotInArray;
 
 	// add to the current generation
-	int32 index = atomic_add(&fGenerations[oldGeneration].next_index, 1);
+	int32 index = atomic_add(&fGenerations[fCurrentGeneration].next_index, 1);
 	if (index < kEntriesPerGeneration) {
 		fGenerations[fCurrentGeneration].entries[index] = entry;
 		entry->index = index;
-		_nodeID = entry->node_id;
 		return true;
 	}
 
@@ -201,16 +208,18 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID)
 	_AddEntryToCurrentGeneration(entry);
 
 	_nodeID = entry->node_id;
+	_missing = entry->missing;
 	return true;
 }
 
 
 const char*
-EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
+EntryCacheShard::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 {
 	for (EntryTable::Iterator it = fEntries.GetIterator();
 			EntryCacheEntry* entry = it.Next();) {
-		if (nodeID == entry->node_id && strcmp(entry->name, ".") != 0
+		if (nodeID == entry->node_id && !entry->missing
+				&& strcmp(entry->name, ".") != 0
 				&& strcmp(entry->name, "..") != 0) {
 			_dirID = entry->dir_id;
 			return entry->name;
@@ -222,7 +231,7 @@ EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 
 
 void
-EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
+EntryCacheShard::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 {
 	// the generation might not be full yet
 	int32 index = fGenerations[fCurrentGeneration].next_index++;
@@ -252,3 +261,90 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 	entry->generation = newGeneration;
 	entry->index = 0;
 }
+
+
+// #pragma mark - EntryCache
+
+
+EntryCache::EntryCache()
+	:
+	fShards(NULL)
+{
+}
+
+
+EntryCache::~EntryCache()
+{
+	if (fShards == NULL)
+		return;
+
+	for (int32 i = 0; i < kShardCount; i++)
+		fShards[i].~EntryCacheShard();
+
+	free(fShards);
+}
+
+
+status_t
+EntryCache::Init()
+{
+	// every shard lives on its own cache lines, so that lookups in different
+	// shards don't contend
+	fShards = (EntryCacheShard*)memalign(CACHE_LINE_SIZE,
+		sizeof(EntryCacheShard) * kShardCount);
+	if (fShards == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = 0; i < kShardCount; i++)
+		new(&fShards[i]) EntryCacheShard;
+
+	for (int32 i = 0; i < kShardCount; i++) {
+		status_t error = fShards[i].Init();
+		if (error != B_OK)
+			return error;
+	}
+
+	return B_OK;
+}
+
+
+status_t
+EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
+{
+	EntryCacheKey key(dirID, name);
+	return _ShardFor(key).Add(key, nodeID, missing);
+}
+
+
+status_t
+EntryCache::Remove(ino_t dirID, const char* name)
+{
+	EntryCacheKey key(dirID, name);
+	return _ShardFor(key).Remove(key);
+}
+
+
+/*!	Returns \c true, if the cache contains an entry for  name in the
+	directory  dirID. If the entry is known not to exist,  _missing is set
+	to \c true, and  _nodeID is not valid.
+*/
+bool
+EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
+	bool& _missing)
+{
+	EntryCacheKey key(dirID, name);
+	return _ShardFor(key).Lookup(key, _nodeID, _missing);
+}
+
+
+const char*
+EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
+{
+	for (int32 i = 0; i < kShardCount; i++) {
+		const char* name = fShards[i].DebugReverseLookup(nodeID, _dirID);
+		if (name != NULL)
+			return name;
+	}
+
+	return NULL;
+}
@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 
+#include <cpu.h>
 #include <util/AutoLock.h>
 #include <util/OpenHashTable.h>
 #include <util/StringHash.h>
@@ -36,6 +37,7 @@ struct EntryCacheEntry {
 			ino_t				dir_id;
 			int32				generation;
 			int32				index;
+			bool				missing;
 			char				name[1];
 };
 
@@ -79,20 +81,20 @@ struct EntryCacheHashDefinition {
 };
 
 
-class EntryCache {
+class EntryCacheShard {
 public:
-								EntryCache();
-								~EntryCache();
+								EntryCacheShard();
+								~EntryCacheShard();
 
 			status_t			Init();
 
-			status_t			Add(ino_t dirID, const char* name,
-									ino_t nodeID);
+			status_t			Add(const EntryCacheKey& key, ino_t nodeID,
+									bool missing);
 
-			status_t			Remove(ino_t dirID, const char* name);
+			status_t			Remove(const EntryCacheKey& key);
 
-			bool				Lookup(ino_t dirID, const char* name,
-									ino_t& nodeID);
+			bool				Lookup(const EntryCacheKey& key,
+									ino_t& nodeID, bool& missing);
 
 			const char*			DebugReverseLookup(ino_t nodeID, ino_t& _dirID);
 
@@ -100,7 +102,6 @@ private:
 	static	const int32			kGenerationCount = 8;
 
 			typedef BOpenHashTable<EntryCacheHashDefinition> EntryTable;
-			typedef DoublyLinkedList<EntryCacheEntry> EntryList;
 
 private:
 			void				_AddEntryToCurrentGeneration(
@@ -111,6 +112,38 @@ private:
 			EntryTable			fEntries;
 			EntryCacheGeneration fGenerations[kGenerationCount];
 			int32				fCurrentGeneration;
+} CACHE_LINE_ALIGN;
+
+
+class EntryCache {
+public:
+								EntryCache();
+								~EntryCache();
+
+			status_t			Init();
+
+			status_t			Add(ino_t dirID, const char* name,
+									ino_t nodeID, bool missing = false);
+
+			status_t			Remove(ino_t dirID, const char* name);
+
+			bool				Lookup(ino_t dirID, const char* name,
+									ino_t& nodeID, bool& missing);
+
+			const char*			DebugReverseLookup(ino_t nodeID, ino_t& _dirID);
+
+private:
+	static	const int32			kShardBits = 4;
+	static	const int32			kShardCount = 1 << kShardBits;
+
+			EntryCacheShard&	_ShardFor(const EntryCacheKey& key) const
+									{ return fShards[((uint32)key.hash
+										* 2654435761U) >> (32 - kShardBits)]; }
+									// uses the upper bits of the hash, since
+									// the lower ones select the table slot
+
+private:
+			EntryCacheShard*	fShards;
 };
 
 
@@ -23,6 +23,7 @@
 #include <arch/int.h>
 #include <boot/kernel_args.h>
 #include <elf.h>
+#include <kscheduler.h>
 #include <load_tracking.h>
 #include <util/AutoLock.h>
 #include <util/kqueue.h>
@@ -72,6 +73,21 @@ struct io_vector {
 #endif
 };
 
+struct irq_balance_cpu {
+	bigtime_t			last_real_time_active;
+	int32				real_time_load;
+	int32				irq_load;
+	bool				latency_critical;
+};
+
+static const int kIRQBalanceFrequency = 5;
+	// in 1/10 s
+static const int32 kIRQLoadDifference = 100;
+static const int32 kLatencyCriticalLoad = 20;
+	// share of a CPU's time spent in real-time threads from which on it is
+	// kept free of device interrupts
+static const int32 kMaxIRQMovesPerPass = 4;
+
 static int32 sLastCPU;
 
 static io_vector sVectors[NUM_IO_VECTORS];
@@ -79,6 +95,12 @@ static bool sAllocatedIOInterruptVectors[NUM_IO_VECTORS];
 static irq_assignment sVectorCPUAssignments[NUM_IO_VECTORS];
 static mutex sIOInterruptVectorAllocationLock
 	= MUTEX_INITIALIZER("io_interrupt_vector_allocation");
+static spinlock sIRQAssignmentLock = B_SPINLOCK_INITIALIZER;
+	// serializes all changes of the CPUs the IRQs are assigned to; nests
+	// inside the vector locks, and outside the CPUs' irqs_lock
+
+static irq_balance_cpu sIRQBalanceCPUs[SMP_MAX_CPUS];
+static bigtime_t sLastIRQBalanceTime;
 
 
 #if DEBUG_INTERRUPTS
@@ -169,6 +191,236 @@ dump_int_load(int argc, char** argv)
 }
 
 
+static int
+dump_irq_balance(int argc, char** argv)
+{
+	kprintf("cpu  irq load  real-time load\n");
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		irq_balance_cpu& cpu = sIRQBalanceCPUs[i];
+		kprintf("%3" B_PRId32 "  %7" B_PRId32 "%%  %13" B_PRId32 "%%%s%s\n", i,
+			cpu.irq_load / 10, cpu.real_time_load / 10,
+			cpu.latency_critical ? "  latency critical" : "",
+			gCPU[i].disabled ? "  disabled" : "");
+	}
+
+	return 0;
+}
+
+
+//	#pragma mark - IRQ balancing
+
+
+static bigtime_t
+get_real_time_active_time(int32 cpu)
+{
+	bigtime_t activeTime;
+	uint32 count;
+
+	do {
+		count = acquire_read_seqlock(&gCPU[cpu].active_time_lock);
+		activeTime = gCPU[cpu].real_time_active_time;
+	} while (!release_read_seqlock(&gCPU[cpu].active_time_lock, count));
+
+	return activeTime;
+}
+
+
+/*!	Determines which CPUs have recently been running real-time threads. The
+	load rises as soon as such a thread shows up, but only decays slowly, so
+	that interrupts don't bounce back and forth between CPUs whose real-time
+	threads run only now and then.
+*/
+static void
+update_latency_critical_cpus()
+{
+	bigtime_t now = system_time();
+	bigtime_t interval = now - sLastIRQBalanceTime;
+	sLastIRQBalanceTime = now;
+
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		irq_balance_cpu& cpu = sIRQBalanceCPUs[i];
+
+		bigtime_t activeTime = get_real_time_active_time(i);
+		int32 load = 0;
+		if (interval > 0) {
+			load = min_c((activeTime - cpu.last_real_time_active) * kMaxLoad
+				/ interval, kMaxLoad);
+		}
+		cpu.last_real_time_active = activeTime;
+
+		cpu.real_time_load = max_c(load, cpu.real_time_load / 2);
+		cpu.latency_critical = !gCPU[i].disabled
+			&& cpu.real_time_load >= kLatencyCriticalLoad;
+	}
+}
+
+
+static int32
+compute_irq_load(int32 cpu)
+{
+	SpinLocker locker(gCPU[cpu].irqs_lock);
+
+	int32 load = 0;
+	irq_assignment* irq = (irq_assignment*)list_get_first_item(&gCPU[cpu].irqs);
+	while (irq != NULL) {
+		load += irq->load;
+		irq = (irq_assignment*)list_get_next_item(&gCPU[cpu].irqs, irq);
+	}
+
+	return load;
+}
+
+
+/*!	Returns the first vector of the busiest IRQ assigned to \a cpu whose load
+	is below \a maxLoad, or -1 if there is none.
+	MSI allocations of several vectors share a single assignment, so they are
+	always moved together.
+*/
+static int32
+choose_irq_to_move(int32 cpu, int32 maxLoad, int32& _load)
+{
+	SpinLocker locker(gCPU[cpu].irqs_lock);
+
+	irq_assignment* chosen = NULL;
+	irq_assignment* irq = (irq_assignment*)list_get_first_item(&gCPU[cpu].irqs);
+	while (irq != NULL) {
+		if (irq->load < maxLoad && (chosen == NULL || chosen->load < irq->load))
+			chosen = irq;
+		irq = (irq_assignment*)list_get_next_item(&gCPU[cpu].irqs, irq);
+	}
+
+	if (chosen == NULL)
+		return -1;
+
+	_load = chosen->load;
+	return chosen->irq;
+}
+
+
+/*!	Returns the enabled CPU not running latency-critical threads with the
+	lowest interrupt load. Of equally loaded CPUs the ones in the same package
+	as \a source are preferred, since they are likely to share a cache with it.
+*/
+static int32
+choose_irq_target(int32 source)
+{
+	int32 target = -1;
+	bool targetSharesPackage = false;
+
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		if (i == source || gCPU[i].disabled
+			|| sIRQBalanceCPUs[i].latency_critical) {
+			continue;
+		}
+
+		bool sharesPackage = gCPU[i].topology_id[CPU_TOPOLOGY_PACKAGE]
+			== gCPU[source].topology_id[CPU_TOPOLOGY_PACKAGE];
+		int32 load = sIRQBalanceCPUs[i].irq_load;
+
+		if (target == -1 || load < sIRQBalanceCPUs[target].irq_load
+			|| (load == sIRQBalanceCPUs[target].irq_load && sharesPackage
+				&& !targetSharesPackage)) {
+			target = i;
+			targetSharesPackage = sharesPackage;
+		}
+	}
+
+	return target;
+}
+
+
+static bool
+move_irq(int32 vector, int32 load, int32 from, int32 to)
+{
+	// the IRQ might have been removed or moved since it was chosen
+	if (to < 0 || !assign_io_interrupt_to_cpu(vector, from, to))
+		return false;
+
+	TRACE(("balance_irqs: moved irq %" B_PRId32 " (load %" B_PRId32 ") from "
+		"cpu %" B_PRId32 " to cpu %" B_PRId32 "\n", vector, load, from, to));
+
+	sIRQBalanceCPUs[from].irq_load -= load;
+	sIRQBalanceCPUs[to].irq_load += load;
+	return true;
+}
+
+
+/*!	Kernel daemon redistributing the IRQs between the CPUs. Interrupts are
+	first moved away from the CPUs running latency-critical threads, then the
+	remaining interrupt load is spread evenly over the other CPUs.
+	The scheduler modes only move the busiest IRQ of the CPU they are running
+	on, so this catches imbalances they don't notice.
+*/
+static void
+balance_irqs(void* /* data */, int /* iteration */)
+{
+	int32 cpuCount = smp_get_num_cpus();
+
+	update_latency_critical_cpus();
+
+	bool haveTarget = false;
+	for (int32 i = 0; i < cpuCount; i++) {
+		sIRQBalanceCPUs[i].irq_load = compute_irq_load(i);
+		if (!gCPU[i].disabled && !sIRQBalanceCPUs[i].latency_critical)
+			haveTarget = true;
+	}
+
+	int32 moves = 0;
+	for (int32 i = 0; haveTarget && i < cpuCount; i++) {
+		if (!sIRQBalanceCPUs[i].latency_critical)
+			continue;
+
+		while (moves < kMaxIRQMovesPerPass) {
+			int32 load;
+			int32 vector = choose_irq_to_move(i, INT32_MAX, load);
+			if (vector < 0 || !move_irq(vector, load, i, choose_irq_target(i)))
+				break;
+			moves++;
+		}
+	}
+
+	// In power saving mode the scheduler deliberately packs the interrupts
+	// onto as few cores as possible.
+	if (scheduler_get_operation_mode() == SCHEDULER_MODE_POWER_SAVING)
+		return;
+
+	while (moves < kMaxIRQMovesPerPass) {
+		int32 busiest = -1;
+		int32 idlest = -1;
+		for (int32 i = 0; i < cpuCount; i++) {
+			if (gCPU[i].disabled
+				|| (haveTarget && sIRQBalanceCPUs[i].latency_critical)) {
+				continue;
+			}
+
+			int32 load = sIRQBalanceCPUs[i].irq_load;
+			if (busiest == -1 || load > sIRQBalanceCPUs[busiest].irq_load)
+				busiest = i;
+			if (idlest == -1 || load < sIRQBalanceCPUs[idlest].irq_load)
+				idlest = i;
+		}
+
+		if (busiest == idlest)
+			break;
+
+		int32 difference = sIRQBalanceCPUs[busiest].irq_load
+			- sIRQBalanceCPUs[idlest].irq_load;
+		if (difference < kIRQLoadDifference)
+			break;
+
+		// Only moving an IRQ with less load than the difference brings the
+		// two CPUs closer together.
+		int32 load;
+		int32 vector = choose_irq_to_move(busiest, difference, load);
+		if (vector < 0 || load == 0
+			|| !move_irq(vector, load, busiest, idlest)) {
+			break;
+		}
+		moves++;
+	}
+}
+
+
 //	#pragma mark - private kernel API
 
 
@@ -244,6 +496,12 @@ int_init_post_device_manager(kernel_args* args)
 {
 	arch_debug_install_interrupt_handlers();
 
+	if (smp_get_num_cpus() > 1)
+		register_kernel_daemon(&balance_irqs, NULL, kIRQBalanceFrequency);
+
+	add_debugger_command("irq_balance", &dump_irq_balance,
+		"show the state of the IRQ balancer");
+
 	return arch_int_init_post_device_manager(args);
 }
 
@@ -463,6 +721,7 @@ install_io_interrupt_handler(long vector, interrupt_handler handler, void *data,
 
 	// Initial attempt to balance IRQs, the scheduler will correct this
 	// if some cores end up being overloaded.
+	SpinLocker assignmentLocker(sIRQAssignmentLock);
 	if (sVectors[vector].type == INTERRUPT_TYPE_IRQ
 		&& sVectors[vector].handler_list == NULL
 		&& sVectors[vector].assigned_cpu->cpu == -1) {
@@ -476,6 +735,7 @@ install_io_interrupt_handler(long vector, interrupt_handler handler, void *data,
 		atomic_add(&sVectors[vector].assigned_cpu->handlers_count, 1);
 		list_add_item(&cpu->irqs, sVectors[vector].assigned_cpu);
 	}
+	assignmentLocker.Unlock();
 
 	if ((flags & B_NO_HANDLED_INFO) != 0
 		&& sVectors[vector].handler_list != NULL) {
@@ -571,21 +831,13 @@ remove_io_interrupt_handler(long vector, interrupt_handler handler, void *data)
 			= atomic_add(&sVectors[vector].assigned_cpu->handlers_count, -1);
 
 		if (oldHandlersCount == 1) {
-			int32 oldCPU;
-			SpinLocker locker;
-			cpu_ent* cpu;
+			SpinLocker assignmentLocker(sIRQAssignmentLock);
 
-			do {
-				locker.Unlock();
-
-				oldCPU = sVectors[vector].assigned_cpu->cpu;
-
-				ASSERT(oldCPU != -1);
-				cpu = &gCPU[oldCPU];
-
-				locker.SetTo(cpu->irqs_lock, false);
-			} while (sVectors[vector].assigned_cpu->cpu != oldCPU);
+			int32 oldCPU = sVectors[vector].assigned_cpu->cpu;
+			ASSERT(oldCPU != -1);
+			cpu_ent* cpu = &gCPU[oldCPU];
 
+			SpinLocker locker(cpu->irqs_lock);
 			sVectors[vector].assigned_cpu->cpu = -1;
 			list_remove_item(&cpu->irqs, sVectors[vector].assigned_cpu);
 		}
@@ -714,19 +966,28 @@ free_io_interrupt_vectors(long count, long startVector)
 }
 
 
-void assign_io_interrupt_to_cpu(long vector, int32 newCPU)
+/*!	Moves the IRQ of \a vector from \a oldCPU to \a newCPU, or to any CPU,
+	if \a newCPU is -1.
+	Returns \c false, if the IRQ isn't assigned to \a oldCPU (anymore), as it
+	might have been moved or removed since the caller looked at it.
+*/
+bool
+assign_io_interrupt_to_cpu(long vector, int32 oldCPU, int32 newCPU)
 {
 	ASSERT(sVectors[vector].type == INTERRUPT_TYPE_IRQ);
 
-	int32 oldCPU = sVectors[vector].assigned_cpu->cpu;
+	InterruptsSpinLocker assignmentLocker(sIRQAssignmentLock);
+
+	irq_assignment* assignment = sVectors[vector].assigned_cpu;
+	if (assignment == NULL || assignment->cpu != oldCPU)
+		return false;
 
 	if (newCPU == -1)
 		newCPU = assign_cpu();
 
 	if (newCPU == oldCPU)
-		return;
+		return true;
 
-	ASSERT(oldCPU != -1);
 	cpu_ent* cpu = &gCPU[oldCPU];
 
 	SpinLocker locker(cpu->irqs_lock);
@@ -739,5 +1000,16 @@ void assign_io_interrupt_to_cpu(long vector, int32 newCPU)
 	sVectors[vector].assigned_cpu->cpu = newCPU;
 	arch_int_assign_to_cpu(vector, newCPU);
 	list_add_item(&cpu->irqs, sVectors[vector].assigned_cpu);
+	return true;
+}
+
+
+/*!	Returns whether \a cpu has recently been running real-time threads, and
+	should therefore not be assigned any device interrupts.
+*/
+bool
+is_latency_critical_cpu(int32 cpu)
+{
+	return sIRQBalanceCPUs[cpu].latency_critical;
 }
 
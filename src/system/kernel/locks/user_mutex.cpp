@@ -12,8 +12,8 @@
 #include <lock.h>
 #include <smp.h>
 #include <syscall_restart.h>
+#include <team.h>
 #include <util/AutoLock.h>
-#include <util/OpenHashTable.h>
 #include <vm/vm.h>
 #include <vm/VMArea.h>
 
@@ -23,59 +23,87 @@ typedef DoublyLinkedList<UserMutexEntry> UserMutexEntryList;
 
 struct UserMutexEntry : public DoublyLinkedListLinkImpl<UserMutexEntry> {
 	addr_t				address;
+	int32*				userAddress;
+	team_id				team;
 	ConditionVariable	condition;
 	bool				locked;
 	UserMutexEntryList	otherEntries;
 	UserMutexEntry*		hashNext;
 };
 
-struct UserMutexHashDefinition {
-	typedef addr_t			KeyType;
-	typedef UserMutexEntry	ValueType;
+/*!	The waiting entries are spread over a fixed number of buckets, each with
+	its own lock, so that unrelated mutexes don't contend for a single lock.
+	Every bucket contains a chain of the first entries for each address; the
+	other entries waiting on the same address are queued in the first entry's
+	otherEntries list.
+*/
+struct UserMutexBucket {
+	mutex				lock;
+	UserMutexEntry*		entries;
+};
 
-	size_t HashKey(addr_t key) const
-	{
-		return key >> 2;
-	}
+static const uint32 kUserMutexBucketCount = 256;
 
-	size_t Hash(const UserMutexEntry* value) const
-	{
-		return HashKey(value->address);
-	}
+static UserMutexBucket sUserMutexBuckets[kUserMutexBucketCount];
 
-	bool Compare(addr_t key, const UserMutexEntry* value) const
-	{
-		return value->address == key;
-	}
 
-	UserMutexEntry*& GetLink(UserMutexEntry* value) const
-	{
-		return value->hashNext;
+static inline UserMutexBucket&
+get_user_mutex_bucket(addr_t address)
+{
+	return sUserMutexBuckets[((address >> 2) * 2654435761U)
+		% kUserMutexBucketCount];
+}
+
+
+static UserMutexEntry*
+lookup_user_mutex_entry(UserMutexBucket& bucket, addr_t address)
+{
+	for (UserMutexEntry* entry = bucket.entries; entry != NULL;
+			entry = entry->hashNext) {
+		if (entry->address == address)
+			return entry;
 	}
-};
 
-typedef BOpenHashTable<UserMutexHashDefinition> UserMutexTable;
+	return NULL;
+}
 
 
-static UserMutexTable sUserMutexTable;
-static mutex sUserMutexTableLock = MUTEX_INITIALIZER("user mutex table");
+static void
+insert_first_user_mutex_entry(UserMutexBucket& bucket, UserMutexEntry* entry)
+{
+	entry->hashNext = bucket.entries;
+	bucket.entries = entry;
+}
+
+
+static void
+remove_first_user_mutex_entry(UserMutexBucket& bucket, UserMutexEntry* entry)
+{
+	UserMutexEntry** link = &bucket.entries;
+	while (*link != entry)
+		link = &(*link)->hashNext;
+
+	*link = entry->hashNext;
+}
 
 
 static void
-add_user_mutex_entry(UserMutexEntry* entry)
+add_user_mutex_entry(UserMutexBucket& bucket, UserMutexEntry* entry)
 {
-	UserMutexEntry* firstEntry = sUserMutexTable.Lookup(entry->address);
+	UserMutexEntry* firstEntry = lookup_user_mutex_entry(bucket,
+		entry->address);
 	if (firstEntry != NULL)
 		firstEntry->otherEntries.Add(entry);
 	else
-		sUserMutexTable.Insert(entry);
+		insert_first_user_mutex_entry(bucket, entry);
 }
 
 
 static bool
-remove_user_mutex_entry(UserMutexEntry* entry)
+remove_user_mutex_entry(UserMutexBucket& bucket, UserMutexEntry* entry)
 {
-	UserMutexEntry* firstEntry = sUserMutexTable.Lookup(entry->address);
+	UserMutexEntry* firstEntry = lookup_user_mutex_entry(bucket,
+		entry->address);
 	if (firstEntry != entry) {
 		// The entry is not the first entry in the table. Just remove it from
 		// the first entry's list.
@@ -85,12 +113,12 @@ remove_user_mutex_entry(UserMutexEntry* entry)
 
 	// The entry is the first entry in the table. Remove it from the table and,
 	// if any, add the next entry to the table.
-	sUserMutexTable.Remove(entry);
+	remove_first_user_mutex_entry(bucket, entry);
 
 	firstEntry = entry->otherEntries.RemoveHead();
 	if (firstEntry != NULL) {
 		firstEntry->otherEntries.MoveFrom(&entry->otherEntries);
-		sUserMutexTable.Insert(firstEntry);
+		insert_first_user_mutex_entry(bucket, firstEntry);
 		return true;
 	}
 
@@ -98,9 +126,81 @@ remove_user_mutex_entry(UserMutexEntry* entry)
 }
 
 
+/*!	Locks the two bucket locks in a defined order, so that two threads
+	locking the same pair of buckets cannot deadlock. Both may be the same.
+*/
+static void
+lock_user_mutex_buckets(mutex* lock1, mutex* lock2)
+{
+	mutex* firstLock = lock1 < lock2 ? lock1 : lock2;
+	mutex* secondLock = lock1 < lock2 ? lock2 : lock1;
+
+	mutex_lock(firstLock);
+	if (secondLock != firstLock)
+		mutex_lock(secondLock);
+}
+
+
+/*!	Dequeues an entry that has been requeued onto another mutex while
+	waiting. Since it may be requeued again until it is dequeued, the entry's
+	current address is only trusted with the respective bucket locked.
+*/
+static status_t
+user_mutex_dequeue_requeued(UserMutexEntry& entry, status_t error)
+{
+	while (true) {
+		addr_t address = entry.address;
+		int32* mutex = entry.userAddress;
+
+		VMPageWiringInfo wiringInfo;
+		bool wired = vm_wire_page(B_CURRENT_TEAM, (addr_t)mutex, true,
+			&wiringInfo) == B_OK;
+
+		UserMutexBucket& bucket = get_user_mutex_bucket(address);
+		MutexLocker locker(bucket.lock);
+
+		if (entry.address != address || entry.userAddress != mutex) {
+			locker.Unlock();
+			if (wired)
+				vm_unwire_page(&wiringInfo);
+			continue;
+		}
+
+		if (!remove_user_mutex_entry(bucket, &entry) && wired) {
+			// no one is waiting anymore -- clear the waiting flag
+			atomic_and(mutex, ~(int32)B_USER_MUTEX_WAITING);
+		}
+
+		if (error != B_OK && (entry.locked
+				|| (wired && (*mutex & B_USER_MUTEX_DISABLED) != 0))) {
+			// timeout or interrupt, but the mutex was unlocked or disabled in
+			// time
+			error = B_OK;
+		}
+
+		locker.Unlock();
+		if (wired)
+			vm_unwire_page(&wiringInfo);
+
+		break;
+	}
+
+	if (error == B_OK && entry.locked)
+		return B_USER_MUTEX_REQUEUED;
+
+	return error;
+}
+
+
+/*!	Locks the user mutex, or waits until it has been handed over.
+	The caller must hold the lock of the mutex's bucket via \a locker. If
+	\a otherLock is given, it is another bucket lock held by the caller; it is
+	released as soon as the thread has been queued, or got the mutex.
+*/
 static status_t
 user_mutex_lock_locked(int32* mutex, addr_t physicalAddress, const char* name,
-	uint32 flags, bigtime_t timeout, MutexLocker& locker)
+	uint32 flags, bigtime_t timeout, MutexLocker& locker,
+	struct mutex* otherLock = NULL)
 {
 	// mark the mutex locked + waiting
 	int32 oldValue = atomic_or(mutex,
@@ -111,28 +211,41 @@ user_mutex_lock_locked(int32* mutex, addr_t physicalAddress, const char* name,
 			|| (oldValue & B_USER_MUTEX_DISABLED) != 0) {
 		// clear the waiting flag and be done
 		atomic_and(mutex, ~(int32)B_USER_MUTEX_WAITING);
+		if (otherLock != NULL)
+			mutex_unlock(otherLock);
 		return B_OK;
 	}
 
 	// we have to wait
 
 	// add the entry to the table
+	UserMutexBucket& bucket = get_user_mutex_bucket(physicalAddress);
 	UserMutexEntry entry;
 	entry.address = physicalAddress;
+	entry.userAddress = mutex;
+	entry.team = team_get_current_team_id();
 	entry.locked = false;
-	add_user_mutex_entry(&entry);
+	add_user_mutex_entry(bucket, &entry);
 
 	// wait
 	ConditionVariableEntry waitEntry;
 	entry.condition.Init((void*)physicalAddress, "user mutex");
 	entry.condition.Add(&waitEntry);
 
+	if (otherLock != NULL)
+		mutex_unlock(otherLock);
 	locker.Unlock();
 	status_t error = waitEntry.Wait(flags, timeout);
 	locker.Lock();
 
+	if (entry.address != physicalAddress) {
+		// we have been moved to another mutex in the meantime
+		locker.Unlock();
+		return user_mutex_dequeue_requeued(entry, error);
+	}
+
 	// dequeue
-	if (!remove_user_mutex_entry(&entry)) {
+	if (!remove_user_mutex_entry(bucket, &entry)) {
 		// no one is waiting anymore -- clear the waiting flag
 		atomic_and(mutex, ~(int32)B_USER_MUTEX_WAITING);
 	}
@@ -150,7 +263,9 @@ user_mutex_lock_locked(int32* mutex, addr_t physicalAddress, const char* name,
 static void
 user_mutex_unlock_locked(int32* mutex, addr_t physicalAddress, uint32 flags)
 {
-	if (UserMutexEntry* entry = sUserMutexTable.Lookup(physicalAddress)) {
+	UserMutexBucket& bucket = get_user_mutex_bucket(physicalAddress);
+	if (UserMutexEntry* entry = lookup_user_mutex_entry(bucket,
+			physicalAddress)) {
 		// Someone is waiting -- set the locked flag. It might still be set,
 		// but when using userland atomic operations, the caller will usually
 		// have cleared it already.
@@ -177,6 +292,75 @@ user_mutex_unlock_locked(int32* mutex, addr_t physicalAddress, uint32 flags)
 }
 
 
+/*!	Unblocks the first thread waiting on \a fromMutex and moves all other
+	waiting threads of the current team over to \a toMutex, as if they had
+	tried to lock that one instead. If \a toMutex isn't locked, it is handed
+	over to the first of them right away.
+	The caller must hold the locks of both buckets.
+*/
+static void
+user_mutex_requeue_locked(int32* fromMutex, addr_t fromAddress,
+	int32* toMutex, addr_t toAddress)
+{
+	UserMutexBucket& fromBucket = get_user_mutex_bucket(fromAddress);
+	UserMutexBucket& toBucket = get_user_mutex_bucket(toAddress);
+
+	UserMutexEntry* entry = lookup_user_mutex_entry(fromBucket, fromAddress);
+	if (entry == NULL) {
+		// no one is waiting -- clear locked flag
+		atomic_and(fromMutex, ~(int32)B_USER_MUTEX_LOCKED);
+		return;
+	}
+
+	int32 oldValue = atomic_or(fromMutex, B_USER_MUTEX_LOCKED);
+	bool disabled = (oldValue & B_USER_MUTEX_DISABLED) != 0;
+
+	// unblock the first thread
+	entry->locked = true;
+	entry->condition.NotifyOne();
+
+	team_id team = team_get_current_team_id();
+	bool firstMoved = true;
+
+	UserMutexEntryList::Iterator it = entry->otherEntries.GetIterator();
+	while (UserMutexEntry* otherEntry = it.Next()) {
+		if (otherEntry->locked) {
+			// already unblocked, but not yet dequeued
+			continue;
+		}
+
+		if (disabled || otherEntry->team != team || fromAddress == toAddress) {
+			// The mutex is gone, or the thread might not see the other mutex
+			// at the same address -- just unblock it.
+			otherEntry->locked = true;
+			otherEntry->condition.NotifyOne();
+			continue;
+		}
+
+		it.Remove();
+
+		if (firstMoved) {
+			firstMoved = false;
+
+			// mark the mutex locked + waiting, the same way
+			// user_mutex_lock_locked() does
+			int32 toValue = atomic_or(toMutex,
+				B_USER_MUTEX_LOCKED | B_USER_MUTEX_WAITING);
+			if ((toValue & (B_USER_MUTEX_LOCKED | B_USER_MUTEX_WAITING)) == 0
+				|| (toValue & B_USER_MUTEX_DISABLED) != 0) {
+				// we have just locked the mutex on behalf of this thread
+				otherEntry->locked = true;
+				otherEntry->condition.NotifyOne();
+			}
+		}
+
+		otherEntry->address = toAddress;
+		otherEntry->userAddress = toMutex;
+		add_user_mutex_entry(toBucket, otherEntry);
+	}
+}
+
+
 static status_t
 user_mutex_lock(int32* mutex, const char* name, uint32 flags, bigtime_t timeout)
 {
@@ -189,7 +373,8 @@ user_mutex_lock(int32* mutex, const char* name, uint32 flags, bigtime_t timeout)
 
 	// get the lock
 	{
-		MutexLocker locker(sUserMutexTableLock);
+		MutexLocker locker(
+			get_user_mutex_bucket(wiringInfo.physicalAddress).lock);
 		error = user_mutex_lock_locked(mutex, wiringInfo.physicalAddress, name,
 			flags, timeout, locker);
 	}
@@ -219,14 +404,20 @@ user_mutex_switch_lock(int32* fromMutex, int32* toMutex, const char* name,
 		return error;
 	}
 
-	// unlock the first mutex and lock the second one
+	// Unlock the first mutex and lock the second one. Both buckets stay
+	// locked until we are queued on the second mutex; otherwise a requeue or
+	// an unlock of it could miss us, and we would never be woken up.
+	mutex* fromLock
+		= &get_user_mutex_bucket(fromWiringInfo.physicalAddress).lock;
+	mutex* toLock = &get_user_mutex_bucket(toWiringInfo.physicalAddress).lock;
+	lock_user_mutex_buckets(fromLock, toLock);
+
 	{
-		MutexLocker locker(sUserMutexTableLock);
+		MutexLocker locker(toLock, true);
 		user_mutex_unlock_locked(fromMutex, fromWiringInfo.physicalAddress,
 			flags);
-
 		error = user_mutex_lock_locked(toMutex, toWiringInfo.physicalAddress,
-			name, flags, timeout, locker);
+			name, flags, timeout, locker, fromLock != toLock ? fromLock : NULL);
 	}
 
 	// unwire the pages
@@ -237,14 +428,53 @@ user_mutex_switch_lock(int32* fromMutex, int32* toMutex, const char* name,
 }
 
 
+static status_t
+user_mutex_requeue(int32* fromMutex, int32* toMutex)
+{
+	// wire the pages and get the physical addresses
+	VMPageWiringInfo fromWiringInfo;
+	status_t error = vm_wire_page(B_CURRENT_TEAM, (addr_t)fromMutex, true,
+		&fromWiringInfo);
+	if (error != B_OK)
+		return error;
+
+	VMPageWiringInfo toWiringInfo;
+	error = vm_wire_page(B_CURRENT_TEAM, (addr_t)toMutex, true, &toWiringInfo);
+	if (error != B_OK) {
+		vm_unwire_page(&fromWiringInfo);
+		return error;
+	}
+
+	mutex* fromLock
+		= &get_user_mutex_bucket(fromWiringInfo.physicalAddress).lock;
+	mutex* toLock = &get_user_mutex_bucket(toWiringInfo.physicalAddress).lock;
+	lock_user_mutex_buckets(fromLock, toLock);
+
+	user_mutex_requeue_locked(fromMutex, fromWiringInfo.physicalAddress,
+		toMutex, toWiringInfo.physicalAddress);
+
+	if (toLock != fromLock)
+		mutex_unlock(toLock);
+	mutex_unlock(fromLock);
+
+	// unwire the pages
+	vm_unwire_page(&toWiringInfo);
+	vm_unwire_page(&fromWiringInfo);
+
+	return B_OK;
+}
+
+
 // #pragma mark - kernel private
 
 
 void
 user_mutex_init()
 {
-	if (sUserMutexTable.Init() != B_OK)
-		panic("user_mutex_init(): Failed to init table!");
+	for (uint32 i = 0; i < kUserMutexBucketCount; i++) {
+		mutex_init(&sUserMutexBuckets[i].lock, "user mutex bucket");
+		sUserMutexBuckets[i].entries = NULL;
+	}
 }
 
 
@@ -281,7 +511,8 @@ _user_mutex_unlock(int32* mutex, uint32 flags)
 		return error;
 
 	{
-		MutexLocker locker(sUserMutexTableLock);
+		MutexLocker locker(
+			get_user_mutex_bucket(wiringInfo.physicalAddress).lock);
 		user_mutex_unlock_locked(mutex, wiringInfo.physicalAddress, flags);
 	}
 
@@ -304,3 +535,16 @@ _user_mutex_switch_lock(int32* fromMutex, int32* toMutex, const char* name,
 	return user_mutex_switch_lock(fromMutex, toMutex, name,
 		flags | B_CAN_INTERRUPT, timeout);
 }
+
+
+status_t
+_user_mutex_requeue(int32* fromMutex, int32* toMutex)
+{
+	if (fromMutex == NULL || !IS_USER_ADDRESS(fromMutex)
+			|| (addr_t)fromMutex % 4 != 0 || toMutex == NULL
+			|| !IS_USER_ADDRESS(toMutex) || (addr_t)toMutex % 4 != 0) {
+		return B_BAD_ADDRESS;
+	}
+
+	return user_mutex_requeue(fromMutex, toMutex);
+}
@@ -23,6 +23,7 @@
 #include <AutoDeleter.h>
 
 #include <arch/int.h>
+#include <cpu.h>
 #include <heap.h>
 #include <kernel.h>
 #include <Notifications.h>
@@ -55,18 +56,24 @@
 
 
 // Locking:
-// * sPortsLock: Protects the sPorts and sPortsByName hash tables.
+// * sPortShards[].lock: Protects the hash table of the respective shard. A
+//   port is in the shard given by (Port::id & (kPortHashShardCount - 1)).
+// * sPortNameShards[].lock: Likewise, for the by-name hash tables. The shard
+//   is selected by the port's name hash.
 // * sTeamListLock[]: Protects Team::port_list. Lock index for given team is
 //   (Team::id % kTeamListLockCount).
 // * Port::lock: Protects all Port members save team_link, hash_link, lock and
 //   state. id is immutable.
 //
+// Looking up a port by ID only ever locks the port's own shard, so reading
+// and writing different ports doesn't contend on any global lock.
+//
 // Port::state ensures atomicity by providing a linearization point for adding
 // and removing ports to the hash tables and the team port list.
-// * sPortsLock and sTeamListLock[] are locked separately and not in a nested
-//   fashion, so a port can be in the hash table but not in the team port list
-//   or vice versa. => Without further provisions, insertion and removal are
-//   not linearizable and thus not concurrency-safe.
+// * The shard locks and sTeamListLock[] are locked separately and not in a
+//   nested fashion, so a port can be in the hash table but not in the team
+//   port list or vice versa. => Without further provisions, insertion and
+//   removal are not linearizable and thus not concurrency-safe.
 // * To make insertion and removal linearizable, Port::state was added. It is
 //   always only accessed atomically and updates are done using
 //   atomic_test_and_set(). A port is only seen as existent when its state is
@@ -103,6 +110,58 @@ struct port_message : DoublyLinkedListLinkImpl<port_message> {
 typedef DoublyLinkedList<port_message> MessageList;
 
 
+// A reader blocking on a port with a large enough buffer. It pins its buffer,
+// so that a writer can copy a large message directly into it, instead of
+// going through a kernel buffer. It waits on its own condition variable, so
+// that a writer can wake up just this reader. The state is protected by the
+// port lock.
+// Readers that wait in port_buffer_size_etc() first, like BLooper and
+// LinkReceiver, don't have a buffer yet, and always get the message through
+// a kernel buffer.
+struct port_direct_reader : DoublyLinkedListLinkImpl<port_direct_reader> {
+	enum State {
+		kWaiting = 0,
+		kClaimed,
+		kDone,
+		kNotified
+	};
+
+	team_id				team;
+	void*				buffer;
+	size_t				buffer_size;
+	physical_entry*		vecs;
+	uint32				vec_count;
+	int32				state;
+	int32				code;
+	ssize_t				result;
+	ConditionVariable	condition;
+
+	port_direct_reader()
+		:
+		team(-1),
+		buffer(NULL),
+		buffer_size(0),
+		vecs(NULL),
+		vec_count(0),
+		state(kWaiting),
+		code(0),
+		result(0)
+	{
+		condition.Init(this, "port direct read");
+	}
+
+	~port_direct_reader()
+	{
+		if (vecs != NULL) {
+			unlock_memory_etc(team, buffer, buffer_size, B_READ_DEVICE);
+			free(vecs);
+		}
+	}
+};
+
+typedef DoublyLinkedList<port_direct_reader> DirectReaderList;
+
+
 struct Port : public KernelReferenceable {
 	enum State {
 		kUnused = 0,
@@ -127,6 +186,11 @@ struct Port : public KernelReferenceable {
 		// messages read from port since creation
 	select_info*		select_infos;
 	MessageList			messages;
+	DirectReaderList	direct_readers;
+	int64				copied_bytes;
+		// message bytes that went through a kernel buffer
+	int64				direct_bytes;
+		// message bytes copied directly into the reader's buffer
 
 	Port(team_id owner, int32 queueLength, char* name)
 		:
@@ -137,7 +201,9 @@ struct Port : public KernelReferenceable {
 		read_count(0),
 		write_count(queueLength),
 		total_count(0),
-		select_infos(NULL)
+		select_infos(NULL),
+		copied_bytes(0),
+		direct_bytes(0)
 	{
 		// id is initialized when the caller adds the port to the hash table
 
@@ -157,13 +223,20 @@ struct Port : public KernelReferenceable {
 };
 
 
+enum {
+	kPortHashShardBits = 5,
+	kPortHashShardCount = 1 << kPortHashShardBits
+};
+
+
 struct PortHashDefinition {
 	typedef port_id		KeyType;
 	typedef	Port		ValueType;
 
 	size_t HashKey(port_id key) const
 	{
-		return key;
+		// the lower bits select the shard
+		return (uint32)key >> kPortHashShardBits;
 	}
 
 	size_t Hash(Port* value) const
@@ -225,6 +298,18 @@ struct PortNameHashDefinition {
 typedef BOpenHashTable<PortNameHashDefinition> PortNameHashTable;
 
 
+struct PortHashShard {
+	rw_lock				lock;
+	PortHashTable		ports;
+} CACHE_LINE_ALIGN;
+
+
+struct PortNameHashShard {
+	rw_lock				lock;
+	PortNameHashTable	ports;
+} CACHE_LINE_ALIGN;
+
+
 class PortNotificationService : public DefaultNotificationService {
 public:
 							PortNotificationService();
@@ -416,36 +501,52 @@ static const size_t kBufferGrowRate = kInitialPortBufferSize;
 #define MAX_QUEUE_LENGTH 4096
 #define PORT_MAX_MESSAGE_SIZE (256 * 1024)
 
+static const size_t kDirectTransferThreshold = 32 * 1024;
+	// messages from this size on are copied directly into a waiting reader
+
 static int32 sMaxPorts = 4096;
 static int32 sUsedPorts;
 
-static PortHashTable sPorts;
-static PortNameHashTable sPortsByName;
+static PortHashShard sPortShards[kPortHashShardCount];
+static PortNameHashShard sPortNameShards[kPortHashShardCount];
 static ConditionVariable sNoSpaceCondition;
 static int32 sTotalSpaceCommited;
 static int32 sWaitingForSpace;
-static port_id sNextPortID = 1;
+static int32 sNextPortID = 1;
 static bool sPortsActive = false;
-static rw_lock sPortsLock = RW_LOCK_INITIALIZER("ports list");
 
 enum {
-	kTeamListLockCount = 8
+	kTeamListLockCount = 64
 };
 
-static mutex sTeamListLock[kTeamListLockCount] = {
-	MUTEX_INITIALIZER("team ports list 1"),
-	MUTEX_INITIALIZER("team ports list 2"),
-	MUTEX_INITIALIZER("team ports list 3"),
-	MUTEX_INITIALIZER("team ports list 4"),
-	MUTEX_INITIALIZER("team ports list 5"),
-	MUTEX_INITIALIZER("team ports list 6"),
-	MUTEX_INITIALIZER("team ports list 7"),
-	MUTEX_INITIALIZER("team ports list 8")
-};
+static mutex sTeamListLock[kTeamListLockCount];
 
 static PortNotificationService sNotificationService;
 
 
+static inline PortHashShard&
+port_shard(port_id id)
+{
+	return sPortShards[id & (kPortHashShardCount - 1)];
+}
+
+
+static inline PortNameHashShard&
+port_name_shard(size_t nameHash)
+{
+	// use the upper bits, the lower ones select the table slot
+	return sPortNameShards[((uint32)nameHash * 2654435761U)
+		>> (32 - kPortHashShardBits)];
+}
+
+
+static inline PortNameHashShard&
+port_name_shard(Port* port)
+{
+	return port_name_shard(PortNameHashDefinition().Hash(port));
+}
+
+
 //	#pragma mark - TeamNotificationService
 
 
@@ -489,16 +590,18 @@ dump_port_list(int argc, char** argv)
 	kprintf("port             id  cap  read-cnt  write-cnt   total   team  "
 		"name\n");
 
-	for (PortHashTable::Iterator it = sPorts.GetIterator();
-		Port* port = it.Next();) {
-		if ((owner != -1 && port->owner != owner)
-			|| (name != NULL && strstr(port->lock.name, name) == NULL))
-			continue;
+	for (int32 i = 0; i < kPortHashShardCount; i++) {
+		for (PortHashTable::Iterator it = sPortShards[i].ports.GetIterator();
+				Port* port = it.Next();) {
+			if ((owner != -1 && port->owner != owner)
+				|| (name != NULL && strstr(port->lock.name, name) == NULL))
+				continue;
 
-		kprintf("%p %8" B_PRId32 " %4" B_PRId32 " %9" B_PRIu32 " %9" B_PRId32
-			" %8" B_PRId32 " %6" B_PRId32 "  %s\n", port, port->id,
-			port->capacity, port->read_count, port->write_count,
-			port->total_count, port->owner, port->lock.name);
+			kprintf("%p %8" B_PRId32 " %4" B_PRId32 " %9" B_PRIu32 " %9"
+				B_PRId32 " %8" B_PRId32 " %6" B_PRId32 "  %s\n", port,
+				port->id, port->capacity, port->read_count, port->write_count,
+				port->total_count, port->owner, port->lock.name);
+		}
 	}
 
 	return 0;
@@ -516,6 +619,8 @@ _dump_port_info(Port* port)
 	kprintf(" read_count:      %" B_PRIu32 "\n", port->read_count);
 	kprintf(" write_count:     %" B_PRId32 "\n", port->write_count);
 	kprintf(" total count:     %" B_PRId32 "\n", port->total_count);
+	kprintf(" copied bytes:    %" B_PRId64 "\n", port->copied_bytes);
+	kprintf(" direct bytes:    %" B_PRId64 "\n", port->direct_bytes);
 
 	if (!port->messages.IsEmpty()) {
 		kprintf("messages:\n");
@@ -554,7 +659,7 @@ dump_port_info(int argc, char** argv)
 	} else if (parse_expression(argv[1]) > 0) {
 		// if the argument looks like a number, treat it as such
 		int32 num = parse_expression(argv[1]);
-		Port* port = sPorts.Lookup(num);
+		Port* port = port_shard(num).ports.Lookup(num);
 		if (port == NULL || port->state != Port::kActive) {
 			kprintf("port %" B_PRId32 " (%#" B_PRIx32 ") doesn't exist!\n",
 				num, num);
@@ -566,14 +671,16 @@ dump_port_info(int argc, char** argv)
 		name = argv[1];
 
 	// walk through the ports list, trying to match name
-	for (PortHashTable::Iterator it = sPorts.GetIterator();
-		Port* port = it.Next();) {
-		if ((name != NULL && port->lock.name != NULL
-				&& !strcmp(name, port->lock.name))
-			|| (condition != NULL && (&port->read_condition == condition
-				|| &port->write_condition == condition))) {
-			_dump_port_info(port);
-			return 0;
+	for (int32 i = 0; i < kPortHashShardCount; i++) {
+		for (PortHashTable::Iterator it = sPortShards[i].ports.GetIterator();
+				Port* port = it.Next();) {
+			if ((name != NULL && port->lock.name != NULL
+					&& !strcmp(name, port->lock.name))
+				|| (condition != NULL && (&port->read_condition == condition
+					|| &port->write_condition == condition))) {
+				_dump_port_info(port);
+				return 0;
+			}
 		}
 	}
 
@@ -602,8 +709,9 @@ get_locked_port(port_id id) GCC_2_NRV(portRef)
 	BReference<Port> portRef;
 #endif
 	{
-		ReadLocker portsLocker(sPortsLock);
-		portRef.SetTo(sPorts.Lookup(id));
+		PortHashShard& shard = port_shard(id);
+		ReadLocker shardLocker(shard.lock);
+		portRef.SetTo(shard.ports.Lookup(id));
 	}
 
 	if (portRef != NULL && portRef->state == Port::kActive)
@@ -621,8 +729,9 @@ get_port(port_id id) GCC_2_NRV(portRef)
 #if __GNUC__ >= 3
 	BReference<Port> portRef;
 #endif
-	ReadLocker portsLocker(sPortsLock);
-	portRef.SetTo(sPorts.Lookup(id));
+	PortHashShard& shard = port_shard(id);
+	ReadLocker shardLocker(shard.lock);
+	portRef.SetTo(shard.ports.Lookup(id));
 	
 	return portRef;
 }
@@ -762,6 +871,155 @@ copy_port_message(port_message* message, int32* _code, void* buffer,
 }
 
 
+/*!	Pins the reader's buffer and retrieves its physical pages, so that a
+	writer can copy a message directly into it.
+	Must not be called with the port locked.
+*/
+static status_t
+prepare_direct_reader(port_direct_reader& reader, void* buffer,
+	size_t bufferSize)
+{
+	bufferSize = min_c(bufferSize, PORT_MAX_MESSAGE_SIZE);
+
+	team_id team = team_get_current_team_id();
+	status_t status = lock_memory_etc(team, buffer, bufferSize,
+		B_READ_DEVICE);
+	if (status != B_OK)
+		return status;
+
+	uint32 count = bufferSize / B_PAGE_SIZE + 2;
+	physical_entry* vecs = (physical_entry*)malloc(
+		sizeof(physical_entry) * count);
+	if (vecs == NULL) {
+		unlock_memory_etc(team, buffer, bufferSize, B_READ_DEVICE);
+		return B_NO_MEMORY;
+	}
+
+	status = get_memory_map_etc(team, buffer, bufferSize, vecs, &count);
+	if (status != B_OK) {
+		free(vecs);
+		unlock_memory_etc(team, buffer, bufferSize, B_READ_DEVICE);
+		return status;
+	}
+
+	reader.team = team;
+	reader.buffer = buffer;
+	reader.buffer_size = bufferSize;
+	reader.vecs = vecs;
+	reader.vec_count = count;
+	return B_OK;
+}
+
+
+/*!	Removes a direct reader from its port after it has been woken up. If a
+	writer has claimed the reader in the meantime, this waits until the writer
+	is done, and returns \c true in that case; \a _result is then set to the
+	message size, or an error code.
+*/
+static bool
+withdraw_direct_reader(Port* port, port_direct_reader& reader,
+	ssize_t& _result)
+{
+	MutexLocker locker(port->lock);
+
+	while (true) {
+		switch (reader.state) {
+			case port_direct_reader::kDone:
+				_result = reader.result;
+				return true;
+			case port_direct_reader::kWaiting:
+				port->direct_readers.Remove(&reader);
+				return false;
+			case port_direct_reader::kNotified:
+				// we have already been removed from the list
+				return false;
+		}
+
+		// A writer is copying a message into our buffer right now. The writer
+		// notifies our condition once it's done.
+		ConditionVariableEntry entry;
+		reader.condition.Add(&entry);
+
+		locker.Unlock();
+		entry.Wait();
+		locker.Lock();
+	}
+}
+
+
+/*!	Wakes up a single reader of the port; a waiting direct reader is
+	preferred, as it would otherwise only be woken up by a large message.
+	The port must be locked.
+*/
+static void
+notify_one_reader(Port* port)
+{
+	port_direct_reader* reader = port->direct_readers.RemoveHead();
+	if (reader != NULL) {
+		reader->state = port_direct_reader::kNotified;
+		reader->condition.NotifyAll();
+	} else
+		port->read_condition.NotifyOne();
+}
+
+
+/*!	Wakes up all readers of the port with the given \a status. The port must
+	be locked.
+*/
+static void
+notify_all_readers(Port* port, status_t status)
+{
+	port->read_condition.NotifyAll(status);
+
+	while (port_direct_reader* reader = port->direct_readers.RemoveHead()) {
+		reader->state = port_direct_reader::kNotified;
+		reader->condition.NotifyAll(status);
+	}
+}
+
+
+/*!	Copies the message from the writer's vecs directly into the physical
+	pages of the reader's buffer. The reader must have been claimed by the
+	caller, the port must not be locked.
+*/
+static status_t
+copy_port_message_direct(port_direct_reader* reader, const iovec* vecs,
+	size_t vecCount, size_t bufferSize, bool userCopy, size_t& _size)
+{
+	size_t size = min_c(bufferSize, reader->buffer_size);
+	size_t bytesLeft = size;
+	uint32 entryIndex = 0;
+	phys_size_t entryOffset = 0;
+
+	for (size_t i = 0; i < vecCount && bytesLeft > 0; i++) {
+		const uint8* from = (const uint8*)vecs[i].iov_base;
+		size_t length = min_c(vecs[i].iov_len, bytesLeft);
+		bytesLeft -= length;
+
+		while (length > 0) {
+			physical_entry& entry = reader->vecs[entryIndex];
+			size_t chunk = min_c(length, entry.size - entryOffset);
+
+			status_t status = vm_memcpy_to_physical(
+				entry.address + entryOffset, from, chunk, userCopy);
+			if (status != B_OK)
+				return status;
+
+			from += chunk;
+			length -= chunk;
+			entryOffset += chunk;
+			if (entryOffset == entry.size) {
+				entryIndex++;
+				entryOffset = 0;
+			}
+		}
+	}
+
+	_size = size;
+	return B_OK;
+}
+
+
 static void
 uninit_port(Port* port)
 {
@@ -772,7 +1030,7 @@ uninit_port(Port* port)
 
 	// Release the threads that were blocking on this port.
 	// read_port() will see the B_BAD_PORT_ID return value, and act accordingly
-	port->read_condition.NotifyAll(B_BAD_PORT_ID);
+	notify_all_readers(port, B_BAD_PORT_ID);
 	port->write_condition.NotifyAll(B_BAD_PORT_ID);
 	sNotificationService.Notify(PORT_REMOVED, port->id);
 }
@@ -814,6 +1072,56 @@ delete_port_logical(Port* port)
 }
 
 
+/*!	Allocates an ID for the port and inserts it into the hash tables.
+*/
+static void
+insert_port_into_hashes(Port* port)
+{
+	port->AcquireReference();
+		// joint reference for the ID and name hash tables
+
+	while (true) {
+		// allocate a port ID, handling integer overflow
+		port_id id = atomic_add(&sNextPortID, 1) & INT32_MAX;
+		if (id == 0)
+			continue;
+
+		PortHashShard& shard = port_shard(id);
+		WriteLocker shardLocker(shard.lock);
+
+		if (shard.ports.Lookup(id) == NULL) {
+			port->id = id;
+			shard.ports.Insert(port);
+			break;
+		}
+	}
+
+	PortNameHashShard& nameShard = port_name_shard(port);
+	WriteLocker nameShardLocker(nameShard.lock);
+	nameShard.ports.Insert(port);
+}
+
+
+static void
+remove_port_from_hashes(Port* port)
+{
+	{
+		PortHashShard& shard = port_shard(port->id);
+		WriteLocker shardLocker(shard.lock);
+		shard.ports.Remove(port);
+	}
+
+	{
+		PortNameHashShard& nameShard = port_name_shard(port);
+		WriteLocker nameShardLocker(nameShard.lock);
+		nameShard.ports.Remove(port);
+	}
+
+	port->ReleaseReference();
+		// joint reference for the ID and name hash tables
+}
+
+
 //	#pragma mark - private kernel API
 
 
@@ -850,18 +1158,10 @@ delete_owned_ports(Team* team)
 	teamPortsListLocker.Unlock();
 
 	// Remove all ports in deletionList from hashes
-	{
-		WriteLocker portsLocker(sPortsLock);
-
-		for (Port* port = (Port*)list_get_first_item(&deletionList);
-			 port != NULL;
-			 port = (Port*)list_get_next_item(&deletionList, port)) {
-
-			sPorts.Remove(port);
-			sPortsByName.Remove(port);
-			port->ReleaseReference();
-				// joint reference for sPorts and sPortsByName
-		}
+	for (Port* port = (Port*)list_get_first_item(&deletionList);
+		 port != NULL;
+		 port = (Port*)list_get_next_item(&deletionList, port)) {
+		remove_port_from_hashes(port);
 	}
 
 	// Uninitialize ports and release team port list references
@@ -901,20 +1201,27 @@ port_team_link_offset()
 status_t
 port_init(kernel_args *args)
 {
-	// initialize ports table and by-name hash
-	new(&sPorts) PortHashTable;
-	if (sPorts.Init() != B_OK) {
-		panic("Failed to init port hash table!");
-		return B_NO_MEMORY;
-	}
+	// initialize ports tables and by-name hashes
+	for (int32 i = 0; i < kPortHashShardCount; i++) {
+		rw_lock_init(&sPortShards[i].lock, "ports list");
+		new(&sPortShards[i].ports) PortHashTable;
+		if (sPortShards[i].ports.Init() != B_OK) {
+			panic("Failed to init port hash table!");
+			return B_NO_MEMORY;
+		}
 
-	new(&sPortsByName) PortNameHashTable;
-	if (sPortsByName.Init() != B_OK) {
-		panic("Failed to init port by name hash table!");
-		return B_NO_MEMORY;
+		rw_lock_init(&sPortNameShards[i].lock, "ports by name list");
+		new(&sPortNameShards[i].ports) PortNameHashTable;
+		if (sPortNameShards[i].ports.Init() != B_OK) {
+			panic("Failed to init port by name hash table!");
+			return B_NO_MEMORY;
+		}
 	}
 
-	sNoSpaceCondition.Init(&sPorts, "port space");
+	for (int32 i = 0; i < kTeamListLockCount; i++)
+		mutex_init(&sTeamListLock[i], "team ports list");
+
+	sNoSpaceCondition.Init(sPortShards, "port space");
 
 	// add debugger commands
 	add_debugger_command_etc("ports", &dump_port_list,
@@ -981,26 +1288,9 @@ create_port(int32 queueLength, const char* name)
 		return B_NO_MORE_PORTS;
 	}
 
-	{
-		WriteLocker locker(sPortsLock);
-
-		// allocate a port ID
-		do {
-			port->id = sNextPortID++;
-
-			// handle integer overflow
-			if (sNextPortID < 0)
-				sNextPortID = 1;
-		} while (sPorts.Lookup(port->id) != NULL);
-
-		// Insert port physically:
-		// (1/2) Insert into hash tables
-		port->AcquireReference();
-			// joint reference for sPorts and sPortsByName
-
-		sPorts.Insert(port);
-		sPortsByName.Insert(port);
-	}
+	// Insert port physically:
+	// (1/2) Insert into hash tables
+	insert_port_into_hashes(port);
 
 	// (2/2) Insert into team list
 	{
@@ -1055,7 +1345,7 @@ close_port(port_id id)
 	notify_port_select_events(portRef, B_EVENT_INVALID);
 	portRef->select_infos = NULL;
 
-	portRef->read_condition.NotifyAll(B_BAD_PORT_ID);
+	notify_all_readers(portRef, B_BAD_PORT_ID);
 	portRef->write_condition.NotifyAll(B_BAD_PORT_ID);
 
 	return B_OK;
@@ -1084,15 +1374,7 @@ delete_port(port_id id)
 
 	// Now remove port physically:
 	// (1/2) Remove from hash tables
-	{
-		WriteLocker portsLocker(sPortsLock);
-
-		sPorts.Remove(portRef);
-		sPortsByName.Remove(portRef);
-
-		portRef->ReleaseReference();
-			// joint reference for sPorts and sPortsByName
-	}
+	remove_port_from_hashes(portRef);
 
 	// (2/2) Remove from team port list
 	{
@@ -1197,9 +1479,11 @@ find_port(const char* name)
 	if (name == NULL)
 		return B_BAD_VALUE;
 
-	ReadLocker locker(sPortsLock);
-	Port* port = sPortsByName.Lookup(name);
-		// Since we have sPortsLock and don't return the port itself,
+	PortNameHashShard& shard
+		= port_name_shard(PortNameHashDefinition().HashKey(name));
+	ReadLocker locker(shard.lock);
+	Port* port = shard.ports.Lookup(name);
+		// Since we have the shard lock and don't return the port itself,
 		// no BReference necessary
 	
 	if (port != NULL && port->state == Port::kActive)
@@ -1374,7 +1658,7 @@ _get_port_message_info_etc(port_id id, port_message_info* info,
 	T(Info(id, id->read_count, id->write_count, message->code, B_OK));
 
 	// notify next one, as we haven't read from the port
-	portRef->read_condition.NotifyOne();
+	notify_one_reader(portRef);
 
 	return B_OK;
 }
@@ -1418,6 +1702,8 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 	bool userCopy = (flags & PORT_FLAG_USE_USER_MEMCPY) != 0;
 	bool peekOnly = !userCopy && (flags & B_PEEK_PORT_MESSAGE) != 0;
 		// TODO: we could allow peeking for user apps now
+	bool directRead = userCopy && bufferSize >= kDirectTransferThreshold;
+	port_direct_reader directReader;
 
 	flags &= B_CAN_INTERRUPT | B_KILL_CAN_INTERRUPT | B_RELATIVE_TIMEOUT
 		| B_ABSOLUTE_TIMEOUT;
@@ -1438,15 +1724,57 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 		if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout <= 0)
 			return B_WOULD_BLOCK;
 
+		if (directRead && directReader.vecs == NULL) {
+			// Pin our buffer, so that a large message can be copied into it
+			// directly. Since this may block, we need to unlock the port
+			// and start over.
+			locker.Unlock();
+
+			if (prepare_direct_reader(directReader, buffer, bufferSize)
+					!= B_OK) {
+				directRead = false;
+			}
+
+			BReference<Port> newPortRef = get_locked_port(id);
+			if (newPortRef == NULL) {
+				T(Read(id, 0, 0, 0, B_BAD_PORT_ID));
+				return B_BAD_PORT_ID;
+			}
+			locker.SetTo(newPortRef->lock, true);
+
+			if (newPortRef != portRef
+				|| (is_port_closed(portRef) && portRef->messages.IsEmpty())) {
+				// the port is no longer there
+				T(Read(id, 0, 0, 0, B_BAD_PORT_ID));
+				return B_BAD_PORT_ID;
+			}
+			continue;
+		}
+
 		// We need to wait for a message to appear
 		ConditionVariableEntry entry;
-		portRef->read_condition.Add(&entry);
+		if (directRead) {
+			directReader.state = port_direct_reader::kWaiting;
+			portRef->direct_readers.Add(&directReader);
+			directReader.condition.Add(&entry);
+		} else
+			portRef->read_condition.Add(&entry);
 
 		locker.Unlock();
 
 		// block if no message, or, if B_TIMEOUT flag set, block with timeout
 		status_t status = entry.Wait(flags, timeout);
 
+		if (directRead) {
+			ssize_t size;
+			if (withdraw_direct_reader(portRef, directReader, size)) {
+				// a writer copied its message directly into our buffer
+				if (size >= 0 && _code != NULL)
+					*_code = directReader.code;
+				return size;
+			}
+		}
+
 		// re-lock
 		BReference<Port> newPortRef = get_locked_port(id);
 		if (newPortRef == NULL) {
@@ -1481,7 +1809,7 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 
 		T(Read(portRef, message->code, size));
 
-		portRef->read_condition.NotifyOne();
+		notify_one_reader(portRef);
 			// we only peeked, but didn't grab the message
 		return size;
 	}
@@ -1565,6 +1893,44 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 		return B_BAD_PORT_ID;
 	}
 
+	if (bufferSize >= kDirectTransferThreshold && portRef->read_count == 0
+		&& !portRef->direct_readers.IsEmpty()) {
+		// A reader is already waiting for a message, copy ours directly into
+		// its buffer.
+		port_direct_reader* reader = portRef->direct_readers.RemoveHead();
+		reader->state = port_direct_reader::kClaimed;
+		portRef->total_count++;
+
+		locker.Unlock();
+
+		size_t size;
+		status = copy_port_message_direct(reader, msgVecs, vecCount,
+			bufferSize, userCopy, size);
+		if (status == B_OK) {
+			atomic_add64(&portRef->direct_bytes, size);
+			T(Write(id, portRef->read_count, portRef->write_count, msgCode,
+				size, B_OK));
+
+			// only wake up the reader we copied the message to
+			locker.Lock();
+			reader->code = msgCode;
+			reader->result = size;
+			reader->state = port_direct_reader::kDone;
+			reader->condition.NotifyAll();
+				// the reader may be gone once we unlock the port
+			return B_OK;
+		}
+
+		// We couldn't read our own buffer -- give the reader back.
+		locker.Lock();
+		portRef->total_count--;
+		portRef->direct_readers.InsertBefore(portRef->direct_readers.Head(),
+			reader);
+		reader->state = port_direct_reader::kWaiting;
+		reader->condition.NotifyAll();
+		return status;
+	}
+
 	if (portRef->write_count <= 0) {
 		if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout <= 0)
 			return B_WOULD_BLOCK;
@@ -1642,12 +2008,13 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 
 	portRef->messages.Add(message);
 	portRef->read_count++;
+	atomic_add64(&portRef->copied_bytes, message->size);
 
 	T(Write(id, portRef->read_count, portRef->write_count, message->code,
 		message->size, B_OK));
 
 	notify_port_select_events(portRef, B_EVENT_READ);
-	portRef->read_condition.NotifyOne();
+	notify_one_reader(portRef);
 	return B_OK;
 
 error:
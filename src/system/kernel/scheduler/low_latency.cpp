@@ -147,8 +147,10 @@ rebalance_irqs(bool idle)
 		return;
 	if (other->GetLoad() + kLoadDifference >= core->GetLoad())
 		return;
+	if (is_latency_critical_cpu(newCPU))
+		return;
 
-	assign_io_interrupt_to_cpu(chosen->irq, newCPU);
+	assign_io_interrupt_to_cpu(chosen->irq, cpu->cpu_num, newCPU);
 }
 
 
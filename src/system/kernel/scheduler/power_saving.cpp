@@ -180,9 +180,11 @@ pack_irqs()
 		locker.Unlock();
 
 		int32 newCPU = smallTaskCore->CPUHeap()->PeekRoot()->ID();
+		if (is_latency_critical_cpu(newCPU))
+			return;
 
 		if (newCPU != cpu->cpu_num)
-			assign_io_interrupt_to_cpu(irq->irq, newCPU);
+			assign_io_interrupt_to_cpu(irq->irq, cpu->cpu_num, newCPU);
 
 		locker.Lock();
 	}
@@ -231,8 +233,10 @@ rebalance_irqs(bool idle)
 		return;
 	if (other->GetLoad() + kLoadDifference >= core->GetLoad())
 		return;
+	if (is_latency_critical_cpu(newCPU))
+		return;
 
-	assign_io_interrupt_to_cpu(chosen->irq, newCPU);
+	assign_io_interrupt_to_cpu(chosen->irq, cpu->cpu_num, newCPU);
 }
 
 
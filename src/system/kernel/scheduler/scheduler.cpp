@@ -31,6 +31,7 @@
 
 #include "scheduler_common.h"
 #include "scheduler_cpu.h"
+#include "scheduler_group.h"
 #include "scheduler_locking.h"
 #include "scheduler_modes.h"
 #include "scheduler_profiler.h"
@@ -66,6 +67,7 @@ spinlock gSchedulerListenersLock = B_SPINLOCK_INITIALIZER;
 static scheduler_mode_operations* sSchedulerModes[] = {
 	&gSchedulerLowLatencyMode,
 	&gSchedulerPowerSavingMode,
+	&gSchedulerThroughputMode,
 };
 
 // Since CPU IDs used internally by the kernel bear no relation to the actual
@@ -99,6 +101,12 @@ enqueue(Thread* thread, bool newOne)
 
 	ThreadData* threadData = thread->scheduler_data;
 
+	// don't run threads of throttled scheduling groups
+	if (SchedulerGroup::ParkThread(threadData)) {
+		thread->state = B_THREAD_READY;
+		return;
+	}
+
 	int32 threadPriority = threadData->GetEffectivePriority();
 	T(EnqueueThread(thread, threadPriority));
 
@@ -140,6 +148,18 @@ enqueue(Thread* thread, bool newOne)
 }
 
 
+/*!	Puts a thread parked by its throttled scheduling group back into the run
+	queue.
+	The caller must hold the thread's scheduler_lock.
+*/
+void
+Scheduler::enqueue_parked_thread(Thread* thread)
+{
+	SchedulerModeLocker _;
+	enqueue(thread, false);
+}
+
+
 /*!	Enqueues the thread into the run queue.
 	Note: thread lock must be held when entering this function
 */
@@ -374,6 +394,13 @@ reschedule(int32 nextState)
 
 	oldThread->has_yielded = false;
 
+	// If the thread's scheduling group has used up its quota, the thread has
+	// to wait until the group's period ends.
+	if (enqueueOldThread && !oldThreadData->IsIdle()
+		&& SchedulerGroup::ParkThread(oldThreadData)) {
+		enqueueOldThread = false;
+	}
+
 	// select thread with the biggest priority and enqueue back the old thread
 	ThreadData* nextThreadData;
 	if (gCPU[thisCPU].disabled) {
@@ -518,7 +545,8 @@ status_t
 scheduler_set_operation_mode(scheduler_mode mode)
 {
 	if (mode != SCHEDULER_MODE_LOW_LATENCY
-		&& mode != SCHEDULER_MODE_POWER_SAVING) {
+		&& mode != SCHEDULER_MODE_POWER_SAVING
+		&& mode != SCHEDULER_MODE_THROUGHPUT) {
 		return B_BAD_VALUE;
 	}
 
@@ -536,6 +564,13 @@ scheduler_set_operation_mode(scheduler_mode mode)
 }
 
 
+scheduler_mode
+scheduler_get_operation_mode(void)
+{
+	return gCurrentModeID;
+}
+
+
 void
 scheduler_set_cpu_enabled(int32 cpuID, bool enabled)
 {
@@ -722,6 +757,7 @@ scheduler_init()
 	scheduler_set_operation_mode(SCHEDULER_MODE_LOW_LATENCY);
 
 	init_debug_commands();
+	init_scheduler_groups();
 
 #if SCHEDULER_TRACING
 	add_debugger_command_etc("scheduler", &cmd_scheduler,
@@ -6,6 +6,7 @@
 
 #include "scheduler_cpu.h"
 
+#include <timer.h>
 #include <util/AutoLock.h>
 
 #include <algorithm>
@@ -117,7 +118,7 @@ CPUEntry::Stop()
 	while (irq != NULL) {
 		locker.Unlock();
 
-		assign_io_interrupt_to_cpu(irq->irq, -1);
+		assign_io_interrupt_to_cpu(irq->irq, fCPUNumber, -1);
 
 		locker.Lock();
 		irq = (irq_assignment*)list_get_first_item(&entry->irqs);
@@ -270,6 +271,8 @@ CPUEntry::TrackActivity(ThreadData* oldThreadData, ThreadData* nextThreadData)
 
 		WriteSequentialLocker locker(cpuEntry->active_time_lock);
 		cpuEntry->active_time += active;
+		if (oldThread->priority >= B_REAL_TIME_DISPLAY_PRIORITY)
+			cpuEntry->real_time_active_time += active;
 		locker.Unlock();
 
 		fMeasureActiveTime += active;
@@ -308,8 +311,11 @@ CPUEntry::StartQuantumTimer(ThreadData* thread, bool wasPreempted)
 		add_timer(&cpu->quantum_timer, &CPUEntry::_RescheduleEvent, quantum,
 			B_ONE_SHOT_RELATIVE_TIMER);
 	} else if (gTrackCoreLoad) {
-		add_timer(&cpu->quantum_timer, &CPUEntry::_UpdateLoadEvent,
-			kLoadMeasureInterval * 2, B_ONE_SHOT_RELATIVE_TIMER);
+		// The load update doesn't need to be exact; let an idle CPU handle it
+		// together with whatever timer it has to wake up for anyway.
+		add_timer_etc(&cpu->quantum_timer, &CPUEntry::_UpdateLoadEvent,
+			kLoadMeasureInterval * 2, B_ONE_SHOT_RELATIVE_TIMER,
+			kLoadMeasureInterval);
 		fUpdateLoadEvent = true;
 	}
 }
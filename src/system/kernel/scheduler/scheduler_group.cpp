@@ -0,0 +1,631 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "scheduler_group.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <kernel.h>
+#include <lock.h>
+#include <team.h>
+#include <util/AutoLock.h>
+
+#include "scheduler_thread.h"
+
+
+using namespace Scheduler;
+
+
+static const bigtime_t kShareUpdateInterval = 100000;
+	// kernel daemon frequency 1
+
+static SchedulerGroup sGroups[kMaxSchedulerGroups];
+static SchedulerGroup* const sRootGroup = &sGroups[0];
+static int32 sNextGroupID = SCHEDULER_ROOT_GROUP + 1;
+
+static mutex sGroupsLock = MUTEX_INITIALIZER("scheduler groups");
+	// protects the group tree, the groups' weights and the teams'
+	// scheduler_group fields
+
+static bigtime_t sRecentCapacity;
+static bigtime_t sLastShareUpdate;
+
+bool Scheduler::gSchedulerGroupsInUse;
+
+
+SchedulerGroup::SchedulerGroup()
+	:
+	fID(-1)
+{
+}
+
+
+void
+SchedulerGroup::Init(int32 id, const char* name, SchedulerGroup* parent)
+{
+	fID = id;
+	strlcpy(fName, name, sizeof(fName));
+	fParent = parent;
+	fChildCount = 0;
+	fTeamCount = 0;
+
+	fWeight = SCHEDULER_GROUP_DEFAULT_WEIGHT;
+	fPenalty = parent != NULL ? parent->fPenalty : 0;
+	fShare = 0;
+	fUsage = 0;
+	fLastUsage = 0;
+	fRecentUsage = 0;
+
+	B_INITIALIZE_SPINLOCK(&fLock);
+	fQuota = 0;
+	fPeriod = 0;
+	fPeriodStart = 0;
+	fPeriodUsage = 0;
+	fThrottled = false;
+	fThrottledSince = 0;
+	fThrottledTime = 0;
+
+	fUnthrottleTimer.user_data = this;
+
+	if (parent != NULL)
+		parent->fChildCount++;
+}
+
+
+void
+SchedulerGroup::Uninit()
+{
+	ASSERT(fTeamCount == 0 && fChildCount == 0);
+
+	SetLimits(fWeight, 0, 0);
+
+	fParent->fChildCount--;
+	fID = -1;
+}
+
+
+void
+SchedulerGroup::SetLimits(int32 weight, bigtime_t quota, bigtime_t period)
+{
+	fWeight = weight;
+
+	cpu_status state = disable_interrupts();
+	acquire_spinlock(&fLock);
+
+	fQuota = quota;
+	fPeriod = period;
+	fPeriodStart = 0;
+	fPeriodUsage = 0;
+
+	bool wasThrottled = fThrottled;
+
+	release_spinlock(&fLock);
+	restore_interrupts(state);
+
+	// Release the threads, if the group has been throttled. The timer may be
+	// just running on another CPU, so make sure it's really done.
+	if (wasThrottled) {
+		cancel_timer(&fUnthrottleTimer);
+		Unthrottle();
+	}
+}
+
+
+void
+SchedulerGroup::GetInfo(scheduler_group_info& info)
+{
+	info.id = fID;
+	info.parent = fParent != NULL ? fParent->fID : -1;
+	strlcpy(info.name, fName, sizeof(info.name));
+	info.weight = fWeight;
+	info.team_count = fTeamCount;
+	info.penalty = fPenalty;
+	info.usage = atomic_get64(&fUsage);
+
+	InterruptsSpinLocker locker(fLock);
+	info.quota = fQuota;
+	info.period = fPeriod;
+	info.throttled_time = fThrottledTime;
+	if (fThrottled)
+		info.throttled_time += system_time() - fThrottledSince;
+}
+
+
+/*!	Accounts \a time of CPU time to the group, and throttles it, if it has
+	used up its quota for the current period.
+	Interrupts must be disabled.
+*/
+void
+SchedulerGroup::Charge(bigtime_t now, bigtime_t time)
+{
+	atomic_add64(&fUsage, time);
+
+	if (fQuota == 0)
+		return;
+
+	SpinLocker locker(fLock);
+
+	if (fQuota == 0)
+		return;
+
+	if (!fThrottled && now >= fPeriodStart + fPeriod) {
+		fPeriodStart = now;
+		fPeriodUsage = 0;
+	}
+
+	fPeriodUsage += time;
+	if (fThrottled || fPeriodUsage < fQuota)
+		return;
+
+	TRACE("throttling scheduler group %" B_PRId32 "\n", fID);
+
+	fThrottled = true;
+	fThrottledSince = now;
+	add_timer(&fUnthrottleTimer, &_UnthrottleEvent, fPeriodStart + fPeriod,
+		B_ONE_SHOT_ABSOLUTE_TIMER);
+}
+
+
+/*!	Keeps \a thread from running until the group's current period ends, if
+	the group is throttled.
+	The caller must hold the thread's scheduler_lock.
+	\return \c true, if the thread has been parked.
+*/
+bool
+SchedulerGroup::Park(ThreadData* thread)
+{
+	SpinLocker locker(fLock);
+	if (!fThrottled)
+		return false;
+
+	fParkedThreads.Add(thread);
+	return true;
+}
+
+
+/*!	Ends the throttling of the group and puts all of its parked threads back
+	into the run queues.
+	Interrupts may be enabled, but no scheduler locks must be held.
+	\return \c true, if any threads have become ready to run.
+*/
+bool
+SchedulerGroup::Unthrottle()
+{
+	cpu_status state = disable_interrupts();
+	acquire_spinlock(&fLock);
+
+	if (!fThrottled) {
+		release_spinlock(&fLock);
+		restore_interrupts(state);
+		return false;
+	}
+
+	bigtime_t now = system_time();
+	fThrottled = false;
+	fThrottledTime += now - fThrottledSince;
+	fPeriodStart = now;
+	fPeriodUsage = 0;
+
+	ThreadDataList threads;
+	threads.MoveFrom(&fParkedThreads);
+
+	release_spinlock(&fLock);
+
+	TRACE("unthrottling scheduler group %" B_PRId32 "\n", fID);
+
+	bool threadsEnqueued = !threads.IsEmpty();
+	while (ThreadData* threadData = threads.RemoveHead()) {
+		Thread* thread = threadData->GetThread();
+
+		SpinLocker threadLocker(thread->scheduler_lock);
+		enqueue_parked_thread(thread);
+	}
+
+	restore_interrupts(state);
+	return threadsEnqueued;
+}
+
+
+/*static*/ SchedulerGroup*
+SchedulerGroup::Of(Team* team)
+{
+	return team->scheduler_group;
+}
+
+
+/*!	Accounts \a time of CPU time to the group of \a team and its ancestors.
+	Interrupts must be disabled.
+*/
+/*static*/ void
+SchedulerGroup::ChargeTeam(Team* team, bigtime_t time)
+{
+	if (!gSchedulerGroupsInUse)
+		return;
+
+	SchedulerGroup* group = Of(team);
+	if (group == NULL)
+		return;
+
+	bigtime_t now = system_time();
+	for (; group != sRootGroup; group = group->fParent)
+		group->Charge(now, time);
+}
+
+
+/*!	Parks \a thread, if its group or any ancestor of it is throttled.
+	Real-time threads are never throttled.
+	The caller must hold the thread's scheduler_lock.
+	\return \c true, if the thread has been parked.
+*/
+/*static*/ bool
+SchedulerGroup::ParkThread(ThreadData* threadData)
+{
+	if (!gSchedulerGroupsInUse)
+		return false;
+
+	if (threadData->IsRealTime() || threadData->IsIdle())
+		return false;
+
+	SchedulerGroup* group = Of(threadData->GetThread()->team);
+	if (group == NULL)
+		return false;
+
+	for (; group != sRootGroup; group = group->fParent) {
+		if (group->fThrottled && group->Park(threadData))
+			return true;
+	}
+
+	return false;
+}
+
+
+/*static*/ int32
+SchedulerGroup::_UnthrottleEvent(timer* event)
+{
+	SchedulerGroup* group = (SchedulerGroup*)event->user_data;
+	// Let the released threads run right away rather than with the next tick.
+	return group->Unthrottle() ? B_INVOKE_SCHEDULER : B_HANDLED_INTERRUPT;
+}
+
+
+/*!	Decays the group's recent usage, so that it mostly reflects the last few
+	share update intervals, and adds the usage since the last update.
+	The caller must hold the groups lock.
+*/
+void
+SchedulerGroup::UpdateRecentUsage()
+{
+	bigtime_t usage = atomic_get64(&fUsage);
+	fRecentUsage = fRecentUsage / 2 + usage - fLastUsage;
+	fLastUsage = usage;
+}
+
+
+/*!	Computes the shares and priority penalties of the group's children and
+	their descendants.
+	The caller must hold the groups lock.
+*/
+void
+SchedulerGroup::UpdateShares(bigtime_t recentCapacity)
+{
+	int32 activeWeight = 0;
+	for (int32 i = 0; i < kMaxSchedulerGroups; i++) {
+		SchedulerGroup& group = sGroups[i];
+		if (group.IsUsed() && group.fParent == this && group.fRecentUsage > 0)
+			activeWeight += group.fWeight;
+	}
+
+	for (int32 i = 0; i < kMaxSchedulerGroups; i++) {
+		SchedulerGroup& group = sGroups[i];
+		if (!group.IsUsed() || group.fParent != this)
+			continue;
+
+		// An inactive group is entitled to the share it would get, if it
+		// became active.
+		int32 weight = activeWeight;
+		if (group.fRecentUsage == 0)
+			weight += group.fWeight;
+		group.fShare = std::max(int32((int64)fShare * group.fWeight / weight),
+			int32(1));
+
+		// Every 20% of usage in excess of the share cost a priority level.
+		int32 usage = recentCapacity > 0
+			? int32(group.fRecentUsage * 1000 / recentCapacity) : 0;
+		int32 penalty = 0;
+		if (usage > group.fShare)
+			penalty = (usage - group.fShare) * 5 / group.fShare + 1;
+
+		group.fPenalty = std::min(fPenalty + penalty,
+			kMaxSchedulerGroupPenalty);
+
+		if (group.fChildCount > 0)
+			group.UpdateShares(recentCapacity);
+	}
+}
+
+
+// #pragma mark -
+
+
+static SchedulerGroup*
+get_group(int32 id)
+{
+	for (int32 i = 0; i < kMaxSchedulerGroups; i++) {
+		if (sGroups[i].ID() == id)
+			return &sGroups[i];
+	}
+
+	return NULL;
+}
+
+
+static void
+update_scheduler_group_shares(void*, int)
+{
+	MutexLocker locker(sGroupsLock);
+
+	bigtime_t now = system_time();
+	bigtime_t capacity = (now - sLastShareUpdate) * smp_get_num_cpus();
+	sLastShareUpdate = now;
+
+	sRecentCapacity = sRecentCapacity / 2 + capacity;
+	for (int32 i = 0; i < kMaxSchedulerGroups; i++) {
+		if (sGroups[i].IsUsed() && &sGroups[i] != sRootGroup)
+			sGroups[i].UpdateRecentUsage();
+	}
+
+	sRootGroup->UpdateShares(sRecentCapacity);
+}
+
+
+static int
+dump_scheduler_groups(int argc, char** argv)
+{
+	kprintf("%-6s %-6s %-20s %6s %6s %5s %7s %10s %10s %12s\n", "id",
+		"parent", "name", "weight", "share", "teams", "penalty", "quota",
+		"period", "usage");
+
+	for (int32 i = 0; i < kMaxSchedulerGroups; i++) {
+		SchedulerGroup& group = sGroups[i];
+		if (!group.IsUsed())
+			continue;
+
+		scheduler_group_info info;
+		group.GetInfo(info);
+
+		kprintf("%-6" B_PRId32 " %-6" B_PRId32 " %-20s %6" B_PRId32 " %5"
+			B_PRId32 "%% %5" B_PRId32 " %7" B_PRId32 " %10" B_PRId64 " %10"
+			B_PRId64 " %12" B_PRId64 "%s\n", info.id, info.parent, info.name,
+			info.weight, group.Share() / 10, info.team_count, info.penalty,
+			info.quota, info.period, info.usage,
+			group.IsThrottled() ? " (throttled)" : "");
+	}
+
+	return 0;
+}
+
+
+void
+Scheduler::init_scheduler_groups()
+{
+	sRootGroup->Init(SCHEDULER_ROOT_GROUP, "root", NULL);
+	sRootGroup->SetShare(1000);
+
+	add_debugger_command_etc("scheduler_groups", &dump_scheduler_groups,
+		"List all scheduling groups",
+		"\n"
+		"Lists all scheduling groups.\n", 0);
+}
+
+
+// #pragma mark - kernel private
+
+
+void
+scheduler_on_team_create(Team* team, Team* parent)
+{
+	MutexLocker locker(sGroupsLock);
+
+	team->scheduler_group = SchedulerGroup::Of(parent);
+	if (team->scheduler_group != NULL)
+		team->scheduler_group->AddTeam();
+}
+
+
+void
+scheduler_on_team_destroy(Team* team)
+{
+	if (team->scheduler_group == NULL)
+		return;
+
+	MutexLocker locker(sGroupsLock);
+
+	team->scheduler_group->RemoveTeam();
+	team->scheduler_group = NULL;
+}
+
+
+// #pragma mark - syscalls
+
+
+int32
+_user_create_scheduler_group(const char* userName, int32 parentID)
+{
+	if (geteuid() != 0)
+		return B_NOT_ALLOWED;
+
+	char name[B_OS_NAME_LENGTH];
+	if (userName == NULL || !IS_USER_ADDRESS(userName)
+		|| user_strlcpy(name, userName, sizeof(name)) < B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	MutexLocker locker(sGroupsLock);
+
+	SchedulerGroup* parent = get_group(parentID);
+	if (parent == NULL)
+		return B_BAD_VALUE;
+
+	SchedulerGroup* group = get_group(-1);
+	if (group == NULL)
+		return B_NO_MEMORY;
+
+	int32 id = sNextGroupID++;
+	group->Init(id, name, parent);
+
+	bool startDaemon = !gSchedulerGroupsInUse;
+	if (startDaemon) {
+		sLastShareUpdate = system_time();
+		gSchedulerGroupsInUse = true;
+	}
+
+	locker.Unlock();
+
+	// The daemon runs with the daemon lock held and acquires the groups lock,
+	// so it must not be registered while holding the latter.
+	if (startDaemon) {
+		register_kernel_daemon(&update_scheduler_group_shares, NULL,
+			kShareUpdateInterval / 100000);
+	}
+
+	return id;
+}
+
+
+status_t
+_user_delete_scheduler_group(int32 id)
+{
+	if (geteuid() != 0)
+		return B_NOT_ALLOWED;
+
+	MutexLocker locker(sGroupsLock);
+
+	SchedulerGroup* group = get_group(id);
+	if (group == NULL || id == SCHEDULER_ROOT_GROUP)
+		return B_BAD_VALUE;
+
+	if (!group->IsEmpty())
+		return B_BUSY;
+
+	group->Uninit();
+	return B_OK;
+}
+
+
+status_t
+_user_set_scheduler_group_limits(int32 id, int32 weight, bigtime_t quota,
+	bigtime_t period)
+{
+	if (geteuid() != 0)
+		return B_NOT_ALLOWED;
+
+	if (weight < SCHEDULER_GROUP_MIN_WEIGHT
+		|| weight > SCHEDULER_GROUP_MAX_WEIGHT || quota < 0) {
+		return B_BAD_VALUE;
+	}
+
+	if (quota > 0 && (period < SCHEDULER_GROUP_MIN_PERIOD
+			|| period > SCHEDULER_GROUP_MAX_PERIOD)) {
+		return B_BAD_VALUE;
+	}
+
+	MutexLocker locker(sGroupsLock);
+
+	SchedulerGroup* group = get_group(id);
+	if (group == NULL || id == SCHEDULER_ROOT_GROUP)
+		return B_BAD_VALUE;
+
+	group->SetLimits(weight, quota, quota > 0 ? period : 0);
+	return B_OK;
+}
+
+
+status_t
+_user_get_next_scheduler_group_info(int32* _cookie,
+	scheduler_group_info* userInfo)
+{
+	int32 cookie;
+	if (_cookie == NULL || userInfo == NULL || !IS_USER_ADDRESS(_cookie)
+		|| !IS_USER_ADDRESS(userInfo)
+		|| user_memcpy(&cookie, _cookie, sizeof(cookie)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	MutexLocker locker(sGroupsLock);
+
+	while (cookie >= 0 && cookie < kMaxSchedulerGroups
+		&& !sGroups[cookie].IsUsed()) {
+		cookie++;
+	}
+
+	if (cookie < 0)
+		return B_BAD_VALUE;
+	if (cookie >= kMaxSchedulerGroups)
+		return B_ENTRY_NOT_FOUND;
+
+	scheduler_group_info info;
+	sGroups[cookie].GetInfo(info);
+	if (cookie == 0)
+		info.team_count = -1;
+
+	locker.Unlock();
+
+	cookie++;
+	if (user_memcpy(userInfo, &info, sizeof(info)) != B_OK
+		|| user_memcpy(_cookie, &cookie, sizeof(cookie)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	return B_OK;
+}
+
+
+status_t
+_user_set_team_scheduler_group(team_id teamID, int32 id)
+{
+	if (geteuid() != 0)
+		return B_NOT_ALLOWED;
+
+	Team* team = Team::Get(teamID);
+	if (team == NULL)
+		return B_BAD_TEAM_ID;
+	BReference<Team> teamReference(team, true);
+
+	if (team == team_get_kernel_team())
+		return B_NOT_ALLOWED;
+
+	MutexLocker locker(sGroupsLock);
+
+	SchedulerGroup* group = get_group(id);
+	if (group == NULL)
+		return B_BAD_VALUE;
+	if (group == sRootGroup)
+		group = NULL;
+
+	if (team->scheduler_group != NULL)
+		team->scheduler_group->RemoveTeam();
+	team->scheduler_group = group;
+	if (group != NULL)
+		group->AddTeam();
+
+	return B_OK;
+}
+
+
+int32
+_user_get_team_scheduler_group(team_id teamID)
+{
+	Team* team = Team::Get(teamID);
+	if (team == NULL)
+		return B_BAD_TEAM_ID;
+	BReference<Team> teamReference(team, true);
+
+	MutexLocker locker(sGroupsLock);
+
+	return team->scheduler_group != NULL
+		? team->scheduler_group->ID() : SCHEDULER_ROOT_GROUP;
+}
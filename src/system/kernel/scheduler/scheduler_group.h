@@ -0,0 +1,121 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef KERNEL_SCHEDULER_GROUP_H
+#define KERNEL_SCHEDULER_GROUP_H
+
+
+#include <OS.h>
+
+#include <scheduler_defs.h>
+#include <thread_types.h>
+#include <timer.h>
+#include <util/DoublyLinkedList.h>
+
+#include "scheduler_common.h"
+
+
+namespace Scheduler {
+
+
+struct ThreadData;
+
+typedef DoublyLinkedList<ThreadData> ThreadDataList;
+
+const int32 kMaxSchedulerGroups = 64;
+const int32 kMaxSchedulerGroupPenalty = 10;
+
+
+/*!	A scheduling group is a set of teams sharing CPU time.
+	Groups form a tree rooted at the root group, which contains the kernel
+	team and every team that hasn't been moved elsewhere. Sibling groups
+	share the CPU time of their parent according to their weights: threads of
+	a group that uses more than its share get a priority penalty. A group can
+	also be limited to a quota of CPU time per period; once that is used up,
+	its threads aren't run until the period ends.
+	Group structures are never freed, so that the scheduler can access them
+	without any locking.
+*/
+struct SchedulerGroup {
+public:
+								SchedulerGroup();
+
+			void				Init(int32 id, const char* name,
+									SchedulerGroup* parent);
+			void				Uninit();
+
+	inline	bool				IsUsed() const	{ return fID >= 0; }
+	inline	int32				ID() const		{ return fID; }
+	inline	SchedulerGroup*		Parent() const	{ return fParent; }
+
+	inline	void				AddTeam()		{ fTeamCount++; }
+	inline	void				RemoveTeam()	{ fTeamCount--; }
+	inline	bool				IsEmpty() const
+									{ return fTeamCount == 0
+										&& fChildCount == 0; }
+
+	inline	bool				IsThrottled() const	{ return fThrottled; }
+	inline	int32				Penalty() const	{ return fPenalty; }
+	inline	int32				Share() const	{ return fShare; }
+	inline	void				SetShare(int32 share)	{ fShare = share; }
+
+			void				SetLimits(int32 weight, bigtime_t quota,
+									bigtime_t period);
+			void				GetInfo(scheduler_group_info& info);
+
+			void				Charge(bigtime_t now, bigtime_t time);
+			bool				Park(ThreadData* thread);
+			bool				Unthrottle();
+
+			void				UpdateRecentUsage();
+			void				UpdateShares(bigtime_t recentCapacity);
+
+	static	SchedulerGroup*		Of(Team* team);
+
+	static	void				ChargeTeam(Team* team, bigtime_t time);
+	static	bool				ParkThread(ThreadData* thread);
+
+private:
+	static	int32				_UnthrottleEvent(timer* event);
+
+			int32				fID;
+			char				fName[B_OS_NAME_LENGTH];
+			SchedulerGroup*		fParent;
+			int32				fChildCount;
+			int32				fTeamCount;
+
+			int32				fWeight;
+			int32				fPenalty;
+			int32				fShare;			// of the whole system, in
+												// per mille
+			int64				fUsage;
+			bigtime_t			fLastUsage;
+			bigtime_t			fRecentUsage;
+
+			spinlock			fLock;
+			bigtime_t			fQuota;
+			bigtime_t			fPeriod;
+			bigtime_t			fPeriodStart;
+			bigtime_t			fPeriodUsage;
+			bool				fThrottled;
+			bigtime_t			fThrottledSince;
+			bigtime_t			fThrottledTime;
+			ThreadDataList		fParkedThreads;
+			timer				fUnthrottleTimer;
+};
+
+
+extern bool gSchedulerGroupsInUse;
+
+
+void init_scheduler_groups();
+
+// implemented in scheduler.cpp
+void enqueue_parked_thread(Thread* thread);
+
+
+}	// namespace Scheduler
+
+
+#endif	// KERNEL_SCHEDULER_GROUP_H
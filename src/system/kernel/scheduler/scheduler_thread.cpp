@@ -25,6 +25,7 @@ ThreadData::_InitBase()
 
 	fTimeUsed = 0;
 	fStolenTime = 0;
+	fCPUTimeStart = 0;
 
 	fMeasureAvailableActiveTime = 0;
 	fLastMeasureAvailableTime = 0;
@@ -283,6 +284,17 @@ ThreadData::_ComputeEffectivePriority() const
 	else {
 		fEffectivePriority = GetPriority();
 		fEffectivePriority -= _GetPenalty();
+
+		// threads of groups using more than their share are penalized, too
+		if (gSchedulerGroupsInUse) {
+			SchedulerGroup* group = SchedulerGroup::Of(fThread->team);
+			if (group != NULL) {
+				fEffectivePriority = std::max(
+					fEffectivePriority - group->Penalty(),
+					int32(B_LOWEST_ACTIVE_PRIORITY));
+			}
+		}
+
 		if (fEffectivePriority > 0)
 			fEffectivePriority -= fAdditionalPenalty % fEffectivePriority;
 
@@ -11,6 +11,7 @@
 
 #include "scheduler_common.h"
 #include "scheduler_cpu.h"
+#include "scheduler_group.h"
 #include "scheduler_locking.h"
 #include "scheduler_profiler.h"
 
@@ -103,6 +104,7 @@ private:
 
 			bigtime_t	fStolenTime;
 			bigtime_t	fQuantumStart;
+			bigtime_t	fCPUTimeStart;
 			bigtime_t	fLastInterruptTime;
 
 			bigtime_t	fWentSleep;
@@ -219,7 +221,7 @@ ThreadData::StartCPUTime()
 	SCHEDULER_ENTER_FUNCTION();
 
 	SpinLocker threadTimeLocker(fThread->time_lock);
-	fThread->last_time = system_time();
+	fCPUTimeStart = fThread->last_time = system_time();
 }
 
 
@@ -230,10 +232,14 @@ ThreadData::StopCPUTime()
 
 	// User time is tracked in thread_at_kernel_entry()
 	SpinLocker threadTimeLocker(fThread->time_lock);
-	fThread->kernel_time += system_time() - fThread->last_time;
+	bigtime_t now = system_time();
+	fThread->kernel_time += now - fThread->last_time;
 	fThread->last_time = 0;
 	threadTimeLocker.Unlock();
 
+	if (!IsIdle())
+		SchedulerGroup::ChargeTeam(fThread->team, now - fCPUTimeStart);
+
 	// If the old thread's team has user time timers, check them now.
 	Team* team = fThread->team;
 	SpinLocker teamTimeLocker(team->time_lock);
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <util/AutoLock.h>
+
+#include "scheduler_common.h"
+#include "scheduler_cpu.h"
+#include "scheduler_modes.h"
+#include "scheduler_profiler.h"
+#include "scheduler_thread.h"
+
+
+using namespace Scheduler;
+
+
+const bigtime_t kCacheExpire = 250000;
+
+
+static void
+switch_to_mode()
+{
+}
+
+
+static void
+set_cpu_enabled(int32 /* cpu */, bool /* enabled */)
+{
+}
+
+
+static bool
+has_cache_expired(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+	if (threadData->WentSleepActive() == 0)
+		return false;
+	CoreEntry* core = threadData->Core();
+	bigtime_t activeTime = core->GetActiveTime();
+	return activeTime - threadData->WentSleepActive() > kCacheExpire;
+}
+
+
+/*!	Estimates what moving the thread away from its current core would cost,
+	in load units. A thread that has just been running, or hasn't been sleeping
+	for long in terms of the core's activity, will still find much of its
+	data in the core's caches, so migrating it is the more expensive.
+*/
+static int32
+migration_cost(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	if (threadData->GetThread()->cpu != NULL)
+		return kLoadDifference;
+
+	if (threadData->WentSleepActive() == 0)
+		return 0;
+
+	bigtime_t coldTime = threadData->Core()->GetActiveTime()
+		- threadData->WentSleepActive();
+	if (coldTime >= kCacheExpire)
+		return 0;
+
+	return kLoadDifference * (kCacheExpire - coldTime) / kCacheExpire;
+}
+
+
+static CoreEntry*
+choose_core(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	// Prefer the core of the waking thread, which has just been touching
+	// the data the woken thread is going to work on, as long as it isn't
+	// overloaded.
+	CoreEntry* core = CoreEntry::GetCore(smp_get_current_cpu());
+	if (!gCPU[smp_get_current_cpu()].disabled
+		&& core->GetLoad() + threadData->GetLoad() / core->CPUCount()
+			< kHighLoad) {
+		return core;
+	}
+
+	// use the least occupied core
+	ReadSpinLocker coreLocker(gCoreHeapsLock);
+	core = gCoreLoadHeap.PeekMinimum();
+	if (core == NULL)
+		core = gCoreHighLoadHeap.PeekMinimum();
+
+	ASSERT(core != NULL);
+	return core;
+}
+
+
+static CoreEntry*
+rebalance(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CoreEntry* core = threadData->Core();
+	ASSERT(core != NULL);
+
+	// Get the least loaded core.
+	ReadSpinLocker coreLocker(gCoreHeapsLock);
+	CoreEntry* other = gCoreLoadHeap.PeekMinimum();
+	if (other == NULL)
+		other = gCoreHighLoadHeap.PeekMinimum();
+	coreLocker.Unlock();
+	ASSERT(other != NULL);
+
+	// Only migrate, if the imbalance outweighs the estimated cost of losing
+	// the thread's cache contents.
+	int32 threshold = kLoadDifference + migration_cost(threadData);
+	int32 coreLoad = core->GetLoad();
+	int32 otherLoad = other->GetLoad();
+	if (other == core || otherLoad + threshold >= coreLoad)
+		return core;
+
+	// Check whether migrating the current thread would result in both core
+	// loads become closer to the average.
+	int32 difference = coreLoad - otherLoad - threshold;
+	ASSERT(difference > 0);
+
+	int32 threadLoad = threadData->GetLoad() / core->CPUCount();
+	return difference >= threadLoad ? other : core;
+}
+
+
+static void
+rebalance_irqs(bool idle)
+{
+	// balance interrupts the same way the low latency mode does
+	gSchedulerLowLatencyMode.rebalance_irqs(idle);
+}
+
+
+scheduler_mode_operations gSchedulerThroughputMode = {
+	"throughput",
+
+	5000,
+	1000,
+	{ 2, 5 },
+
+	50000,
+
+	switch_to_mode,
+	set_cpu_enabled,
+	has_cache_expired,
+	choose_core,
+	rebalance,
+	rebalance_irqs,
+};
@@ -437,6 +437,7 @@ Team::Team(team_id id, bool kernel)
 	}
 
 	hash_next = siblings_next = children = parent = NULL;
+	scheduler_group = NULL;
 	fName[0] = '\0';
 	fArgs[0] = '\0';
 	num_threads = 0;
@@ -447,6 +448,7 @@ Team::Team(team_id id, bool kernel)
 	thread_list = NULL;
 	main_thread = NULL;
 	loading_info = NULL;
+	vfork_info = NULL;
 	state = TEAM_STATE_BIRTH;
 	flags = 0;
 	death_entry = NULL;
@@ -518,6 +520,8 @@ Team::~Team()
 
 	DeleteUserTimers(false);
 
+	scheduler_on_team_destroy(this);
+
 	fPendingSignals.Clear();
 
 	if (fQueuedSignalsCounter != NULL)
@@ -1744,6 +1748,8 @@ load_image_internal(char**& _flatArgs, size_t flatArgsSize, int32 argCount,
 	team->Unlock();
 	parent->UnlockTeamAndProcessGroup();
 
+	scheduler_on_team_create(team, parent);
+
 	// notify team listeners
 	sNotificationService.Notify(TEAM_ADDED, team);
 
@@ -1870,6 +1876,24 @@ err1:
 }
 
 
+/*!	Lets the parent of a team created by vfork() continue, once the team does
+	no longer use the parent's memory, i.e. when it has called exec() or is
+	going away.
+	The caller must hold the team's lock.
+*/
+static void
+release_vfork_parent(Team* team)
+{
+	struct team_vfork_info* vforkInfo = team->vfork_info;
+	if (vforkInfo == NULL)
+		return;
+
+	team->vfork_info = NULL;
+	vforkInfo->done = true;
+	vforkInfo->condition.NotifyAll();
+}
+
+
 /*!	Almost shuts down the current team and loads a new image into it.
 	If successful, this function does not return and will takeover ownership of
 	the arguments provided.
@@ -1944,6 +1968,12 @@ exec_team(const char* path, char**& _flatArgs, size_t flatArgsSize,
 
 	delete_team_user_data(team);
 	vm_delete_areas(team->address_space, false);
+
+	// if we have been vfork()ed, we are now done with our parent's memory
+	teamLocker.Lock();
+	release_vfork_parent(team);
+	teamLocker.Unlock();
+
 	xsi_sem_undo(team);
 	delete_owned_ports(team);
 	sem_delete_owned_sems(team);
@@ -2018,8 +2048,13 @@ exec_team(const char* path, char**& _flatArgs, size_t flatArgsSize,
 }
 
 
+/*!	Creates a copy of the current team.
+	If \a vfork is \c true, the child doesn't get a copy of its parent's
+	memory, but shares it, except for the stack of the calling thread, and the
+	calling thread is blocked until the child calls exec() or exits.
+*/
 static thread_id
-fork_team(void)
+fork_team(bool vfork)
 {
 	Thread* parentThread = thread_get_current_thread();
 	Team* parentTeam = parentThread->team;
@@ -2030,6 +2065,7 @@ fork_team(void)
 	status_t status;
 	ssize_t areaCookie;
 	int32 imageCookie;
+	struct team_vfork_info vforkInfo;
 
 	TRACE(("fork_team(): team %" B_PRId32 "\n", parentTeam->id));
 
@@ -2066,6 +2102,12 @@ fork_team(void)
 	// inherit signal handlers
 	team->InheritSignalActions(parentTeam);
 
+	if (vfork) {
+		vforkInfo.condition.Init(team, "vfork");
+		vforkInfo.done = false;
+		team->vfork_info = &vforkInfo;
+	}
+
 	InterruptsSpinLocker teamsLocker(sTeamHashLock);
 
 	sTeamHash.Insert(team);
@@ -2081,6 +2123,8 @@ fork_team(void)
 	team->Unlock();
 	parentTeam->UnlockTeamAndProcessGroup();
 
+	scheduler_on_team_create(team, parentTeam);
+
 	// notify team listeners
 	sNotificationService.Notify(TEAM_ADDED, team);
 
@@ -2137,8 +2181,17 @@ fork_team(void)
 			thread->user_thread = team_allocate_user_thread(team);
 		} else {
 			void* address;
-			area_id area = vm_copy_area(team->address_space->ID(), info.name,
-				&address, B_CLONE_ADDRESS, info.protection, info.area);
+			area_id area = B_NOT_SUPPORTED;
+			if (vfork && info.area != parentThread->user_stack_area) {
+				// The parent won't touch its memory before we are done with
+				// it, so there is no need to make it copy-on-write.
+				area = vm_share_area(team->address_space->ID(), info.name,
+					&address, B_CLONE_ADDRESS, info.protection, info.area);
+			}
+			if (area == B_NOT_SUPPORTED) {
+				area = vm_copy_area(team->address_space->ID(), info.name,
+					&address, B_CLONE_ADDRESS, info.protection, info.area);
+			}
 			if (area < B_OK) {
 				status = area;
 				break;
@@ -2198,6 +2251,33 @@ fork_team(void)
 
 	T(TeamForked(threadID));
 
+	if (vfork) {
+		// keep the team object around until we are done waiting
+		BReference<Team> teamReference(team);
+
+		resume_thread(threadID);
+
+		// Wait until the child doesn't use our memory anymore. Whoever sets
+		// `vforkInfo.done' is responsible for removing the info from the
+		// team structure.
+		TeamLocker teamLocker(team);
+		while (!vforkInfo.done) {
+			ConditionVariableEntry entry;
+			vforkInfo.condition.Add(&entry);
+			teamLocker.Unlock();
+
+			status = entry.Wait(B_KILL_CAN_INTERRUPT);
+
+			teamLocker.Lock();
+			if (status == B_INTERRUPTED && !vforkInfo.done) {
+				team->vfork_info = NULL;
+				break;
+			}
+		}
+
+		return threadID;
+	}
+
 	resume_thread(threadID);
 	return threadID;
 
@@ -3211,6 +3291,8 @@ team_delete_team(Team* team, port_id debuggerPort)
 		}
 	}
 
+	release_vfork_parent(team);
+
 	teamLocker.Unlock();
 
 	sNotificationService.Notify(TEAM_REMOVED, team);
@@ -3909,7 +3991,14 @@ _user_exec(const char* userPath, const char* const* userFlatArgs,
 thread_id
 _user_fork(void)
 {
-	return fork_team();
+	return fork_team(false);
+}
+
+
+thread_id
+_user_vfork(void)
+{
+	return fork_team(true);
 }
 
 
@@ -170,6 +170,7 @@ Thread::Thread(const char* name, thread_id threadID, struct cpu_ent* cpu)
 	team_next(NULL),
 	priority(-1),
 	io_priority(-1),
+	timer_slack(0),
 	cpu(cpu),
 	previous_cpu(NULL),
 	pinned_to_cpu(0),
@@ -897,6 +898,11 @@ thread_create_thread(const ThreadCreationAttributes& attributes, bool kernel)
 			(int32)THREAD_MAX_SET_PRIORITY);
 	thread->state = B_THREAD_SUSPENDED;
 
+	// Userland threads tolerate a bit of timer slack by default, so that
+	// their timeouts can be coalesced with other timers.
+	thread->timer_slack = team == team_get_kernel_team()
+		? 0 : DEFAULT_USER_TIMER_SLACK;
+
 	thread->sig_block_mask = attributes.signal_mask;
 
 	// init debug structure
@@ -2902,10 +2908,12 @@ thread_block_with_timeout(uint32 timeoutFlags, bigtime_t timeout)
 				timerFlags |= B_TIMER_REAL_TIME_BASE;
 		}
 
-		// install the timer
+		// install the timer -- real-time threads don't get any slack
+		bigtime_t slack = thread->priority >= B_REAL_TIME_DISPLAY_PRIORITY
+			? 0 : thread->timer_slack;
 		thread->wait.unblock_timer.user_data = thread;
-		add_timer(&thread->wait.unblock_timer, &thread_block_timeout, timeout,
-			timerFlags);
+		add_timer_etc(&thread->wait.unblock_timer, &thread_block_timeout,
+			timeout, timerFlags, slack);
 	}
 
 	// block
@@ -2934,6 +2942,17 @@ thread_unblock(Thread* thread, status_t status)
 }
 
 
+/*!	Sets the timer slack of the current thread, i.e. how many microseconds
+	late its timeouts may expire, so that they can be coalesced with other
+	timers.
+*/
+void
+thread_set_timer_slack(bigtime_t slack)
+{
+	thread_get_current_thread()->timer_slack = slack;
+}
+
+
 /*!	Unblocks a userland-blocked thread.
 	The caller must not hold any locks.
 */
@@ -31,6 +31,7 @@ struct per_cpu_timer_data {
 	timer* volatile	current_event;
 	int32			current_event_in_progress;
 	bigtime_t		real_time_offset;
+	int64			coalesced_events;
 };
 
 static per_cpu_timer_data sPerCPU[SMP_MAX_CPUS];
@@ -90,6 +91,42 @@ add_event_to_list(timer* event, timer* volatile* list)
 }
 
 
+/*!	Moves the schedule time of the one-shot timer \a event by at most \a slack
+	into the future, so that it expires together with other timers.
+	If a timer already scheduled on this CPU expires within the slack, the
+	event is scheduled at that same time. Otherwise the schedule time is
+	rounded up to the greatest power of two not exceeding the slack, so that
+	timers added later are likely to end up at the same time.
+	NOTE: expects interrupts to be off and the CPU's timer lock to be held.
+*/
+static void
+apply_timer_slack(per_cpu_timer_data& cpuData, timer* event, bigtime_t slack)
+{
+	bigtime_t scheduleTime = event->schedule_time;
+	if (scheduleTime > B_INFINITE_TIMEOUT - slack)
+		return;
+
+	for (timer* other = cpuData.events; other != NULL; other = other->next) {
+		if ((bigtime_t)other->schedule_time < scheduleTime)
+			continue;
+
+		if ((bigtime_t)other->schedule_time <= scheduleTime + slack) {
+			event->schedule_time = other->schedule_time;
+			cpuData.coalesced_events++;
+			return;
+		}
+		break;
+	}
+
+	bigtime_t granularity = 1;
+	while (granularity <= slack / 2)
+		granularity *= 2;
+
+	event->schedule_time = (scheduleTime + granularity - 1) / granularity
+		* granularity;
+}
+
+
 static void
 per_cpu_real_time_clock_changed(void*, int cpu)
 {
@@ -163,7 +200,8 @@ dump_timers(int argc, char** argv)
 {
 	int32 cpuCount = smp_get_num_cpus();
 	for (int32 i = 0; i < cpuCount; i++) {
-		kprintf("CPU %" B_PRId32 ":\n", i);
+		kprintf("CPU %" B_PRId32 ": %" B_PRId64 " coalesced timers\n", i,
+			sPerCPU[i].coalesced_events);
 
 		if (sPerCPU[i].events == NULL) {
 			kprintf("  no timers scheduled\n");
@@ -208,6 +246,69 @@ dump_timers(int argc, char** argv)
 // #pragma mark - kernel-private
 
 
+/*!	Like add_timer(), but allows the kernel to expire a one-shot timer up to
+	\a slack microseconds late, if that lets it coalesce the timer with
+	others, saving timer interrupts and allowing an idle CPU to sleep longer.
+	Periodic timers are never delayed.
+*/
+status_t
+add_timer_etc(timer* event, timer_hook hook, bigtime_t period, int32 flags,
+	bigtime_t slack)
+{
+	bigtime_t currentTime = system_time();
+	cpu_status state;
+
+	if (event == NULL || hook == NULL || period < 0 || slack < 0)
+		return B_BAD_VALUE;
+
+	TRACE(("add_timer_etc: event %p, slack %lld\n", event, slack));
+
+	// compute the schedule time
+	if ((flags & B_TIMER_USE_TIMER_STRUCT_TIMES) != 0) {
+		period = event->period;
+	} else {
+		bigtime_t scheduleTime = period;
+		if ((flags & ~B_TIMER_FLAGS) != B_ONE_SHOT_ABSOLUTE_TIMER)
+			scheduleTime += currentTime;
+		event->schedule_time = (int64)scheduleTime;
+		event->period = period;
+	}
+
+	event->hook = hook;
+	event->flags = flags;
+
+	state = disable_interrupts();
+	int currentCPU = smp_get_current_cpu();
+	per_cpu_timer_data& cpuData = sPerCPU[currentCPU];
+	acquire_spinlock(&cpuData.lock);
+
+	// If the timer is an absolute real-time base timer, convert the schedule
+	// time to system time.
+	if ((flags & ~B_TIMER_FLAGS) == B_ONE_SHOT_ABSOLUTE_TIMER
+		&& (flags & B_TIMER_REAL_TIME_BASE) != 0) {
+		if (event->schedule_time > cpuData.real_time_offset)
+			event->schedule_time -= cpuData.real_time_offset;
+		else
+			event->schedule_time = 0;
+	}
+
+	if (slack > 0 && (flags & ~B_TIMER_FLAGS) != B_PERIODIC_TIMER)
+		apply_timer_slack(cpuData, event, slack);
+
+	add_event_to_list(event, &cpuData.events);
+	event->cpu = currentCPU;
+
+	// if we were stuck at the head of the list, set the hardware timer
+	if (event == cpuData.events)
+		set_hardware_timer(event->schedule_time, currentTime);
+
+	release_spinlock(&cpuData.lock);
+	restore_interrupts(state);
+
+	return B_OK;
+}
+
+
 status_t
 timer_init(kernel_args* args)
 {
@@ -319,56 +420,7 @@ timer_interrupt()
 status_t
 add_timer(timer* event, timer_hook hook, bigtime_t period, int32 flags)
 {
-	bigtime_t currentTime = system_time();
-	cpu_status state;
-
-	if (event == NULL || hook == NULL || period < 0)
-		return B_BAD_VALUE;
-
-	TRACE(("add_timer: event %p\n", event));
-
-	// compute the schedule time
-	bigtime_t scheduleTime;
-	if ((flags & B_TIMER_USE_TIMER_STRUCT_TIMES) != 0) {
-		scheduleTime = event->schedule_time;
-		period = event->period;
-	} else {
-		scheduleTime = period;
-		if ((flags & ~B_TIMER_FLAGS) != B_ONE_SHOT_ABSOLUTE_TIMER)
-			scheduleTime += currentTime;
-		event->schedule_time = (int64)scheduleTime;
-		event->period = period;
-	}
-
-	event->hook = hook;
-	event->flags = flags;
-
-	state = disable_interrupts();
-	int currentCPU = smp_get_current_cpu();
-	per_cpu_timer_data& cpuData = sPerCPU[currentCPU];
-	acquire_spinlock(&cpuData.lock);
-
-	// If the timer is an absolute real-time base timer, convert the schedule
-	// time to system time.
-	if ((flags & ~B_TIMER_FLAGS) == B_ONE_SHOT_ABSOLUTE_TIMER
-		&& (flags & B_TIMER_REAL_TIME_BASE) != 0) {
-		if (event->schedule_time > cpuData.real_time_offset)
-			event->schedule_time -= cpuData.real_time_offset;
-		else
-			event->schedule_time = 0;
-	}
-
-	add_event_to_list(event, &cpuData.events);
-	event->cpu = currentCPU;
-
-	// if we were stuck at the head of the list, set the hardware timer
-	if (event == cpuData.events)
-		set_hardware_timer(scheduleTime, currentTime);
-
-	release_spinlock(&cpuData.lock);
-	restore_interrupts(state);
-
-	return B_OK;
+	return add_timer_etc(event, hook, period, flags, 0);
 }
 
 
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A small implementation of the LZ4 block format. It is meant for
+	compressing single pages and other small buffers: the compressor is a
+	plain greedy one with 16 bit offsets into the input, so it only handles
+	input of up to LZ4_MAX_INPUT_SIZE bytes. The output can be decompressed by
+	any LZ4 implementation, and vice versa.
+*/
+
+
+#include <util/lz4.h>
+
+#include <string.h>
+
+
+static const size_t kMinMatch = 4;
+static const size_t kLastLiterals = 5;
+	// the last bytes of a block are always literals
+static const size_t kMatchFindLimit = 12;
+	// a match must not start within the last bytes of a block
+static const uint32 kHashBits = 12;
+static const uint32 kMaxOffset = 65535;
+static const uint32 kRunMask = 15;
+
+
+static inline uint32
+read32(const uint8* data)
+{
+	uint32 value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+
+static inline uint32
+hash_sequence(uint32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+
+static inline uint8*
+write_length(uint8* output, size_t length)
+{
+	while (length >= 255) {
+		*output++ = 255;
+		length -= 255;
+	}
+	*output++ = (uint8)length;
+	return output;
+}
+
+
+static inline bool
+read_length(const uint8*& input, const uint8* inputEnd, size_t& length)
+{
+	uint8 byte;
+	do {
+		if (input >= inputEnd)
+			return false;
+		byte = *input++;
+		length += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+
+/*!	Compresses \a sourceSize bytes from \a source into \a dest.
+	\a workMemory must point to LZ4_WORK_MEMORY_SIZE bytes of scratch memory.
+	Returns the size of the compressed data, or 0 if it didn't fit into
+	\a destCapacity bytes.
+*/
+size_t
+lz4_compress(const void* source, size_t sourceSize, void* dest,
+	size_t destCapacity, void* workMemory)
+{
+	if (sourceSize > LZ4_MAX_INPUT_SIZE)
+		return 0;
+
+	const uint8* input = (const uint8*)source;
+	const uint8* inputEnd = input + sourceSize;
+	const uint8* anchor = input;
+	uint8* output = (uint8*)dest;
+	uint8* outputEnd = output + destCapacity;
+
+	uint16* hashTable = (uint16*)workMemory;
+	memset(hashTable, 0, LZ4_WORK_MEMORY_SIZE);
+
+	if (sourceSize > kMatchFindLimit) {
+		const uint8* matchFindEnd = inputEnd - kMatchFindLimit;
+		const uint8* matchEnd = inputEnd - kLastLiterals;
+		const uint8* position = input;
+
+		while (position < matchFindEnd) {
+			uint32 sequence = read32(position);
+			uint32 hash = hash_sequence(sequence);
+			const uint8* match = input + hashTable[hash];
+			hashTable[hash] = (uint16)(position - input);
+
+			if (match >= position || position - match > kMaxOffset
+				|| read32(match) != sequence) {
+				position++;
+				continue;
+			}
+
+			// extend the match backwards into the pending literals
+			while (position > anchor && match > input
+				&& position[-1] == match[-1]) {
+				position--;
+				match--;
+			}
+
+			const uint8* matchStart = position;
+			uint32 offset = position - match;
+			position += kMinMatch;
+			match += kMinMatch;
+			while (position < matchEnd && *position == *match) {
+				position++;
+				match++;
+			}
+
+			size_t literalLength = matchStart - anchor;
+			size_t matchLength = position - matchStart - kMinMatch;
+
+			if ((size_t)(outputEnd - output) < 1 + literalLength / 255 + 1
+					+ literalLength + 2 + matchLength / 255 + 1) {
+				return 0;
+			}
+
+			uint8* token = output++;
+			*token = (literalLength >= kRunMask ? kRunMask : literalLength)
+				<< 4;
+			if (literalLength >= kRunMask)
+				output = write_length(output, literalLength - kRunMask);
+			memcpy(output, anchor, literalLength);
+			output += literalLength;
+
+			*output++ = (uint8)offset;
+			*output++ = (uint8)(offset >> 8);
+
+			*token |= matchLength >= kRunMask ? kRunMask : matchLength;
+			if (matchLength >= kRunMask)
+				output = write_length(output, matchLength - kRunMask);
+
+			anchor = position;
+		}
+	}
+
+	// the remaining input is stored as literals
+	size_t literalLength = inputEnd - anchor;
+	if ((size_t)(outputEnd - output)
+			< 1 + literalLength / 255 + 1 + literalLength) {
+		return 0;
+	}
+
+	*output++ = (literalLength >= kRunMask ? kRunMask : literalLength) << 4;
+	if (literalLength >= kRunMask)
+		output = write_length(output, literalLength - kRunMask);
+	memcpy(output, anchor, literalLength);
+	output += literalLength;
+
+	return output - (uint8*)dest;
+}
+
+
+/*!	Decompresses \a sourceSize bytes of LZ4 block data from \a source into
+	\a dest. Returns the size of the decompressed data, or \c B_BAD_DATA if the
+	input is corrupt or doesn't fit into \a destCapacity bytes.
+*/
+ssize_t
+lz4_decompress(const void* source, size_t sourceSize, void* dest,
+	size_t destCapacity)
+{
+	const uint8* input = (const uint8*)source;
+	const uint8* inputEnd = input + sourceSize;
+	uint8* output = (uint8*)dest;
+	uint8* outputEnd = output + destCapacity;
+
+	while (input < inputEnd) {
+		uint8 token = *input++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == kRunMask
+			&& !read_length(input, inputEnd, literalLength)) {
+			return B_BAD_DATA;
+		}
+
+		if (literalLength > (size_t)(inputEnd - input)
+			|| literalLength > (size_t)(outputEnd - output)) {
+			return B_BAD_DATA;
+		}
+
+		memcpy(output, input, literalLength);
+		input += literalLength;
+		output += literalLength;
+
+		// the last sequence only consists of literals
+		if (input == inputEnd)
+			break;
+
+		if (inputEnd - input < 2)
+			return B_BAD_DATA;
+
+		size_t offset = input[0] | (input[1] << 8);
+		input += 2;
+		if (offset == 0 || offset > (size_t)(output - (uint8*)dest))
+			return B_BAD_DATA;
+
+		size_t matchLength = token & kRunMask;
+		if (matchLength == kRunMask
+			&& !read_length(input, inputEnd, matchLength)) {
+			return B_BAD_DATA;
+		}
+		matchLength += kMinMatch;
+
+		if (matchLength > (size_t)(outputEnd - output))
+			return B_BAD_DATA;
+
+		// the match may overlap the output, so it needs to be copied bytewise
+		const uint8* match = output - offset;
+		while (matchLength-- > 0)
+			*output++ = *match++;
+	}
+
+	return output - (uint8*)dest;
+}
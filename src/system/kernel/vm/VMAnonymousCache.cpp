@@ -47,6 +47,7 @@
 #include <tracing.h>
 #include <util/AutoLock.h>
 #include <util/DoublyLinkedList.h>
+#include <util/lz4.h>
 #include <util/OpenHashTable.h>
 #include <util/RadixBitmap.h>
 #include <vfs.h>
@@ -54,6 +55,7 @@
 #include <vm/vm_page.h>
 #include <vm/vm_priv.h>
 #include <vm/VMAddressSpace.h>
+#include <vm_defs.h>
 
 #include "IORequest.h"
 
@@ -82,6 +84,21 @@
 #define SWAP_BLOCK_SHIFT 5		/* 1 << SWAP_BLOCK_SHIFT == SWAP_BLOCK_PAGES */
 #define SWAP_BLOCK_MASK  (SWAP_BLOCK_PAGES - 1)
 
+// The slots of the compressed swap tier lie beyond those of all swap files.
+#define COMPRESSED_SWAP_FIRST_SLOT	0x80000000
+
+// Compressed pages are stored in object caches of multiples of this size.
+#define COMPRESSED_PAGE_GRANULARITY	256
+
+// A page is only kept compressed, if it shrinks at least to this size.
+#define COMPRESSED_PAGE_MAX_SIZE	(B_PAGE_SIZE * 3 / 4)
+
+// Pages that don't compress well are only kept in the compressed swap tier
+// when the swap files are full; they are stored uncompressed then.
+#define COMPRESSED_PAGE_SIZE_CLASSES \
+	((sizeof(compressed_page) + B_PAGE_SIZE - 1) \
+		/ COMPRESSED_PAGE_GRANULARITY + 1)
+
 
 static const char* const kDefaultSwapPath = "/var/swap";
 
@@ -94,6 +111,11 @@ struct swap_file : DoublyLinkedListLinkImpl<swap_file> {
 	radix_bitmap*	bmp;
 };
 
+struct compressed_page {
+	uint16			size;
+	uint8			data[0];
+};
+
 struct swap_hash_key {
 	VMAnonymousCache	*cache;
 	off_t				page_index;  // page index in the cache
@@ -155,6 +177,33 @@ static mutex sAvailSwapSpaceLock;
 
 static object_cache* sSwapBlockCache;
 
+// The compressed swap tier keeps swapped out pages compressed in memory, as
+// long as they compress well and its pool isn't full. Only the other pages
+// are written to a swap file.
+// The memory of the pool is reserved up front, and the tier only provides as
+// many slots as the pool can hold uncompressed pages, so that the swap space
+// it adds is really backed. The part of the reservation the pool uses is
+// handed over to the slab allocator, which reserves it again.
+static swap_file* sCompressedSwap = NULL;
+static compressed_page** sCompressedPages;
+	// indexed by slot, protected by sSwapFileListLock
+static object_cache* sCompressedPageCaches[COMPRESSED_PAGE_SIZE_CLASSES];
+static mutex sCompressionLock;
+	// protects the buffers below
+static uint8* sCompressionBuffer;
+static uint8* sCompressedData;
+static void* sCompressionWorkMemory;
+static off_t sCompressedSwapMaxPoolSize;
+static int64 sCompressedSwapPoolSize;
+static off_t sCompressedSwapReservedMemory;
+	// protected by sCompressionLock
+static int64 sCompressedSwapStoredPages;
+static int64 sCompressedSwapCompressedSize;
+static int64 sCompressedSwapStores;
+static int64 sCompressedSwapLoads;
+static int64 sCompressedSwapRejected;
+static int64 sCompressedSwapPoolFull;
+
 
 #if SWAP_TRACING
 namespace SwapTracing {
@@ -245,6 +294,16 @@ dump_swap_info(int argc, char** argv)
 		freeSwapPages += file->bmp->free_slots;
 	}
 
+	if (sCompressedSwap != NULL) {
+		swap_addr_t total = sCompressedSwap->last_slot
+			- sCompressedSwap->first_slot;
+		kprintf("  compressed, pages: total: %" B_PRIu32 ", free: %" B_PRIu32
+			"\n", total, sCompressedSwap->bmp->free_slots);
+
+		totalSwapPages += total;
+		freeSwapPages += sCompressedSwap->bmp->free_slots;
+	}
+
 	kprintf("\n");
 	kprintf("swap space in pages:\n");
 	kprintf("total:     %9" B_PRIu32 "\n", totalSwapPages);
@@ -254,6 +313,20 @@ dump_swap_info(int argc, char** argv)
 	kprintf("used:      %9" B_PRIu32 "\n", totalSwapPages - freeSwapPages);
 	kprintf("free:      %9" B_PRIu32 "\n", freeSwapPages);
 
+	if (sCompressedSwap != NULL) {
+		kprintf("\n");
+		kprintf("compressed swap:\n");
+		kprintf("pool size: %9" B_PRId64 " of %" B_PRIdOFF " bytes\n",
+			sCompressedSwapPoolSize, sCompressedSwapMaxPoolSize);
+		kprintf("stored:    %9" B_PRId64 " pages, %" B_PRId64 " bytes\n",
+			sCompressedSwapStoredPages, sCompressedSwapCompressedSize);
+		kprintf("stores:    %9" B_PRId64 "\n", sCompressedSwapStores);
+		kprintf("loads:     %9" B_PRId64 "\n", sCompressedSwapLoads);
+		kprintf("rejected:  %9" B_PRId64 " pages, %" B_PRId64
+			" with a full pool\n", sCompressedSwapRejected,
+			sCompressedSwapPoolFull);
+	}
+
 	return 0;
 }
 
@@ -265,7 +338,10 @@ swap_slot_alloc(uint32 count)
 
 	if (sSwapFileList.IsEmpty()) {
 		mutex_unlock(&sSwapFileListLock);
-		panic("swap_slot_alloc(): no swap file in the system\n");
+		// pages that don't fit into the compressed swap tier can't be swapped
+		// out without a swap file
+		if (sCompressedSwap == NULL)
+			panic("swap_slot_alloc(): no swap file in the system\n");
 		return SWAP_SLOT_NONE;
 	}
 
@@ -293,7 +369,10 @@ swap_slot_alloc(uint32 count)
 
 	if (j == sSwapFileCount) {
 		mutex_unlock(&sSwapFileListLock);
-		panic("swap_slot_alloc: swap space exhausted!\n");
+		// The swap space reserved includes the compressed swap tier, so the
+		// swap files can run out when pages didn't compress well.
+		if (sCompressedSwap == NULL)
+			panic("swap_slot_alloc: swap space exhausted!\n");
 		return SWAP_SLOT_NONE;
 	}
 
@@ -310,9 +389,20 @@ swap_slot_alloc(uint32 count)
 }
 
 
+static inline bool
+is_compressed_swap_slot(swap_addr_t slotIndex)
+{
+	return sCompressedSwap != NULL && slotIndex >= sCompressedSwap->first_slot
+		&& slotIndex < sCompressedSwap->last_slot;
+}
+
+
 static swap_file*
 find_swap_file(swap_addr_t slotIndex)
 {
+	if (is_compressed_swap_slot(slotIndex))
+		return sCompressedSwap;
+
 	for (SwapFileList::Iterator it = sSwapFileList.GetIterator();
 		swap_file* swapFile = it.Next();) {
 		if (slotIndex >= swapFile->first_slot
@@ -327,6 +417,67 @@ find_swap_file(swap_addr_t slotIndex)
 }
 
 
+static inline uint32
+compressed_page_size_class(size_t size)
+{
+	return (sizeof(compressed_page) + size - 1) / COMPRESSED_PAGE_GRANULARITY;
+}
+
+
+/*!	Adjusts the memory the compressed swap tier keeps reserved to the part of
+	its pool that isn't in use.
+	The caller must hold sCompressionLock.
+*/
+static void
+compressed_swap_update_reserved_memory()
+{
+	off_t reserved = sCompressedSwapMaxPoolSize
+		- atomic_get64(&sCompressedSwapPoolSize);
+	if (reserved < sCompressedSwapReservedMemory) {
+		vm_unreserve_memory(sCompressedSwapReservedMemory - reserved);
+		sCompressedSwapReservedMemory = reserved;
+	} else if (reserved > sCompressedSwapReservedMemory) {
+		// If this fails, it's tried again the next time.
+		if (vm_try_reserve_memory(reserved - sCompressedSwapReservedMemory,
+				VM_PRIORITY_VIP, 0) == B_OK) {
+			sCompressedSwapReservedMemory = reserved;
+		}
+	}
+}
+
+
+/*!	Frees the compressed pages of the given slots, relative to the first slot
+	of the compressed swap tier. The caller must hold sSwapFileListLock.
+*/
+static void
+compressed_swap_free(swap_addr_t slotIndex, uint32 count)
+{
+	bool freed = false;
+	for (uint32 i = 0; i < count; i++) {
+		compressed_page* page = sCompressedPages[slotIndex + i];
+		if (page == NULL)
+			continue;
+
+		sCompressedPages[slotIndex + i] = NULL;
+
+		uint32 sizeClass = compressed_page_size_class(page->size);
+		atomic_add64(&sCompressedSwapPoolSize,
+			-(int64)(sizeClass + 1) * COMPRESSED_PAGE_GRANULARITY);
+		atomic_add64(&sCompressedSwapStoredPages, -1);
+		atomic_add64(&sCompressedSwapCompressedSize, -(int64)page->size);
+
+		object_cache_free(sCompressedPageCaches[sizeClass], page,
+			CACHE_DONT_WAIT_FOR_MEMORY | CACHE_DONT_LOCK_KERNEL_SPACE);
+		freed = true;
+	}
+
+	if (freed) {
+		MutexLocker locker(sCompressionLock);
+		compressed_swap_update_reserved_memory();
+	}
+}
+
+
 static void
 swap_slot_dealloc(swap_addr_t slotIndex, uint32 count)
 {
@@ -336,11 +487,160 @@ swap_slot_dealloc(swap_addr_t slotIndex, uint32 count)
 	mutex_lock(&sSwapFileListLock);
 	swap_file* swapFile = find_swap_file(slotIndex);
 	slotIndex -= swapFile->first_slot;
+	if (swapFile == sCompressedSwap)
+		compressed_swap_free(slotIndex, count);
 	radix_bitmap_dealloc(swapFile->bmp, slotIndex, count);
 	mutex_unlock(&sSwapFileListLock);
 }
 
 
+/*!	Tries to store the page at \a base compressed in the compressed swap tier.
+	Returns the slot it has been stored in, or \c SWAP_SLOT_NONE, if the
+	page didn't compress well enough, or there is no room left for it.
+	If \a storeUncompressed is \c true, a page that doesn't compress well is
+	stored as is instead.
+*/
+static swap_addr_t
+compressed_swap_store(generic_addr_t base, generic_size_t length, uint32 flags,
+	bool storeUncompressed)
+{
+	if (sCompressedSwap == NULL)
+		return SWAP_SLOT_NONE;
+
+	mutex_lock(&sSwapFileListLock);
+	swap_addr_t slotIndex = radix_bitmap_alloc(sCompressedSwap->bmp, 1);
+	mutex_unlock(&sSwapFileListLock);
+	if (slotIndex == SWAP_SLOT_NONE)
+		return SWAP_SLOT_NONE;
+
+	slotIndex += sCompressedSwap->first_slot;
+
+	MutexLocker locker(sCompressionLock);
+
+	length = min_c(length, B_PAGE_SIZE);
+	if ((flags & B_PHYSICAL_IO_REQUEST) != 0) {
+		if (vm_memcpy_from_physical(sCompressionBuffer, base, length, false)
+				!= B_OK) {
+			locker.Unlock();
+			swap_slot_dealloc(slotIndex, 1);
+			return SWAP_SLOT_NONE;
+		}
+	} else
+		memcpy(sCompressionBuffer, (void*)base, length);
+
+	if (length < B_PAGE_SIZE)
+		memset(sCompressionBuffer + length, 0, B_PAGE_SIZE - length);
+
+	const uint8* data = sCompressedData;
+	size_t size = lz4_compress(sCompressionBuffer, B_PAGE_SIZE,
+		sCompressedData, COMPRESSED_PAGE_MAX_SIZE - sizeof(compressed_page),
+		sCompressionWorkMemory);
+	if (size == 0) {
+		if (!storeUncompressed) {
+			locker.Unlock();
+			atomic_add64(&sCompressedSwapRejected, 1);
+			swap_slot_dealloc(slotIndex, 1);
+			return SWAP_SLOT_NONE;
+		}
+
+		data = sCompressionBuffer;
+		size = B_PAGE_SIZE;
+	}
+
+	uint32 sizeClass = compressed_page_size_class(size);
+	int64 objectSize = (int64)(sizeClass + 1) * COMPRESSED_PAGE_GRANULARITY;
+	compressed_page* page = NULL;
+	if (atomic_add64(&sCompressedSwapPoolSize, objectSize) + objectSize
+			<= sCompressedSwapMaxPoolSize) {
+		// hand the memory over to the slab allocator
+		compressed_swap_update_reserved_memory();
+		page = (compressed_page*)object_cache_alloc(
+			sCompressedPageCaches[sizeClass],
+			CACHE_DONT_WAIT_FOR_MEMORY | CACHE_DONT_LOCK_KERNEL_SPACE
+				| CACHE_PRIORITY_VIP);
+	}
+
+	if (page == NULL) {
+		atomic_add64(&sCompressedSwapPoolSize, -objectSize);
+		compressed_swap_update_reserved_memory();
+		locker.Unlock();
+		atomic_add64(&sCompressedSwapPoolFull, 1);
+		swap_slot_dealloc(slotIndex, 1);
+		return SWAP_SLOT_NONE;
+	}
+
+	page->size = size;
+	memcpy(page->data, data, size);
+	locker.Unlock();
+
+	mutex_lock(&sSwapFileListLock);
+	sCompressedPages[slotIndex - sCompressedSwap->first_slot] = page;
+	mutex_unlock(&sSwapFileListLock);
+
+	atomic_add64(&sCompressedSwapStoredPages, 1);
+	atomic_add64(&sCompressedSwapCompressedSize, size);
+	atomic_add64(&sCompressedSwapStores, 1);
+
+	return slotIndex;
+}
+
+
+static status_t
+compressed_swap_load(swap_addr_t slotIndex, const generic_io_vec& vec,
+	uint32 flags)
+{
+	// The page is busy while it is read, so its compressed data can't go away
+	// in the meantime.
+	mutex_lock(&sSwapFileListLock);
+	compressed_page* page
+		= sCompressedPages[slotIndex - sCompressedSwap->first_slot];
+	mutex_unlock(&sSwapFileListLock);
+
+	if (page == NULL) {
+		panic("compressed_swap_load(): no page in slot %" B_PRIu32 "\n",
+			slotIndex);
+		return B_ERROR;
+	}
+
+	generic_size_t length = min_c(vec.length, B_PAGE_SIZE);
+
+	if (page->size == B_PAGE_SIZE) {
+		// the page is stored uncompressed
+		if ((flags & B_PHYSICAL_IO_REQUEST) != 0) {
+			status_t status = vm_memcpy_to_physical(vec.base, page->data,
+				length, false);
+			if (status != B_OK)
+				return status;
+		} else
+			memcpy((void*)vec.base, page->data, length);
+	} else if ((flags & B_PHYSICAL_IO_REQUEST) == 0 && length == B_PAGE_SIZE) {
+		// we can decompress into the buffer directly
+		if (lz4_decompress(page->data, page->size, (void*)vec.base,
+				B_PAGE_SIZE) != B_PAGE_SIZE) {
+			return B_BAD_DATA;
+		}
+	} else {
+		MutexLocker locker(sCompressionLock);
+
+		if (lz4_decompress(page->data, page->size, sCompressionBuffer,
+				B_PAGE_SIZE) != B_PAGE_SIZE) {
+			return B_BAD_DATA;
+		}
+
+		if ((flags & B_PHYSICAL_IO_REQUEST) != 0) {
+			status_t status = vm_memcpy_to_physical(vec.base,
+				sCompressionBuffer, length, false);
+			if (status != B_OK)
+				return status;
+		} else
+			memcpy((void*)vec.base, sCompressionBuffer, length);
+	}
+
+	atomic_add64(&sCompressedSwapLoads, 1);
+	return B_OK;
+}
+
+
 static off_t
 swap_space_reserve(off_t amount)
 {
@@ -606,6 +906,16 @@ VMAnonymousCache::Read(off_t offset, const generic_io_vec* vecs, size_t count,
 		T(ReadPage(this, pageIndex, startSlotIndex));
 			// TODO: Assumes that only one page is read.
 
+		if (is_compressed_swap_slot(startSlotIndex)) {
+			for (uint32 k = i; k < j; k++) {
+				status_t status = compressed_swap_load(
+					startSlotIndex + k - i, vecs[k], flags);
+				if (status != B_OK)
+					return status;
+			}
+			continue;
+		}
+
 		swap_file* swapFile = find_swap_file(startSlotIndex);
 
 		off_t pos = (off_t)(startSlotIndex - swapFile->first_slot)
@@ -632,11 +942,24 @@ VMAnonymousCache::Write(off_t offset, const generic_io_vec* vecs, size_t count,
 	page_num_t totalPages = 0;
 	for (uint32 i = 0; i < count; i++) {
 		page_num_t pageCount = (vecs[i].length + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
-		swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex + totalPages);
-		if (slotIndex != SWAP_SLOT_NONE) {
-			swap_slot_dealloc(slotIndex, pageCount);
-			_SwapBlockFree(pageIndex + totalPages, pageCount);
-			fAllocatedSwapSize -= pageCount * B_PAGE_SIZE;
+		if (sCompressedSwap != NULL) {
+			// the pages' slots aren't necessarily contiguous
+			for (page_num_t j = 0; j < pageCount; j++) {
+				swap_addr_t slotIndex
+					= _SwapBlockGetAddress(pageIndex + totalPages + j);
+				if (slotIndex != SWAP_SLOT_NONE) {
+					swap_slot_dealloc(slotIndex, 1);
+					_SwapBlockFree(pageIndex + totalPages + j, 1);
+					fAllocatedSwapSize -= B_PAGE_SIZE;
+				}
+			}
+		} else {
+			swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex + totalPages);
+			if (slotIndex != SWAP_SLOT_NONE) {
+				swap_slot_dealloc(slotIndex, pageCount);
+				_SwapBlockFree(pageIndex + totalPages, pageCount);
+				fAllocatedSwapSize -= pageCount * B_PAGE_SIZE;
+			}
 		}
 
 		totalPages += pageCount;
@@ -657,53 +980,121 @@ VMAnonymousCache::Write(off_t offset, const generic_io_vec* vecs, size_t count,
 
 		generic_addr_t vectorBase = vecs[i].base;
 		generic_size_t vectorLength = vecs[i].length;
-		page_num_t n = pageCount;
-
-		for (page_num_t j = 0; j < pageCount; j += n) {
-			swap_addr_t slotIndex;
-			// try to allocate n slots, if fail, try to allocate n/2
-			while ((slotIndex = swap_slot_alloc(n)) == SWAP_SLOT_NONE && n >= 2)
-				n >>= 1;
 
+		// Keep the pages in the compressed swap tier, if possible; the runs
+		// of pages in between are written to the swap files together.
+		page_num_t runStart = 0;
+		for (page_num_t j = 0; sCompressedSwap != NULL && j < pageCount; j++) {
+			generic_size_t offset = j * B_PAGE_SIZE;
+			swap_addr_t slotIndex = compressed_swap_store(vectorBase + offset,
+				min_c(vectorLength - offset, B_PAGE_SIZE), flags, false);
 			if (slotIndex == SWAP_SLOT_NONE)
-				panic("VMAnonymousCache::Write(): can't allocate swap space\n");
-
-			T(WritePage(this, pageIndex, slotIndex));
-				// TODO: Assumes that only one page is written.
+				continue;
 
-			swap_file* swapFile = find_swap_file(slotIndex);
+			status_t status = B_OK;
+			if (j > runStart) {
+				generic_size_t runOffset = runStart * B_PAGE_SIZE;
+				status = _WriteSwapFilePages(pageIndex + totalPages + runStart,
+					vectorBase + runOffset, offset - runOffset, j - runStart,
+					flags, pagesLeft);
+			}
+			if (status != B_OK) {
+				swap_slot_dealloc(slotIndex, 1);
 
-			off_t pos = (off_t)(slotIndex - swapFile->first_slot) * B_PAGE_SIZE;
+				locker.Lock();
+				fAllocatedSwapSize -= (off_t)pagesLeft * B_PAGE_SIZE;
+				locker.Unlock();
+				return status;
+			}
 
-			generic_size_t length = (phys_addr_t)n * B_PAGE_SIZE;
-			generic_io_vec vector[1];
-			vector->base = vectorBase;
-			vector->length = length;
+			T(WritePage(this, pageIndex, slotIndex));
+			_SwapBlockBuild(pageIndex + totalPages + j, slotIndex, 1);
+			pagesLeft--;
+			runStart = j + 1;
+		}
 
-			status_t status = vfs_write_pages(swapFile->vnode, swapFile->cookie,
-				pos, vector, 1, flags, &length);
+		if (runStart < pageCount) {
+			generic_size_t runOffset = runStart * B_PAGE_SIZE;
+			status_t status = _WriteSwapFilePages(
+				pageIndex + totalPages + runStart, vectorBase + runOffset,
+				vectorLength - min_c(vectorLength, runOffset),
+				pageCount - runStart, flags, pagesLeft);
 			if (status != B_OK) {
 				locker.Lock();
 				fAllocatedSwapSize -= (off_t)pagesLeft * B_PAGE_SIZE;
 				locker.Unlock();
-
-				swap_slot_dealloc(slotIndex, n);
 				return status;
 			}
+		}
+
+		totalPages += pageCount;
+	}
+
+	ASSERT(pagesLeft == 0);
+	return B_OK;
+}
+
+
+/*!	Writes \a pageCount pages from \a base on to the swap files, in as few
+	runs of contiguous slots as possible. When the swap files are full, the
+	pages are kept in the compressed swap tier, which has room for all pages
+	its slots have been accounted for.
+	\a pagesLeft is decremented by the number of pages written.
+*/
+status_t
+VMAnonymousCache::_WriteSwapFilePages(off_t pageIndex, generic_addr_t base,
+	generic_size_t length, page_num_t pageCount, uint32 flags,
+	page_num_t& pagesLeft)
+{
+	page_num_t n = pageCount;
+
+	for (page_num_t j = 0; j < pageCount; j += n) {
+		n = min_c(n, pageCount - j);
+
+		// try to allocate n slots, if fail, try to allocate n/2
+		swap_addr_t slotIndex;
+		while ((slotIndex = swap_slot_alloc(n)) == SWAP_SLOT_NONE && n >= 2)
+			n >>= 1;
+
+		if (slotIndex == SWAP_SLOT_NONE) {
+			slotIndex = compressed_swap_store(base,
+				min_c(length, B_PAGE_SIZE), flags, true);
+			if (slotIndex == SWAP_SLOT_NONE) {
+				if (sCompressedSwap == NULL) {
+					panic("VMAnonymousCache::Write(): can't allocate swap "
+						"space\n");
+				}
+				return B_DEVICE_FULL;
+			}
+		} else {
+			swap_file* swapFile = find_swap_file(slotIndex);
 
-			_SwapBlockBuild(pageIndex + totalPages, slotIndex, n);
-			pagesLeft -= n;
+			off_t pos = (off_t)(slotIndex - swapFile->first_slot)
+				* B_PAGE_SIZE;
 
-			if (n != pageCount) {
-				vectorBase = vectorBase + n * B_PAGE_SIZE;
-				vectorLength -= n * B_PAGE_SIZE;
+			generic_size_t writeLength = (phys_addr_t)n * B_PAGE_SIZE;
+			generic_io_vec vector[1];
+			vector->base = base;
+			vector->length = writeLength;
+
+			status_t status = vfs_write_pages(swapFile->vnode,
+				swapFile->cookie, pos, vector, 1, flags, &writeLength);
+			if (status != B_OK) {
+				swap_slot_dealloc(slotIndex, n);
+				return status;
 			}
 		}
 
-		totalPages += pageCount;
+		T(WritePage(this, pageIndex, slotIndex));
+			// TODO: Assumes that only one page is written.
+
+		_SwapBlockBuild(pageIndex + j, slotIndex, n);
+		pagesLeft -= n;
+
+		base += n * B_PAGE_SIZE;
+		length -= min_c(length, n * B_PAGE_SIZE);
 	}
 
-	ASSERT(pagesLeft == 0);
 	return B_OK;
 }
 
@@ -723,6 +1114,47 @@ VMAnonymousCache::WriteAsync(off_t offset, const generic_io_vec* vecs,
 	swap_addr_t slotIndex = _SwapBlockGetAddress(pageIndex);
 	bool newSlot = slotIndex == SWAP_SLOT_NONE;
 
+	if (sCompressedSwap != NULL) {
+		// If the page can be kept in the compressed swap tier, there is
+		// nothing to write.
+		swap_addr_t compressedSlot = compressed_swap_store(vecs[0].base,
+			numBytes, flags, false);
+		if (compressedSlot != SWAP_SLOT_NONE) {
+			if (newSlot) {
+				AutoLocker<VMCache> locker(this);
+				if (fAllocatedSwapSize + B_PAGE_SIZE > fCommittedSwapSize) {
+					locker.Unlock();
+					swap_slot_dealloc(compressedSlot, 1);
+					_callback->IOFinished(B_ERROR, true, 0);
+					return B_ERROR;
+				}
+
+				fAllocatedSwapSize += B_PAGE_SIZE;
+			} else {
+				swap_slot_dealloc(slotIndex, 1);
+				_SwapBlockFree(pageIndex, 1);
+			}
+
+			T(WritePage(this, pageIndex, compressedSlot));
+
+			_SwapBlockBuild(pageIndex, compressedSlot, 1);
+			_callback->IOFinished(B_OK, false, numBytes);
+			return B_OK;
+		}
+
+		if (!newSlot && is_compressed_swap_slot(slotIndex)) {
+			// the page has to go to a swap file now
+			swap_slot_dealloc(slotIndex, 1);
+			_SwapBlockFree(pageIndex, 1);
+
+			AutoLocker<VMCache> locker(this);
+			fAllocatedSwapSize -= B_PAGE_SIZE;
+			locker.Unlock();
+
+			newSlot = true;
+		}
+	}
+
 	// If the page doesn't have any swap space yet, allocate it.
 	if (newSlot) {
 		AutoLocker<VMCache> locker(this);
@@ -731,9 +1163,32 @@ VMAnonymousCache::WriteAsync(off_t offset, const generic_io_vec* vecs,
 			return B_ERROR;
 		}
 
-		fAllocatedSwapSize += B_PAGE_SIZE;
-
 		slotIndex = swap_slot_alloc(1);
+		if (slotIndex == SWAP_SLOT_NONE) {
+			// Only possible with the compressed swap tier, which has room for
+			// the page when the swap files are full.
+			fAllocatedSwapSize += B_PAGE_SIZE;
+			locker.Unlock();
+
+			slotIndex = compressed_swap_store(vecs[0].base, numBytes, flags,
+				true);
+			if (slotIndex == SWAP_SLOT_NONE) {
+				locker.Lock();
+				fAllocatedSwapSize -= B_PAGE_SIZE;
+				locker.Unlock();
+
+				_callback->IOFinished(B_DEVICE_FULL, true, 0);
+				return B_DEVICE_FULL;
+			}
+
+			T(WritePage(this, pageIndex, slotIndex));
+
+			_SwapBlockBuild(pageIndex, slotIndex, 1);
+			_callback->IOFinished(B_OK, false, numBytes);
+			return B_OK;
+		}
+
+		fAllocatedSwapSize += B_PAGE_SIZE;
 	}
 
 	// create our callback
@@ -1440,9 +1895,122 @@ swap_init(void)
 }
 
 
+static void
+compressed_swap_init()
+{
+	bool enabled = false;
+	off_t poolSize = (off_t)vm_page_num_pages() * B_PAGE_SIZE / 4;
+
+	void* settings = load_driver_settings("virtual_memory");
+	if (settings != NULL) {
+		enabled = get_driver_boolean_parameter(settings, "compressed_swap",
+			false, false);
+
+		const char* size = get_driver_parameter(settings,
+			"compressed_swap_size", NULL, NULL);
+		if (size != NULL)
+			poolSize = atoll(size);
+
+		unload_driver_settings(settings);
+	}
+
+	if (!enabled || poolSize < B_PAGE_SIZE)
+		return;
+
+	// The tier only provides as many slots as its pool can hold pages that
+	// didn't compress at all.
+	off_t slotCount = poolSize / ((off_t)COMPRESSED_PAGE_SIZE_CLASSES
+		* COMPRESSED_PAGE_GRANULARITY);
+	if (slotCount > SWAP_SLOT_NONE - COMPRESSED_SWAP_FIRST_SLOT - 1)
+		slotCount = SWAP_SLOT_NONE - COMPRESSED_SWAP_FIRST_SLOT - 1;
+	if (slotCount == 0)
+		return;
+
+	poolSize = slotCount * COMPRESSED_PAGE_SIZE_CLASSES
+		* COMPRESSED_PAGE_GRANULARITY;
+	if (vm_try_reserve_memory(poolSize, VM_PRIORITY_SYSTEM, 0) != B_OK) {
+		dprintf("%s: Failed to reserve %" B_PRIdOFF " bytes for the compressed "
+			"swap tier\n", __func__, poolSize);
+		return;
+	}
+
+	swap_file* swap = (swap_file*)malloc(sizeof(swap_file));
+	sCompressedPages = (compressed_page**)calloc(slotCount,
+		sizeof(compressed_page*));
+	sCompressionBuffer = (uint8*)malloc(B_PAGE_SIZE);
+	sCompressedData = (uint8*)malloc(COMPRESSED_PAGE_MAX_SIZE);
+	sCompressionWorkMemory = malloc(LZ4_WORK_MEMORY_SIZE);
+	radix_bitmap* bitmap = radix_bitmap_create(slotCount);
+
+	bool failed = swap == NULL || sCompressedPages == NULL
+		|| sCompressionBuffer == NULL || sCompressedData == NULL
+		|| sCompressionWorkMemory == NULL || bitmap == NULL;
+
+	// The size classes between the largest compressed pages and uncompressed
+	// ones are never used.
+	uint32 maxCompressedSizeClass = compressed_page_size_class(
+		COMPRESSED_PAGE_MAX_SIZE - sizeof(compressed_page));
+	for (uint32 i = 0; !failed && i < COMPRESSED_PAGE_SIZE_CLASSES; i++) {
+		if (i > maxCompressedSizeClass && i < COMPRESSED_PAGE_SIZE_CLASSES - 1)
+			continue;
+
+		char name[32];
+		snprintf(name, sizeof(name), "compressed pages %" B_PRIu32,
+			(i + 1) * COMPRESSED_PAGE_GRANULARITY);
+		sCompressedPageCaches[i] = create_object_cache(name,
+			(i + 1) * COMPRESSED_PAGE_GRANULARITY, sizeof(void*), NULL, NULL,
+			NULL);
+		failed = sCompressedPageCaches[i] == NULL;
+	}
+
+	if (failed) {
+		dprintf("%s: Failed to set up the compressed swap tier\n", __func__);
+
+		for (uint32 i = 0; i < COMPRESSED_PAGE_SIZE_CLASSES; i++) {
+			if (sCompressedPageCaches[i] != NULL)
+				delete_object_cache(sCompressedPageCaches[i]);
+		}
+		if (bitmap != NULL)
+			radix_bitmap_destroy(bitmap);
+		free(sCompressionWorkMemory);
+		free(sCompressedData);
+		free(sCompressionBuffer);
+		free(sCompressedPages);
+		free(swap);
+		vm_unreserve_memory(poolSize);
+		return;
+	}
+
+	mutex_init(&sCompressionLock, "compressed swap");
+	sCompressedSwapMaxPoolSize = poolSize;
+	sCompressedSwapReservedMemory = poolSize;
+
+	swap->fd = -1;
+	swap->vnode = NULL;
+	swap->cookie = NULL;
+	swap->first_slot = COMPRESSED_SWAP_FIRST_SLOT;
+	swap->last_slot = COMPRESSED_SWAP_FIRST_SLOT + slotCount;
+	swap->bmp = bitmap;
+
+	mutex_lock(&sSwapFileListLock);
+	sCompressedSwap = swap;
+	mutex_unlock(&sSwapFileListLock);
+
+	mutex_lock(&sAvailSwapSpaceLock);
+	sAvailSwapSpace += slotCount * B_PAGE_SIZE;
+	mutex_unlock(&sAvailSwapSpaceLock);
+
+	dprintf("%s: using up to %" B_PRIdOFF " bytes for compressed swap\n",
+		__func__, poolSize);
+}
+
+
 void
 swap_init_post_modules()
 {
+	// The compressed swap tier doesn't need a writable device.
+	compressed_swap_init();
+
 	// Never try to create a swap file on a read-only device - when booting
 	// from CD, the write overlay is used.
 	if (gReadOnlyBootDevice)
@@ -1660,6 +2228,10 @@ swap_total_swap_pages()
 		totalSwapSlots += swapFile->last_slot - swapFile->first_slot;
 	}
 
+	if (sCompressedSwap != NULL)
+		totalSwapSlots += sCompressedSwap->last_slot
+			- sCompressedSwap->first_slot;
+
 	mutex_unlock(&sSwapFileListLock);
 
 	return totalSwapSlots;
@@ -1681,3 +2253,31 @@ swap_get_info(system_info* info)
 #endif
 }
 
+
+status_t
+_user_get_compressed_swap_info(compressed_swap_info* userInfo)
+{
+	if (userInfo == NULL || !IS_USER_ADDRESS(userInfo))
+		return B_BAD_ADDRESS;
+
+	compressed_swap_info info;
+	memset(&info, 0, sizeof(info));
+
+#if ENABLE_SWAP_SUPPORT
+	if (sCompressedSwap != NULL) {
+		info.max_pool_size = sCompressedSwapMaxPoolSize;
+		info.pool_size = sCompressedSwapPoolSize;
+		info.stored_pages = sCompressedSwapStoredPages;
+		info.compressed_size = sCompressedSwapCompressedSize;
+		info.stores = sCompressedSwapStores;
+		info.loads = sCompressedSwapLoads;
+		info.rejected_pages = sCompressedSwapRejected;
+		info.pool_full = sCompressedSwapPoolFull;
+	}
+#endif
+
+	if (user_memcpy(userInfo, &info, sizeof(info)) != B_OK)
+		return B_BAD_ADDRESS;
+
+	return B_OK;
+}
@@ -78,6 +78,10 @@ private:
 			void        		_SwapBlockFree(off_t pageIndex, uint32 count);
 			swap_addr_t			_SwapBlockGetAddress(off_t pageIndex);
 			status_t			_Commit(off_t size, int priority);
+			status_t			_WriteSwapFilePages(off_t pageIndex,
+									generic_addr_t base, generic_size_t length,
+									page_num_t pageCount, uint32 flags,
+									page_num_t& pagesLeft);
 
 			void				_MergePagesSmallerSource(
 									VMAnonymousCache* source);
@@ -2527,6 +2527,69 @@ vm_copy_area(team_id team, const char* name, void** _address,
 }
 
 
+/*!	Creates an area in \a team's address space that maps the cache of the
+	area \a sourceID, so that both areas see the same memory. Unlike
+	vm_clone_area() this doesn't turn the source area into a shared one, so
+	its team will still get a copy-on-write copy of it when it forks.
+	This is used by vfork(): the child borrows its parent's memory until it
+	calls exec() or exits.
+	Returns \c B_NOT_SUPPORTED for areas whose memory can't be shared this
+	way; the caller should copy those.
+*/
+area_id
+vm_share_area(team_id team, const char* name, void** _address,
+	uint32 addressSpec, uint32 protection, area_id sourceID)
+{
+	if ((protection & B_KERNEL_PROTECTION) == 0) {
+		// set the same protection for the kernel as for userland
+		protection |= B_KERNEL_READ_AREA;
+		if ((protection & B_WRITE_AREA) != 0)
+			protection |= B_KERNEL_WRITE_AREA;
+	}
+
+	// Lock the target address space, all address spaces associated with the
+	// source cache, and the cache itself.
+	MultiAddressSpaceLocker locker;
+	VMAddressSpace* targetAddressSpace;
+	VMCache* cache;
+	VMArea* source;
+	status_t status = locker.AddTeam(team, true, &targetAddressSpace);
+	if (status == B_OK) {
+		status = locker.AddAreaCacheAndLock(sourceID, false, false, source,
+			&cache);
+	}
+	if (status != B_OK)
+		return status;
+
+	AreaCacheLocker cacheLocker(cache);	// already locked
+
+	if (cache->type != CACHE_TYPE_RAM && cache->type != CACHE_TYPE_VNODE)
+		return B_NOT_SUPPORTED;
+
+	if (addressSpec == B_CLONE_ADDRESS) {
+		addressSpec = B_EXACT_ADDRESS;
+		*_address = (void*)source->Base();
+	}
+
+	VMArea* target;
+	virtual_address_restrictions addressRestrictions = {};
+	addressRestrictions.address = *_address;
+	addressRestrictions.address_specification = addressSpec;
+	status = map_backing_store(targetAddressSpace, cache, source->cache_offset,
+		name, source->Size(), source->wiring, protection, REGION_NO_PRIVATE_MAP,
+		CREATE_AREA_DONT_COMMIT_MEMORY, &addressRestrictions, true, &target,
+		_address);
+	if (status != B_OK)
+		return status;
+
+	// map_backing_store() hasn't acquired a reference to the cache for the
+	// new area, since it didn't create a cache of its own
+	cache->AcquireRefLocked();
+
+	return target->id;
+}
+
+
 status_t
 vm_set_area_protection(team_id team, area_id areaID, uint32 newProtection,
 	bool kernel)
@@ -27,6 +27,7 @@
 #include <heap.h>
 #include <kernel.h>
 #include <low_resource_manager.h>
+#include <smp.h>
 #include <thread.h>
 #include <tracing.h>
 #include <util/AutoLock.h>
@@ -103,14 +104,26 @@ static const int32 kPageUsageDecline = 1;
 int32 gMappedPagesCount;
 
 static VMPageQueue sPageQueues[PAGE_STATE_COUNT];
+	// the free and clear queues are kept per memory node (sMemoryNodes), the
+	// respective entries are unused
 
-static VMPageQueue& sFreePageQueue = sPageQueues[PAGE_STATE_FREE];
-static VMPageQueue& sClearPageQueue = sPageQueues[PAGE_STATE_CLEAR];
 static VMPageQueue& sModifiedPageQueue = sPageQueues[PAGE_STATE_MODIFIED];
 static VMPageQueue& sInactivePageQueue = sPageQueues[PAGE_STATE_INACTIVE];
 static VMPageQueue& sActivePageQueue = sPageQueues[PAGE_STATE_ACTIVE];
 static VMPageQueue& sCachedPageQueue = sPageQueues[PAGE_STATE_CACHED];
 
+// Free and clear pages are queued per memory (NUMA) node, so that allocations
+// can be satisfied with memory local to the allocating CPU. Without topology
+// information from the boot loader there is a single node only.
+struct memory_node {
+	VMPageQueue	free_queue;
+	VMPageQueue	clear_queue;
+};
+
+static memory_node sMemoryNodes[MAX_MEMORY_NODES];
+static uint32 sMemoryNodeCount = 1;
+static uint8 sCPUMemoryNode[SMP_MAX_CPUS];
+
 static vm_page *sPages;
 static page_num_t sPhysicalPageOffset;
 static page_num_t sNumPages;
@@ -133,6 +146,54 @@ static mutex sPageDeficitLock = MUTEX_INITIALIZER("page deficit");
 static rw_lock sFreePageQueuesLock
 	= RW_LOCK_INITIALIZER("free/clear page queues");
 
+
+static inline VMPageQueue&
+free_page_queue(vm_page* page)
+{
+	return sMemoryNodes[page->memory_node].free_queue;
+}
+
+
+static inline VMPageQueue&
+clear_page_queue(vm_page* page)
+{
+	return sMemoryNodes[page->memory_node].clear_queue;
+}
+
+
+static page_num_t
+free_page_count()
+{
+	page_num_t count = 0;
+	for (uint32 i = 0; i < sMemoryNodeCount; i++)
+		count += sMemoryNodes[i].free_queue.Count();
+	return count;
+}
+
+
+static page_num_t
+clear_page_count()
+{
+	page_num_t count = 0;
+	for (uint32 i = 0; i < sMemoryNodeCount; i++)
+		count += sMemoryNodes[i].clear_queue.Count();
+	return count;
+}
+
+
+/*!	Returns the memory node that is local to the current CPU. Since pages of
+	anonymous memory are allocated when they are first touched, this yields a
+	first-touch placement policy for them.
+*/
+static inline uint32
+local_memory_node()
+{
+	if (sMemoryNodeCount == 1)
+		return 0;
+
+	return sCPUMemoryNode[smp_get_current_cpu()];
+}
+
 #ifdef TRACK_PAGE_USAGE_STATS
 static page_num_t sPageUsageArrays[512];
 static page_num_t* sPageUsage = sPageUsageArrays;
@@ -771,16 +832,22 @@ find_page(int argc, char **argv)
 	struct {
 		const char*	name;
 		VMPageQueue*	queue;
-	} pageQueueInfos[] = {
-		{ "free",		&sFreePageQueue },
-		{ "clear",		&sClearPageQueue },
+	} pageQueueInfos[4 + 2 * MAX_MEMORY_NODES + 1] = {
 		{ "modified",	&sModifiedPageQueue },
 		{ "active",		&sActivePageQueue },
 		{ "inactive",	&sInactivePageQueue },
 		{ "cached",		&sCachedPageQueue },
-		{ NULL, NULL }
 	};
 
+	int32 queueCount = 4;
+	for (uint32 node = 0; node < sMemoryNodeCount; node++) {
+		pageQueueInfos[queueCount].name = "free";
+		pageQueueInfos[queueCount++].queue = &sMemoryNodes[node].free_queue;
+		pageQueueInfos[queueCount].name = "clear";
+		pageQueueInfos[queueCount++].queue = &sMemoryNodes[node].clear_queue;
+	}
+	pageQueueInfos[queueCount].name = NULL;
+
 	if (argc < 2
 		|| strlen(argv[index]) <= 2
 		|| argv[index][0] != '0'
@@ -913,6 +980,7 @@ dump_page(int argc, char **argv)
 	kprintf("busy_writing:    %d\n", page->busy_writing);
 	kprintf("accessed:        %d\n", page->accessed);
 	kprintf("modified:        %d\n", page->modified);
+	kprintf("memory_node:     %d\n", page->memory_node);
 	#if DEBUG_PAGE_QUEUE
 		kprintf("queue:           %p\n", page->queue);
 	#endif
@@ -965,6 +1033,27 @@ dump_page(int argc, char **argv)
 }
 
 
+static void
+dump_page_queue_contents(VMPageQueue* queue, bool list)
+{
+	kprintf("queue = %p, queue->head = %p, queue->tail = %p, queue->count = %"
+		B_PRIuPHYSADDR "\n", queue, queue->Head(), queue->Tail(),
+		queue->Count());
+
+	if (list) {
+		struct vm_page *page = queue->Head();
+
+		kprintf("page        cache       type       state  wired  usage\n");
+		for (page_num_t i = 0; page; i++, page = queue->Next(page)) {
+			kprintf("%p  %p  %-7s %8s  %5d  %5d\n", page, page->Cache(),
+				vm_cache_type_to_string(page->Cache()->type),
+				page_state_to_string(page->State()),
+				page->WiredCount(), page->usage_count);
+		}
+	}
+}
+
+
 static int
 dump_page_queue(int argc, char **argv)
 {
@@ -975,12 +1064,19 @@ dump_page_queue(int argc, char **argv)
 		return 0;
 	}
 
+	bool freeQueue = !strcmp(argv[1], "free");
+	if (freeQueue || !strcmp(argv[1], "clear")) {
+		// there is one free and one clear queue per memory node
+		for (uint32 node = 0; node < sMemoryNodeCount; node++) {
+			kprintf("memory node %" B_PRIu32 ": ", node);
+			dump_page_queue_contents(freeQueue ? &sMemoryNodes[node].free_queue
+				: &sMemoryNodes[node].clear_queue, argc == 3);
+		}
+		return 0;
+	}
+
 	if (strlen(argv[1]) >= 2 && argv[1][0] == '0' && argv[1][1] == 'x')
 		queue = (VMPageQueue*)strtoul(argv[1], NULL, 16);
-	else if (!strcmp(argv[1], "free"))
-		queue = &sFreePageQueue;
-	else if (!strcmp(argv[1], "clear"))
-		queue = &sClearPageQueue;
 	else if (!strcmp(argv[1], "modified"))
 		queue = &sModifiedPageQueue;
 	else if (!strcmp(argv[1], "active"))
@@ -994,21 +1090,7 @@ dump_page_queue(int argc, char **argv)
 		return 0;
 	}
 
-	kprintf("queue = %p, queue->head = %p, queue->tail = %p, queue->count = %"
-		B_PRIuPHYSADDR "\n", queue, queue->Head(), queue->Tail(),
-		queue->Count());
-
-	if (argc == 3) {
-		struct vm_page *page = queue->Head();
-
-		kprintf("page        cache       type       state  wired  usage\n");
-		for (page_num_t i = 0; page; i++, page = queue->Next(page)) {
-			kprintf("%p  %p  %-7s %8s  %5d  %5d\n", page, page->Cache(),
-				vm_cache_type_to_string(page->Cache()->type),
-				page_state_to_string(page->State()),
-				page->WiredCount(), page->usage_count);
-		}
-	}
+	dump_page_queue_contents(queue, argc == 3);
 	return 0;
 }
 
@@ -1113,10 +1195,15 @@ dump_page_stats(int argc, char **argv)
 			waiter->missing, waiter->dontTouch);
 	}
 
-	kprintf("\nfree queue: %p, count = %" B_PRIuPHYSADDR "\n", &sFreePageQueue,
-		sFreePageQueue.Count());
-	kprintf("clear queue: %p, count = %" B_PRIuPHYSADDR "\n", &sClearPageQueue,
-		sClearPageQueue.Count());
+	kprintf("\n");
+	for (uint32 i = 0; i < sMemoryNodeCount; i++) {
+		kprintf("free queue (node %" B_PRIu32 "): %p, count = %" B_PRIuPHYSADDR
+			"\n", i, &sMemoryNodes[i].free_queue,
+			sMemoryNodes[i].free_queue.Count());
+		kprintf("clear queue (node %" B_PRIu32 "): %p, count = %"
+			B_PRIuPHYSADDR "\n", i, &sMemoryNodes[i].clear_queue,
+			sMemoryNodes[i].clear_queue.Count());
+	}
 	kprintf("modified queue: %p, count = %" B_PRIuPHYSADDR " (%" B_PRId32
 		" temporary, %" B_PRIuPHYSADDR " swappable, " "inactive: %"
 		B_PRIuPHYSADDR ")\n", &sModifiedPageQueue, sModifiedPageQueue.Count(),
@@ -1517,10 +1604,10 @@ free_page(vm_page* page, bool clear)
 
 	if (clear) {
 		page->SetState(PAGE_STATE_CLEAR);
-		sClearPageQueue.PrependUnlocked(page);
+		clear_page_queue(page).PrependUnlocked(page);
 	} else {
 		page->SetState(PAGE_STATE_FREE);
-		sFreePageQueue.PrependUnlocked(page);
+		free_page_queue(page).PrependUnlocked(page);
 	}
 
 	locker.Unlock();
@@ -1698,7 +1785,7 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 // in the early boot process only, though.
 				DEBUG_PAGE_ACCESS_START(page);
 				VMPageQueue& queue = page->State() == PAGE_STATE_FREE
-					? sFreePageQueue : sClearPageQueue;
+					? free_page_queue(page) : clear_page_queue(page);
 				queue.Remove(page);
 				page->SetState(wired ? PAGE_STATE_WIRED : PAGE_STATE_UNUSED);
 				page->busy = false;
@@ -1741,7 +1828,7 @@ page_scrubber(void *unused)
 	for (;;) {
 		snooze(100000); // 100ms
 
-		if (sFreePageQueue.Count() == 0
+		if (free_page_count() == 0
 				|| atomic_get(&sUnreservedFreePages)
 					< (int32)sFreePagesTarget) {
 			continue;
@@ -1762,8 +1849,14 @@ page_scrubber(void *unused)
 
 		vm_page *page[SCRUB_SIZE];
 		int32 scrubCount = 0;
+		uint32 node = 0;
 		for (int32 i = 0; i < reserved; i++) {
-			page[i] = sFreePageQueue.RemoveHeadUnlocked();
+			page[i] = NULL;
+			for (; node < sMemoryNodeCount; node++) {
+				page[i] = sMemoryNodes[node].free_queue.RemoveHeadUnlocked();
+				if (page[i] != NULL)
+					break;
+			}
 			if (page[i] == NULL)
 				break;
 
@@ -1794,7 +1887,7 @@ page_scrubber(void *unused)
 			page[i]->SetState(PAGE_STATE_CLEAR);
 			page[i]->busy = false;
 			DEBUG_PAGE_ACCESS_END(page[i]);
-			sClearPageQueue.PrependUnlocked(page[i]);
+			clear_page_queue(page[i]).PrependUnlocked(page[i]);
 		}
 
 		locker.Unlock();
@@ -2573,7 +2666,7 @@ free_cached_pages(uint32 pagesToFree, bool dontWait)
 			ReadLocker locker(sFreePageQueuesLock);
 			page->SetState(PAGE_STATE_FREE);
 			DEBUG_PAGE_ACCESS_END(page);
-			sFreePageQueue.PrependUnlocked(page);
+			free_page_queue(page).PrependUnlocked(page);
 			locker.Unlock();
 
 			TA(StolenPage());
@@ -3261,8 +3354,18 @@ vm_page_init(kernel_args *args)
 	sInactivePageQueue.Init("inactive pages queue");
 	sActivePageQueue.Init("active pages queue");
 	sCachedPageQueue.Init("cached pages queue");
-	sFreePageQueue.Init("free pages queue");
-	sClearPageQueue.Init("clear pages queue");
+
+	// init the memory nodes
+	sMemoryNodeCount = std::min(std::max(args->num_memory_nodes, (uint32)1),
+		(uint32)MAX_MEMORY_NODES);
+	for (uint32 i = 0; i < sMemoryNodeCount; i++) {
+		sMemoryNodes[i].free_queue.Init("free pages queue");
+		sMemoryNodes[i].clear_queue.Init("clear pages queue");
+	}
+	for (uint32 i = 0; i < SMP_MAX_CPUS; i++) {
+		sCPUMemoryNode[i] = args->cpu_memory_node[i] < sMemoryNodeCount
+			? args->cpu_memory_node[i] : 0;
+	}
 
 	new (&sPageReservationWaiters) PageReservationWaiterList;
 
@@ -3277,13 +3380,31 @@ vm_page_init(kernel_args *args)
 	// initialize the free page table
 	for (uint32 i = 0; i < sNumPages; i++) {
 		sPages[i].Init(sPhysicalPageOffset + i);
-		sFreePageQueue.Append(&sPages[i]);
 
 #if VM_PAGE_ALLOCATION_TRACKING_AVAILABLE
 		sPages[i].allocation_tracking_info.Clear();
 #endif
 	}
 
+	// assign the pages to their memory nodes
+	for (uint32 i = 0; sMemoryNodeCount > 1
+			&& i < args->num_memory_node_ranges; i++) {
+		const memory_node_addr_range& range = args->memory_node_range[i];
+		if (range.node >= sMemoryNodeCount)
+			continue;
+
+		page_num_t start = std::max((page_num_t)(range.start / B_PAGE_SIZE),
+			sPhysicalPageOffset);
+		page_num_t end = std::min(
+			(page_num_t)((range.start + range.size) / B_PAGE_SIZE),
+			sPhysicalPageOffset + sNumPages);
+		for (page_num_t page = start; page < end; page++)
+			sPages[page - sPhysicalPageOffset].memory_node = range.node;
+	}
+
+	for (uint32 i = 0; i < sNumPages; i++)
+		free_page_queue(&sPages[i]).Append(&sPages[i]);
+
 	sUnreservedFreePages = sNumPages;
 
 	TRACE(("initialized table\n"));
@@ -3401,7 +3522,7 @@ status_t
 vm_page_init_post_thread(kernel_args *args)
 {
 	new (&sFreePageCondition) ConditionVariable;
-	sFreePageCondition.Publish(&sFreePageQueue, "free page");
+	sFreePageCondition.Publish(&sMemoryNodes, "free page");
 
 	// create a kernel thread to clear out pages
 
@@ -3503,6 +3624,31 @@ vm_page_try_reserve_pages(vm_page_reservation* reservation, uint32 count,
 }
 
 
+/*!	Removes a page from the free or clear page queues. The queues of the
+	given memory node are tried first -- the one matching \a clear preferred
+	-- then the queues of the other nodes.
+	The caller must hold \c sFreePageQueuesLock.
+*/
+static vm_page*
+remove_free_or_clear_page(uint32 preferredNode, bool clear)
+{
+	for (uint32 i = 0; i < sMemoryNodeCount; i++) {
+		memory_node& node
+			= sMemoryNodes[(preferredNode + i) % sMemoryNodeCount];
+		VMPageQueue& queue = clear ? node.clear_queue : node.free_queue;
+		VMPageQueue& otherQueue = clear ? node.free_queue : node.clear_queue;
+
+		vm_page* page = queue.RemoveHeadUnlocked();
+		if (page == NULL)
+			page = otherQueue.RemoveHeadUnlocked();
+		if (page != NULL)
+			return page;
+	}
+
+	return NULL;
+}
+
+
 vm_page *
 vm_page_allocate_page(vm_page_reservation* reservation, uint32 flags)
 {
@@ -3513,44 +3659,27 @@ vm_page_allocate_page(vm_page_reservation* reservation, uint32 flags)
 	ASSERT(reservation->count > 0);
 	reservation->count--;
 
-	VMPageQueue* queue;
-	VMPageQueue* otherQueue;
-
-	if ((flags & VM_PAGE_ALLOC_CLEAR) != 0) {
-		queue = &sClearPageQueue;
-		otherQueue = &sFreePageQueue;
-	} else {
-		queue = &sFreePageQueue;
-		otherQueue = &sClearPageQueue;
-	}
+	uint32 node = local_memory_node();
+	bool clear = (flags & VM_PAGE_ALLOC_CLEAR) != 0;
 
 	ReadLocker locker(sFreePageQueuesLock);
 
-	vm_page* page = queue->RemoveHeadUnlocked();
+	vm_page* page = remove_free_or_clear_page(node, clear);
 	if (page == NULL) {
-		// if the primary queue was empty, grab the page from the
-		// secondary queue
-		page = otherQueue->RemoveHeadUnlocked();
+		// Unlikely, but possible: the page we have reserved has moved
+		// between the queues while we checked them. Grab the write locker
+		// to make sure this doesn't happen again.
+		locker.Unlock();
+		WriteLocker writeLocker(sFreePageQueuesLock);
 
+		page = remove_free_or_clear_page(node, clear);
 		if (page == NULL) {
-			// Unlikely, but possible: the page we have reserved has moved
-			// between the queues after we checked the first queue. Grab the
-			// write locker to make sure this doesn't happen again.
-			locker.Unlock();
-			WriteLocker writeLocker(sFreePageQueuesLock);
-
-			page = queue->RemoveHead();
-			if (page == NULL)
-				otherQueue->RemoveHead();
-
-			if (page == NULL) {
-				panic("Had reserved page, but there is none!");
-				return NULL;
-			}
-
-			// downgrade to read lock
-			locker.Lock();
+			panic("Had reserved page, but there is none!");
+			return NULL;
 		}
+
+		// downgrade to read lock
+		locker.Lock();
 	}
 
 	if (page->CacheRef() != NULL)
@@ -3594,14 +3723,14 @@ allocate_page_run_cleanup(VMPageQueue::PageList& freePages,
 		page->busy = false;
 		page->SetState(PAGE_STATE_FREE);
 		DEBUG_PAGE_ACCESS_END(page);
-		sFreePageQueue.PrependUnlocked(page);
+		free_page_queue(page).PrependUnlocked(page);
 	}
 
 	while (vm_page* page = clearPages.RemoveHead()) {
 		page->busy = false;
 		page->SetState(PAGE_STATE_CLEAR);
 		DEBUG_PAGE_ACCESS_END(page);
-		sClearPageQueue.PrependUnlocked(page);
+		clear_page_queue(page).PrependUnlocked(page);
 	}
 }
 
@@ -3648,12 +3777,12 @@ allocate_page_run(page_num_t start, page_num_t length, uint32 flags,
 		switch (page.State()) {
 			case PAGE_STATE_CLEAR:
 				DEBUG_PAGE_ACCESS_START(&page);
-				sClearPageQueue.Remove(&page);
+				clear_page_queue(&page).Remove(&page);
 				clearPages.Add(&page);
 				break;
 			case PAGE_STATE_FREE:
 				DEBUG_PAGE_ACCESS_START(&page);
-				sFreePageQueue.Remove(&page);
+				free_page_queue(&page).Remove(&page);
 				freePages.Add(&page);
 				break;
 			case PAGE_STATE_CACHED:
@@ -4094,8 +4223,8 @@ vm_page_get_stats(system_info *info)
 	//	active + inactive + unused + wired + modified + cached + free + clear
 	// So taking out the cached (including modified non-temporary), free and
 	// clear ones leaves us with all used pages.
-	uint32 subtractPages = info->cached_pages + sFreePageQueue.Count()
-		+ sClearPageQueue.Count();
+	uint32 subtractPages = info->cached_pages + free_page_count()
+		+ clear_page_count();
 	info->used_pages = subtractPages > info->max_pages
 		? 0 : info->max_pages - subtractPages;
 
@@ -20,6 +20,7 @@
 #include <runtime_loader.h>
 #include <syscalls.h>
 #include <user_runtime.h>
+#include <user_thread.h>
 
 
 struct EnvironmentFilter {
@@ -199,6 +200,25 @@ private:
 };
 
 
+/*!	Allocates memory for the arguments of a new process. In the child of
+	vfork() the heap belongs to the parent, which would never get memory
+	back that is allocated there if exec() succeeds, so the memory comes from
+	an area of the child's own instead.
+*/
+static void*
+allocate_process_args(size_t size)
+{
+	if ((get_user_thread()->flags & USER_THREAD_VFORK_CHILD) == 0)
+		return malloc(size);
+
+	void* address;
+	area_id area = create_area("process args", &address, B_ANY_ADDRESS,
+		(size + B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1), B_NO_LOCK,
+		B_READ_AREA | B_WRITE_AREA);
+	return area >= 0 ? address : NULL;
+}
+
+
 thread_id
 load_image(int32 argCount, const char **args, const char **environ)
 {
@@ -237,11 +257,11 @@ load_image(int32 argCount, const char **args, const char **environ)
 		thread = _kern_load_image(flatArgs, flatArgsSize, argCount, envCount,
 			B_NORMAL_PRIORITY, B_WAIT_TILL_LOADED, -1, 0);
 
-		free(flatArgs);
+		__free_process_args(flatArgs);
 	} else
 		thread = status;
 
-	free(newArgs);
+	__free_process_args(newArgs);
 	return thread;
 }
 
@@ -368,7 +388,8 @@ __parse_invoke_line(char *invoker, char ***_newArgs,
 	}
 
 	// this is a shell script and requires special treatment
-	newArgs = (char**)malloc((*_argCount + count + 1) * sizeof(void *));
+	newArgs = (char**)allocate_process_args(
+		(*_argCount + count + 1) * sizeof(void *));
 	if (newArgs == NULL)
 		return B_NO_MEMORY;
 
@@ -453,7 +474,7 @@ __flatten_process_args(const char* const* args, int32 argCount,
 		return B_TOO_MANY_ARGS;
 
 	// allocate space
-	char** flatArgs = (char**)malloc(size);
+	char** flatArgs = (char**)allocate_process_args(size);
 	if (flatArgs == NULL)
 		return B_NO_MEMORY;
 
@@ -487,6 +508,22 @@ __flatten_process_args(const char* const* args, int32 argCount,
 }
 
 
+/*!	Frees arguments allocated by __flatten_process_args() or
+	__parse_invoke_line().
+*/
+void
+__free_process_args(void* args)
+{
+	if ((get_user_thread()->flags & USER_THREAD_VFORK_CHILD) == 0) {
+		free(args);
+		return;
+	}
+
+	if (args != NULL)
+		delete_area(area_for(args));
+}
+
+
 extern "C" void _call_init_routines_(void);
 void
 _call_init_routines_(void)
@@ -85,7 +85,13 @@ cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, bigtime_t timeout)
 		status = 0;
 	}
 
-	pthread_mutex_lock(mutex);
+	if (status == B_USER_MUTEX_REQUEUED) {
+		// a broadcast has moved us over to the mutex, and we own it already
+		mutex->owner = find_thread(NULL);
+		mutex->owner_count = 1;
+		status = 0;
+	} else
+		pthread_mutex_lock(mutex);
 
 	cond->waiter_count--;
 	// If there are no more waiters, we can change mutexes.
@@ -102,6 +108,14 @@ cond_signal(pthread_cond_t* cond, bool broadcast)
 	if (cond->waiter_count == 0)
 		return;
 
+	pthread_mutex_t* mutex = cond->mutex;
+	if (broadcast && mutex != NULL && (cond->flags & COND_FLAG_SHARED) == 0) {
+		// Only wake up one waiter, and move the others over to the mutex;
+		// they could only run one after the other anyway.
+		_kern_mutex_requeue((int32*)&cond->lock, (int32*)&mutex->lock);
+		return;
+	}
+
 	// release the condition lock
 	_kern_mutex_unlock((int32*)&cond->lock,
 		broadcast ? B_USER_MUTEX_UNBLOCK_ALL : 0);
@@ -0,0 +1,627 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <spawn.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <errno_private.h>
+#include <libroot_private.h>
+#include <signal_defs.h>
+#include <syscalls.h>
+#include <umask.h>
+
+
+enum file_action_type {
+	FILE_ACTION_OPEN,
+	FILE_ACTION_CLOSE,
+	FILE_ACTION_DUP2
+};
+
+struct file_action {
+	file_action_type	type;
+	int					fd;
+	union {
+		struct {
+			char*		path;
+			int			openMode;
+			mode_t		mode;
+		} open;
+		struct {
+			int			newFD;
+		} dup2;
+	};
+};
+
+struct _posix_spawn_file_actions {
+	int					count;
+	file_action*		actions;
+};
+
+struct _posix_spawnattr {
+	short				flags;
+	pid_t				process_group;
+	sigset_t			signal_default;
+	sigset_t			signal_mask;
+};
+
+
+static const short kValidFlags = POSIX_SPAWN_RESETIDS | POSIX_SPAWN_SETPGROUP
+	| POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSID;
+
+
+static int
+add_file_action(posix_spawn_file_actions_t* fileActions,
+	file_action_type type, int fd, file_action*& _action)
+{
+	if (fileActions == NULL || *fileActions == NULL)
+		return EINVAL;
+	if (fd < 0)
+		return EBADF;
+
+	_posix_spawn_file_actions* actions = *fileActions;
+	file_action* newActions = (file_action*)realloc(actions->actions,
+		(actions->count + 1) * sizeof(file_action));
+	if (newActions == NULL)
+		return ENOMEM;
+
+	actions->actions = newActions;
+
+	_action = &newActions[actions->count++];
+	_action->type = type;
+	_action->fd = fd;
+	return 0;
+}
+
+
+/*!	Looks up \a file in the PATH the same way execvp() does. */
+static status_t
+find_in_path(const char* file, char* path)
+{
+	const char* paths = getenv("PATH");
+	if (paths == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	int fileNameLength = strlen(file);
+
+	const char* pathEnd = paths - 1;
+	while (pathEnd != NULL) {
+		paths = pathEnd + 1;
+		pathEnd = strchr(paths, ':');
+		int pathLength = pathEnd != NULL ? pathEnd - paths : strlen(paths);
+
+		// skip empty paths and those that would become too long
+		if (pathLength == 0
+			|| pathLength + 1 + fileNameLength >= B_PATH_NAME_LENGTH) {
+			continue;
+		}
+
+		memcpy(path, paths, pathLength);
+		path[pathLength] = '\0';
+
+		if (path[pathLength - 1] != '/')
+			strcat(path, "/");
+		strcat(path, file);
+
+		struct stat st;
+		if (stat(path, &st) == 0 && S_ISREG(st.st_mode)
+			&& access(path, X_OK) == 0) {
+			return B_OK;
+		}
+	}
+
+	return B_ENTRY_NOT_FOUND;
+}
+
+
+//	#pragma mark - child side
+
+
+/*	The functions in this section are run in the child of vfork(), which
+	shares our memory: they must not touch any global state, and only use
+	syscalls.
+*/
+
+
+static status_t
+reset_signal_handlers()
+{
+	// Signal handlers would be reset by exec() anyway, but until then they
+	// must not run in the child, since they would operate on our memory.
+	for (int signal = 1; signal <= MAX_SIGNAL_NUMBER; signal++) {
+		struct sigaction action;
+		if (_kern_sigaction(signal, NULL, &action) != B_OK
+			|| action.sa_handler == SIG_DFL || action.sa_handler == SIG_IGN) {
+			continue;
+		}
+
+		action.sa_handler = SIG_DFL;
+		action.sa_flags = 0;
+		_kern_sigaction(signal, &action, NULL);
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+apply_attributes(const _posix_spawnattr* attributes)
+{
+	short flags = attributes->flags;
+
+	if ((flags & POSIX_SPAWN_SETSID) != 0) {
+		pid_t session = _kern_setsid();
+		if (session < 0)
+			return session;
+	}
+
+	if ((flags & POSIX_SPAWN_SETPGROUP) != 0) {
+		pid_t group = _kern_setpgid(0, attributes->process_group);
+		if (group < 0)
+			return group;
+	}
+
+	if ((flags & POSIX_SPAWN_RESETIDS) != 0) {
+		status_t status = _kern_setregid((gid_t)-1, _kern_getgid(false),
+			false);
+		if (status == B_OK) {
+			status = _kern_setreuid((uid_t)-1, _kern_getuid(false), false);
+		}
+		if (status != B_OK)
+			return status;
+	}
+
+	if ((flags & POSIX_SPAWN_SETSIGDEF) != 0) {
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_handler = SIG_DFL;
+
+		for (int signal = 1; signal <= MAX_SIGNAL_NUMBER; signal++) {
+			if (signal == SIGKILL || signal == SIGSTOP
+				|| sigismember(&attributes->signal_default, signal) != 1) {
+				continue;
+			}
+
+			status_t status = _kern_sigaction(signal, &action, NULL);
+			if (status != B_OK)
+				return status;
+		}
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+apply_file_actions(const _posix_spawn_file_actions* actions)
+{
+	for (int i = 0; i < actions->count; i++) {
+		const file_action& action = actions->actions[i];
+
+		switch (action.type) {
+			case FILE_ACTION_OPEN:
+			{
+				int fd = _kern_open(-1, action.open.path, action.open.openMode,
+					action.open.mode & ~__gUmask);
+				if (fd < 0)
+					return fd;
+
+				if (fd != action.fd) {
+					int newFD = _kern_dup2(fd, action.fd);
+					_kern_close(fd);
+					if (newFD < 0)
+						return newFD;
+				}
+				break;
+			}
+
+			case FILE_ACTION_CLOSE:
+				// closing a descriptor that isn't open is not an error
+				_kern_close(action.fd);
+				break;
+
+			case FILE_ACTION_DUP2:
+			{
+				status_t status;
+				if (action.fd == action.dup2.newFD) {
+					// the descriptor has to survive exec()
+					status = _kern_fcntl(action.fd, F_SETFD, 0);
+				} else
+					status = _kern_dup2(action.fd, action.dup2.newFD);
+				if (status < 0)
+					return status;
+				break;
+			}
+		}
+	}
+
+	return B_OK;
+}
+
+
+//	#pragma mark -
+
+
+static int
+do_posix_spawn(pid_t* _pid, const char* path,
+	const posix_spawn_file_actions_t* fileActions,
+	const posix_spawnattr_t* attributes, char* const argv[],
+	char* const environment[], bool useDefaultInterpreter)
+{
+	if (path == NULL || argv == NULL)
+		return EINVAL;
+	if (environment == NULL)
+		environment = environ;
+
+	int32 argCount = 0;
+	int32 envCount = 0;
+	while (argv[argCount] != NULL)
+		argCount++;
+	while (environment[envCount] != NULL)
+		envCount++;
+
+	if (argCount == 0)
+		return EINVAL;
+
+	// Do all the work that needs memory allocations here, since the child
+	// shares our memory (see vfork()): test the executable, add support for
+	// scripts, and flatten the arguments.
+	char invoker[B_FILE_NAME_LENGTH];
+	status_t status = __test_executable(path, invoker);
+	if (status == B_NOT_AN_EXECUTABLE && useDefaultInterpreter) {
+		strcpy(invoker, "/bin/sh");
+		status = B_OK;
+	}
+	if (status != B_OK)
+		return status;
+
+	char** newArgs = NULL;
+	if (invoker[0] != '\0') {
+		status = __parse_invoke_line(invoker, &newArgs, &argv, &argCount,
+			path);
+		if (status != B_OK)
+			return status;
+
+		path = newArgs[0];
+	}
+
+	char** flatArgs = NULL;
+	size_t flatArgsSize;
+	status = __flatten_process_args(newArgs != NULL ? newArgs : argv,
+		argCount, environment, &envCount, path, &flatArgs, &flatArgsSize);
+	if (status != B_OK) {
+		__free_process_args(newArgs);
+		return status;
+	}
+
+	// the child reports failures before exec() through this
+	status_t* childStatus = (status_t*)malloc(sizeof(status_t));
+	if (childStatus == NULL) {
+		__free_process_args(flatArgs);
+		__free_process_args(newArgs);
+		return ENOMEM;
+	}
+	*childStatus = B_OK;
+
+	// Block all signals, so that no signal handler runs in the child before it
+	// had a chance to reset them.
+	sigset_t allSignals;
+	sigset_t oldMask;
+	sigfillset(&allSignals);
+	_kern_set_signal_mask(SIG_SETMASK, &allSignals, &oldMask);
+
+	pid_t child = vfork();
+	if (child == 0) {
+		status = reset_signal_handlers();
+		if (status == B_OK && attributes != NULL && *attributes != NULL)
+			status = apply_attributes(*attributes);
+		if (status == B_OK && fileActions != NULL && *fileActions != NULL)
+			status = apply_file_actions(*fileActions);
+
+		if (status == B_OK) {
+			const sigset_t* mask = &oldMask;
+			if (attributes != NULL && *attributes != NULL
+				&& ((*attributes)->flags & POSIX_SPAWN_SETSIGMASK) != 0) {
+				mask = &(*attributes)->signal_mask;
+			}
+			_kern_set_signal_mask(SIG_SETMASK, mask, NULL);
+
+			status = _kern_exec(path, flatArgs, flatArgsSize, argCount,
+				envCount, __gUmask);
+		}
+
+		*childStatus = status;
+		_kern_exit_team(127);
+	}
+
+	int error = 0;
+	if (child < 0)
+		error = errno;
+	else if (*childStatus != B_OK) {
+		// the child is gone already, we just need to collect it
+		while (waitpid(child, NULL, 0) < 0 && errno == EINTR)
+			;
+		error = *childStatus;
+	} else if (_pid != NULL)
+		*_pid = child;
+
+	_kern_set_signal_mask(SIG_SETMASK, &oldMask, NULL);
+
+	free(childStatus);
+	__free_process_args(flatArgs);
+	__free_process_args(newArgs);
+	return error;
+}
+
+
+//	#pragma mark - spawning
+
+
+int
+posix_spawn(pid_t* _pid, const char* path,
+	const posix_spawn_file_actions_t* fileActions,
+	const posix_spawnattr_t* attributes, char* const argv[],
+	char* const environment[])
+{
+	return do_posix_spawn(_pid, path, fileActions, attributes, argv,
+		environment, false);
+}
+
+
+int
+posix_spawnp(pid_t* _pid, const char* file,
+	const posix_spawn_file_actions_t* fileActions,
+	const posix_spawnattr_t* attributes, char* const argv[],
+	char* const environment[])
+{
+	if (file == NULL)
+		return EINVAL;
+
+	// a file name with a slash is used as is
+	if (strchr(file, '/') != NULL) {
+		return do_posix_spawn(_pid, file, fileActions, attributes, argv,
+			environment, true);
+	}
+
+	char path[B_PATH_NAME_LENGTH];
+	status_t status = find_in_path(file, path);
+	if (status != B_OK)
+		return status;
+
+	return do_posix_spawn(_pid, path, fileActions, attributes, argv,
+		environment, true);
+}
+
+
+//	#pragma mark - file actions
+
+
+int
+posix_spawn_file_actions_init(posix_spawn_file_actions_t* fileActions)
+{
+	if (fileActions == NULL)
+		return EINVAL;
+
+	_posix_spawn_file_actions* actions = (_posix_spawn_file_actions*)malloc(
+		sizeof(_posix_spawn_file_actions));
+	if (actions == NULL)
+		return ENOMEM;
+
+	actions->count = 0;
+	actions->actions = NULL;
+
+	*fileActions = actions;
+	return 0;
+}
+
+
+int
+posix_spawn_file_actions_destroy(posix_spawn_file_actions_t* fileActions)
+{
+	if (fileActions == NULL || *fileActions == NULL)
+		return EINVAL;
+
+	_posix_spawn_file_actions* actions = *fileActions;
+	for (int i = 0; i < actions->count; i++) {
+		if (actions->actions[i].type == FILE_ACTION_OPEN)
+			free(actions->actions[i].open.path);
+	}
+
+	free(actions->actions);
+	free(actions);
+
+	*fileActions = NULL;
+	return 0;
+}
+
+
+int
+posix_spawn_file_actions_addopen(posix_spawn_file_actions_t* fileActions,
+	int fd, const char* path, int openMode, mode_t mode)
+{
+	if (path == NULL)
+		return EINVAL;
+
+	char* pathCopy = strdup(path);
+	if (pathCopy == NULL)
+		return ENOMEM;
+
+	file_action* action;
+	int error = add_file_action(fileActions, FILE_ACTION_OPEN, fd, action);
+	if (error != 0) {
+		free(pathCopy);
+		return error;
+	}
+
+	action->open.path = pathCopy;
+	action->open.openMode = openMode;
+	action->open.mode = mode;
+	return 0;
+}
+
+
+int
+posix_spawn_file_actions_addclose(posix_spawn_file_actions_t* fileActions,
+	int fd)
+{
+	file_action* action;
+	return add_file_action(fileActions, FILE_ACTION_CLOSE, fd, action);
+}
+
+
+int
+posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t* fileActions,
+	int fd, int newFD)
+{
+	if (newFD < 0)
+		return EBADF;
+
+	file_action* action;
+	int error = add_file_action(fileActions, FILE_ACTION_DUP2, fd, action);
+	if (error != 0)
+		return error;
+
+	action->dup2.newFD = newFD;
+	return 0;
+}
+
+
+//	#pragma mark - attributes
+
+
+int
+posix_spawnattr_init(posix_spawnattr_t* _attributes)
+{
+	if (_attributes == NULL)
+		return EINVAL;
+
+	_posix_spawnattr* attributes
+		= (_posix_spawnattr*)malloc(sizeof(_posix_spawnattr));
+	if (attributes == NULL)
+		return ENOMEM;
+
+	attributes->flags = 0;
+	attributes->process_group = 0;
+	sigemptyset(&attributes->signal_default);
+	sigemptyset(&attributes->signal_mask);
+
+	*_attributes = attributes;
+	return 0;
+}
+
+
+int
+posix_spawnattr_destroy(posix_spawnattr_t* attributes)
+{
+	if (attributes == NULL || *attributes == NULL)
+		return EINVAL;
+
+	free(*attributes);
+	*attributes = NULL;
+	return 0;
+}
+
+
+int
+posix_spawnattr_getflags(const posix_spawnattr_t* attributes, short* flags)
+{
+	if (attributes == NULL || *attributes == NULL || flags == NULL)
+		return EINVAL;
+
+	*flags = (*attributes)->flags;
+	return 0;
+}
+
+
+int
+posix_spawnattr_setflags(posix_spawnattr_t* attributes, short flags)
+{
+	if (attributes == NULL || *attributes == NULL
+		|| (flags & ~kValidFlags) != 0) {
+		return EINVAL;
+	}
+
+	(*attributes)->flags = flags;
+	return 0;
+}
+
+
+int
+posix_spawnattr_getpgroup(const posix_spawnattr_t* attributes,
+	pid_t* processGroup)
+{
+	if (attributes == NULL || *attributes == NULL || processGroup == NULL)
+		return EINVAL;
+
+	*processGroup = (*attributes)->process_group;
+	return 0;
+}
+
+
+int
+posix_spawnattr_setpgroup(posix_spawnattr_t* attributes, pid_t processGroup)
+{
+	if (attributes == NULL || *attributes == NULL || processGroup < 0)
+		return EINVAL;
+
+	(*attributes)->process_group = processGroup;
+	return 0;
+}
+
+
+int
+posix_spawnattr_getsigdefault(const posix_spawnattr_t* attributes,
+	sigset_t* signals)
+{
+	if (attributes == NULL || *attributes == NULL || signals == NULL)
+		return EINVAL;
+
+	*signals = (*attributes)->signal_default;
+	return 0;
+}
+
+
+int
+posix_spawnattr_setsigdefault(posix_spawnattr_t* attributes,
+	const sigset_t* signals)
+{
+	if (attributes == NULL || *attributes == NULL || signals == NULL)
+		return EINVAL;
+
+	(*attributes)->signal_default = *signals;
+	return 0;
+}
+
+
+int
+posix_spawnattr_getsigmask(const posix_spawnattr_t* attributes,
+	sigset_t* signals)
+{
+	if (attributes == NULL || *attributes == NULL || signals == NULL)
+		return EINVAL;
+
+	*signals = (*attributes)->signal_mask;
+	return 0;
+}
+
+
+int
+posix_spawnattr_setsigmask(posix_spawnattr_t* attributes,
+	const sigset_t* signals)
+{
+	if (attributes == NULL || *attributes == NULL || signals == NULL)
+		return EINVAL;
+
+	(*attributes)->signal_mask = *signals;
+	return 0;
+}
@@ -110,11 +110,11 @@ do_exec(const char *path, char * const args[], char * const environment[],
 			__gUmask));
 			// if this call returns, something definitely went wrong
 
-		free(flatArgs);
+		__free_process_args(flatArgs);
 	} else
 		__set_errno(status);
 
-	free(newArgs);
+	__free_process_args(newArgs);
 	return -1;
 }
 
@@ -15,6 +15,8 @@
 #include <libroot_private.h>
 #include <runtime_loader.h>
 #include <syscalls.h>
+#include <tls.h>
+#include <user_thread_defs.h>
 
 
 typedef struct fork_hook {
@@ -165,9 +167,29 @@ fork(void)
 }
 
 
+/**	Unlike fork(), the child shares the memory of its parent, and the calling
+ *	thread doesn't return before the child has called one of the exec*()
+ *	functions, or _exit(). Anything else the child does, including calling
+ *	any other function, affects the parent as well.
+ *	The fork hooks are not called.
+ */
+
 pid_t
 vfork(void)
 {
-	return fork();
+	thread_id thread = _kern_vfork();
+	if (thread < 0) {
+		__set_errno(thread);
+		return -1;
+	}
+
+	if (thread == 0) {
+		// we are the child -- our user_thread is not shared with the parent
+		struct user_thread* userThread
+			= (struct user_thread*)tls_get(TLS_USER_THREAD_SLOT);
+		userThread->flags |= USER_THREAD_VFORK_CHILD;
+	}
+
+	return thread;
 }
 
@@ -762,6 +762,7 @@ void __fpclassifyf() {}
 void __fpclassifyl() {}
 void __fpurge() {}
 void __freading() {}
+void __free_process_args() {}
 void __frexp() {}
 void __frexpf() {}
 void __frexpl() {}
@@ -1414,6 +1415,7 @@ void _kern_memory_advice() {}
 void _kern_mount() {}
 void _kern_move_partition() {}
 void _kern_mutex_lock() {}
+void _kern_mutex_requeue() {}
 void _kern_mutex_switch_lock() {}
 void _kern_mutex_unlock() {}
 void _kern_next_device() {}
@@ -1547,6 +1549,7 @@ void _kern_unregister_file_device() {}
 void _kern_unregister_image() {}
 void _kern_unregister_messaging_service() {}
 void _kern_unreserve_address_range() {}
+void _kern_vfork() {}
 void _kern_wait_for_child() {}
 void _kern_wait_for_debugger() {}
 void _kern_wait_for_objects() {}
@@ -2309,6 +2312,23 @@ void port_count() {}
 void posix_madvise() {}
 void posix_memalign() {}
 void posix_openpt() {}
+void posix_spawn() {}
+void posix_spawn_file_actions_addclose() {}
+void posix_spawn_file_actions_adddup2() {}
+void posix_spawn_file_actions_addopen() {}
+void posix_spawn_file_actions_destroy() {}
+void posix_spawn_file_actions_init() {}
+void posix_spawnattr_destroy() {}
+void posix_spawnattr_getflags() {}
+void posix_spawnattr_getpgroup() {}
+void posix_spawnattr_getsigdefault() {}
+void posix_spawnattr_getsigmask() {}
+void posix_spawnattr_init() {}
+void posix_spawnattr_setflags() {}
+void posix_spawnattr_setpgroup() {}
+void posix_spawnattr_setsigdefault() {}
+void posix_spawnattr_setsigmask() {}
+void posix_spawnp() {}
 void pow() {}
 void pow10() {}
 void pow10f() {}
@@ -12,10 +12,56 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "images.h"
+
+
+extern "C" void x86_64_lazy_binding_trampoline();
+
+
+/*!	Called by x86_64_lazy_binding_trampoline() the first time a lazily bound
+	PLT entry is used. Binds the entry and returns the function address.
+*/
+extern "C" Elf64_Addr
+x86_64_bind_lazy_symbol(image_t* image, uint64 relocationIndex)
+{
+	Elf64_Rela* rel = (Elf64_Rela*)image->pltrel + relocationIndex;
+	Elf64_Sym* sym = SYMBOL(image, ELF64_R_SYM(rel->r_info));
+
+	Elf64_Addr address = resolve_lazy_symbol(image, sym) + rel->r_addend;
+	*(Elf64_Addr*)(image->regions[0].delta + rel->r_offset) = address;
+
+	return address;
+}
+
+
+/*!	Prepares the GOT of \a image for lazy binding: The PLT's first entry
+	pushes GOT[1] and jumps to GOT[2], which becomes the binding trampoline,
+	with the index of the PLT relocation already on the stack.
+*/
+static bool
+prepare_lazy_binding(image_t* image)
+{
+	Elf64_Addr* got = NULL;
+	for (Elf64_Dyn* d = (Elf64_Dyn*)image->dynamic_ptr; d->d_tag != DT_NULL;
+			d++) {
+		if (d->d_tag == DT_PLTGOT) {
+			got = (Elf64_Addr*)(d->d_un.d_ptr + image->regions[0].delta);
+			break;
+		}
+	}
+
+	if (got == NULL)
+		return false;
+
+	got[1] = (Elf64_Addr)image;
+	got[2] = (Elf64_Addr)&x86_64_lazy_binding_trampoline;
+	return true;
+}
+
 
 static status_t
 relocate_rela(image_t* rootImage, image_t* image, Elf64_Rela* rel,
-	size_t relLength, SymbolLookupCache* cache)
+	size_t relLength, SymbolLookupCache* cache, bool lazy = false)
 {
 	for (size_t i = 0; i < relLength / sizeof(Elf64_Rela); i++) {
 		int type = ELF64_R_TYPE(rel[i].r_info);
@@ -23,6 +69,14 @@ relocate_rela(image_t* rootImage, image_t* image, Elf64_Rela* rel,
 		Elf64_Addr symAddr = 0;
 		image_t* symbolImage = NULL;
 
+		if (lazy && type == R_X86_64_JUMP_SLOT) {
+			// The GOT entry initially points back into the PLT entry, which
+			// will push the relocation index and enter the trampoline.
+			*(Elf64_Addr*)(image->regions[0].delta + rel[i].r_offset)
+				+= image->regions[0].delta;
+			continue;
+		}
+
 		// Resolve the symbol, if any.
 		if (symIndex != 0) {
 			Elf64_Sym* sym = SYMBOL(image, symIndex);
@@ -95,8 +149,14 @@ arch_relocate_image(image_t* rootImage, image_t* image,
 
 	// PLT relocations (they are RELA on x86_64).
 	if (image->pltrel) {
+		if ((image->flags & RFLAG_LAZY_BINDING) != 0
+			&& !prepare_lazy_binding(image)) {
+			image->flags &= ~RFLAG_LAZY_BINDING;
+		}
+
 		status = relocate_rela(rootImage, image, (Elf64_Rela*)image->pltrel,
-			image->pltrel_len, cache);
+			image->pltrel_len, cache,
+			(image->flags & RFLAG_LAZY_BINDING) != 0);
 		if (status != B_OK)
 			return status;
 	}
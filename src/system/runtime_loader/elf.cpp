@@ -30,10 +30,10 @@
 #include "elf_versioning.h"
 #include "errors.h"
 #include "images.h"
+#include "relocation_cache.h"
 
 
 // TODO: implement better locking strategy
-// TODO: implement lazy binding
 
 // a handle returned by load_library() (dlopen())
 #define RLD_GLOBAL_SCOPE	((void*)-2l)
@@ -196,9 +196,22 @@ load_dependencies(image_t* image)
 
 
 static status_t
-relocate_image(image_t *rootImage, image_t *image)
+relocate_image(image_t *rootImage, image_t *image,
+	RelocationCache* relocationCache)
 {
+	// The PLT of the program and its initial dependencies may be bound
+	// lazily, unless the environment or the image itself asks otherwise.
+	// Images loaded later are always bound immediately, since the root image
+	// they are loaded for might be gone by the time a binding happens.
+	if (rootImage == gProgramImage && !gProgramLoaded
+		&& (image->flags & RFLAG_BIND_NOW) == 0
+		&& getenv("LD_BIND_NOW") == NULL) {
+		image->flags |= RFLAG_LAZY_BINDING;
+	}
+
 	SymbolLookupCache cache(image);
+	if (relocationCache != NULL)
+		relocationCache->Prefill(image, &cache);
 
 	status_t status = arch_relocate_image(rootImage, image, &cache);
 	if (status < B_OK) {
@@ -206,6 +219,9 @@ relocate_image(image_t *rootImage, image_t *image)
 		return status;
 	}
 
+	if (relocationCache != NULL)
+		relocationCache->Update(image, &cache);
+
 	_kern_image_relocated(image->id);
 	image_event(image, IMAGE_EVENT_RELOCATED);
 	return B_OK;
@@ -213,7 +229,7 @@ relocate_image(image_t *rootImage, image_t *image)
 
 
 static status_t
-relocate_dependencies(image_t *image)
+relocate_dependencies(image_t *image, RelocationCache* relocationCache = NULL)
 {
 	// get the images that still have to be relocated
 	image_t **list;
@@ -223,7 +239,7 @@ relocate_dependencies(image_t *image)
 
 	// relocate
 	for (ssize_t i = 0; i < count; i++) {
-		status_t status = relocate_image(image, list[i]);
+		status_t status = relocate_image(image, list[i], relocationCache);
 		if (status < B_OK) {
 			free(list);
 			return status;
@@ -426,9 +442,19 @@ load_program(char const *path, void **_entry)
 	// This results in the desired symbol resolution for dlopen()ed libraries.
 	set_image_flags_recursively(gProgramImage, RTLD_GLOBAL);
 
-	status = relocate_dependencies(gProgramImage);
-	if (status < B_OK)
-		goto err;
+	{
+		// If enabled, reuse the symbol lookup results of a previous launch.
+		RelocationCache relocationCache;
+		bool useRelocationCache = relocationCache.Init() == B_OK;
+
+		status = relocate_dependencies(gProgramImage,
+			useRelocationCache ? &relocationCache : NULL);
+		if (status < B_OK)
+			goto err;
+
+		if (useRelocationCache)
+			relocationCache.Store();
+	}
 
 	inject_runtime_loader_api(gProgramImage);
 
@@ -1023,6 +1049,32 @@ terminate_program(void)
 }
 
 
+/*!	Resolves a symbol referenced by a lazily bound PLT entry of \a image.
+	Called by the architecture specific binding trampoline the first time the
+	entry is used. Since there is no way to report an error to the caller, the
+	team is killed, if the symbol can't be resolved.
+*/
+addr_t
+resolve_lazy_symbol(image_t* image, elf_sym* sym)
+{
+	rld_lock();
+
+	addr_t address;
+	status_t status = resolve_symbol(gProgramImage, image, sym, NULL,
+		&address);
+
+	rld_unlock();
+
+	if (status != B_OK) {
+		FATAL("%s: Could not bind symbol '%s' lazily\n", image->path,
+			SYMNAME(image, sym));
+		_kern_exit_team(status);
+	}
+
+	return address;
+}
+
+
 void
 rldelf_init(void)
 {
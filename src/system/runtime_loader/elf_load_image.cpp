@@ -250,6 +250,7 @@ parse_dynamic_segment(image_t* image)
 	int sonameOffset = -1;
 
 	image->symhash = 0;
+	image->gnuhash = 0;
 	image->syms = 0;
 	image->strtab = 0;
 
@@ -266,6 +267,10 @@ parse_dynamic_segment(image_t* image)
 				image->symhash
 					= (uint32*)(d[i].d_un.d_ptr + image->regions[0].delta);
 				break;
+			case DT_GNU_HASH:
+				image->gnuhash
+					= (uint32*)(d[i].d_un.d_ptr + image->regions[0].delta);
+				break;
 			case DT_STRTAB:
 				image->strtab
 					= (char*)(d[i].d_un.d_ptr + image->regions[0].delta);
@@ -328,11 +333,16 @@ parse_dynamic_segment(image_t* image)
 			case DT_SYMBOLIC:
 				image->flags |= RFLAG_SYMBOLIC;
 				break;
+			case DT_BIND_NOW:
+				image->flags |= RFLAG_BIND_NOW;
+				break;
 			case DT_FLAGS:
 			{
 				uint32 flags = d[i].d_un.d_val;
 				if ((flags & DF_SYMBOLIC) != 0)
 					image->flags |= RFLAG_SYMBOLIC;
+				if ((flags & DF_BIND_NOW) != 0)
+					image->flags |= RFLAG_BIND_NOW;
 				if ((flags & DF_STATIC_TLS) != 0) {
 					FATAL("Static TLS model is not supported.\n");
 					return false;
@@ -347,7 +357,6 @@ parse_dynamic_segment(image_t* image)
 			// DT_RELAENT: The size of a DT_RELA entry.
 			// DT_SYMENT: The size of a symbol table entry.
 			// DT_PLTREL: The type of the PLT relocation entries (DT_JMPREL).
-			// DT_BIND_NOW/DF_BIND_NOW: No lazy binding allowed.
 			// DT_INIT_ARRAY[SZ], DT_FINI_ARRAY[SZ]: Initialization/termination
 			//		function arrays.
 			// DT_PREINIT_ARRAY[SZ]: Preinitialization function array.
@@ -358,6 +367,9 @@ parse_dynamic_segment(image_t* image)
 	}
 
 	// lets make sure we found all the required sections
+	// DT_HASH is needed even if there is a DT_GNU_HASH table: the latter is
+	// preferred for lookups, but the symbol count and symbol iteration (also
+	// in the debug kit) are based on the former.
 	if (!image->symhash || !image->syms || !image->strtab)
 		return false;
 
@@ -63,6 +63,19 @@ elf_hash(const char* _name)
 }
 
 
+uint32
+elf_gnu_hash(const char* _name)
+{
+	const uint8* name = (const uint8*)_name;
+
+	uint32 hash = 5381;
+	while (*name)
+		hash = (hash << 5) + hash + *name++;
+
+	return hash;
+}
+
+
 void
 patch_defined_symbol(image_t* image, const char* name, void** symbol,
 	int32* type)
@@ -93,120 +106,216 @@ patch_undefined_symbol(image_t* rootImage, image_t* image, const char* name,
 }
 
 
-elf_sym*
-find_symbol(image_t* image, const SymbolLookupInfo& lookupInfo)
+/*!	Checks whether the symbol with index \a index in \a image satisfies the
+	lookup described by \a lookupInfo.
+
+	\return \c true, if the lookup is finished. In this case \a _symbol is set
+		to the symbol found, which may be \c NULL, if the image must not be
+		used to resolve the symbol at all. \c false, if the lookup has to go
+		on. A unique non-hidden versioned symbol that is acceptable, if
+		nothing better turns up, is recorded in \a versionedSymbol and
+		\a versionedSymbolCount.
+*/
+static inline bool
+check_symbol(image_t* image, uint32 index, const SymbolLookupInfo& lookupInfo,
+	elf_sym*& _symbol, elf_sym*& versionedSymbol,
+	uint32& versionedSymbolCount)
 {
-	if (image->dynamic_ptr == 0)
-		return NULL;
+	elf_sym* symbol = &image->syms[index];
 
-	elf_sym* versionedSymbol = NULL;
-	uint32 versionedSymbolCount = 0;
+	if (symbol->st_shndx == SHN_UNDEF
+		|| ((symbol->Bind() != STB_GLOBAL)
+			&& (symbol->Bind() != STB_WEAK))
+		|| strcmp(SYMNAME(image, symbol), lookupInfo.name) != 0) {
+		return false;
+	}
 
-	uint32 bucket = lookupInfo.hash % HASHTABSIZE(image);
+	// check if the type matches
+	uint32 type = symbol->Type();
+	if ((lookupInfo.type == B_SYMBOL_TYPE_TEXT && type != STT_FUNC)
+		|| (lookupInfo.type == B_SYMBOL_TYPE_DATA
+			&& type != STT_OBJECT)) {
+		return false;
+	}
 
-	for (uint32 i = HASHBUCKETS(image)[bucket]; i != STN_UNDEF;
-			i = HASHCHAINS(image)[i]) {
-		elf_sym* symbol = &image->syms[i];
+	// check the version
 
-		if (symbol->st_shndx != SHN_UNDEF
-			&& ((symbol->Bind() == STB_GLOBAL)
-				|| (symbol->Bind() == STB_WEAK))
-			&& !strcmp(SYMNAME(image, symbol), lookupInfo.name)) {
-
-			// check if the type matches
-			uint32 type = symbol->Type();
-			if ((lookupInfo.type == B_SYMBOL_TYPE_TEXT && type != STT_FUNC)
-				|| (lookupInfo.type == B_SYMBOL_TYPE_DATA
-					&& type != STT_OBJECT)) {
-				continue;
-			}
+	// Handle the simple cases -- the image doesn't have version
+	// information -- first.
+	if (image->symbol_versions == NULL) {
+		if (lookupInfo.version == NULL) {
+			// No specific symbol version was requested either, so the
+			// symbol is just fine.
+			_symbol = symbol;
+			return true;
+		}
+
+		// A specific version is requested. If it's the dependency
+		// referred to by the requested version, it's apparently an
+		// older version of the dependency and we're not happy.
+		if (equals_image_name(image, lookupInfo.version->file_name)) {
+			// TODO: That should actually be kind of fatal!
+			_symbol = NULL;
+			return true;
+		}
 
-			// check the version
+		// This is some other image. We accept the symbol.
+		_symbol = symbol;
+		return true;
+	}
 
-			// Handle the simple cases -- the image doesn't have version
-			// information -- first.
-			if (image->symbol_versions == NULL) {
-				if (lookupInfo.version == NULL) {
-					// No specific symbol version was requested either, so the
-					// symbol is just fine.
-					return symbol;
-				}
+	// The image has version information. Let's see what we've got.
+	uint32 versionID = image->symbol_versions[index];
+	uint32 versionIndex = VER_NDX(versionID);
+	elf_version_info& version = image->versions[versionIndex];
 
-				// A specific version is requested. If it's the dependency
-				// referred to by the requested version, it's apparently an
-				// older version of the dependency and we're not happy.
-				if (equals_image_name(image, lookupInfo.version->file_name)) {
-					// TODO: That should actually be kind of fatal!
-					return NULL;
-				}
+	// skip local versions
+	if (versionIndex == VER_NDX_LOCAL)
+		return false;
 
-				// This is some other image. We accept the symbol.
-				return symbol;
-			}
+	if (lookupInfo.version != NULL) {
+		// a specific version is requested
 
-			// The image has version information. Let's see what we've got.
-			uint32 versionID = image->symbol_versions[i];
-			uint32 versionIndex = VER_NDX(versionID);
-			elf_version_info& version = image->versions[versionIndex];
+		// compare the versions
+		if (version.hash == lookupInfo.version->hash
+			&& strcmp(version.name, lookupInfo.version->name) == 0) {
+			// versions match
+			_symbol = symbol;
+			return true;
+		}
 
-			// skip local versions
-			if (versionIndex == VER_NDX_LOCAL)
-				continue;
+		// The versions don't match. We're still fine with the
+		// base version, if it is public and we're not looking for
+		// the default version.
+		if ((versionID & VER_NDX_FLAG_HIDDEN) == 0
+			&& versionIndex == VER_NDX_GLOBAL
+			&& (lookupInfo.flags & LOOKUP_FLAG_DEFAULT_VERSION)
+				== 0) {
+			// TODO: Revise the default version case! That's how
+			// FreeBSD implements it, but glibc doesn't handle it
+			// specially.
+			_symbol = symbol;
+			return true;
+		}
+	} else {
+		// No specific version requested, but the image has version
+		// information. This can happen in either of these cases:
+		//
+		// * The dependent object was linked against an older version
+		//   of the now versioned dependency.
+		// * The symbol is looked up via find_image_symbol() or dlsym().
+		//
+		// In the first case we return the base version of the symbol
+		// (VER_NDX_GLOBAL or VER_NDX_INITIAL), or, if that doesn't
+		// exist, the unique, non-hidden versioned symbol.
+		//
+		// In the second case we want to return the public default
+		// version of the symbol. The handling is pretty similar to the
+		// first case, with the exception that we treat VER_NDX_INITIAL
+		// as regular version.
+
+		// VER_NDX_GLOBAL is always good, VER_NDX_INITIAL is fine, if
+		// we don't look for the default version.
+		if (versionIndex == VER_NDX_GLOBAL
+			|| ((lookupInfo.flags & LOOKUP_FLAG_DEFAULT_VERSION) == 0
+				&& versionIndex == VER_NDX_INITIAL)) {
+			_symbol = symbol;
+			return true;
+		}
 
-			if (lookupInfo.version != NULL) {
-				// a specific version is requested
+		// If not hidden, remember the version -- we'll return it, if
+		// it is the only one.
+		if ((versionID & VER_NDX_FLAG_HIDDEN) == 0) {
+			versionedSymbolCount++;
+			versionedSymbol = symbol;
+		}
+	}
 
-				// compare the versions
-				if (version.hash == lookupInfo.version->hash
-					&& strcmp(version.name, lookupInfo.version->name) == 0) {
-					// versions match
-					return symbol;
-				}
+	return false;
+}
 
-				// The versions don't match. We're still fine with the
-				// base version, if it is public and we're not looking for
-				// the default version.
-				if ((versionID & VER_NDX_FLAG_HIDDEN) == 0
-					&& versionIndex == VER_NDX_GLOBAL
-					&& (lookupInfo.flags & LOOKUP_FLAG_DEFAULT_VERSION)
-						== 0) {
-					// TODO: Revise the default version case! That's how
-					// FreeBSD implements it, but glibc doesn't handle it
-					// specially.
-					return symbol;
-				}
-			} else {
-				// No specific version requested, but the image has version
-				// information. This can happen in either of these cases:
-				//
-				// * The dependent object was linked against an older version
-				//   of the now versioned dependency.
-				// * The symbol is looked up via find_image_symbol() or dlsym().
-				//
-				// In the first case we return the base version of the symbol
-				// (VER_NDX_GLOBAL or VER_NDX_INITIAL), or, if that doesn't
-				// exist, the unique, non-hidden versioned symbol.
-				//
-				// In the second case we want to return the public default
-				// version of the symbol. The handling is pretty similar to the
-				// first case, with the exception that we treat VER_NDX_INITIAL
-				// as regular version.
-
-				// VER_NDX_GLOBAL is always good, VER_NDX_INITIAL is fine, if
-				// we don't look for the default version.
-				if (versionIndex == VER_NDX_GLOBAL
-					|| ((lookupInfo.flags & LOOKUP_FLAG_DEFAULT_VERSION) == 0
-						&& versionIndex == VER_NDX_INITIAL)) {
-					return symbol;
-				}
 
-				// If not hidden, remember the version -- we'll return it, if
-				// it is the only one.
-				if ((versionID & VER_NDX_FLAG_HIDDEN) == 0) {
-					versionedSymbolCount++;
-					versionedSymbol = symbol;
-				}
-			}
+/*!	Looks up a symbol using the image's DT_GNU_HASH table.
+
+	The table starts with a header (bucket count, index of the first symbol
+	covered by the table, bloom filter word count, and bloom filter shift),
+	followed by the bloom filter words (of the ELF class' size), the buckets,
+	and the hash chain. The symbols are sorted by bucket, so that each
+	bucket's chain is a contiguous run of the symbol table. The lowest bit of
+	a chain entry marks the end of the run, the other bits are the symbol's
+	hash value.
+*/
+static elf_sym*
+find_symbol_gnu_hash(image_t* image, const SymbolLookupInfo& lookupInfo)
+{
+	const uint32* table = image->gnuhash;
+	uint32 bucketCount = table[0];
+	uint32 symbolOffset = table[1];
+	uint32 bloomSize = table[2];
+	uint32 bloomShift = table[3];
+	if (bucketCount == 0 || bloomSize == 0)
+		return NULL;
+
+	const addr_t* bloom = (const addr_t*)(table + 4);
+	const uint32* buckets = (const uint32*)(bloom + bloomSize);
+	const uint32* chain = buckets + bucketCount;
+
+	// Check the bloom filter first -- most lookups are for symbols the image
+	// doesn't define, and the filter rejects almost all of them without
+	// touching the buckets or the string table.
+	const uint32 kBloomWordBits = sizeof(addr_t) * 8;
+	uint32 hash = lookupInfo.GnuHash();
+	addr_t word = bloom[(hash / kBloomWordBits) % bloomSize];
+	addr_t mask = ((addr_t)1 << (hash % kBloomWordBits))
+		| ((addr_t)1 << ((hash >> bloomShift) % kBloomWordBits));
+	if ((word & mask) != mask)
+		return NULL;
+
+	uint32 index = buckets[hash % bucketCount];
+	if (index < symbolOffset)
+		return NULL;
+
+	elf_sym* versionedSymbol = NULL;
+	uint32 versionedSymbolCount = 0;
+
+	for (;; index++) {
+		uint32 chainHash = chain[index - symbolOffset];
+
+		elf_sym* symbol;
+		if (((chainHash ^ hash) >> 1) == 0
+			&& check_symbol(image, index, lookupInfo, symbol, versionedSymbol,
+				versionedSymbolCount)) {
+			return symbol;
+		}
+
+		if ((chainHash & 1) != 0)
+			break;
+	}
+
+	return versionedSymbolCount == 1 ? versionedSymbol : NULL;
+}
+
+
+elf_sym*
+find_symbol(image_t* image, const SymbolLookupInfo& lookupInfo)
+{
+	if (image->dynamic_ptr == 0)
+		return NULL;
+
+	if (image->gnuhash != NULL)
+		return find_symbol_gnu_hash(image, lookupInfo);
+
+	elf_sym* versionedSymbol = NULL;
+	uint32 versionedSymbolCount = 0;
+
+	uint32 bucket = lookupInfo.hash % HASHTABSIZE(image);
+
+	for (uint32 i = HASHBUCKETS(image)[bucket]; i != STN_UNDEF;
+			i = HASHCHAINS(image)[i]) {
+		elf_sym* symbol;
+		if (check_symbol(image, i, lookupInfo, symbol, versionedSymbol,
+				versionedSymbolCount)) {
+			return symbol;
 		}
 	}
 
@@ -472,6 +581,200 @@ find_undefined_symbol_add_on(image_t* rootImage, image_t* image,
 }
 
 
+// #pragma mark - symbol resolution cache
+
+
+/*!	Process-wide cache of global symbol lookup results.
+
+	For images that aren't linked symbolically, the outcome of the global and
+	add-on lookup order doesn't depend on the requesting image, only on the
+	root image, the symbol's name, type, and version, and on the set of
+	loaded images used for resolving. Since the same symbols (e.g. from
+	libroot or libstdc++) are referenced by most images, caching the result
+	saves walking the whole image list again for every image being relocated.
+	Only lookups done while relocating are cached, so the name and version
+	pointers refer to the requesting image's string table and version infos.
+	The cache is flushed whenever the loaded images generation changes, which
+	also guarantees that those and the cached image pointers stay valid.
+*/
+struct SymbolResolutionCacheEntry {
+	const char*				name;
+	const elf_version_info*	version;
+	image_t*				rootImage;
+	image_t*				image;
+	elf_sym*				symbol;
+	uint32					hash;
+	int32					type;
+	uint32					flags;
+};
+
+static const uint32 kSymbolResolutionCacheInitialSize = 1024;
+static const uint32 kSymbolResolutionCacheMaxSize = 65536;
+
+static SymbolResolutionCacheEntry* sResolutionCache = NULL;
+static uint32 sResolutionCacheSize = 0;
+static uint32 sResolutionCacheCount = 0;
+static uint32 sResolutionCacheGeneration = 0;
+
+
+static inline bool
+can_use_resolution_cache(image_t* rootImage, image_t* image)
+{
+	if ((image->flags & RFLAG_SYMBOLIC) != 0)
+		return false;
+
+	return rootImage->find_undefined_symbol == find_undefined_symbol_global
+		|| (rootImage->find_undefined_symbol == find_undefined_symbol_add_on
+			&& image != rootImage);
+}
+
+
+static inline uint32
+resolution_cache_hash(image_t* rootImage, uint32 nameHash, int32 type,
+	const elf_version_info* version)
+{
+	uint32 hash = nameHash ^ (uint32)type ^ ((uint32)(addr_t)rootImage >> 4);
+	if (version != NULL)
+		hash ^= version->hash * 31;
+	return hash;
+}
+
+
+static inline bool
+resolution_cache_entry_matches(const SymbolResolutionCacheEntry& entry,
+	image_t* rootImage, const SymbolLookupInfo& lookupInfo)
+{
+	if (entry.rootImage != rootImage || entry.hash != lookupInfo.hash
+		|| entry.type != lookupInfo.type || entry.flags != lookupInfo.flags
+		|| strcmp(entry.name, lookupInfo.name) != 0) {
+		return false;
+	}
+
+	// Version infos belong to the requesting image, so compare them by value.
+	const elf_version_info* version = lookupInfo.version;
+	if (entry.version == NULL || version == NULL)
+		return entry.version == version;
+
+	if (entry.version->hash != version->hash
+		|| strcmp(entry.version->name, version->name) != 0) {
+		return false;
+	}
+
+	if (entry.version->file_name == NULL || version->file_name == NULL)
+		return entry.version->file_name == version->file_name;
+	return strcmp(entry.version->file_name, version->file_name) == 0;
+}
+
+
+static bool
+resize_resolution_cache(uint32 newSize)
+{
+	SymbolResolutionCacheEntry* newCache = (SymbolResolutionCacheEntry*)
+		malloc(sizeof(SymbolResolutionCacheEntry) * newSize);
+	if (newCache == NULL)
+		return false;
+
+	memset(newCache, 0, sizeof(SymbolResolutionCacheEntry) * newSize);
+
+	if (sResolutionCacheCount > 0) {
+		for (uint32 i = 0; i < sResolutionCacheSize; i++) {
+			SymbolResolutionCacheEntry& entry = sResolutionCache[i];
+			if (entry.name == NULL)
+				continue;
+
+			uint32 index = resolution_cache_hash(entry.rootImage, entry.hash,
+				entry.type, entry.version) & (newSize - 1);
+			while (newCache[index].name != NULL)
+				index = (index + 1) & (newSize - 1);
+			newCache[index] = entry;
+		}
+	}
+
+	free(sResolutionCache);
+	sResolutionCache = newCache;
+	sResolutionCacheSize = newSize;
+	return true;
+}
+
+
+static elf_sym*
+lookup_resolution_cache(image_t* rootImage, const SymbolLookupInfo& lookupInfo,
+	image_t** _foundInImage)
+{
+	if (sResolutionCacheCount == 0)
+		return NULL;
+
+	uint32 generation = get_loaded_images_generation();
+	if (generation != sResolutionCacheGeneration) {
+		// the set of images used for resolving has changed
+		memset(sResolutionCache, 0,
+			sizeof(SymbolResolutionCacheEntry) * sResolutionCacheSize);
+		sResolutionCacheCount = 0;
+		return NULL;
+	}
+
+	uint32 mask = sResolutionCacheSize - 1;
+	uint32 hash = resolution_cache_hash(rootImage, lookupInfo.hash,
+		lookupInfo.type, lookupInfo.version);
+	for (uint32 index = hash & mask; sResolutionCache[index].name != NULL;
+			index = (index + 1) & mask) {
+		SymbolResolutionCacheEntry& entry = sResolutionCache[index];
+		if (resolution_cache_entry_matches(entry, rootImage, lookupInfo)) {
+			*_foundInImage = entry.image;
+			return entry.symbol;
+		}
+	}
+
+	return NULL;
+}
+
+
+static void
+add_to_resolution_cache(image_t* rootImage, const SymbolLookupInfo& lookupInfo,
+	image_t* image, elf_sym* symbol)
+{
+	uint32 generation = get_loaded_images_generation();
+	if (generation != sResolutionCacheGeneration) {
+		if (sResolutionCacheCount > 0) {
+			memset(sResolutionCache, 0,
+				sizeof(SymbolResolutionCacheEntry) * sResolutionCacheSize);
+			sResolutionCacheCount = 0;
+		}
+		sResolutionCacheGeneration = generation;
+	}
+
+	// keep the load factor below 1/2
+	if ((sResolutionCacheCount + 1) * 2 > sResolutionCacheSize) {
+		uint32 newSize = sResolutionCacheSize == 0
+			? kSymbolResolutionCacheInitialSize : sResolutionCacheSize * 2;
+		if (newSize > kSymbolResolutionCacheMaxSize
+			|| !resize_resolution_cache(newSize)) {
+			return;
+		}
+	}
+
+	uint32 mask = sResolutionCacheSize - 1;
+	uint32 index = resolution_cache_hash(rootImage, lookupInfo.hash,
+		lookupInfo.type, lookupInfo.version) & mask;
+	while (sResolutionCache[index].name != NULL)
+		index = (index + 1) & mask;
+
+	SymbolResolutionCacheEntry& entry = sResolutionCache[index];
+	entry.name = lookupInfo.name;
+	entry.version = lookupInfo.version;
+	entry.rootImage = rootImage;
+	entry.image = image;
+	entry.symbol = symbol;
+	entry.hash = lookupInfo.hash;
+	entry.type = lookupInfo.type;
+	entry.flags = lookupInfo.flags;
+	sResolutionCacheCount++;
+}
+
+
+// #pragma mark -
+
+
 int
 resolve_symbol(image_t* rootImage, image_t* image, elf_sym* sym,
 	SymbolLookupCache* cache, addr_t* symAddress, image_t** symbolImage)
@@ -479,7 +782,7 @@ resolve_symbol(image_t* rootImage, image_t* image, elf_sym* sym,
 	uint32 index = sym - image->syms;
 
 	// check the cache first
-	if (cache->IsSymbolValueCached(index)) {
+	if (cache != NULL && cache->IsSymbolValueCached(index)) {
 		*symAddress = cache->SymbolValueAt(index, symbolImage);
 		return B_OK;
 	}
@@ -509,8 +812,22 @@ resolve_symbol(image_t* rootImage, image_t* image, elf_sym* sym,
 		}
 
 		// search the symbol
-		sharedSym = rootImage->find_undefined_symbol(rootImage, image,
-			SymbolLookupInfo(symName, type, versionInfo, 0, sym), &sharedImage);
+		SymbolLookupInfo lookupInfo(symName, type, versionInfo, 0, sym);
+		bool useCache = can_use_resolution_cache(rootImage, image);
+
+		sharedSym = NULL;
+		if (useCache) {
+			sharedSym = lookup_resolution_cache(rootImage, lookupInfo,
+				&sharedImage);
+		}
+		if (sharedSym == NULL) {
+			sharedSym = rootImage->find_undefined_symbol(rootImage, image,
+				lookupInfo, &sharedImage);
+			if (useCache && sharedSym != NULL) {
+				add_to_resolution_cache(rootImage, lookupInfo, sharedImage,
+					sharedSym);
+			}
+		}
 	}
 
 	enum {
@@ -579,7 +896,8 @@ resolve_symbol(image_t* rootImage, image_t* image, elf_sym* sym,
 		return B_MISSING_SYMBOL;
 	}
 
-	cache->SetSymbolValueAt(index, (addr_t)location, sharedImage);
+	if (cache != NULL)
+		cache->SetSymbolValueAt(index, (addr_t)location, sharedImage);
 
 	if (symbolImage)
 		*symbolImage = sharedImage;
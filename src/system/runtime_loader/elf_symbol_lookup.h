@@ -17,12 +17,16 @@
 
 
 uint32 elf_hash(const char* name);
+uint32 elf_gnu_hash(const char* name);
 
 
 struct SymbolLookupInfo {
 	const char*				name;
 	int32					type;
 	uint32					hash;
+	mutable uint32			gnuHash;
+		// only valid if gnuHashValid is set, use GnuHash()
+	mutable bool			gnuHashValid;
 	uint32					flags;
 	const elf_version_info*	version;
 	elf_sym*				requestingSymbol;
@@ -34,6 +38,8 @@ struct SymbolLookupInfo {
 		name(name),
 		type(type),
 		hash(hash),
+		gnuHash(0),
+		gnuHashValid(false),
 		flags(flags),
 		version(version),
 		requestingSymbol(requestingSymbol)
@@ -47,11 +53,24 @@ struct SymbolLookupInfo {
 		name(name),
 		type(type),
 		hash(elf_hash(name)),
+		gnuHash(0),
+		gnuHashValid(false),
 		flags(flags),
 		version(version),
 		requestingSymbol(requestingSymbol)
 	{
 	}
+
+	// The GNU hash is only computed when an image with a DT_GNU_HASH table
+	// is searched.
+	uint32 GnuHash() const
+	{
+		if (!gnuHashValid) {
+			gnuHash = elf_gnu_hash(name);
+			gnuHashValid = true;
+		}
+		return gnuHash;
+	}
 };
 
 
@@ -87,6 +106,11 @@ struct SymbolLookupCache {
 		free(fDSOs);
 	}
 
+	size_t TableSize() const
+	{
+		return fTableSize;
+	}
+
 	bool IsSymbolValueCached(size_t index) const
 	{
 		return index < fTableSize
@@ -10,6 +10,7 @@
 
 #include "images.h"
 
+#include <dlfcn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,6 +44,8 @@ bool gInvalidImageIDs;
 static image_queue_t sLoadedImages = {0, 0};
 static image_queue_t sDisposableImages = {0, 0};
 static uint32 sLoadedImageCount = 0;
+static uint32 sLoadedImagesGeneration = 0;
+	// changes whenever the set of images used for symbol resolution changes
 
 
 //! Remaps the image ID of \a image after fork.
@@ -146,6 +149,11 @@ update_image_flags_recursively(image_t* image, uint32 flagsToSet,
 		queue[i]->flags = (queue[i]->flags | flagsToSet)
 			& ~(flagsToClear | RFLAG_VISITED);
 	}
+
+	if (((flagsToSet | flagsToClear)
+			& (RTLD_GLOBAL | RFLAG_USE_FOR_RESOLVING)) != 0) {
+		sLoadedImagesGeneration++;
+	}
 }
 
 
@@ -278,6 +286,7 @@ put_image(image_t* image)
 		dequeue_image(&sLoadedImages, image);
 		enqueue_image(&sDisposableImages, image);
 		sLoadedImageCount--;
+		sLoadedImagesGeneration++;
 
 		for (i = 0; i < image->num_needed; i++)
 			put_image(image->needed[i]);
@@ -560,11 +569,24 @@ count_loaded_images()
 }
 
 
+/*!	Returns a counter that changes whenever an image is added to or removed
+	from the loaded images list, or whenever an image's RTLD_GLOBAL or
+	RFLAG_USE_FOR_RESOLVING flag changes, i.e. whenever a global symbol lookup
+	might have a different outcome.
+*/
+uint32
+get_loaded_images_generation()
+{
+	return sLoadedImagesGeneration;
+}
+
+
 void
 enqueue_loaded_image(image_t* image)
 {
 	enqueue_image(&sLoadedImages, image);
 	sLoadedImageCount++;
+	sLoadedImagesGeneration++;
 }
 
 
@@ -573,6 +595,7 @@ dequeue_loaded_image(image_t* image)
 {
 	dequeue_image(&sLoadedImages, image);
 	sLoadedImageCount--;
+	sLoadedImagesGeneration++;
 }
 
 
@@ -28,8 +28,12 @@ enum {
 	RFLAG_REMAPPED				= 0x8000,
 
 	RFLAG_VISITED				= 0x10000,
-	RFLAG_USE_FOR_RESOLVING		= 0x20000
+	RFLAG_USE_FOR_RESOLVING		= 0x20000,
 		// temporarily set in the symbol resolution code
+	RFLAG_BIND_NOW				= 0x40000,
+		// the image requests immediate binding (DT_BIND_NOW/DF_BIND_NOW)
+	RFLAG_LAZY_BINDING			= 0x80000
+		// the image's PLT may be bound lazily by the architecture code
 };
 
 
@@ -60,6 +64,7 @@ status_t	update_image_ids();
 image_queue_t& get_loaded_images();
 image_queue_t& get_disposable_images();
 uint32		count_loaded_images();
+uint32		get_loaded_images_generation();
 void		enqueue_loaded_image(image_t* image);
 void		dequeue_loaded_image(image_t* image);
 void		dequeue_disposable_image(image_t* image);
@@ -0,0 +1,451 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Persistent cache of symbol resolution results for program launches.
+
+	When enabled via the LD_RELOCATION_CACHE environment variable, the result
+	of every symbol lookup done while relocating a program and its libraries
+	is written to a file in the user's cache directory, keyed by the exact set
+	of loaded images (device, node, size, and modification time of each, in
+	load order). On the next launch with an unchanged set of images, the
+	per-image symbol lookup caches are prefilled from that file, so that
+	relocating doesn't have to search for a single symbol.
+
+	Since the images are mapped at randomized addresses, the cache doesn't
+	contain absolute addresses; it records for each symbol the image that
+	defines it and its unrelocated value.
+*/
+
+
+#include "relocation_cache.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <find_directory_private.h>
+#include <syscalls.h>
+
+#include "elf_symbol_lookup.h"
+#include "images.h"
+
+
+static const char* const kCacheSubDirectory = "runtime_loader";
+static const uint32 kCacheMagic = 'rlRC';
+static const uint32 kCacheVersion = 1 | (sizeof(addr_t) << 16);
+static const uint32 kMaxCacheEntries = 1024 * 1024;
+
+
+struct relocation_cache_header {
+	uint32	magic;
+	uint32	version;
+	uint32	image_count;
+	uint32	entry_count;
+};
+
+struct relocation_cache_image {
+	int32	device;
+	uint32	first_entry;
+	int64	node;
+	int64	size;
+	int64	modification_time;
+	uint32	entry_count;
+	uint32	reserved;
+};
+
+struct relocation_cache_entry {
+	uint32	symbol;
+	int32	image;
+	uint64	value;
+};
+
+
+static inline bool
+is_tls_symbol(image_t* image, uint32 symbol)
+{
+	return image->syms[symbol].Type() == STT_TLS;
+}
+
+
+/*!	Returns whether \a value can be the (relocated) address of a symbol
+	defined in \a target, i.e. whether it lies within one of its regions.
+*/
+static bool
+is_in_image(image_t* target, addr_t value)
+{
+	for (uint32 i = 0; i < target->num_regions; i++) {
+		const elf_region_t& region = target->regions[i];
+		if (value >= region.vmstart
+			&& value - region.vmstart <= region.vmsize) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+// #pragma mark -
+
+
+RelocationCache::RelocationCache()
+	:
+	fImages(NULL),
+	fImageRecords(NULL),
+	fImageCount(0),
+	fEntries(NULL),
+	fEntryCount(0),
+	fEntryCapacity(0),
+	fLoaded(false),
+	fDirty(false)
+{
+	fPath[0] = '\0';
+}
+
+
+RelocationCache::~RelocationCache()
+{
+	free(fImages);
+	free(fImageRecords);
+	free(fEntries);
+}
+
+
+/*!	Identifies the currently loaded images, and loads the matching cache file,
+	if there is one.
+	Must be called after all images have been loaded, but before any of them
+	is relocated.
+	\return \c B_OK, if the cache can be used, an error code otherwise. In the
+		latter case the object must not be used any further.
+*/
+status_t
+RelocationCache::Init()
+{
+	if (getenv("LD_RELOCATION_CACHE") == NULL)
+		return B_NOT_SUPPORTED;
+
+	fImageCount = count_loaded_images();
+	fImages = (image_t**)malloc(sizeof(image_t*) * fImageCount);
+	fImageRecords = (relocation_cache_image*)malloc(
+		sizeof(relocation_cache_image) * fImageCount);
+	if (fImages == NULL || fImageRecords == NULL)
+		return B_NO_MEMORY;
+
+	memset(fImageRecords, 0, sizeof(relocation_cache_image) * fImageCount);
+
+	// identify the images and compute the cache key (64 bit FNV-1a)
+	uint64 key = 0xcbf29ce484222325ULL;
+	uint32 index = 0;
+	for (image_t* image = get_loaded_images().head; image != NULL;
+			image = image->next, index++) {
+		// Symbol patchers may redirect symbols anywhere; we can't record that.
+		if (image->defined_symbol_patchers != NULL
+			|| image->undefined_symbol_patchers != NULL) {
+			return B_NOT_SUPPORTED;
+		}
+
+		struct stat st;
+		status_t status = _kern_read_stat(-1, image->path, true, &st,
+			sizeof(struct stat));
+		if (status != B_OK)
+			return status;
+
+		relocation_cache_image& record = fImageRecords[index];
+		record.device = st.st_dev;
+		record.node = st.st_ino;
+		record.size = st.st_size;
+		record.modification_time = (int64)st.st_mtim.tv_sec * 1000000000LL
+			+ st.st_mtim.tv_nsec;
+
+		fImages[index] = image;
+
+		const uint8* data = (const uint8*)&record;
+		for (size_t i = 0; i < sizeof(record); i++) {
+			key ^= data[i];
+			key *= 0x100000001b3ULL;
+		}
+	}
+
+	status_t status = __find_directory(B_USER_CACHE_DIRECTORY, -1, false,
+		fPath, sizeof(fPath));
+	if (status != B_OK)
+		return status;
+
+	size_t length = strlen(fPath);
+	if ((size_t)snprintf(fPath + length, sizeof(fPath) - length,
+			"/%s/%016" B_PRIx64, kCacheSubDirectory, key)
+				>= sizeof(fPath) - length) {
+		return B_NAME_TOO_LONG;
+	}
+
+	if (_Load() == B_OK)
+		fLoaded = true;
+	else {
+		fEntryCount = 0;
+		fDirty = true;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Fills \a cache with the cached lookup results for the symbols referenced
+	by \a image.
+*/
+void
+RelocationCache::Prefill(image_t* image, SymbolLookupCache* cache)
+{
+	if (!fLoaded)
+		return;
+
+	int32 index = _IndexOf(image);
+	if (index < 0)
+		return;
+
+	const relocation_cache_image& record = fImageRecords[index];
+	uint32 symbolCount = image->symhash[1];
+
+	for (uint32 i = 0; i < record.entry_count; i++) {
+		const relocation_cache_entry& entry
+			= fEntries[record.first_entry + i];
+		if (entry.symbol == STN_UNDEF || entry.symbol >= symbolCount
+			|| entry.image < 0 || (uint32)entry.image >= fImageCount) {
+			continue;
+		}
+
+		// Don't trust the cached value any further than the lookup would:
+		// it must point into the image that defines the symbol, or, for TLS
+		// symbols, that image must have a TLS block at all. Anything else
+		// (like a value a symbol patcher had replaced) is left to the
+		// regular lookup.
+		image_t* target = fImages[entry.image];
+		addr_t value = (addr_t)entry.value;
+		if (is_tls_symbol(image, entry.symbol)) {
+			if (target->dso_tls_id == unsigned(-1))
+				continue;
+		} else {
+			value += target->regions[0].delta;
+			if (!is_in_image(target, value))
+				continue;
+		}
+
+		cache->SetSymbolValueAt(entry.symbol, value, target);
+	}
+}
+
+
+/*!	Records the lookup results \a cache holds after \a image has been
+	relocated.
+*/
+void
+RelocationCache::Update(image_t* image, const SymbolLookupCache* cache)
+{
+	if (!fDirty)
+		return;
+
+	int32 index = _IndexOf(image);
+	if (index < 0)
+		return;
+
+	relocation_cache_image& record = fImageRecords[index];
+	record.first_entry = fEntryCount;
+	record.entry_count = 0;
+
+	for (uint32 symbol = 0; symbol < cache->TableSize(); symbol++) {
+		if (!cache->IsSymbolValueCached(symbol))
+			continue;
+
+		image_t* target;
+		addr_t value = cache->SymbolValueAt(symbol, &target);
+		int32 targetIndex = target != NULL ? _IndexOf(target) : -1;
+		if (targetIndex < 0)
+			continue;
+
+		if (!is_tls_symbol(image, symbol))
+			value -= target->regions[0].delta;
+
+		if (!_AddEntry(symbol, targetIndex, value)) {
+			// out of memory -- don't write an incomplete cache
+			fDirty = false;
+			return;
+		}
+		record.entry_count++;
+	}
+}
+
+
+/*!	Writes the recorded lookup results to the cache file, unless they have
+	been loaded from there in the first place.
+*/
+status_t
+RelocationCache::Store()
+{
+	if (!fDirty)
+		return B_OK;
+
+	fDirty = false;
+
+	// make sure the cache directory exists
+	char directory[B_PATH_NAME_LENGTH];
+	status_t status = __find_directory(B_USER_CACHE_DIRECTORY, -1, true,
+		directory, sizeof(directory));
+	if (status != B_OK)
+		return status;
+
+	strlcat(directory, "/", sizeof(directory));
+	strlcat(directory, kCacheSubDirectory, sizeof(directory));
+	status = _kern_create_dir(-1, directory, 0755);
+	if (status != B_OK && status != B_FILE_EXISTS)
+		return status;
+
+	// Write to a temporary file first, so that concurrently launched
+	// instances never see an incomplete cache.
+	char tempPath[B_PATH_NAME_LENGTH];
+	snprintf(tempPath, sizeof(tempPath), "%s.%" B_PRId32, fPath,
+		find_thread(NULL));
+
+	int fd = _kern_open(-1, tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return fd;
+
+	relocation_cache_header header;
+	header.magic = kCacheMagic;
+	header.version = kCacheVersion;
+	header.image_count = fImageCount;
+	header.entry_count = fEntryCount;
+
+	size_t imagesSize = sizeof(relocation_cache_image) * fImageCount;
+	size_t entriesSize = sizeof(relocation_cache_entry) * fEntryCount;
+
+	status = B_OK;
+	if (_kern_write(fd, 0, &header, sizeof(header)) != sizeof(header)
+		|| _kern_write(fd, sizeof(header), fImageRecords, imagesSize)
+			!= (ssize_t)imagesSize
+		|| (entriesSize > 0
+			&& _kern_write(fd, sizeof(header) + imagesSize, fEntries,
+				entriesSize) != (ssize_t)entriesSize)) {
+		status = B_IO_ERROR;
+	}
+
+	_kern_close(fd);
+
+	if (status == B_OK)
+		status = _kern_rename(-1, tempPath, -1, fPath);
+	if (status != B_OK)
+		_kern_unlink(-1, tempPath);
+
+	return status;
+}
+
+
+status_t
+RelocationCache::_Load()
+{
+	int fd = _kern_open(-1, fPath, O_RDONLY, 0);
+	if (fd < 0)
+		return fd;
+
+	status_t status = B_OK;
+	relocation_cache_header header;
+	relocation_cache_image* images = NULL;
+	size_t imagesSize = 0;
+	size_t entriesSize = 0;
+
+	if (_kern_read(fd, 0, &header, sizeof(header)) != sizeof(header)
+		|| header.magic != kCacheMagic || header.version != kCacheVersion
+		|| header.image_count != fImageCount
+		|| header.entry_count > kMaxCacheEntries) {
+		status = B_BAD_DATA;
+	}
+
+	if (status == B_OK) {
+		imagesSize = sizeof(relocation_cache_image) * fImageCount;
+		entriesSize = sizeof(relocation_cache_entry) * header.entry_count;
+		images = (relocation_cache_image*)malloc(imagesSize);
+		fEntries = (relocation_cache_entry*)malloc(entriesSize + 1);
+		if (images == NULL || fEntries == NULL)
+			status = B_NO_MEMORY;
+	}
+
+	if (status == B_OK
+		&& (_kern_read(fd, sizeof(header), images, imagesSize)
+				!= (ssize_t)imagesSize
+			|| _kern_read(fd, sizeof(header) + imagesSize, fEntries,
+				entriesSize) != (ssize_t)entriesSize)) {
+		status = B_BAD_DATA;
+	}
+
+	_kern_close(fd);
+
+	// The key is just a hash, so make sure the images actually match. Take
+	// over the entry ranges from the file.
+	for (uint32 i = 0; status == B_OK && i < fImageCount; i++) {
+		relocation_cache_image& record = fImageRecords[i];
+		const relocation_cache_image& cached = images[i];
+		if (record.device != cached.device || record.node != cached.node
+			|| record.size != cached.size
+			|| record.modification_time != cached.modification_time
+			|| cached.first_entry > header.entry_count
+			|| cached.entry_count > header.entry_count - cached.first_entry) {
+			status = B_BAD_DATA;
+			break;
+		}
+
+		record.first_entry = cached.first_entry;
+		record.entry_count = cached.entry_count;
+	}
+
+	free(images);
+
+	if (status != B_OK) {
+		free(fEntries);
+		fEntries = NULL;
+		return status;
+	}
+
+	fEntryCount = header.entry_count;
+	fEntryCapacity = header.entry_count;
+	return B_OK;
+}
+
+
+int32
+RelocationCache::_IndexOf(image_t* image) const
+{
+	for (uint32 i = 0; i < fImageCount; i++) {
+		if (fImages[i] == image)
+			return i;
+	}
+
+	return -1;
+}
+
+
+bool
+RelocationCache::_AddEntry(uint32 symbol, int32 image, uint64 value)
+{
+	if (fEntryCount == fEntryCapacity) {
+		uint32 newCapacity = fEntryCapacity == 0 ? 1024 : fEntryCapacity * 2;
+		if (newCapacity > kMaxCacheEntries)
+			return false;
+
+		relocation_cache_entry* entries = (relocation_cache_entry*)realloc(
+			fEntries, sizeof(relocation_cache_entry) * newCapacity);
+		if (entries == NULL)
+			return false;
+
+		fEntries = entries;
+		fEntryCapacity = newCapacity;
+	}
+
+	relocation_cache_entry& entry = fEntries[fEntryCount++];
+	entry.symbol = symbol;
+	entry.image = image;
+	entry.value = value;
+	return true;
+}
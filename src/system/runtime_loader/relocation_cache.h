@@ -0,0 +1,49 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef RELOCATION_CACHE_H
+#define RELOCATION_CACHE_H
+
+
+#include "runtime_loader_private.h"
+
+
+struct SymbolLookupCache;
+struct relocation_cache_image;
+struct relocation_cache_entry;
+
+
+class RelocationCache {
+public:
+								RelocationCache();
+								~RelocationCache();
+
+			status_t			Init();
+
+			void				Prefill(image_t* image,
+									SymbolLookupCache* cache);
+			void				Update(image_t* image,
+									const SymbolLookupCache* cache);
+			status_t			Store();
+
+private:
+			status_t			_Load();
+			int32				_IndexOf(image_t* image) const;
+			bool				_AddEntry(uint32 symbol, int32 image,
+									uint64 value);
+
+private:
+			char				fPath[B_PATH_NAME_LENGTH];
+			image_t**			fImages;
+			relocation_cache_image* fImageRecords;
+			uint32				fImageCount;
+			relocation_cache_entry* fEntries;
+			uint32				fEntryCount;
+			uint32				fEntryCapacity;
+			bool				fLoaded;
+			bool				fDirty;
+};
+
+
+#endif	// RELOCATION_CACHE_H
@@ -47,6 +47,9 @@ class Inode {
 		bool IsDirectory() const { return true; }
 		bool IsIndex() const { return is_index(Mode()); }
 
+		void WriteLockInTransaction(Transaction&) {}
+			// the test keeps the inode write locked all the time
+
 		void AssertReadLocked() { ASSERT_READ_LOCKED_RW_LOCK(&fLock); }
 		void AssertWriteLocked() { ASSERT_WRITE_LOCKED_RW_LOCK(&fLock); }
 
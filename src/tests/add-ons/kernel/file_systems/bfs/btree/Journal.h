@@ -77,6 +77,11 @@ class Transaction {
 			return B_OK;
 		}
 
+		bool IsTooLarge() const
+		{
+			return false;
+		}
+
 		void
 		AddListener(TransactionListener* listener)
 		{
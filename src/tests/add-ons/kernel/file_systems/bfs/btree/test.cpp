@@ -42,7 +42,7 @@ key* gKeys;
 int32 gNum = DEFAULT_NUM_KEYS;
 int32 gType = DEFAULT_KEY_TYPE;
 int32 gTreeCount = 0;
-bool gVerbose, gExcessive;
+bool gVerbose, gExcessive, gBulk;
 int32 gIterations = DEFAULT_ITERATIONS;
 int32 gHard = 1;
 Volume* gVolume;
@@ -439,6 +439,36 @@ addAllKeys(Transaction& transaction, BPlusTree* tree)
 }
 
 
+void
+bulkLoadKeys(BPlusTree* tree)
+{
+	printf("*** Building the tree from all keys...\n");
+
+	TreeBuilder builder(tree);
+	for (int32 i = 0; i < gNum; i++) {
+		// add every tenth key twice to get some duplicates as well
+		int32 count = i % 10 == 0 ? 2 : 1;
+		for (int32 j = 0; j < count; j++) {
+			status_t status = builder.Add((uint8*)gKeys[i].data,
+				gKeys[i].length, gKeys[i].value);
+			if (status != B_OK) {
+				printf("TreeBuilder::Add() returned: %s\n", strerror(status));
+				bailOutWithKey(gKeys[i].data, gKeys[i].length);
+			}
+			gKeys[i].in++;
+			gTreeCount++;
+		}
+	}
+
+	status_t status = builder.Finish();
+	if (status != B_OK) {
+		printf("TreeBuilder::Finish() returned: %s\n", strerror(status));
+		bailOut();
+	}
+	checkTree(tree);
+}
+
+
 void
 removeAllKeys(Transaction& transaction, BPlusTree* tree)
 {
@@ -620,7 +650,7 @@ usage(char* program)
 {
 	if (strrchr(program, '/'))
 		program = strrchr(program, '/') + 1;
-	fprintf(stderr, "usage: %s [-veh] [-t type] [-n keys] [-i iterations] "
+	fprintf(stderr, "usage: %s [-vbeh] [-t type] [-n keys] [-i iterations] "
 			"[-h times] [-r seed]\n"
 		"BFS B+Tree torture test\n"
 		"\t-t\ttype is one of string, int32, uint32, int64, uint64, float,\n"
@@ -630,6 +660,9 @@ usage(char* program)
 		"\t-i\titerations is the number of the test cycles, defaults to %d.\n"
 		"\t-r\tthe seed for the random function, defaults to %ld.\n"
 		"\t-h\tremoves the keys and start over again for x times.\n"
+		"\t-b\tbuild the tree with a TreeBuilder instead of inserting all "
+			"keys\n"
+		"\t\tone by one.\n"
 		"\t-e\texcessive validity tests: tree contents will be tested after "
 			"every operation\n"
 		"\t-v\tfor verbose output.\n",
@@ -654,6 +687,9 @@ main(int argc, char** argv)
 					case 'v':
 						gVerbose = true;
 						break;
+					case 'b':
+						gBulk = true;
+						break;
 					case 'e':
 						gExcessive = true;
 						break;
@@ -750,7 +786,10 @@ main(int argc, char** argv)
 		dumpKeys();
 
 	for (int32 j = 0; j < gHard; j++) {
-		addAllKeys(transaction, &tree);
+		if (gBulk)
+			bulkLoadKeys(&tree);
+		else
+			addAllKeys(transaction, &tree);
 
 		// Run the tests (they will exit the app, if an error occurs)
 
@@ -0,0 +1,290 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+/*!	Checks the BFS free extent index against a block bitmap, and compares
+	the time it takes to find free ranges in a fragmented allocation group
+	with the index, and by scanning the bitmap like the BlockAllocator does
+	without it.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include "FreeExtentIndex.h"
+
+
+static const int32 kNumBits = 65536;
+	// the size of an allocation group with 8 KB of bitmap
+static const int32 kIterations = 20000;
+
+static uint8 sBitmap[kNumBits / 8];
+static FreeExtentIndex sIndex;
+
+
+static bool
+is_used(int32 bit)
+{
+	return (sBitmap[bit >> 3] & (1 << (bit & 7))) != 0;
+}
+
+
+static void
+allocate(int32 start, int32 length)
+{
+	for (int32 bit = start; bit < start + length; bit++)
+		sBitmap[bit >> 3] |= 1 << (bit & 7);
+
+	sIndex.Remove(start, length);
+}
+
+
+static void
+free_run(int32 start, int32 length)
+{
+	for (int32 bit = start; bit < start + length; bit++)
+		sBitmap[bit >> 3] &= ~(1 << (bit & 7));
+
+	sIndex.Add(start, length);
+}
+
+
+/*!	Finds a free range the way BlockAllocator::AllocateBlocks() does if it
+	has to look at the bitmap: the first range that is large enough, or
+	the largest one.
+*/
+static bool
+scan_bitmap(int32 wanted, int32& _start, int32& _length)
+{
+	int32 bestStart = -1;
+	int32 bestLength = 0;
+	int32 currentStart = 0;
+	int32 currentLength = 0;
+
+	for (int32 bit = 0; bit < kNumBits; bit++) {
+		if (!is_used(bit)) {
+			if (currentLength++ == 0)
+				currentStart = bit;
+			if (currentLength >= wanted) {
+				_start = currentStart;
+				_length = currentLength;
+				return true;
+			}
+		} else {
+			if (currentLength > bestLength) {
+				bestStart = currentStart;
+				bestLength = currentLength;
+			}
+			currentLength = 0;
+		}
+	}
+
+	if (currentLength > bestLength) {
+		bestStart = currentStart;
+		bestLength = currentLength;
+	}
+
+	_start = bestStart;
+	_length = bestLength;
+	return bestLength > 0;
+}
+
+
+static void
+check_index()
+{
+	if (!sIndex.IsValid()) {
+		fprintf(stderr, "index is invalid!\n");
+		exit(1);
+	}
+
+	int32 count = 0;
+	int32 largest = 0;
+	int32 bit = 0;
+	while (bit < kNumBits) {
+		if (is_used(bit)) {
+			bit++;
+			continue;
+		}
+
+		int32 start = bit;
+		while (bit < kNumBits && !is_used(bit))
+			bit++;
+
+		int32 foundStart;
+		int32 foundLength;
+		if (!sIndex.FindRun(start, bit - start, foundStart, foundLength)
+			|| foundStart != start || foundLength != bit - start) {
+			fprintf(stderr, "free range %" B_PRId32 ", %" B_PRId32 " is "
+				"not in the index!\n", start, bit - start);
+			exit(1);
+		}
+
+		if (bit - start > largest)
+			largest = bit - start;
+		count++;
+	}
+
+	if (count != sIndex.CountExtents() || largest != sIndex.LargestExtent()) {
+		fprintf(stderr, "index has %" B_PRId32 " extents (largest %" B_PRId32
+			"), bitmap %" B_PRId32 " (largest %" B_PRId32 ")\n",
+			sIndex.CountExtents(), sIndex.LargestExtent(), count, largest);
+		exit(1);
+	}
+}
+
+
+/*!	Checks that indices sharing a budget become invalid once it is used up,
+	and give back what they used when they are emptied.
+*/
+static void
+check_budget()
+{
+	FreeExtentBudget budget(4);
+	FreeExtentIndex first;
+	FreeExtentIndex second;
+	first.SetBudget(&budget);
+	second.SetBudget(&budget);
+
+	// ranges that don't touch each other need an extent each
+	for (int32 i = 0; i < 3; i++)
+		first.Add(i * 2, 1);
+	second.Add(0, 1);
+
+	if (!first.IsValid() || !second.IsValid()
+		|| budget.CountExtents() != 4) {
+		fprintf(stderr, "budget: %" B_PRId32 " extents used, expected 4\n",
+			budget.CountExtents());
+		exit(1);
+	}
+
+	second.Add(2, 1);
+	if (second.IsValid() || budget.CountExtents() != 3) {
+		fprintf(stderr, "budget: index is still valid with %" B_PRId32
+			" extents used\n", budget.CountExtents());
+		exit(1);
+	}
+
+	first.MakeEmpty();
+	if (budget.CountExtents() != 0) {
+		fprintf(stderr, "budget: %" B_PRId32 " extents still used\n",
+			budget.CountExtents());
+		exit(1);
+	}
+}
+
+
+/*!	Fills the bitmap with small runs, and then frees about half of them
+	again, leaving lots of small free ranges behind.
+*/
+static void
+fragment()
+{
+	sIndex.MakeEmpty();
+	free_run(0, kNumBits);
+
+	int32 bit = 0;
+	while (bit < kNumBits) {
+		int32 length = 1 + rand() % 16;
+		if (bit + length > kNumBits)
+			length = kNumBits - bit;
+
+		allocate(bit, length);
+		if (rand() % 2 == 0)
+			free_run(bit, length);
+
+		bit += length;
+	}
+}
+
+
+static void
+benchmark(const char* name, bool useIndex)
+{
+	srand(42);
+	fragment();
+
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < kIterations; i++) {
+		int32 wanted = 16 + rand() % 112;
+		int32 foundStart;
+		int32 foundLength;
+		bool found = useIndex
+			? sIndex.FindRun(0, wanted, foundStart, foundLength)
+			: scan_bitmap(wanted, foundStart, foundLength);
+		if (!found)
+			break;
+
+		if (foundLength > wanted)
+			foundLength = wanted;
+
+		// keep the fragmentation level stable
+		allocate(foundStart, foundLength);
+		free_run(foundStart, foundLength);
+	}
+
+	bigtime_t time = system_time() - start;
+	printf("%-8s %" B_PRId32 " allocations in %" B_PRId64 " usecs (%"
+		B_PRId32 " free extents)\n", name, kIterations, time,
+		sIndex.CountExtents());
+}
+
+
+int
+main(int argc, char** argv)
+{
+	// correctness
+	srand(1);
+	fragment();
+	check_index();
+
+	for (int32 i = 0; i < kIterations; i++) {
+		int32 wanted = 1 + rand() % 64;
+		int32 foundStart;
+		int32 foundLength;
+		if (rand() % 3 != 0
+			&& sIndex.FindRun(rand() % kNumBits, wanted, foundStart,
+				foundLength)) {
+			if (foundLength > wanted)
+				foundLength = wanted;
+			for (int32 bit = foundStart; bit < foundStart + foundLength;
+					bit++) {
+				if (is_used(bit)) {
+					fprintf(stderr, "index returned used block %" B_PRId32
+						"!\n", bit);
+					return 1;
+				}
+			}
+			allocate(foundStart, foundLength);
+		} else {
+			// free a used range
+			int32 start = rand() % kNumBits;
+			int32 length = 0;
+			while (start + length < kNumBits && length < wanted
+				&& is_used(start + length))
+				length++;
+			free_run(start, length);
+		}
+
+		if (i % 1000 == 0)
+			check_index();
+	}
+	check_index();
+	printf("index matches the bitmap\n");
+
+	check_budget();
+	printf("budget is shared between the indices\n");
+
+	// performance
+	benchmark("bitmap:", false);
+	benchmark("index:", true);
+
+	return 0;
+}
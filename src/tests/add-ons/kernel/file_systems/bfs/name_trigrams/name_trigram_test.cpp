@@ -0,0 +1,145 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+/*!	Checks that every name that matches a query pattern contains all the
+	trigrams BFS looks up in the name trigram index for that pattern.
+*/
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <file_systems/QueryParserUtils.h>
+
+#include "NameTrigrams.h"
+
+
+using namespace QueryParser;
+
+
+static const int32 kIterations = 100000;
+static const char* kCharacters = "abcABC.x-";
+
+
+static char
+random_char()
+{
+	return kCharacters[rand() % strlen(kCharacters)];
+}
+
+
+/*!	Creates a random pattern, and a name that matches it most of the time.
+*/
+static void
+create_pattern(char* pattern, char* name)
+{
+	int32 parts = 1 + rand() % 8;
+	for (int32 i = 0; i < parts; i++) {
+		char c = random_char();
+		switch (rand() % 8) {
+			case 0:
+				*pattern++ = '*';
+				for (int32 count = rand() % 3; count > 0; count--)
+					*name++ = random_char();
+				break;
+			case 1:
+				*pattern++ = '?';
+				*name++ = c;
+				break;
+			case 2:
+				// a set that only matches the character in any case
+				pattern += sprintf(pattern, "[%c%c]", tolower(c),
+					toupper(c));
+				*name++ = rand() % 2 == 0 ? tolower(c) : toupper(c);
+				break;
+			case 3:
+				pattern += sprintf(pattern, "[%c-c]", 'a' + rand() % 3);
+				*name++ = 'c';
+				break;
+			case 4:
+				pattern += sprintf(pattern, "\\%c", c);
+				*name++ = c;
+				break;
+			default:
+				*pattern++ = c;
+				*name++ = c;
+				break;
+		}
+	}
+
+	*pattern = '\0';
+	*name = '\0';
+}
+
+
+static bool
+contains(const NameTrigrams& trigrams, uint32 trigram)
+{
+	for (int32 i = 0; i < trigrams.CountTrigrams(); i++) {
+		if (trigrams.TrigramAt(i) == trigram)
+			return true;
+	}
+	return false;
+}
+
+
+static void
+check(const char* pattern, const char* name)
+{
+	NameTrigrams patternTrigrams;
+	patternTrigrams.SetToPattern(pattern);
+	NameTrigrams nameTrigrams;
+	nameTrigrams.SetToName(name);
+
+	for (int32 i = 0; i < patternTrigrams.CountTrigrams(); i++) {
+		if (!contains(nameTrigrams, patternTrigrams.TrigramAt(i))) {
+			uint8 key[kTrigramLength];
+			NameTrigrams::GetKey(patternTrigrams.TrigramAt(i), key);
+			fprintf(stderr, "\"%s\" matches \"%s\", but lacks trigram "
+				"\"%.3s\"!\n", name, pattern, (char*)key);
+			exit(1);
+		}
+	}
+}
+
+
+int
+main(int argc, char** argv)
+{
+	NameTrigrams trigrams;
+	trigrams.SetToPattern("*[Hh][Oo][Ww]*");
+	if (trigrams.CountTrigrams() != 1 || trigrams.TrigramAt(0) != 0x686f77) {
+		fprintf(stderr, "pattern trigrams are wrong!\n");
+		return 1;
+	}
+
+	trigrams.SetToName("AbCabc");
+	if (trigrams.CountTrigrams() != 3) {
+		fprintf(stderr, "name trigrams are not unique!\n");
+		return 1;
+	}
+
+	srand(42);
+
+	int32 matches = 0;
+	for (int32 i = 0; i < kIterations; i++) {
+		char pattern[256];
+		char name[256];
+		create_pattern(pattern, name);
+
+		if (isValidPattern(pattern) != B_OK
+			|| matchString(pattern, name) != MATCH_OK)
+			continue;
+
+		check(pattern, name);
+		matches++;
+	}
+
+	printf("%" B_PRId32 " matching names checked\n", matches);
+	return 0;
+}
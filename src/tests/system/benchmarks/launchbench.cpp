@@ -0,0 +1,160 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how long it takes to launch a program, with lazy PLT binding
+	and with immediate binding (LD_BIND_NOW).
+	The program to launch and its arguments are given on the command line;
+	it is looked up in the PATH. Without a program, the benchmark launches
+	itself; since it links against libbe and libstdc++, most of the time is
+	spent loading and relocating those.
+	A program is timed until it exits. With "-a", it is timed until it has
+	registered with the roster instead, that is until it has constructed
+	its BApplication; it is then asked to quit. This is how the bundled
+	applications, which don't exit on their own, can be measured.
+*/
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <Application.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <Roster.h>
+
+
+static const int kDefaultIterations = 50;
+
+
+static void
+usage(const char* programPath)
+{
+	fprintf(stderr, "usage: %s [-n <iterations>] [-a] [<program> [<args>]]\n"
+		"Measures the launch time of <program>, with lazy and with immediate\n"
+		"binding. Without <program>, %s launches itself.\n"
+		"  -n  The number of launches to average (default: %d)\n"
+		"  -a  <program> is an application: it is timed until its\n"
+		"      BApplication is constructed, and then asked to quit\n",
+		programPath, programPath, kDefaultIterations);
+}
+
+
+/*!	Waits until the application \a child has registered with the roster.
+	Returns \c false if it exited before that.
+*/
+static bool
+wait_for_application(pid_t child)
+{
+	app_info info;
+	while (be_roster->GetRunningAppInfo(child, &info) != B_OK) {
+		if (waitpid(child, NULL, WNOHANG) == child)
+			return false;
+
+		snooze(500);
+	}
+
+	return true;
+}
+
+
+static bigtime_t
+launch(char** argv, int iterations, bool application)
+{
+	bigtime_t totalTime = 0;
+
+	for (int i = 0; i < iterations; i++) {
+		bigtime_t startTime = system_time();
+
+		pid_t child = fork();
+		if (child == 0) {
+			execvp(argv[0], argv);
+			fprintf(stderr, "Failed to execute \"%s\": %s\n", argv[0],
+				strerror(errno));
+			_exit(1);
+		}
+		if (child < 0) {
+			fprintf(stderr, "fork() failed: %s\n", strerror(errno));
+			exit(1);
+		}
+
+		if (application) {
+			if (!wait_for_application(child)) {
+				fprintf(stderr, "\"%s\" exited without registering as an "
+					"application\n", argv[0]);
+				exit(1);
+			}
+			totalTime += system_time() - startTime;
+
+			BMessenger(NULL, child).SendMessage(B_QUIT_REQUESTED);
+		}
+
+		int status;
+		waitpid(child, &status, 0);
+
+		if (!application)
+			totalTime += system_time() - startTime;
+	}
+
+	return totalTime / iterations;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc == 2 && strcmp(argv[1], "--child") == 0) {
+		// Make sure libbe is really needed, so that it gets loaded.
+		if (be_app != NULL)
+			printf("%s\n", be_app->Name());
+		return 0;
+	}
+
+	char* programPath = argv[0];
+	int iterations = kDefaultIterations;
+	bool application = false;
+	while (argc > 1 && argv[1][0] == '-') {
+		if (strcmp(argv[1], "-n") == 0 && argc > 2) {
+			iterations = atoi(argv[2]);
+			argc--;
+			argv++;
+		} else if (strcmp(argv[1], "-a") == 0)
+			application = true;
+		else {
+			usage(programPath);
+			return strcmp(argv[1], "--help") == 0 ? 0 : 1;
+		}
+
+		argc--;
+		argv++;
+	}
+
+	if (iterations < 1 || (application && argc < 2)) {
+		usage(programPath);
+		return 1;
+	}
+
+	char* childArgs[] = { programPath, (char*)"--child", NULL };
+	char** programArgs = argc > 1 ? argv + 1 : childArgs;
+
+	// one untimed launch to get everything into the caches
+	setenv("LD_BIND_NOW", "1", 1);
+	launch(programArgs, 1, application);
+
+	bigtime_t bindNowTime = launch(programArgs, iterations, application);
+
+	unsetenv("LD_BIND_NOW");
+	bigtime_t lazyTime = launch(programArgs, iterations, application);
+
+	printf("%s: %d launches\n", programArgs[0], iterations);
+	printf("  immediate binding: %8" B_PRIdBIGTIME " us/launch\n",
+		bindNowTime);
+	printf("  lazy binding:      %8" B_PRIdBIGTIME " us/launch\n", lazyTime);
+	return 0;
+}
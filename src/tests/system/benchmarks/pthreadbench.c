@@ -0,0 +1,194 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*
+ * Measures pthread mutex and condition variable performance under
+ * contention: a number of threads hammering on a single mutex, and a number
+ * of threads being woken up by pthread_cond_broadcast() over and over.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#define MAX_THREADS			64
+#define DEFAULT_THREADS		8
+#define MUTEX_ITERATIONS	200000
+#define BROADCAST_ROUNDS	5000
+
+static pthread_mutex_t sMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sCondition = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sDoneCondition = PTHREAD_COND_INITIALIZER;
+
+static int sThreadCount = DEFAULT_THREADS;
+static long sCounter;
+static int sGeneration;
+static int sDone;
+static int sQuit;
+
+
+static void
+usage(void)
+{
+	printf("pthreadbench [-h] [-t <threads>]\n");
+	exit(1);
+}
+
+
+static bigtime_t
+now(void)
+{
+	struct timeval time;
+	gettimeofday(&time, NULL);
+	return time.tv_sec * 1000000LL + time.tv_usec;
+}
+
+
+static void*
+mutex_thread(void* data)
+{
+	int i;
+	for (i = 0; i < MUTEX_ITERATIONS; i++) {
+		pthread_mutex_lock(&sMutex);
+		sCounter++;
+		pthread_mutex_unlock(&sMutex);
+	}
+
+	return NULL;
+}
+
+
+static void*
+broadcast_thread(void* data)
+{
+	int generation = 0;
+
+	pthread_mutex_lock(&sMutex);
+	while (1) {
+		while (sGeneration == generation && !sQuit)
+			pthread_cond_wait(&sCondition, &sMutex);
+		if (sQuit)
+			break;
+
+		generation = sGeneration;
+		if (++sDone == sThreadCount)
+			pthread_cond_signal(&sDoneCondition);
+	}
+	pthread_mutex_unlock(&sMutex);
+
+	return NULL;
+}
+
+
+static void
+run_threads(void* (*function)(void*), pthread_t* threads)
+{
+	int i;
+	for (i = 0; i < sThreadCount; i++) {
+		if (pthread_create(&threads[i], NULL, function, NULL) != 0) {
+			fprintf(stderr, "pthreadbench: could not create thread\n");
+			exit(1);
+		}
+	}
+}
+
+
+static void
+wait_for_threads(pthread_t* threads)
+{
+	int i;
+	for (i = 0; i < sThreadCount; i++)
+		pthread_join(threads[i], NULL);
+}
+
+
+static void
+test_mutex(void)
+{
+	pthread_t threads[MAX_THREADS];
+	bigtime_t startTime = now();
+	bigtime_t elapsed;
+	long operations = (long)sThreadCount * MUTEX_ITERATIONS;
+
+	sCounter = 0;
+	run_threads(&mutex_thread, threads);
+	wait_for_threads(threads);
+	elapsed = now() - startTime;
+
+	if (sCounter != operations)
+		fprintf(stderr, "pthreadbench: counter is off: %ld\n", sCounter);
+
+	printf("mutex:     %d threads, %ld lock/unlock pairs in %" B_PRId64 " us, "
+		"%" B_PRId64 " ns each\n", sThreadCount, operations, elapsed,
+		elapsed * 1000 / operations);
+}
+
+
+static void
+test_broadcast(void)
+{
+	pthread_t threads[MAX_THREADS];
+	bigtime_t startTime;
+	bigtime_t elapsed;
+	int round;
+
+	sGeneration = 0;
+	sQuit = 0;
+	run_threads(&broadcast_thread, threads);
+
+	startTime = now();
+	for (round = 0; round < BROADCAST_ROUNDS; round++) {
+		pthread_mutex_lock(&sMutex);
+		sDone = 0;
+		sGeneration++;
+		pthread_cond_broadcast(&sCondition);
+
+		// wait until all threads have seen the new generation
+		while (sDone < sThreadCount)
+			pthread_cond_wait(&sDoneCondition, &sMutex);
+		pthread_mutex_unlock(&sMutex);
+	}
+	elapsed = now() - startTime;
+
+	pthread_mutex_lock(&sMutex);
+	sQuit = 1;
+	pthread_cond_broadcast(&sCondition);
+	pthread_mutex_unlock(&sMutex);
+	wait_for_threads(threads);
+
+	printf("broadcast: %d threads, %d rounds in %" B_PRId64 " us, %" B_PRId64
+		" us per round\n", sThreadCount, BROADCAST_ROUNDS, elapsed,
+		elapsed / BROADCAST_ROUNDS);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+	int option;
+	while ((option = getopt(argc, argv, "ht:")) != -1) {
+		switch (option) {
+			case 't':
+				sThreadCount = atoi(optarg);
+				if (sThreadCount < 1 || sThreadCount > MAX_THREADS) {
+					fprintf(stderr, "pthreadbench: thread count must be "
+						"between 1 and %d\n", MAX_THREADS);
+					return 1;
+				}
+				break;
+			default:
+				usage();
+		}
+	}
+
+	test_mutex();
+	test_broadcast();
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <OS.h>
+
+
+static const int32 kIterations = 10000;
+static const int32 kMaxThreads = 64;
+
+static const char* const kPaths[] = {
+	"/boot/develop/headers/posix/sys/stat.h",
+	"/boot/develop/headers/posix/stdio.h",
+	"/boot/develop/headers/os/kernel/OS.h",
+	"/boot/system/lib/libroot.so",
+	// missing entries, served by negative entry cache entries
+	"/boot/develop/headers/posix/sys/does_not_exist.h",
+	"/boot/develop/headers/os/kernel/does_not_exist.h",
+	NULL
+};
+
+
+static status_t
+lstat_thread(void* /*data*/)
+{
+	for (int32 i = 0; i < kIterations; i++) {
+		for (int32 j = 0; kPaths[j] != NULL; j++) {
+			struct stat st;
+			lstat(kPaths[j], &st);
+		}
+	}
+
+	return B_OK;
+}
+
+
+static void
+time_parallel_lstat(int32 threadCount)
+{
+	printf("%3" B_PRId32 " threads ...", threadCount);
+	fflush(stdout);
+
+	thread_id threads[kMaxThreads];
+	bigtime_t startTime = system_time();
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&lstat_thread, "lstat", B_NORMAL_PRIORITY,
+			NULL);
+		resume_thread(threads[i]);
+	}
+
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t result;
+		wait_for_thread(threads[i], &result);
+	}
+
+	bigtime_t totalTime = system_time() - startTime;
+
+	int32 pathCount = 0;
+	while (kPaths[pathCount] != NULL)
+		pathCount++;
+
+	double calls = (double)threadCount * kIterations * pathCount;
+	printf(" %8.3f us/call, %10.0f calls/s\n",
+		(double)totalTime * threadCount / calls, calls * 1000000 / totalTime);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+
+	int32 maxThreads = argc > 1 ? atoi(argv[1]) : info.cpu_count * 2;
+	if (maxThreads < 1)
+		maxThreads = 1;
+	if (maxThreads > kMaxThreads)
+		maxThreads = kMaxThreads;
+
+	// warm up the caches
+	lstat_thread(NULL);
+
+	for (int32 threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+		time_parallel_lstat(threadCount);
+
+	return 0;
+}
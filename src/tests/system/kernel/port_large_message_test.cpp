@@ -0,0 +1,165 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+#define MESSAGE_COUNT	1000
+#define MESSAGE_SIZE	(128 * 1024)
+
+
+struct test_run {
+	const char*	name;
+	bool		query_size_first;
+		// read like BLooper and LinkReceiver: wait in port_buffer_size(),
+		// then read the message
+};
+
+
+static const test_run kTestRuns[] = {
+	{ "read_port()", false },
+	{ "port_buffer_size() + read_port()", true }
+};
+
+
+struct reader_args {
+	port_id		port;
+	bool		query_size_first;
+	bigtime_t	read_times[MESSAGE_COUNT];
+		// when the reader got each message
+};
+
+
+static status_t
+read_thread(void* _data)
+{
+	reader_args* args = (reader_args*)_data;
+	uint8* buffer = (uint8*)malloc(MESSAGE_SIZE);
+
+	for (int32 i = 0; i < MESSAGE_COUNT; i++) {
+		if (args->query_size_first) {
+			ssize_t size = port_buffer_size(args->port);
+			if (size != MESSAGE_SIZE) {
+				printf("message %" B_PRId32 ": unexpected buffer size %"
+					B_PRIdSSIZE "\n", i, size);
+				free(buffer);
+				return B_ERROR;
+			}
+		}
+
+		int32 code;
+		ssize_t bytes = read_port(args->port, &code, buffer, MESSAGE_SIZE);
+		if (bytes != MESSAGE_SIZE || code != i) {
+			printf("message %" B_PRId32 ": unexpected size %" B_PRIdSSIZE
+				" or code %" B_PRId32 "\n", i, bytes, code);
+			free(buffer);
+			return B_ERROR;
+		}
+
+		args->read_times[i] = system_time();
+
+		// check the contents
+		for (ssize_t j = 0; j < bytes; j += 4096) {
+			if (buffer[j] != (uint8)(i + j / 4096)) {
+				printf("message %" B_PRId32 ": corrupted at offset %"
+					B_PRIdSSIZE "\n", i, j);
+				free(buffer);
+				return B_ERROR;
+			}
+		}
+	}
+
+	free(buffer);
+	return B_OK;
+}
+
+
+/*!	Waits until the reader blocks on the empty port. A message written then
+	is copied directly into the buffer of a reader waiting in read_port().
+*/
+static void
+wait_for_blocked_reader(thread_id thread, port_id port)
+{
+	while (true) {
+		thread_info info;
+		if (get_thread_info(thread, &info) != B_OK)
+			return;
+		if (info.state == B_THREAD_WAITING && port_count(port) == 0)
+			return;
+
+		snooze(10);
+	}
+}
+
+
+static bool
+run_test(const test_run& run, uint8* buffer)
+{
+	reader_args args;
+	args.port = create_port(16, "large message test");
+	args.query_size_first = run.query_size_first;
+
+	thread_id thread = spawn_thread(read_thread, "read thread",
+		B_NORMAL_PRIORITY, &args);
+	resume_thread(thread);
+
+	bigtime_t writeTimes[MESSAGE_COUNT];
+
+	for (int32 i = 0; i < MESSAGE_COUNT; i++) {
+		for (size_t j = 0; j < MESSAGE_SIZE; j += 4096)
+			buffer[j] = (uint8)(i + j / 4096);
+
+		wait_for_blocked_reader(thread, args.port);
+
+		writeTimes[i] = system_time();
+		status_t status = write_port(args.port, i, buffer, MESSAGE_SIZE);
+		if (status != B_OK) {
+			printf("writing message %" B_PRId32 " failed: %s\n", i,
+				strerror(status));
+			kill_thread(thread);
+			delete_port(args.port);
+			return false;
+		}
+	}
+
+	status_t result;
+	wait_for_thread(thread, &result);
+	delete_port(args.port);
+
+	// Only the time from writing a message until the reader got it counts,
+	// not the time spent waiting for the reader to block.
+	bigtime_t totalTime = 0;
+	for (int32 i = 0; i < MESSAGE_COUNT; i++)
+		totalTime += args.read_times[i] - writeTimes[i];
+
+	printf("%s: %s: %d messages of %d bytes in %" B_PRIdBIGTIME
+		" us (%g MB/s)\n",
+		result == B_OK ? "passed" : "FAILED", run.name, MESSAGE_COUNT,
+		MESSAGE_SIZE, totalTime,
+		(double)MESSAGE_COUNT * MESSAGE_SIZE / totalTime);
+
+	return result == B_OK;
+}
+
+
+int
+main()
+{
+	uint8* buffer = (uint8*)malloc(MESSAGE_SIZE);
+	bool passed = true;
+
+	for (size_t i = 0; i < sizeof(kTestRuns) / sizeof(kTestRuns[0]); i++) {
+		if (!run_test(kTestRuns[i], buffer))
+			passed = false;
+	}
+
+	free(buffer);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+#define MAX_THREADS		64
+#define ITERATIONS		20000
+
+
+enum {
+	TEST_WRITE_READ = 0,
+	TEST_CREATE_DELETE,
+	TEST_FIND
+};
+
+struct test_info {
+	int32		test;
+	int32		index;
+	status_t	result;
+};
+
+
+static status_t
+test_thread(void* _data)
+{
+	test_info* info = (test_info*)_data;
+	char name[B_OS_NAME_LENGTH];
+	snprintf(name, sizeof(name), "scaling test %ld", info->index);
+
+	port_id port = create_port(1, name);
+	if (port < 0)
+		return info->result = port;
+
+	for (int32 i = 0; i < ITERATIONS; i++) {
+		switch (info->test) {
+			case TEST_WRITE_READ:
+			{
+				int32 code;
+				char buffer[64];
+				if (write_port(port, i, buffer, sizeof(buffer)) != B_OK
+					|| read_port(port, &code, buffer, sizeof(buffer))
+						!= sizeof(buffer)
+					|| code != i) {
+					info->result = B_ERROR;
+				}
+				break;
+			}
+
+			case TEST_CREATE_DELETE:
+			{
+				port_id other = create_port(1, "scaling test temporary");
+				if (other < 0 || delete_port(other) != B_OK)
+					info->result = B_ERROR;
+				break;
+			}
+
+			case TEST_FIND:
+				if (find_port(name) != port)
+					info->result = B_ERROR;
+				break;
+		}
+	}
+
+	delete_port(port);
+	return B_OK;
+}
+
+
+static bool
+run_test(int32 test, const char* testName, int32 threadCount)
+{
+	thread_id threads[MAX_THREADS];
+	test_info infos[MAX_THREADS];
+
+	bigtime_t startTime = system_time();
+
+	for (int32 i = 0; i < threadCount; i++) {
+		infos[i].test = test;
+		infos[i].index = i;
+		infos[i].result = B_OK;
+		threads[i] = spawn_thread(test_thread, "port test", B_NORMAL_PRIORITY,
+			&infos[i]);
+		resume_thread(threads[i]);
+	}
+
+	bool passed = true;
+	for (int32 i = 0; i < threadCount; i++) {
+		wait_for_thread(threads[i], NULL);
+		if (infos[i].result != B_OK)
+			passed = false;
+	}
+
+	bigtime_t totalTime = system_time() - startTime;
+
+	printf("%-14s %3ld threads: %10.0f ops/s%s\n", testName, threadCount,
+		(double)threadCount * ITERATIONS * 1000000 / totalTime,
+		passed ? "" : "  FAILED");
+	return passed;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+
+	int32 maxThreads = argc > 1 ? atoi(argv[1]) : info.cpu_count * 2;
+	if (maxThreads < 1)
+		maxThreads = 1;
+	if (maxThreads > MAX_THREADS)
+		maxThreads = MAX_THREADS;
+
+	bool passed = true;
+	for (int32 count = 1; count <= maxThreads; count *= 2) {
+		passed &= run_test(TEST_WRITE_READ, "write/read", count);
+		passed &= run_test(TEST_CREATE_DELETE, "create/delete", count);
+		passed &= run_test(TEST_FIND, "find", count);
+	}
+
+	return passed ? 0 : 1;
+}
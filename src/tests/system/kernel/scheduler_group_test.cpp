@@ -0,0 +1,103 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <scheduler_defs.h>
+#include <syscalls.h>
+
+
+static const bigtime_t kQuota = 20000;
+static const bigtime_t kPeriod = 100000;
+static const bigtime_t kRunTime = 2000000;
+
+
+static status_t
+spin_thread(void*)
+{
+	while (true)
+		;
+	return B_OK;
+}
+
+
+static bigtime_t
+team_cpu_time(team_id team)
+{
+	team_usage_info usage;
+	if (get_team_usage_info(team, B_TEAM_USAGE_SELF, &usage) != B_OK)
+		return -1;
+	return usage.user_time + usage.kernel_time;
+}
+
+
+int
+main()
+{
+	system_info systemInfo;
+	get_system_info(&systemInfo);
+
+	int32 group = _kern_create_scheduler_group("test group",
+		SCHEDULER_ROOT_GROUP);
+	if (group < 0) {
+		fprintf(stderr, "creating group failed: %s\n", strerror(group));
+		return 1;
+	}
+
+	status_t status = _kern_set_scheduler_group_limits(group,
+		SCHEDULER_GROUP_DEFAULT_WEIGHT, kQuota, kPeriod);
+	if (status != B_OK) {
+		fprintf(stderr, "setting limits failed: %s\n", strerror(status));
+		return 1;
+	}
+
+	// fork a child that keeps all CPUs busy
+	pid_t child = fork();
+	if (child == 0) {
+		for (uint32 i = 0; i < systemInfo.cpu_count; i++) {
+			resume_thread(spawn_thread(&spin_thread, "spin", B_NORMAL_PRIORITY,
+				NULL));
+		}
+		snooze(B_INFINITE_TIMEOUT);
+		return 0;
+	}
+
+	status = _kern_set_team_scheduler_group(child, group);
+	if (status != B_OK)
+		fprintf(stderr, "moving the child failed: %s\n", strerror(status));
+
+	bigtime_t startTime = team_cpu_time(child);
+	snooze(kRunTime);
+	bigtime_t usedTime = team_cpu_time(child) - startTime;
+
+	scheduler_group_info info;
+	int32 cookie = 0;
+	while (_kern_get_next_scheduler_group_info(&cookie, &info) == B_OK
+		&& info.id != group) {
+	}
+
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+
+	// allow some overrun, since a group is only throttled at a reschedule
+	bigtime_t expectedTime = kRunTime * kQuota / kPeriod;
+	bool passed = status == B_OK && usedTime <= expectedTime * 3 / 2;
+
+	printf("%s: used %" B_PRId64 " us of CPU time in %" B_PRId64 " us, expected"
+		" about %" B_PRId64 " us, throttled for %" B_PRId64 " us\n",
+		passed ? "passed" : "FAILED", usedTime, kRunTime, expectedTime,
+		info.throttled_time);
+
+	_kern_delete_scheduler_group(group);
+	return passed ? 0 : 1;
+}
@@ -2,6 +2,7 @@
 #include <TestSuiteAddon.h>
 
 //#include "AVLTreeMapTest.h"
+#include "Lz4Test.h"
 #include "SinglyLinkedListTest.h"
 #include "DoublyLinkedListTest.h"
 #include "VectorMapTest.h"
@@ -12,6 +13,7 @@
 BTestSuite* getTestSuite() {
 	BTestSuite *suite = new BTestSuite("KernelUtils");
 //	suite->addTest("AVLTreeMap", AVLTreeMapTest::Suite());
+	suite->addTest("LZ4", Lz4Test::Suite());
 	suite->addTest("SinglyLinkedList", SinglyLinkedListTest::Suite());
 	suite->addTest("DoublyLinkedList", DoublyLinkedListTest::Suite());
 	suite->addTest("VectorMap", VectorMapTest::Suite());
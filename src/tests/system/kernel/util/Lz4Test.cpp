@@ -0,0 +1,144 @@
+#include <cppunit/Test.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include <stdlib.h>
+#include <string.h>
+#include <TestUtils.h>
+
+#include "Lz4Test.h"
+#include "lz4.h"
+
+
+static const size_t kBufferSize = 8192;
+
+
+Lz4Test::Lz4Test(std::string name)
+	: BTestCase(name)
+{
+}
+
+
+CppUnit::Test*
+Lz4Test::Suite() {
+	CppUnit::TestSuite *suite = new CppUnit::TestSuite("LZ4");
+
+	suite->addTest(new CppUnit::TestCaller<Lz4Test>("LZ4::Round Trip Test", &Lz4Test::RoundTripTest));
+	suite->addTest(new CppUnit::TestCaller<Lz4Test>("LZ4::Overflow Test", &Lz4Test::OverflowTest));
+	suite->addTest(new CppUnit::TestCaller<Lz4Test>("LZ4::Corrupt Data Test", &Lz4Test::CorruptDataTest));
+
+	return suite;
+}
+
+
+//! Compresses and decompresses the given data, and compares the result
+void
+Lz4Test::TestRoundTrip(const uint8* data, size_t size)
+{
+	uint8 compressed[kBufferSize + kBufferSize / 128];
+	uint8 decompressed[kBufferSize];
+	uint8 workMemory[LZ4_WORK_MEMORY_SIZE];
+
+	NextSubTest();
+	size_t compressedSize = lz4_compress(data, size, compressed,
+		sizeof(compressed), workMemory);
+	CHK(compressedSize > 0);
+
+	ssize_t decompressedSize = lz4_decompress(compressed, compressedSize,
+		decompressed, sizeof(decompressed));
+	CHK(decompressedSize == (ssize_t)size);
+	CHK(memcmp(data, decompressed, size) == 0);
+}
+
+
+void
+Lz4Test::RoundTripTest()
+{
+	uint8 data[kBufferSize];
+
+	// empty and tiny input
+	TestRoundTrip(data, 0);
+	memset(data, 'x', sizeof(data));
+	TestRoundTrip(data, 1);
+	TestRoundTrip(data, 12);
+	TestRoundTrip(data, 13);
+
+	// a zeroed page compresses very well
+	memset(data, 0, sizeof(data));
+	TestRoundTrip(data, 4096);
+
+	// repeating patterns of different lengths
+	for (size_t period = 1; period < 300; period += 7) {
+		for (size_t i = 0; i < sizeof(data); i++)
+			data[i] = (uint8)(i % period);
+		TestRoundTrip(data, sizeof(data));
+	}
+
+	// random data doesn't compress, but must survive
+	srand(42);
+	for (int run = 0; run < 50; run++) {
+		size_t size = rand() % (sizeof(data) + 1);
+		for (size_t i = 0; i < size; i++)
+			data[i] = run % 2 == 0 ? rand() : "abcd efgh"[rand() % 9];
+		TestRoundTrip(data, size);
+	}
+}
+
+
+void
+Lz4Test::OverflowTest()
+{
+	uint8 data[4096];
+	uint8 compressed[kBufferSize];
+	uint8 workMemory[LZ4_WORK_MEMORY_SIZE];
+
+	srand(7);
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = rand();
+
+	// incompressible data doesn't fit into a buffer of its own size
+	NextSubTest();
+	CHK(lz4_compress(data, sizeof(data), compressed, sizeof(data),
+		workMemory) == 0);
+
+	// and compressible data must not fit into a buffer that is one byte short
+	NextSubTest();
+	memset(data, 'a', sizeof(data));
+	size_t size = lz4_compress(data, sizeof(data), compressed,
+		sizeof(compressed), workMemory);
+	CHK(size > 0);
+	CHK(lz4_compress(data, sizeof(data), compressed, size - 1, workMemory)
+		== 0);
+
+	// nor decompress into a buffer that's too small
+	NextSubTest();
+	uint8 decompressed[4096];
+	CHK(lz4_decompress(compressed, size, decompressed,
+		sizeof(decompressed) - 1) < 0);
+}
+
+
+void
+Lz4Test::CorruptDataTest()
+{
+	uint8 decompressed[4096];
+
+	// an offset pointing before the start of the output
+	NextSubTest();
+	const uint8 badOffset[] = { 0x10, 'a', 0x05, 0x00, 0x50, 'b', 'c', 'd',
+		'e', 'f' };
+	CHK(lz4_decompress(badOffset, sizeof(badOffset), decompressed,
+		sizeof(decompressed)) < 0);
+
+	// a zero offset
+	NextSubTest();
+	const uint8 zeroOffset[] = { 0x10, 'a', 0x00, 0x00, 0x50, 'b', 'c', 'd',
+		'e', 'f' };
+	CHK(lz4_decompress(zeroOffset, sizeof(zeroOffset), decompressed,
+		sizeof(decompressed)) < 0);
+
+	// a literal run that exceeds the input
+	NextSubTest();
+	const uint8 truncated[] = { 0xf0, 0x20, 'a', 'b' };
+	CHK(lz4_decompress(truncated, sizeof(truncated), decompressed,
+		sizeof(decompressed)) < 0);
+}
@@ -0,0 +1,20 @@
+#ifndef _lz4_test_h_
+#define _lz4_test_h_
+
+#include <SupportDefs.h>
+#include <TestCase.h>
+
+class Lz4Test : public BTestCase {
+public:
+	Lz4Test(std::string name = "");
+
+	static CppUnit::Test* Suite();
+
+	void RoundTripTest();
+	void OverflowTest();
+	void CorruptDataTest();
+private:
+	void TestRoundTrip(const uint8* data, size_t size);
+};
+
+#endif // _lz4_test_h_
@@ -17,15 +17,25 @@ namespace FSShell {
 fssh_status_t
 command_checkfs(int argc, const char* const* argv)
 {
-	if (argc == 2 && !strcmp(argv[1], "--help")) {
-		fssh_dprintf("Usage: %s [-c]\n"
-			"  -c  Check only; don't perform any changes\n", argv[0]);
-		return B_OK;
-	}
-
 	bool checkOnly = false;
-	if (argc == 2 && !strcmp(argv[1], "-c"))
-		checkOnly = true;
+	bool parallel = false;
+	bool readOnly = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-c"))
+			checkOnly = true;
+		else if (!strcmp(argv[i], "-p"))
+			parallel = checkOnly = true;
+		else if (!strcmp(argv[i], "-o"))
+			readOnly = checkOnly = true;
+		else {
+			fssh_dprintf("Usage: %s [-c] [-p] [-o]\n"
+				"  -c  Check only; don't perform any changes\n"
+				"  -p  Check with several threads (implies -c)\n"
+				"  -o  Check online, without locking the volume (implies -c)\n",
+				argv[0]);
+			return strcmp(argv[i], "--help") ? B_BAD_VALUE : B_OK;
+		}
+	}
 
 	int rootDir = _kern_open_dir(-1, "/myfs");
 	if (rootDir < 0)
@@ -39,6 +49,10 @@ command_checkfs(int argc, const char* const* argv)
 		result.flags |= BFS_FIX_BITMAP_ERRORS | BFS_REMOVE_WRONG_TYPES
 			| BFS_REMOVE_INVALID | BFS_FIX_NAME_MISMATCHES | BFS_FIX_BPLUSTREES;
 	}
+	if (parallel)
+		result.flags |= BFS_CHECK_PARALLEL;
+	if (readOnly)
+		result.flags |= BFS_CHECK_READ_ONLY;
 
 	// start checking
 	fssh_status_t status = _kern_ioctl(rootDir, BFS_IOCTL_START_CHECKING,
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2014, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "fssh_stdio.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+fssh_status_t
+command_explain(int argc, const char* const* argv)
+{
+	if (argc != 2 || !strcmp(argv[1], "--help")) {
+		fssh_dprintf("Usage: %s <query>\n"
+			"  Shows how the query would be run\n", argv[0]);
+		return B_OK;
+	}
+
+	int rootDir = _kern_open_dir(-1, "/myfs");
+	if (rootDir < 0)
+		return rootDir;
+
+	char plan[4096];
+	struct explain_query explain;
+	explain.query = argv[1];
+	explain.query_length = strlen(argv[1]);
+	explain.flags = 0;
+	explain.plan = plan;
+	explain.plan_size = sizeof(plan);
+
+	fssh_status_t status = _kern_ioctl(rootDir, BFS_IOCTL_EXPLAIN_QUERY,
+		&explain, sizeof(explain));
+	_kern_close(rootDir);
+
+	if (status != B_OK)
+		return status;
+
+	fssh_dprintf("%s", plan);
+	return B_OK;
+}
+
+
+}	// namespace FSShell
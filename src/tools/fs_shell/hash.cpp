@@ -172,12 +172,16 @@ hash_remove_current(struct hash_table *table, struct hash_iterator *iterator)
 				} else {
 					table->table[index] = (struct hash_element *)NEXT(table,
 						element);
+					// let hash_next() continue with the new head of this
+					// bucket
+					iterator->bucket = (int)index - 1;
 				}
 
 				table->num_elements--;
 				return;
 			}
 
+			lastElement = element;
 			element = NEXT(table, element);
 		}
 	}
@@ -11,13 +11,15 @@
 #include <string.h>
 
 #include "fssh_errors.h"
+#include "fssh_os.h"
 
 
 fssh_thread_id
 fssh_spawn_kernel_thread(fssh_thread_func function, const char *threadName,
 	int32_t priority, void *arg)
 {
-	return FSSH_B_ERROR;
+	// the FS shell is the kernel
+	return fssh_spawn_thread(function, threadName, priority, arg);
 }
 
 
@@ -7,12 +7,21 @@
 
 #include <string.h>
 
+#if (!defined(__BEOS__) && !defined(__HAIKU__))
+#	include <errno.h>
+#	include <pthread.h>
+#	include <sys/time.h>
+#endif
+
 #include <OS.h>
 
 #include "fssh_errors.h"
 #include "fssh_os.h"
 
 
+#if (defined(__BEOS__) || defined(__HAIKU__))
+
+
 static void
 copy_sem_info(fssh_sem_info* info, const sem_info* systemInfo)
 {
@@ -115,3 +124,313 @@ _fssh_get_next_sem_info(fssh_team_id team, int32_t *cookie,
 	return FSSH_B_OK;
 }
 
+
+#else	// !__BEOS__ && !__HAIKU__
+
+
+// The semaphores of the build platform's libroot assume a single thread.
+// Since the FS shell can run kernel threads (see thread.cpp), it implements
+// real semaphores on top of pthreads instead.
+
+struct semaphore {
+	fssh_sem_id		id;
+	int32_t			count;
+	int32_t			waiting;
+	fssh_thread_id	latest_holder;
+	bool			in_use;
+	char			name[FSSH_B_OS_NAME_LENGTH];
+};
+
+static const int32_t kSemaphoreCount = 40960;
+static const int32_t kMaxSemaphoreGeneration = 0x7fff;
+	// A semaphore ID is its slot plus a multiple of kSemaphoreCount, so that
+	// a thread that waited on a deleted semaphore doesn't end up waiting on
+	// its successor in the same slot.
+
+static semaphore sSemaphores[kSemaphoreCount];
+static int32_t sNextSemaphore = 0;
+static pthread_mutex_t sSemaphoreLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sSemaphoreCondition = PTHREAD_COND_INITIALIZER;
+
+
+/*!	Returns the semaphore with the given \a id, or \c NULL if there is none.
+	The semaphore lock must be held.
+*/
+static semaphore*
+lookup_sem(fssh_sem_id id)
+{
+	if (id < 0)
+		return NULL;
+
+	semaphore& sem = sSemaphores[id % kSemaphoreCount];
+	if (!sem.in_use || sem.id != id)
+		return NULL;
+
+	return &sem;
+}
+
+
+static void
+copy_sem_info(fssh_sem_info* info, const semaphore& sem)
+{
+	info->sem = sem.id;
+	info->team = 1;
+	strcpy(info->name, sem.name);
+	info->count = sem.waiting > 0 ? -sem.waiting : sem.count;
+	info->latest_holder = sem.latest_holder;
+}
+
+
+// #pragma mark -
+
+
+fssh_sem_id
+fssh_create_sem(int32_t count, const char *name)
+{
+	if (count < 0)
+		return FSSH_B_BAD_VALUE;
+
+	pthread_mutex_lock(&sSemaphoreLock);
+
+	for (int32_t i = 0; i < kSemaphoreCount; i++) {
+		int32_t slot = (sNextSemaphore + i) % kSemaphoreCount;
+		semaphore& sem = sSemaphores[slot];
+		if (sem.in_use)
+			continue;
+
+		int32_t generation = sem.id / kSemaphoreCount + 1;
+		if (generation > kMaxSemaphoreGeneration)
+			generation = 0;
+
+		sem.id = generation * kSemaphoreCount + slot;
+		sem.count = count;
+		sem.waiting = 0;
+		sem.latest_holder = -1;
+		sem.in_use = true;
+		strlcpy(sem.name, name != NULL ? name : "unnamed sem",
+			sizeof(sem.name));
+
+		sNextSemaphore = slot + 1;
+		pthread_mutex_unlock(&sSemaphoreLock);
+		return sem.id;
+	}
+
+	pthread_mutex_unlock(&sSemaphoreLock);
+	return FSSH_B_NO_MORE_SEMS;
+}
+
+
+fssh_status_t
+fssh_delete_sem(fssh_sem_id id)
+{
+	pthread_mutex_lock(&sSemaphoreLock);
+
+	semaphore* sem = lookup_sem(id);
+	if (sem == NULL) {
+		pthread_mutex_unlock(&sSemaphoreLock);
+		return FSSH_B_BAD_SEM_ID;
+	}
+
+	sem->in_use = false;
+
+	// wake up the threads waiting on it
+	pthread_cond_broadcast(&sSemaphoreCondition);
+	pthread_mutex_unlock(&sSemaphoreLock);
+	return FSSH_B_OK;
+}
+
+
+fssh_status_t
+fssh_acquire_sem(fssh_sem_id id)
+{
+	return fssh_acquire_sem_etc(id, 1, 0, 0);
+}
+
+
+fssh_status_t
+fssh_acquire_sem_etc(fssh_sem_id id, int32_t count, uint32_t flags,
+	fssh_bigtime_t timeout)
+{
+	if (count <= 0)
+		return FSSH_B_BAD_VALUE;
+
+	// compute the absolute time when to time out
+	bool hasTimeout = false;
+	struct timespec until;
+	if ((flags & (FSSH_B_RELATIVE_TIMEOUT | FSSH_B_ABSOLUTE_TIMEOUT)) != 0
+		&& timeout != FSSH_B_INFINITE_TIMEOUT) {
+		if ((flags & FSSH_B_ABSOLUTE_TIMEOUT) != 0)
+			timeout -= fssh_system_time();
+		if (timeout < 0)
+			timeout = 0;
+
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		int64_t micros = now.tv_usec + timeout % 1000000;
+		until.tv_sec = now.tv_sec + timeout / 1000000 + micros / 1000000;
+		until.tv_nsec = (micros % 1000000) * 1000;
+		hasTimeout = true;
+	}
+
+	pthread_mutex_lock(&sSemaphoreLock);
+
+	semaphore* sem = lookup_sem(id);
+	if (sem == NULL) {
+		pthread_mutex_unlock(&sSemaphoreLock);
+		return FSSH_B_BAD_SEM_ID;
+	}
+
+	fssh_status_t status = FSSH_B_OK;
+
+	if (sem->count < count) {
+		if (hasTimeout && timeout == 0) {
+			pthread_mutex_unlock(&sSemaphoreLock);
+			return FSSH_B_WOULD_BLOCK;
+		}
+
+		sem->waiting++;
+
+		while (true) {
+			int result = hasTimeout
+				? pthread_cond_timedwait(&sSemaphoreCondition,
+					&sSemaphoreLock, &until)
+				: pthread_cond_wait(&sSemaphoreCondition, &sSemaphoreLock);
+
+			// the semaphore might have been deleted in the mean time
+			sem = lookup_sem(id);
+			if (sem == NULL) {
+				status = FSSH_B_BAD_SEM_ID;
+				break;
+			}
+			if (sem->count >= count)
+				break;
+			if (result == ETIMEDOUT) {
+				status = FSSH_B_TIMED_OUT;
+				break;
+			}
+		}
+
+		if (sem != NULL)
+			sem->waiting--;
+	}
+
+	if (status == FSSH_B_OK) {
+		sem->count -= count;
+		sem->latest_holder = fssh_find_thread(NULL);
+	}
+
+	pthread_mutex_unlock(&sSemaphoreLock);
+	return status;
+}
+
+
+fssh_status_t
+fssh_release_sem(fssh_sem_id id)
+{
+	return fssh_release_sem_etc(id, 1, 0);
+}
+
+
+fssh_status_t
+fssh_release_sem_etc(fssh_sem_id id, int32_t count, uint32_t flags)
+{
+	if (count <= 0 && (flags & FSSH_B_RELEASE_ALL) == 0)
+		return FSSH_B_BAD_VALUE;
+
+	pthread_mutex_lock(&sSemaphoreLock);
+
+	semaphore* sem = lookup_sem(id);
+	if (sem == NULL) {
+		pthread_mutex_unlock(&sSemaphoreLock);
+		return FSSH_B_BAD_SEM_ID;
+	}
+
+	if ((flags & FSSH_B_RELEASE_ALL) != 0)
+		count = sem->waiting;
+	sem->count += count;
+
+	if (sem->waiting > 0)
+		pthread_cond_broadcast(&sSemaphoreCondition);
+
+	pthread_mutex_unlock(&sSemaphoreLock);
+	return FSSH_B_OK;
+}
+
+
+fssh_status_t
+fssh_get_sem_count(fssh_sem_id id, int32_t *threadCount)
+{
+	if (threadCount == NULL)
+		return FSSH_B_BAD_VALUE;
+
+	pthread_mutex_lock(&sSemaphoreLock);
+
+	semaphore* sem = lookup_sem(id);
+	if (sem == NULL) {
+		pthread_mutex_unlock(&sSemaphoreLock);
+		return FSSH_B_BAD_SEM_ID;
+	}
+
+	*threadCount = sem->waiting > 0 ? -sem->waiting : sem->count;
+
+	pthread_mutex_unlock(&sSemaphoreLock);
+	return FSSH_B_OK;
+}
+
+
+fssh_status_t
+fssh_set_sem_owner(fssh_sem_id id, fssh_team_id team)
+{
+	// The FS shell is the kernel and no other teams exist.
+	return FSSH_B_OK;
+}
+
+
+fssh_status_t
+_fssh_get_sem_info(fssh_sem_id id, struct fssh_sem_info *info,
+	fssh_size_t infoSize)
+{
+	if (info == NULL)
+		return FSSH_B_BAD_VALUE;
+
+	pthread_mutex_lock(&sSemaphoreLock);
+
+	semaphore* sem = lookup_sem(id);
+	if (sem == NULL) {
+		pthread_mutex_unlock(&sSemaphoreLock);
+		return FSSH_B_BAD_SEM_ID;
+	}
+
+	copy_sem_info(info, *sem);
+
+	pthread_mutex_unlock(&sSemaphoreLock);
+	return FSSH_B_OK;
+}
+
+
+fssh_status_t
+_fssh_get_next_sem_info(fssh_team_id team, int32_t *cookie,
+	struct fssh_sem_info *info, fssh_size_t infoSize)
+{
+	if (cookie == NULL || info == NULL || *cookie < 0)
+		return FSSH_B_BAD_VALUE;
+
+	pthread_mutex_lock(&sSemaphoreLock);
+
+	for (int32_t i = *cookie; i < kSemaphoreCount; i++) {
+		if (!sSemaphores[i].in_use)
+			continue;
+
+		copy_sem_info(info, sSemaphores[i]);
+		*cookie = i + 1;
+
+		pthread_mutex_unlock(&sSemaphoreLock);
+		return FSSH_B_OK;
+	}
+
+	pthread_mutex_unlock(&sSemaphoreLock);
+	return FSSH_B_ENTRY_NOT_FOUND;
+}
+
+
+#endif	// !__BEOS__ && !__HAIKU__
@@ -7,11 +7,28 @@
 
 #include "fssh_os.h"
 
+#include <string.h>
+
+#if (!defined(__BEOS__) && !defined(__HAIKU__))
+#	include <pthread.h>
+#endif
+
 #include <OS.h>
 
 #include "fssh_errors.h"
 
 
+#if (defined(__BEOS__) || defined(__HAIKU__))
+
+
+fssh_thread_id
+fssh_spawn_thread(fssh_thread_func function, const char *name,
+	int32_t priority, void *data)
+{
+	return spawn_thread((thread_func)function, name, priority, data);
+}
+
+
 fssh_status_t
 fssh_kill_thread(fssh_thread_id thread)
 {
@@ -33,13 +50,221 @@ fssh_suspend_thread(fssh_thread_id thread)
 }
 
 
-fssh_thread_id 
+fssh_status_t
+fssh_wait_for_thread(fssh_thread_id thread, fssh_status_t *threadReturnValue)
+{
+	return wait_for_thread(thread, (status_t*)threadReturnValue);
+}
+
+
+fssh_thread_id
 fssh_find_thread(const char *name)
 {
 	return find_thread(name);
 }
 
 
+#else	// !__BEOS__ && !__HAIKU__
+
+
+// The threads of the build platform's libroot are fakes; the FS shell runs
+// the threads spawned by the file system on top of pthreads instead.
+
+struct thread_slot {
+	fssh_thread_id		id;
+	fssh_thread_func	function;
+	void*				data;
+	fssh_status_t		return_value;
+	bool				in_use;
+	bool				resumed;
+	bool				exited;
+	char				name[FSSH_B_OS_NAME_LENGTH];
+};
+
+static const int32_t kMaxThreads = 256;
+static const fssh_thread_id kFirstThreadID = 1000;
+	// well above the ID find_thread() returns for the main thread
+
+static thread_slot sThreads[kMaxThreads];
+static fssh_thread_id sNextThreadID = kFirstThreadID;
+static pthread_mutex_t sThreadLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sThreadCondition = PTHREAD_COND_INITIALIZER;
+static __thread fssh_thread_id sCurrentThread = -1;
+
+
+/*!	Returns the slot of the thread with the given \a id, or \c NULL if there
+	is none. The thread lock must be held.
+*/
+static thread_slot*
+lookup_thread(fssh_thread_id id)
+{
+	for (int32_t i = 0; i < kMaxThreads; i++) {
+		if (sThreads[i].in_use && sThreads[i].id == id)
+			return &sThreads[i];
+	}
+
+	return NULL;
+}
+
+
+static void*
+run_thread(void* _slot)
+{
+	thread_slot* slot = (thread_slot*)_slot;
+
+	// like on Haiku, new threads are suspended until they are resumed
+	pthread_mutex_lock(&sThreadLock);
+	while (!slot->resumed)
+		pthread_cond_wait(&sThreadCondition, &sThreadLock);
+
+	sCurrentThread = slot->id;
+	fssh_thread_func function = slot->function;
+	void* data = slot->data;
+	pthread_mutex_unlock(&sThreadLock);
+
+	fssh_status_t returnValue = function(data);
+
+	pthread_mutex_lock(&sThreadLock);
+	slot->return_value = returnValue;
+	slot->exited = true;
+	pthread_cond_broadcast(&sThreadCondition);
+	pthread_mutex_unlock(&sThreadLock);
+
+	return NULL;
+}
+
+
+fssh_thread_id
+fssh_spawn_thread(fssh_thread_func function, const char *name,
+	int32_t priority, void *data)
+{
+	if (function == NULL)
+		return FSSH_B_BAD_VALUE;
+
+	pthread_mutex_lock(&sThreadLock);
+
+	// The slot of an exited thread is kept until someone waited for it
+	thread_slot* slot = NULL;
+	for (int32_t i = 0; i < kMaxThreads; i++) {
+		if (!sThreads[i].in_use) {
+			slot = &sThreads[i];
+			break;
+		}
+	}
+	if (slot == NULL) {
+		pthread_mutex_unlock(&sThreadLock);
+		return FSSH_B_NO_MORE_THREADS;
+	}
+
+	slot->id = sNextThreadID++;
+	slot->function = function;
+	slot->data = data;
+	slot->return_value = FSSH_B_OK;
+	slot->in_use = true;
+	slot->resumed = false;
+	slot->exited = false;
+	strlcpy(slot->name, name != NULL ? name : "unnamed thread",
+		sizeof(slot->name));
+
+	pthread_attr_t attributes;
+	pthread_attr_init(&attributes);
+	pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+	pthread_t thread;
+	int result = pthread_create(&thread, &attributes, &run_thread, slot);
+	pthread_attr_destroy(&attributes);
+
+	if (result != 0) {
+		slot->in_use = false;
+		pthread_mutex_unlock(&sThreadLock);
+		return FSSH_B_NO_MORE_THREADS;
+	}
+
+	fssh_thread_id id = slot->id;
+	pthread_mutex_unlock(&sThreadLock);
+	return id;
+}
+
+
+fssh_status_t
+fssh_kill_thread(fssh_thread_id thread)
+{
+	return kill_thread(thread);
+}
+
+
+fssh_status_t
+fssh_resume_thread(fssh_thread_id thread)
+{
+	pthread_mutex_lock(&sThreadLock);
+
+	thread_slot* slot = lookup_thread(thread);
+	if (slot == NULL || slot->exited) {
+		pthread_mutex_unlock(&sThreadLock);
+		return resume_thread(thread);
+	}
+
+	fssh_status_t status = FSSH_B_BAD_THREAD_STATE;
+	if (!slot->resumed) {
+		slot->resumed = true;
+		pthread_cond_broadcast(&sThreadCondition);
+		status = FSSH_B_OK;
+	}
+
+	pthread_mutex_unlock(&sThreadLock);
+	return status;
+}
+
+
+fssh_status_t
+fssh_suspend_thread(fssh_thread_id thread)
+{
+	return suspend_thread(thread);
+}
+
+
+fssh_status_t
+fssh_wait_for_thread(fssh_thread_id thread, fssh_status_t *threadReturnValue)
+{
+	pthread_mutex_lock(&sThreadLock);
+
+	thread_slot* slot = lookup_thread(thread);
+	if (slot == NULL) {
+		pthread_mutex_unlock(&sThreadLock);
+		return FSSH_B_BAD_THREAD_ID;
+	}
+
+	// a suspended thread would never exit
+	if (!slot->resumed) {
+		slot->resumed = true;
+		pthread_cond_broadcast(&sThreadCondition);
+	}
+
+	while (!slot->exited)
+		pthread_cond_wait(&sThreadCondition, &sThreadLock);
+
+	if (threadReturnValue != NULL)
+		*threadReturnValue = slot->return_value;
+	slot->in_use = false;
+
+	pthread_mutex_unlock(&sThreadLock);
+	return FSSH_B_OK;
+}
+
+
+fssh_thread_id
+fssh_find_thread(const char *name)
+{
+	if (name == NULL && sCurrentThread >= 0)
+		return sCurrentThread;
+
+	return find_thread(name);
+}
+
+
+#endif	// !__BEOS__ && !__HAIKU__
+
+
 fssh_status_t
 fssh_snooze(fssh_bigtime_t amount)
 {